@@ -9,6 +9,9 @@ import PackageDescription
 // For session support:
 //  - Uncomment lines containing `SQLITE_ENABLE_PREUPDATE_HOOK`
 //  - Uncomment lines containing `SQLITE_ENABLE_SESSION`
+//
+// For statement scan status support (per-loop metrics in `Statement.scanStatus()` and `Statement.explainQueryPlan()`):
+//  - Uncomment lines containing `SQLITE_ENABLE_STMT_SCANSTATUS`
 
 let package = Package(
 	name: "FeistyDB",
@@ -23,6 +26,9 @@ let package = Package(
 		.library(
 			name: "CSQLite",
 			targets: ["CSQLite"]),
+		.executable(
+			name: "feisty-db-benchmarks",
+			targets: ["FeistyDBBenchmarks"]),
 	],
 	dependencies: [
 		// Dependencies declare other packages that this package depends on.
@@ -84,14 +90,15 @@ let package = Package(
 				.define("SQLITE_DEFAULT_WAL_SYNCHRONOUS", to: "1"),
 				.define("SQLITE_LIKE_DOESNT_MATCH_BLOBS"),
 				.define("SQLITE_MAX_EXPR_DEPTH", to: "0"),
+				.define("SQLITE_MAX_MMAP_SIZE", to: "0x1000000000"),
 				.define("SQLITE_OMIT_DECLTYPE", to: "1"),
 				.define("SQLITE_OMIT_DEPRECATED", to: "1"),
-				.define("SQLITE_OMIT_PROGRESS_CALLBACK", to: "1"),
 				.define("SQLITE_OMIT_SHARED_CACHE", to: "1"),
 				.define("SQLITE_USE_ALLOCA", to: "1"),
 				.define("SQLITE_OMIT_DEPRECATED", to: "1"),
 //				.define("SQLITE_ENABLE_PREUPDATE_HOOK", to: "1"),
 //				.define("SQLITE_ENABLE_SESSION", to: "1"),
+//				.define("SQLITE_ENABLE_STMT_SCANSTATUS", to: "1"),
 				.define("SQLITE_ENABLE_FTS5", to: "1"),
 				.define("SQLITE_ENABLE_RTREE", to: "1"),
 				.define("SQLITE_ENABLE_STAT4", to: "1"),
@@ -103,6 +110,12 @@ let package = Package(
 		linkerSettings: [
 			.linkedLibrary("m")
 		]),
+		.target(
+			name: "CMallocCounter",
+			dependencies: []),
+		.target(
+			name: "FeistyDBBenchmarks",
+			dependencies: ["FeistyDB", "CSQLite", "CMallocCounter"]),
 		.testTarget(
 			name: "FeistyDBTests",
 			dependencies: ["FeistyDB"]
@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+#include "feisty_db_malloc_counter.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+static atomic_uint_fast64_t allocation_count;
+static atomic_int is_counting;
+
+static inline void count_allocation(void)
+{
+	if(atomic_load_explicit(&is_counting, memory_order_relaxed))
+		atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+}
+
+#if defined(__APPLE__)
+
+// The malloc logger is invoked by libmalloc for every allocation and deallocation in every zone.
+// It is declared in libmalloc's stack_logging.h, which is not part of the SDK
+typedef void (malloc_logger_t)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip);
+extern malloc_logger_t *malloc_logger;
+
+#define MALLOC_LOG_TYPE_ALLOCATE 2
+
+static void counting_malloc_logger(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip)
+{
+	(void)arg1; (void)arg2; (void)arg3; (void)result; (void)num_hot_frames_to_skip;
+	// realloc is logged once with both the allocate and deallocate bits set
+	if(type & MALLOC_LOG_TYPE_ALLOCATE)
+		count_allocation();
+}
+
+int feisty_db_malloc_counter_install(void)
+{
+	if(malloc_logger && malloc_logger != counting_malloc_logger)
+		return 0;
+	malloc_logger = counting_malloc_logger;
+	atomic_store(&is_counting, 1);
+	return 1;
+}
+
+#elif defined(__GLIBC__)
+
+// Definitions in the executable take precedence over libc's, so these replace the allocation functions
+// for the entire process and forward to glibc's implementations.  free() is not replaced.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size)
+{
+	count_allocation();
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+	count_allocation();
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	count_allocation();
+	return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+	count_allocation();
+	return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+	count_allocation();
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+	if(alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+		return EINVAL;
+	count_allocation();
+	void *p = __libc_memalign(alignment, size);
+	if(!p)
+		return ENOMEM;
+	*ptr = p;
+	return 0;
+}
+
+int feisty_db_malloc_counter_install(void)
+{
+	atomic_store(&is_counting, 1);
+	return 1;
+}
+
+#else
+
+int feisty_db_malloc_counter_install(void)
+{
+	return 0;
+}
+
+#endif
+
+uint64_t feisty_db_malloc_counter_count(void)
+{
+	return atomic_load_explicit(&allocation_count, memory_order_relaxed);
+}
@@ -0,0 +1,18 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+#pragma once
+
+#include <stdint.h>
+
+/// Starts counting heap allocations made by the process through `malloc`, `calloc`, `realloc` and the aligned allocation functions
+///
+/// Allocations are counted on Darwin using the malloc logger and on glibc by interposing the allocation functions.
+/// Returns `1` if allocations are counted or `0` if counting is unsupported on the platform
+int feisty_db_malloc_counter_install(void);
+
+/// Returns the number of heap allocations counted since `feisty_db_malloc_counter_install()` was called
+uint64_t feisty_db_malloc_counter_count(void);
@@ -12,6 +12,37 @@ char * feisty_db_sqlite3_strdup(const char *s)
 }
 
 
+int feisty_db_sqlite3_config_memstatus(int x)
+{
+	return sqlite3_config(SQLITE_CONFIG_MEMSTATUS, x);
+}
+
+int feisty_db_sqlite3_config_pagecache(void *p, int sz, int n)
+{
+	return sqlite3_config(SQLITE_CONFIG_PAGECACHE, p, sz, n);
+}
+
+int feisty_db_sqlite3_config_pcache_hdrsz(int *x)
+{
+	return sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, x);
+}
+
+int feisty_db_sqlite3_config_malloc(const sqlite3_mem_methods *x)
+{
+	return sqlite3_config(SQLITE_CONFIG_MALLOC, x);
+}
+
+int feisty_db_sqlite3_config_getmalloc(sqlite3_mem_methods *x)
+{
+	return sqlite3_config(SQLITE_CONFIG_GETMALLOC, x);
+}
+
+
+int feisty_db_sqlite3_db_config_lookaside(sqlite3 *db, void *p, int sz, int n)
+{
+	return sqlite3_db_config(db, SQLITE_DBCONFIG_LOOKASIDE, p, sz, n);
+}
+
 int feisty_db_sqlite3_db_config_enable_fkey(sqlite3 *db, int x, int *y)
 {
 	return sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_FKEY, x, y);
@@ -87,3 +118,64 @@ int feisty_db_sqlite3_vtab_config_directonly(sqlite3 *db)
 {
 	return sqlite3_vtab_config(db, SQLITE_VTAB_DIRECTONLY);
 }
+
+
+int feisty_db_sqlite3_vtab_in(sqlite3_index_info *p, int i, int b)
+{
+#if SQLITE_VERSION_NUMBER >= 3038000
+	return sqlite3_vtab_in(p, i, b);
+#else
+	(void)p; (void)i; (void)b;
+	return 0;
+#endif
+}
+
+int feisty_db_sqlite3_vtab_in_first(sqlite3_value *p, sqlite3_value **pp)
+{
+#if SQLITE_VERSION_NUMBER >= 3038000
+	return sqlite3_vtab_in_first(p, pp);
+#else
+	(void)p; (void)pp;
+	return SQLITE_MISUSE;
+#endif
+}
+
+int feisty_db_sqlite3_vtab_in_next(sqlite3_value *p, sqlite3_value **pp)
+{
+#if SQLITE_VERSION_NUMBER >= 3038000
+	return sqlite3_vtab_in_next(p, pp);
+#else
+	(void)p; (void)pp;
+	return SQLITE_MISUSE;
+#endif
+}
+
+int feisty_db_sqlite3_vtab_rhs_value(sqlite3_index_info *p, int i, sqlite3_value **pp)
+{
+#if SQLITE_VERSION_NUMBER >= 3038000
+	return sqlite3_vtab_rhs_value(p, i, pp);
+#else
+	(void)p; (void)i; (void)pp;
+	return SQLITE_NOTFOUND;
+#endif
+}
+
+
+int feisty_db_sqlite3_stmt_scanstatus(sqlite3_stmt *p, int idx, int op, void *out)
+{
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+	return sqlite3_stmt_scanstatus(p, idx, op, out);
+#else
+	(void)p; (void)idx; (void)op; (void)out;
+	return 1;
+#endif
+}
+
+void feisty_db_sqlite3_stmt_scanstatus_reset(sqlite3_stmt *p)
+{
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+	sqlite3_stmt_scanstatus_reset(p);
+#else
+	(void)p;
+#endif
+}
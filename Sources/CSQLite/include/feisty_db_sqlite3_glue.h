@@ -11,6 +11,19 @@
 /// Duplicates and returns `s` using memory allocated by `sqlite3_malloc()`
 char * feisty_db_sqlite3_strdup(const char *s);
 
+/// Equivalent to `sqlite3_config(SQLITE_CONFIG_MEMSTATUS, x)`
+int feisty_db_sqlite3_config_memstatus(int x);
+/// Equivalent to `sqlite3_config(SQLITE_CONFIG_PAGECACHE, p, sz, n)`
+int feisty_db_sqlite3_config_pagecache(void *p, int sz, int n);
+/// Equivalent to `sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, x)`
+int feisty_db_sqlite3_config_pcache_hdrsz(int *x);
+/// Equivalent to `sqlite3_config(SQLITE_CONFIG_MALLOC, x)`
+int feisty_db_sqlite3_config_malloc(const sqlite3_mem_methods *x);
+/// Equivalent to `sqlite3_config(SQLITE_CONFIG_GETMALLOC, x)`
+int feisty_db_sqlite3_config_getmalloc(sqlite3_mem_methods *x);
+
+/// Equivalent to `sqlite3_db_config(db, SQLITE_DBCONFIG_LOOKASIDE, p, sz, n)`
+int feisty_db_sqlite3_db_config_lookaside(sqlite3 *db, void *p, int sz, int n);
 /// Equivalent to `sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_FKEY, x, y)`
 int feisty_db_sqlite3_db_config_enable_fkey(sqlite3 *db, int x, int *y);
 /// Equivalent to `sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_TRIGGER, x, y)`
@@ -43,11 +56,38 @@ int feisty_db_sqlite3_vtab_config_innocuous(sqlite3 *db);
 /// Equivalent to `sqlite3_vtab_config(db, SQLITE_VTAB_DIRECTONLY)`
 int feisty_db_sqlite3_vtab_config_directonly(sqlite3 *db);
 
+// Virtual table query planning interfaces added in SQLite 3.38.0
+
+#ifndef SQLITE_INDEX_CONSTRAINT_LIMIT
+#define SQLITE_INDEX_CONSTRAINT_LIMIT      73
+#endif
+#ifndef SQLITE_INDEX_CONSTRAINT_OFFSET
+#define SQLITE_INDEX_CONSTRAINT_OFFSET     74
+#endif
+
+/// Equivalent to `sqlite3_vtab_in(p, i, b)`, or returns `0` if unsupported by the SQLite version
+int feisty_db_sqlite3_vtab_in(sqlite3_index_info *p, int i, int b);
+/// Equivalent to `sqlite3_vtab_in_first(p, pp)`, or returns `SQLITE_MISUSE` if unsupported by the SQLite version
+int feisty_db_sqlite3_vtab_in_first(sqlite3_value *p, sqlite3_value **pp);
+/// Equivalent to `sqlite3_vtab_in_next(p, pp)`, or returns `SQLITE_MISUSE` if unsupported by the SQLite version
+int feisty_db_sqlite3_vtab_in_next(sqlite3_value *p, sqlite3_value **pp);
+/// Equivalent to `sqlite3_vtab_rhs_value(p, i, pp)`, or returns `SQLITE_NOTFOUND` if unsupported by the SQLite version
+int feisty_db_sqlite3_vtab_rhs_value(sqlite3_index_info *p, int i, sqlite3_value **pp);
+
+// Prepared statement scan status interfaces, available when SQLite is compiled with SQLITE_ENABLE_STMT_SCANSTATUS
+
+/// Equivalent to `sqlite3_stmt_scanstatus(p, idx, op, out)`, or returns `1` if scan status is unavailable
+int feisty_db_sqlite3_stmt_scanstatus(sqlite3_stmt *p, int idx, int op, void *out);
+/// Equivalent to `sqlite3_stmt_scanstatus_reset(p)`, or does nothing if scan status is unavailable
+void feisty_db_sqlite3_stmt_scanstatus_reset(sqlite3_stmt *p);
+
 struct feisty_db_sqlite3_vtab {
 	/// sqlite3 required fields
 	sqlite3_vtab base;
 	/// `UnsafeMutablePointer<VirtualTableModule>`
 	void *virtual_table_module_ptr;
+	/// `UnsafeMutablePointer<WritableVirtualTable>`, or `NULL` if the virtual table is read-only
+	void *writable_virtual_table_ptr;
 };
 typedef struct feisty_db_sqlite3_vtab feisty_db_sqlite3_vtab;
 
@@ -0,0 +1,200 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+extension BLOB {
+	/// The default chunk size used for streaming BLOB I/O
+	public static let defaultChunkSize = 64 * 1024
+
+	/// Reads the BLOB in fixed-size chunks.
+	///
+	/// A single buffer of `chunkSize` bytes is reused for all chunks so memory use is independent of the BLOB's length.
+	///
+	/// - important: The buffer passed to `body` must not be used outside of `body`.
+	///
+	/// - requires: `chunkSize > 0`
+	///
+	/// - parameter chunkSize: The maximum number of bytes in each chunk
+	/// - parameter body: A closure processing each chunk
+	/// - parameter chunk: The bytes of the chunk
+	/// - parameter offset: The offset of the chunk in the BLOB
+	///
+	/// - throws: An error if a read error occurs or any error thrown in `body`
+	public func readChunks(chunkSize: Int = BLOB.defaultChunkSize, _ body: (_ chunk: UnsafeRawBufferPointer, _ offset: Int) throws -> Void) throws {
+		precondition(chunkSize > 0, "chunkSize must be positive")
+		let length = self.length
+		let buffer = UnsafeMutableRawBufferPointer.allocate(byteCount: min(chunkSize, max(length, 1)), alignment: 1)
+		defer {
+			buffer.deallocate()
+		}
+
+		var offset = 0
+		while offset < length {
+			let count = min(buffer.count, length - offset)
+			try read(buffer.baseAddress.unsafelyUnwrapped, length: count, from: offset)
+			try body(UnsafeRawBufferPointer(rebasing: buffer[0 ..< count]), offset)
+			offset += count
+		}
+	}
+
+	/// Writes the contents of the BLOB to `stream`.
+	///
+	/// - note: `stream` must be open.
+	///
+	/// - parameter stream: The destination for the BLOB's contents
+	/// - parameter chunkSize: The maximum number of bytes to copy at once
+	///
+	/// - throws: An error if a read or write error occurs
+	public func write(to stream: OutputStream, chunkSize: Int = BLOB.defaultChunkSize) throws {
+		try readChunks(chunkSize: chunkSize) { chunk, offset in
+			var written = 0
+			while written < chunk.count {
+				let count = stream.write(chunk.baseAddress.unsafelyUnwrapped.advanced(by: written).assumingMemoryBound(to: UInt8.self), maxLength: chunk.count - written)
+				guard count > 0 else {
+					throw stream.streamError ?? DatabaseError("Error writing BLOB to stream at offset \(offset + written)")
+				}
+				written += count
+			}
+		}
+	}
+
+	/// Overwrites the contents of the BLOB with bytes read from `stream`.
+	///
+	/// - note: `stream` must be open.
+	/// - note: It is not possible to change the size of a BLOB. If `stream` contains fewer bytes than `length`
+	/// the remainder of the BLOB is unchanged; if `stream` contains more bytes an error is thrown.
+	///
+	/// - parameter stream: The source of the BLOB's new contents
+	/// - parameter chunkSize: The maximum number of bytes to copy at once
+	///
+	/// - throws: An error if a read or write error occurs or `stream` contains more than `length` bytes
+	///
+	/// - returns: The number of bytes written
+	@discardableResult public func write(from stream: InputStream, chunkSize: Int = BLOB.defaultChunkSize) throws -> Int {
+		precondition(chunkSize > 0, "chunkSize must be positive")
+		let length = self.length
+		let buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: chunkSize)
+		defer {
+			buffer.deallocate()
+		}
+
+		var offset = 0
+		while true {
+			let count = stream.read(buffer, maxLength: chunkSize)
+			guard count >= 0 else {
+				throw stream.streamError ?? DatabaseError("Error reading stream for BLOB at offset \(offset)")
+			}
+			if count == 0 {
+				break
+			}
+			guard offset + count <= length else {
+				throw DatabaseError("Stream contains more than \(length) bytes")
+			}
+			try write(buffer, length: count, from: offset)
+			offset += count
+		}
+
+		return offset
+	}
+}
+
+extension Database {
+	/// Inserts a row containing the contents of `stream` as a BLOB without loading the contents into memory.
+	///
+	/// A zero-filled BLOB of `length` bytes is inserted using `zeroblob()` and then overwritten
+	/// incrementally with bytes read from `stream`, all within a savepoint.
+	///
+	/// - note: `stream` must be open.
+	///
+	/// - parameter stream: The source of the BLOB's contents
+	/// - parameter length: The number of bytes in `stream`
+	/// - parameter schema: The symbolic name of the database such as `main` or `temp`
+	/// - parameter table: The name of the table in `schema`
+	/// - parameter column: The name of the BLOB column in `table`
+	/// - parameter chunkSize: The maximum number of bytes to copy at once
+	///
+	/// - throws: An error if the row couldn't be inserted or `stream` couldn't be read
+	///
+	/// - returns: The rowid of the inserted row
+	@discardableResult public func insertBLOB(from stream: InputStream, length: Int, schema: String = "main", table: String, column: String, chunkSize: Int = BLOB.defaultChunkSize) throws -> Int64 {
+		var rowid: Int64 = 0
+		try savepoint { database in
+			let statement = try database.prepare(sql: "INSERT INTO \(BulkInserter.quote(schema)).\(BulkInserter.quote(table))(\(BulkInserter.quote(column))) VALUES (?);")
+			try statement.bindZeroBLOB(toParameter: 1, length: length)
+			try statement.execute()
+			rowid = sqlite3_last_insert_rowid(database.db)
+
+			// The BLOB handle must be closed before the savepoint is released
+			let written = try { () -> Int in
+				let blob = try database.openBLOB(schema, table: table, column: column, row: rowid, readOnly: false)
+				return try blob.write(from: stream, chunkSize: chunkSize)
+			}()
+			guard written == length else {
+				throw DatabaseError("Stream contained \(written) bytes but \(length) were expected")
+			}
+			return .release
+		}
+		return rowid
+	}
+
+	/// Inserts a row containing the contents of the file at `url` as a BLOB without loading the file into memory.
+	///
+	/// - parameter url: The location of the file
+	/// - parameter schema: The symbolic name of the database such as `main` or `temp`
+	/// - parameter table: The name of the table in `schema`
+	/// - parameter column: The name of the BLOB column in `table`
+	/// - parameter chunkSize: The maximum number of bytes to copy at once
+	///
+	/// - throws: An error if the row couldn't be inserted or the file couldn't be read
+	///
+	/// - returns: The rowid of the inserted row
+	@discardableResult public func insertBLOB(contentsOf url: URL, schema: String = "main", table: String, column: String, chunkSize: Int = BLOB.defaultChunkSize) throws -> Int64 {
+		let attributes = try FileManager.default.attributesOfItem(atPath: url.path)
+		guard let length = (attributes[.size] as? NSNumber)?.intValue else {
+			throw DatabaseError("Unable to determine the size of \(url.path)")
+		}
+		guard let stream = InputStream(url: url) else {
+			throw DatabaseError("Unable to open \(url.path) for reading")
+		}
+		stream.open()
+		defer {
+			stream.close()
+		}
+		return try insertBLOB(from: stream, length: length, schema: schema, table: table, column: column, chunkSize: chunkSize)
+	}
+
+	/// Invokes `body` with the BLOB in `column` for each row in `rows`.
+	///
+	/// A single BLOB handle is opened and moved between rows using `sqlite3_blob_reopen()`,
+	/// which is significantly faster than opening a new handle for each row.
+	///
+	/// - important: The BLOB passed to `body` must not be used outside of `body`.
+	///
+	/// - parameter rows: The rowids of the desired rows
+	/// - parameter schema: The symbolic name of the database such as `main` or `temp`
+	/// - parameter table: The name of the table in `schema`
+	/// - parameter column: The name of the BLOB column in `table`
+	/// - parameter readOnly: Whether the BLOBs should be opened read-only
+	/// - parameter body: A closure processing each BLOB
+	/// - parameter row: The rowid of the current row
+	/// - parameter blob: The BLOB for the current row
+	///
+	/// - throws: An error if a BLOB couldn't be opened or any error thrown in `body`
+	public func forEachBLOB<S: Sequence>(inRows rows: S, schema: String = "main", table: String, column: String, readOnly: Bool = true, _ body: (_ row: Int64, _ blob: BLOB) throws -> Void) throws where S.Element == Int64 {
+		var blob: BLOB? = nil
+		for row in rows {
+			if let blob = blob {
+				try blob.reopen(row)
+			}
+			else {
+				blob = try openBLOB(schema, table: table, column: column, row: row, readOnly: readOnly)
+			}
+			try body(row, blob.unsafelyUnwrapped)
+		}
+	}
+}
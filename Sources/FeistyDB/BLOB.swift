@@ -107,6 +107,23 @@ public final class BLOB {
 }
 
 extension Database {
+	/// Opens and returns a BLOB for incremental I/O
+	///
+	/// - note: This is the BLOB that would be selected by `SELECT column FROM schema.table WHERE rowid = row;`
+	///
+	/// - parameter schema: The symbolic name of the database such as `main` or `temp`
+	/// - parameter table: The name of the desired table in `schema`
+	/// - parameter column: The name of the desired column in `table`
+	/// - parameter row: The desired rowid
+	/// - parameter readOnly: Whether the BLOB should be opened read-only
+	///
+	/// - throws: An error if the BLOB could not be opened
+	///
+	/// - returns: An initialized `BLOB` for incremental I/O
+	public func openBLOB(_ schema: String = "main", table: String, column: String, row: Int64, readOnly: Bool) throws -> BLOB {
+		return try BLOB(self, schema: schema, table: table, column: column, row: row, readOnly: readOnly)
+	}
+
 	/// Opens and returns a BLOB for incremental I/O
 	///
 	/// - note: This is the BLOB that would be selected by `SELECT column FROM schema.table WHERE rowid = row;`
@@ -120,7 +137,8 @@ extension Database {
 	/// - throws: An error if the BLOB could not be created
 	///
 	/// - returns: An initialized `BLOB` for incremental reading
+	@available(*, deprecated, renamed: "openBLOB(_:table:column:row:readOnly:)")
 	public func openBLOB(_ schema: String, table: String, column: String, row: Int64, readOny: Bool) throws -> BLOB {
-		return try BLOB(self, schema: schema, table: table, column: column, row: row, readOnly: true)
+		return try BLOB(self, schema: schema, table: table, column: column, row: row, readOnly: readOny)
 	}
 }
@@ -0,0 +1,331 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import os.log
+import Foundation
+import CSQLite
+
+/// An efficient inserter of many rows into a table.
+///
+/// A bulk inserter buffers rows and inserts them using multi-row `INSERT INTO ... VALUES (...), (...)`
+/// statements sized to the maximum number of SQL parameters permitted by the database connection.
+/// Compiled statements are cached for the lifetime of the inserter.
+///
+/// If the database is in autocommit mode when the first row is inserted, the inserter manages transactions itself,
+/// committing after a configurable number of rows or elapsed time, even if fewer rows than fill a multi-row statement
+/// have been buffered.  Otherwise rows are inserted within the caller's transaction.
+///
+/// ```swift
+/// let inserter = try db.bulkInserter(table: "events", columns: ["timestamp", "kind", "payload"])
+/// for event in events {
+///     try inserter.insert([.float(event.timestamp), .text(event.kind), .blob(event.payload)])
+/// }
+/// let statistics = try inserter.finish()
+/// print("Inserted \(statistics.rowCount) rows at \(statistics.rowsPerSecond) rows/sec")
+/// ```
+///
+/// - important: `finish()` must be called to insert any buffered rows and commit the final transaction.
+public final class BulkInserter {
+	/// Bulk insert statistics.
+	public struct Statistics {
+		/// The number of rows inserted
+		public let rowCount: Int
+		/// The number of transactions committed by the inserter
+		public let commitCount: Int
+		/// The time elapsed between the first insertion and the most recent flush, in seconds
+		public let elapsedTime: TimeInterval
+
+		/// The average insertion rate in rows per second
+		public var rowsPerSecond: Double {
+			return elapsedTime > 0 ? Double(rowCount) / elapsedTime : 0
+		}
+	}
+
+	/// The database into which rows are inserted
+	public let database: Database
+	/// The number of columns in each row
+	public let columnCount: Int
+	/// The number of rows inserted by each full multi-row statement
+	public let rowsPerStatement: Int
+	/// The number of rows after which the inserter's transaction is committed or `nil` for no row limit
+	public let commitRowInterval: Int?
+	/// The time after which the inserter's transaction is committed or `nil` for no time limit
+	public let commitTimeInterval: TimeInterval?
+
+	/// The SQL prefix `INSERT INTO table(columns) VALUES `
+	let sqlPrefix: String
+	/// The SQL for a single row of values `(?, ?, ...)`
+	let sqlRow: String
+	/// Compiled statements keyed by the number of rows they insert
+	var statements = [Int: Statement]()
+
+	/// Buffered column values for rows not yet inserted
+	var pendingValues = [DatabaseValue]()
+
+	/// `true` if the inserter began the current transaction
+	var ownsTransaction = false
+	/// The number of rows inserted in the current transaction
+	var rowsSinceCommit = 0
+	/// The time at which the first row not yet committed was buffered
+	var batchStartTime: UInt64 = 0
+
+	/// The number of rows inserted
+	var insertedRowCount = 0
+	/// The number of transactions committed
+	var commitCount = 0
+	/// The time of the first insertion
+	var startTime: UInt64?
+	/// The time of the most recent flush
+	var lastFlushTime: UInt64 = 0
+
+	/// Creates a bulk inserter.
+	///
+	/// - parameter database: The database into which rows are inserted
+	/// - parameter table: The name of the table into which rows are inserted
+	/// - parameter columns: The names of the columns for which values are provided
+	/// - parameter schema: The name of the database containing `table`
+	/// - parameter maximumRowsPerStatement: The maximum number of rows inserted by a single statement or `nil` to use the limit imposed by the maximum number of SQL parameters
+	/// - parameter commitRowInterval: The number of rows after which the inserter's transaction is committed or `nil` for no row limit
+	/// - parameter commitTimeInterval: The time after which the inserter's transaction is committed or `nil` for no time limit
+	///
+	/// - throws: An error if `columns` is empty
+	public init(database: Database, table: String, columns: [String], schema: String = "main", maximumRowsPerStatement: Int? = nil, commitRowInterval: Int? = 10_000, commitTimeInterval: TimeInterval? = 0.5) throws {
+		guard !columns.isEmpty else {
+			throw DatabaseError("At least one column is required for bulk insertion")
+		}
+
+		self.database = database
+		self.columnCount = columns.count
+		self.commitRowInterval = commitRowInterval
+		self.commitTimeInterval = commitTimeInterval
+
+		let variableLimit = Int(sqlite3_limit(database.db, SQLITE_LIMIT_VARIABLE_NUMBER, -1))
+		var rowsPerStatement = max(1, variableLimit / columns.count)
+		if let maximumRowsPerStatement = maximumRowsPerStatement {
+			rowsPerStatement = max(1, min(rowsPerStatement, maximumRowsPerStatement))
+		}
+		self.rowsPerStatement = rowsPerStatement
+
+		let quotedColumns = columns.map { BulkInserter.quote($0) }.joined(separator: ", ")
+		self.sqlPrefix = "INSERT INTO \(BulkInserter.quote(schema)).\(BulkInserter.quote(table))(\(quotedColumns)) VALUES "
+		self.sqlRow = "(" + Array(repeating: "?", count: columns.count).joined(separator: ", ") + ")"
+
+		pendingValues.reserveCapacity(rowsPerStatement * columns.count)
+	}
+
+	deinit {
+		if !pendingValues.isEmpty || ownsTransaction {
+			os_log("BulkInserter deallocated without calling finish(); discarding uncommitted rows", type: .info)
+			if ownsTransaction {
+				try? database.rollback()
+			}
+		}
+	}
+
+	/// Returns `identifier` as a quoted SQL identifier.
+	static func quote(_ identifier: String) -> String {
+		return "\"" + identifier.replacingOccurrences(of: "\"", with: "\"\"") + "\""
+	}
+
+	/// The current bulk insert statistics
+	public var statistics: Statistics {
+		var elapsed: TimeInterval = 0
+		if let startTime = startTime, lastFlushTime > startTime {
+			elapsed = Double(lastFlushTime - startTime) / Double(NSEC_PER_SEC)
+		}
+		return Statistics(rowCount: insertedRowCount, commitCount: commitCount, elapsedTime: elapsed)
+	}
+
+	/// Inserts a row.
+	///
+	/// The row is buffered and inserted when enough rows have accumulated to fill a multi-row statement,
+	/// or when the inserter's transaction is due to be committed.
+	///
+	/// - requires: `values.count == columnCount`
+	///
+	/// - parameter values: The column values for the row
+	///
+	/// - throws: An error if `values` contains the wrong number of values or the buffered rows could not be inserted
+	public func insert(_ values: [DatabaseValue]) throws {
+		guard values.count == columnCount else {
+			throw DatabaseError("Row contains \(values.count) values but \(columnCount) columns were specified")
+		}
+
+		if pendingValues.isEmpty && !ownsTransaction {
+			batchStartTime = DispatchTime.now().uptimeNanoseconds
+			if startTime == nil {
+				startTime = batchStartTime
+			}
+		}
+
+		pendingValues.append(contentsOf: values)
+		// flush() commits the inserter's transaction when a commit is due
+		if pendingValues.count == rowsPerStatement * columnCount || isCommitDue(at: commitTimeInterval != nil ? DispatchTime.now().uptimeNanoseconds : 0) {
+			try flush()
+		}
+	}
+
+	/// Inserts a sequence of rows.
+	///
+	/// - parameter rows: The rows to insert
+	///
+	/// - throws: An error if any row contains the wrong number of values or the rows could not be inserted
+	public func insert<S: Sequence>(contentsOf rows: S) throws where S.Element == [DatabaseValue] {
+		for row in rows {
+			try insert(row)
+		}
+	}
+
+	/// Inserts all buffered rows and commits the inserter's transaction.
+	///
+	/// - throws: An error if the buffered rows could not be inserted or the transaction could not be committed
+	///
+	/// - returns: The bulk insert statistics
+	@discardableResult public func finish() throws -> Statistics {
+		try flush()
+		if ownsTransaction {
+			try commit()
+		}
+		return statistics
+	}
+
+	/// Inserts all buffered rows, committing the inserter's transaction if required.
+	///
+	/// - note: If an error occurs and the inserter began the current transaction, the transaction is rolled back
+	/// and all rows inserted since the last commit are discarded.
+	///
+	/// - throws: An error if the buffered rows could not be inserted
+	public func flush() throws {
+		guard !pendingValues.isEmpty else {
+			return
+		}
+
+		if !ownsTransaction && database.isInAutocommitMode {
+			try database.begin(type: .immediate)
+			ownsTransaction = true
+		}
+
+		let rowCount = pendingValues.count / columnCount
+		do {
+			var row = 0
+			while row < rowCount {
+				// Partial batches are inserted by statements for power-of-two row counts to bound the number of compiled statements
+				let remaining = rowCount - row
+				let count = remaining == rowsPerStatement ? remaining : 1 << (Int.bitWidth - 1 - remaining.leadingZeroBitCount)
+				let statement = try self.statement(forRowCount: count)
+				let stmt = statement.stmt
+				let offset = row * columnCount
+				for i in 0 ..< count * columnCount {
+					try pendingValues[offset + i].bind(to: stmt, parameter: Int32(i + 1))
+				}
+				defer {
+					sqlite3_reset(stmt)
+				}
+				try statement.execute()
+				row += count
+			}
+		}
+		catch let error {
+			pendingValues.removeAll(keepingCapacity: true)
+			if ownsTransaction {
+				ownsTransaction = false
+				rowsSinceCommit = 0
+				try? database.rollback()
+			}
+			throw error
+		}
+
+		pendingValues.removeAll(keepingCapacity: true)
+		insertedRowCount += rowCount
+		rowsSinceCommit += rowCount
+
+		let now = DispatchTime.now().uptimeNanoseconds
+		lastFlushTime = now
+
+		if ownsTransaction && isCommitDue(at: now) {
+			try commit()
+		}
+	}
+
+	/// Returns `true` if the inserter manages transactions and the rows inserted or buffered since the last commit
+	/// have reached `commitRowInterval` or were first buffered at least `commitTimeInterval` before `now`.
+	///
+	/// - parameter now: The current uptime in nanoseconds, used only if `commitTimeInterval` is not `nil`
+	func isCommitDue(at now: UInt64) -> Bool {
+		guard ownsTransaction || database.isInAutocommitMode else {
+			return false
+		}
+		let rowCount = rowsSinceCommit + pendingValues.count / columnCount
+		let rowLimitReached = commitRowInterval.map { rowCount >= $0 } ?? false
+		let timeLimitReached = commitTimeInterval.map { Double(now - batchStartTime) / Double(NSEC_PER_SEC) >= $0 } ?? false
+		return rowLimitReached || timeLimitReached
+	}
+
+	/// Commits the inserter's transaction.
+	///
+	/// - note: If the commit fails the inserter retains ownership of the transaction so `finish()` may retry
+	/// the commit or the transaction is rolled back when the inserter is deallocated
+	func commit() throws {
+		try database.commit()
+		ownsTransaction = false
+		rowsSinceCommit = 0
+		commitCount += 1
+	}
+
+	/// Returns the compiled statement inserting `rowCount` rows.
+	func statement(forRowCount rowCount: Int) throws -> Statement {
+		if let statement = statements[rowCount] {
+			return statement
+		}
+
+		var sql = sqlPrefix
+		sql.reserveCapacity(sqlPrefix.utf8.count + rowCount * (sqlRow.utf8.count + 2))
+		for i in 0 ..< rowCount {
+			if i > 0 {
+				sql += ", "
+			}
+			sql += sqlRow
+		}
+		sql += ";"
+
+		let statement = try Statement(database: database, sql: sql, prepareFlags: UInt32(SQLITE_PREPARE_PERSISTENT))
+		statements[rowCount] = statement
+		return statement
+	}
+}
+
+extension Database {
+	/// Returns a bulk inserter for `table`.
+	///
+	/// - parameter table: The name of the table into which rows are inserted
+	/// - parameter columns: The names of the columns for which values are provided
+	/// - parameter schema: The name of the database containing `table`
+	/// - parameter commitRowInterval: The number of rows after which the inserter's transaction is committed or `nil` for no row limit
+	/// - parameter commitTimeInterval: The time after which the inserter's transaction is committed or `nil` for no time limit
+	///
+	/// - throws: An error if `columns` is empty
+	///
+	/// - returns: A bulk inserter
+	public func bulkInserter(table: String, columns: [String], schema: String = "main", commitRowInterval: Int? = 10_000, commitTimeInterval: TimeInterval? = 0.5) throws -> BulkInserter {
+		return try BulkInserter(database: self, table: table, columns: columns, schema: schema, commitRowInterval: commitRowInterval, commitTimeInterval: commitTimeInterval)
+	}
+
+	/// Inserts a sequence of rows into `table` using a bulk inserter.
+	///
+	/// - parameter rows: The rows to insert
+	/// - parameter table: The name of the table into which rows are inserted
+	/// - parameter columns: The names of the columns for which values are provided
+	/// - parameter schema: The name of the database containing `table`
+	///
+	/// - throws: An error if any row contains the wrong number of values or the rows could not be inserted
+	///
+	/// - returns: The bulk insert statistics
+	@discardableResult public func bulkInsert<S: Sequence>(_ rows: S, into table: String, columns: [String], schema: String = "main") throws -> BulkInserter.Statistics where S.Element == [DatabaseValue] {
+		let inserter = try bulkInserter(table: table, columns: columns, schema: schema)
+		try inserter.insert(contentsOf: rows)
+		return try inserter.finish()
+	}
+}
@@ -0,0 +1,314 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+#if canImport(Compression)
+import Compression
+#endif
+import CSQLite
+
+#if SQLITE_ENABLE_PREUPDATE_HOOK && SQLITE_ENABLE_SESSION
+
+/// Batches changesets on a leader and applies them on a follower.
+///
+/// Changesets added to a replicator are combined using a changegroup, so multiple changes
+/// to the same row are merged. `flush(to:)` streams the combined changeset, optionally compressed,
+/// and `apply(streamingFrom:compression:to:chunkSize:_:_:)` decompresses and applies a batch in a single
+/// transaction without holding the uncompressed changeset in memory.
+///
+/// ```swift
+/// let replicator = try ChangesetReplicator(compression: .zlib)
+/// try replicator.add(session)
+/// let batch = try replicator.flush()
+/// // ... transmit batch ...
+/// try ChangesetReplicator.apply(batch, compression: .zlib, to: follower) { _ in .abort }
+/// ```
+public final class ChangesetReplicator {
+	/// Compression algorithms for changeset batches
+	public enum Compression {
+		/// Batches are not compressed
+		case none
+		#if canImport(Compression)
+		/// zlib (raw DEFLATE) compression
+		case zlib
+		/// LZFSE compression
+		case lzfse
+		/// LZ4 compression
+		case lz4
+		#endif
+	}
+
+	/// The compression used for batches produced by `flush(to:)`
+	public let compression: Compression
+
+	/// The size of the buffers used for compression
+	public let chunkSize: Int
+
+	/// The changegroup accumulating pending changes
+	var changegroup: Changegroup
+
+	/// The number of changesets added since the last flush
+	public private(set) var pendingChangesetCount = 0
+
+	/// Creates a replicator.
+	///
+	/// - parameter compression: The compression used for batches
+	/// - parameter chunkSize: The size of the buffers used for streaming
+	///
+	/// - throws: An error if the changegroup could not be created
+	public init(compression: Compression = .none, chunkSize: Int = 64 * 1024) throws {
+		precondition(chunkSize > 0, "chunkSize must be positive")
+		self.compression = compression
+		self.chunkSize = chunkSize
+		self.changegroup = try Changegroup()
+	}
+
+	/// Adds the changes in `changeset` to the pending batch.
+	///
+	/// - parameter changeset: The changeset to add
+	///
+	/// - throws: An error if the changeset could not be added
+	public func add(_ changeset: Changeset) throws {
+		try changegroup.add(changeset)
+		pendingChangesetCount += 1
+	}
+
+	/// Adds the changes recorded by `session` to the pending batch.
+	///
+	/// - parameter session: The session whose changes should be added
+	///
+	/// - throws: An error if the changeset could not be created or added
+	public func add(_ session: Session) throws {
+		try add(session.changeset())
+	}
+
+	/// Adds the changes in a changeset read from `input` to the pending batch.
+	///
+	/// - parameter input: A closure providing the changeset data
+	///
+	/// - throws: An error if the changeset could not be added or any error thrown by `input`
+	public func add(streamingFrom input: ChangesetInput) throws {
+		try changegroup.add(streamingFrom: input)
+		pendingChangesetCount += 1
+	}
+
+	/// Streams the pending batch to `output` and begins a new batch.
+	///
+	/// - parameter output: A closure receiving the batch data
+	///
+	/// - throws: An error if the batch could not be created or any error thrown by `output`
+	public func flush(to output: ChangesetOutput) throws {
+		let encoder = try ChangesetStreamCodec(compression, encoding: true, chunkSize: chunkSize)
+		try changegroup.changeset(streamingTo: { chunk in
+			try encoder.process(chunk, finalize: false, output)
+		})
+		try encoder.process(UnsafeRawBufferPointer(start: nil, count: 0), finalize: true, output)
+
+		changegroup = try Changegroup()
+		pendingChangesetCount = 0
+	}
+
+	/// Returns the pending batch and begins a new batch.
+	///
+	/// - throws: An error if the batch could not be created
+	public func flush() throws -> Data {
+		var data = Data()
+		try flush { chunk in
+			data.append(contentsOf: chunk)
+		}
+		return data
+	}
+
+	/// Applies a batch produced by `flush(to:)` to `database` in a single transaction.
+	///
+	/// - parameter input: A closure providing the batch data
+	/// - parameter compression: The compression used for the batch
+	/// - parameter database: The database to which the batch should be applied
+	/// - parameter chunkSize: The size of the buffer used for decompression
+	/// - parameter isIncluded: An optional closure returning `true` if changes to the named table should be applied. If `nil`, all tables will be included.
+	/// - parameter onConflict: A closure indicating how conflicts should be handled
+	///
+	/// - throws: An error if the batch could not be applied, in which case no changes are made
+	public static func apply(streamingFrom input: ChangesetInput, compression: Compression = .none, to database: Database, chunkSize: Int = 64 * 1024, _ isIncluded: ChangesetTableFilter? = nil, _ onConflict: @escaping ChangesetConflictHandler) throws {
+		let decoder = try ChangesetStreamCodec(compression, encoding: false, chunkSize: chunkSize)
+		try database.transaction(type: .immediate) { database in
+			try database.apply(streamingFrom: { buffer in
+				try decoder.read(into: buffer, from: input)
+			}, options: .noSavepoint, isIncluded, onConflict)
+			return .commit
+		}
+	}
+
+	/// Applies a batch produced by `flush()` to `database` in a single transaction.
+	///
+	/// - parameter batch: The batch data
+	/// - parameter compression: The compression used for the batch
+	/// - parameter database: The database to which the batch should be applied
+	/// - parameter isIncluded: An optional closure returning `true` if changes to the named table should be applied. If `nil`, all tables will be included.
+	/// - parameter onConflict: A closure indicating how conflicts should be handled
+	///
+	/// - throws: An error if the batch could not be applied, in which case no changes are made
+	public static func apply(_ batch: Data, compression: Compression = .none, to database: Database, _ isIncluded: ChangesetTableFilter? = nil, _ onConflict: @escaping ChangesetConflictHandler) throws {
+		var offset = 0
+		try apply(streamingFrom: { buffer in
+			let count = min(buffer.count, batch.count - offset)
+			if count > 0 {
+				batch.copyBytes(to: buffer.bindMemory(to: UInt8.self), from: batch.startIndex + offset ..< batch.startIndex + offset + count)
+			}
+			offset += count
+			return count
+		}, compression: compression, to: database, isIncluded, onConflict)
+	}
+}
+
+/// A streaming encoder or decoder for changeset batches
+final class ChangesetStreamCodec {
+	#if canImport(Compression)
+	/// The compression stream, or `nil` for uncompressed data
+	let stream: UnsafeMutablePointer<compression_stream>?
+	#endif
+
+	/// The buffer for output produced by compression or input consumed by decompression
+	let buffer: UnsafeMutablePointer<UInt8>
+	/// The capacity of `buffer`
+	let chunkSize: Int
+	/// Whether the decoder's input is exhausted
+	var inputExhausted = false
+	/// Whether the decoder has produced all output
+	var finished = false
+
+	/// Creates a codec.
+	///
+	/// - parameter compression: The compression algorithm
+	/// - parameter encoding: `true` to compress or `false` to decompress
+	/// - parameter chunkSize: The size of the internal buffer
+	///
+	/// - throws: An error if the compression stream could not be initialized
+	init(_ compression: ChangesetReplicator.Compression, encoding: Bool, chunkSize: Int) throws {
+		self.chunkSize = chunkSize
+		self.buffer = UnsafeMutablePointer<UInt8>.allocate(capacity: chunkSize)
+
+		#if canImport(Compression)
+		let algorithm: compression_algorithm
+		switch compression {
+		case .none:
+			self.stream = nil
+			return
+		case .zlib:
+			algorithm = COMPRESSION_ZLIB
+		case .lzfse:
+			algorithm = COMPRESSION_LZFSE
+		case .lz4:
+			algorithm = COMPRESSION_LZ4
+		}
+
+		let stream = UnsafeMutablePointer<compression_stream>.allocate(capacity: 1)
+		guard compression_stream_init(stream, encoding ? COMPRESSION_STREAM_ENCODE : COMPRESSION_STREAM_DECODE, algorithm) == COMPRESSION_STATUS_OK else {
+			stream.deallocate()
+			buffer.deallocate()
+			throw DatabaseError("Error initializing compression stream")
+		}
+		stream.pointee.src_size = 0
+		self.stream = stream
+		#endif
+	}
+
+	deinit {
+		#if canImport(Compression)
+		if let stream = stream {
+			compression_stream_destroy(stream)
+			stream.deallocate()
+		}
+		#endif
+		buffer.deallocate()
+	}
+
+	/// Compresses `input` and passes the compressed data to `output`.
+	///
+	/// - parameter input: The data to compress
+	/// - parameter finalize: `true` if `input` is the final data
+	/// - parameter output: A closure receiving the compressed data
+	func process(_ input: UnsafeRawBufferPointer, finalize: Bool, _ output: ChangesetOutput) throws {
+		#if canImport(Compression)
+		guard let stream = stream else {
+			try output(input)
+			return
+		}
+
+		stream.pointee.src_ptr = input.baseAddress?.assumingMemoryBound(to: UInt8.self) ?? UnsafePointer(buffer)
+		stream.pointee.src_size = input.count
+		let flags = finalize ? Int32(COMPRESSION_STREAM_FINALIZE.rawValue) : 0
+		while true {
+			stream.pointee.dst_ptr = buffer
+			stream.pointee.dst_size = chunkSize
+			let status = compression_stream_process(stream, flags)
+			guard status != COMPRESSION_STATUS_ERROR else {
+				throw DatabaseError("Error compressing changeset")
+			}
+			let produced = chunkSize - stream.pointee.dst_size
+			if produced > 0 {
+				try output(UnsafeRawBufferPointer(start: buffer, count: produced))
+			}
+			if status == COMPRESSION_STATUS_END || (!finalize && stream.pointee.src_size == 0 && stream.pointee.dst_size > 0) {
+				return
+			}
+		}
+		#else
+		try output(input)
+		#endif
+	}
+
+	/// Fills `destination` with decompressed data read from `input`.
+	///
+	/// - parameter destination: The buffer to receive decompressed data
+	/// - parameter input: A closure providing compressed data
+	///
+	/// - returns: The number of bytes written to `destination`, or `0` if no data remains
+	func read(into destination: UnsafeMutableRawBufferPointer, from input: ChangesetInput) throws -> Int {
+		#if canImport(Compression)
+		guard let stream = stream else {
+			return try input(destination)
+		}
+
+		guard !finished, destination.count > 0 else {
+			return 0
+		}
+
+		stream.pointee.dst_ptr = destination.baseAddress.unsafelyUnwrapped.assumingMemoryBound(to: UInt8.self)
+		stream.pointee.dst_size = destination.count
+		while stream.pointee.dst_size > 0 {
+			if stream.pointee.src_size == 0 && !inputExhausted {
+				let count = try input(UnsafeMutableRawBufferPointer(start: buffer, count: chunkSize))
+				inputExhausted = count == 0
+				stream.pointee.src_ptr = UnsafePointer(buffer)
+				stream.pointee.src_size = count
+			}
+			let flags = inputExhausted ? Int32(COMPRESSION_STREAM_FINALIZE.rawValue) : 0
+			let available = stream.pointee.dst_size
+			let status = compression_stream_process(stream, flags)
+			guard status != COMPRESSION_STATUS_ERROR else {
+				throw DatabaseError("Error decompressing changeset")
+			}
+			if status == COMPRESSION_STATUS_END {
+				finished = true
+				break
+			}
+			// No progress is possible once the input is exhausted
+			if inputExhausted && stream.pointee.src_size == 0 && stream.pointee.dst_size == available {
+				guard stream.pointee.dst_size < destination.count else {
+					throw DatabaseError("Truncated compressed changeset")
+				}
+				break
+			}
+		}
+		return destination.count - stream.pointee.dst_size
+		#else
+		return try input(destination)
+		#endif
+	}
+}
+
+#endif
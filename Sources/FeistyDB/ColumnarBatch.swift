@@ -0,0 +1,325 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// A fixed-schema block of rows stored column by column in contiguous typed buffers.
+///
+/// Each column stores its values in a single contiguous buffer along with a validity bitmap
+/// indicating which values are non-`NULL`.  Fixed-width columns (`int64` and `double`) store one
+/// element per row.  Variable-width columns (`text` and `blob`) store the bytes of all values in a
+/// single buffer with `count + 1` offsets delimiting each value.
+///
+/// Buffers are reused when a batch is cleared so filling a batch repeatedly performs no per-cell allocation.
+///
+/// ```swift
+/// let statement = try db.prepare(sql: "select id, score from t1;")
+/// try statement.batches(schema: [.init(.int64, nullable: false), .init(.double)], chunkSize: 4096) { batch in
+///     let ids = batch.columns[0].int64Values
+///     let scores = batch.columns[1].doubleValues
+///     // Do something with `ids` and `scores`
+/// }
+/// ```
+public final class ColumnarBatch {
+	/// The storage type of a column.
+	public enum ColumnType {
+		/// 64-bit signed integers
+		case int64
+		/// Double-precision floating-point numbers
+		case double
+		/// UTF-8 text
+		case text
+		/// Untyped bytes
+		case blob
+	}
+
+	/// The type and nullability of a column.
+	public struct Field {
+		/// The storage type of the column
+		public let type: ColumnType
+		/// Whether the column may contain `NULL` values
+		public let isNullable: Bool
+
+		/// Creates a field.
+		///
+		/// - parameter type: The storage type of the column
+		/// - parameter nullable: Whether the column may contain `NULL` values
+		public init(_ type: ColumnType, nullable: Bool = true) {
+			self.type = type
+			self.isNullable = nullable
+		}
+	}
+
+	/// A column of values stored in contiguous typed buffers.
+	public final class Column {
+		/// The type and nullability of the column
+		public let field: Field
+
+		/// The number of values in the column
+		public private(set) var count = 0
+
+		/// The validity bitmap for the column, least significant bit first.  A set bit indicates a non-`NULL` value.
+		public private(set) var validity = [UInt8]()
+
+		/// The values of an `int64` column.  `NULL` values are stored as `0`.
+		public private(set) var int64Values = [Int64]()
+
+		/// The values of a `double` column.  `NULL` values are stored as `0`.
+		public private(set) var doubleValues = [Double]()
+
+		/// The offsets of each value in `bytes` for a `text` or `blob` column.
+		///
+		/// The bytes of the value at `index` are `bytes[offsets[index] ..< offsets[index + 1]]`.
+		public private(set) var offsets = [0]
+
+		/// The concatenated bytes of all values in a `text` or `blob` column
+		public private(set) var bytes = [UInt8]()
+
+		/// Creates an empty column.
+		///
+		/// - parameter field: The type and nullability of the column
+		/// - parameter capacity: The number of values for which to reserve space
+		init(field: Field, capacity: Int) {
+			self.field = field
+			validity.reserveCapacity((capacity + 7) / 8)
+			switch field.type {
+			case .int64:
+				int64Values.reserveCapacity(capacity)
+			case .double:
+				doubleValues.reserveCapacity(capacity)
+			case .text, .blob:
+				offsets.reserveCapacity(capacity + 1)
+			}
+		}
+
+		/// Returns `true` if the value at `index` is not `NULL`.
+		///
+		/// - requires: `index >= 0`
+		/// - requires: `index < self.count`
+		///
+		/// - parameter index: The index of the desired value
+		public func isValid(at index: Int) -> Bool {
+			precondition(index >= 0 && index < count, "Index out of bounds")
+			return validity[index >> 3] & (1 << UInt8(index & 7)) != 0
+		}
+
+		/// Invokes `body` with the bytes of the `text` or `blob` value at `index`.
+		///
+		/// - requires: `index >= 0`
+		/// - requires: `index < self.count`
+		///
+		/// - parameter index: The index of the desired value
+		/// - parameter body: A closure accessing the bytes of the value
+		/// - parameter bytes: The bytes of the value
+		///
+		/// - throws: Any error thrown in `body`
+		///
+		/// - returns: The value returned by `body`
+		public func withUnsafeBytes<T>(at index: Int, _ body: (_ bytes: UnsafeRawBufferPointer) throws -> T) rethrows -> T {
+			precondition(index >= 0 && index < count, "Index out of bounds")
+			let range = offsets[index] ..< offsets[index + 1]
+			return try bytes.withUnsafeBytes { buffer in
+				return try body(UnsafeRawBufferPointer(rebasing: buffer[range]))
+			}
+		}
+
+		/// Returns the `text` value at `index` or `nil` if the value is `NULL`.
+		///
+		/// - requires: `index >= 0`
+		/// - requires: `index < self.count`
+		///
+		/// - parameter index: The index of the desired value
+		public func string(at index: Int) -> String? {
+			guard isValid(at: index) else {
+				return nil
+			}
+			return withUnsafeBytes(at: index) { String(decoding: $0, as: UTF8.self) }
+		}
+
+		/// Appends a bit to the validity bitmap.
+		func appendValidity(_ isValid: Bool) {
+			let bit = count & 7
+			if bit == 0 {
+				validity.append(0)
+			}
+			if isValid {
+				validity[validity.count - 1] |= 1 << UInt8(bit)
+			}
+			count += 1
+		}
+
+		/// Appends an integer value to an `int64` column.
+		///
+		/// - requires: `field.type == .int64`
+		public func append(_ value: Int64) {
+			precondition(field.type == .int64, "Type mismatch")
+			int64Values.append(value)
+			appendValidity(true)
+		}
+
+		/// Appends a floating-point value to a `double` column.
+		///
+		/// - requires: `field.type == .double`
+		public func append(_ value: Double) {
+			precondition(field.type == .double, "Type mismatch")
+			doubleValues.append(value)
+			appendValidity(true)
+		}
+
+		/// Appends the bytes of a value to a `text` or `blob` column.
+		///
+		/// - requires: `field.type == .text || field.type == .blob`
+		public func append(_ value: UnsafeRawBufferPointer) {
+			precondition(field.type == .text || field.type == .blob, "Type mismatch")
+			bytes.append(contentsOf: value)
+			offsets.append(bytes.count)
+			appendValidity(true)
+		}
+
+		/// Appends the UTF-8 representation of a value to a `text` column.
+		///
+		/// - requires: `field.type == .text`
+		public func append(_ value: String) {
+			precondition(field.type == .text, "Type mismatch")
+			bytes.append(contentsOf: value.utf8)
+			offsets.append(bytes.count)
+			appendValidity(true)
+		}
+
+		/// Appends a `NULL` value.
+		///
+		/// - requires: `field.isNullable`
+		public func appendNull() {
+			precondition(field.isNullable, "NULL appended to non-nullable column")
+			switch field.type {
+			case .int64:
+				int64Values.append(0)
+			case .double:
+				doubleValues.append(0)
+			case .text, .blob:
+				offsets.append(bytes.count)
+			}
+			appendValidity(false)
+		}
+
+		/// Reserves space for `byteCount` bytes of `text` or `blob` values.
+		func reserveByteCapacity(_ byteCount: Int) {
+			bytes.reserveCapacity(byteCount)
+		}
+
+		/// Removes all values while retaining the allocated storage.
+		func removeAll() {
+			count = 0
+			validity.removeAll(keepingCapacity: true)
+			int64Values.removeAll(keepingCapacity: true)
+			doubleValues.removeAll(keepingCapacity: true)
+			offsets.removeAll(keepingCapacity: true)
+			offsets.append(0)
+			bytes.removeAll(keepingCapacity: true)
+		}
+	}
+
+	/// The columns of the batch
+	public let columns: [Column]
+
+	/// The number of rows for which space is reserved
+	public let capacity: Int
+
+	/// Creates an empty batch.
+	///
+	/// - parameter fields: The type and nullability of each column
+	/// - parameter capacity: The number of rows for which to reserve space
+	public init(fields: [Field], capacity: Int) {
+		precondition(capacity > 0)
+		self.capacity = capacity
+		self.columns = fields.map { Column(field: $0, capacity: capacity) }
+	}
+
+	/// The number of rows in the batch
+	public var count: Int {
+		return columns.first?.count ?? 0
+	}
+
+	/// `true` if the batch contains `capacity` rows
+	public var isFull: Bool {
+		return count >= capacity
+	}
+
+	/// Removes all rows while retaining the allocated storage.
+	public func removeAll() {
+		for column in columns {
+			column.removeAll()
+		}
+	}
+}
+
+extension Statement {
+	/// Executes the statement and applies `block` to successive batches of result rows stored in columnar form.
+	///
+	/// The first `fields.count` result columns are read into the corresponding columns of the batch.
+	/// Column values are converted to the field's type using SQLite's type conversion rules.
+	///
+	/// - important: The same batch object is passed to each invocation of `block` and is cleared
+	/// between invocations.  Copy any values that must outlive `block`.
+	///
+	/// - parameter fields: The type and nullability of the leftmost result columns
+	/// - parameter chunkSize: The maximum number of rows in each batch
+	/// - parameter block: A closure applied to each batch of result rows
+	/// - parameter batch: A batch of up to `chunkSize` result rows
+	///
+	/// - throws: Any error thrown in `block`, an error if `fields.count` exceeds the number of result columns,
+	/// an error if a non-nullable column contains `NULL`, or an error if the statement did not successfully run to completion
+	public func batches(schema fields: [ColumnarBatch.Field], chunkSize: Int = 1024, _ block: (_ batch: ColumnarBatch) throws -> ()) throws {
+		guard fields.count <= columnCount else {
+			throw DatabaseError("Schema contains \(fields.count) columns but the statement returns \(columnCount) columns")
+		}
+
+		let batch = ColumnarBatch(fields: fields, capacity: chunkSize)
+
+		var result = sqlite3_step(stmt)
+		while result == SQLITE_ROW {
+			for (i, column) in batch.columns.enumerated() {
+				let idx = Int32(i)
+				if sqlite3_column_type(stmt, idx) == SQLITE_NULL {
+					guard column.field.isNullable else {
+						throw DatabaseError("NULL value in non-nullable column \(i)")
+					}
+					column.appendNull()
+					continue
+				}
+
+				switch column.field.type {
+				case .int64:
+					column.append(sqlite3_column_int64(stmt, idx))
+				case .double:
+					column.append(sqlite3_column_double(stmt, idx))
+				case .text:
+					let text = sqlite3_column_text(stmt, idx)
+					column.append(UnsafeRawBufferPointer(start: text, count: Int(sqlite3_column_bytes(stmt, idx))))
+				case .blob:
+					let blob = sqlite3_column_blob(stmt, idx)
+					column.append(UnsafeRawBufferPointer(start: blob, count: blob != nil ? Int(sqlite3_column_bytes(stmt, idx)) : 0))
+				}
+			}
+
+			if batch.isFull {
+				try block(batch)
+				batch.removeAll()
+			}
+
+			result = sqlite3_step(stmt)
+		}
+
+		guard result == SQLITE_DONE else {
+			throw SQLiteError("Error executing statement", takingDescriptionFromStatement: stmt)
+		}
+
+		if batch.count > 0 {
+			try block(batch)
+		}
+	}
+}
@@ -0,0 +1,536 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import os.log
+import Foundation
+import CSQLite
+
+/// A cursor for an SQLite virtual table producing rows in columnar batches.
+///
+/// Rather than being asked for one column value at a time, a batched cursor fills a `ColumnarBatch`
+/// with as many rows as will fit.  SQLite's per-row and per-column callbacks are then served
+/// directly from the batch.
+public protocol BatchedVirtualTableCursor: AnyObject {
+	/// Applies a filter to the virtual table
+	///
+	/// The next call to `fill(_:rowids:)` should produce the first rows matching the filter.
+	///
+	/// - parameter arguments: Arguments applicable to the query plan made in `BatchedVirtualTableModule.bestIndex()`
+	/// - parameter indexNumber: The index number returned by `BatchedVirtualTableModule.bestIndex()`
+	/// - parameter indexName: The index name returned by `BatchedVirtualTableModule.bestIndex()`
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func filter(_ arguments: SQLArguments, indexNumber: Int32, indexName: String?) throws
+
+	/// Appends the next rows of output to `batch`
+	///
+	/// Appending fewer than `batch.capacity` rows indicates the end of output.
+	/// If `rowids` is left empty the rowid of each row is its 1-based position in the output.
+	///
+	/// - requires: If any rowids are appended one rowid must be appended for each row
+	///
+	/// - parameter batch: An empty batch to receive rows, with one column for each field in `BatchedVirtualTableModule.schema`
+	/// - parameter rowids: An empty array to receive the rowid of each row appended to `batch`
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func fill(_ batch: ColumnarBatch, rowids: inout [Int64]) throws
+}
+
+/// An SQLite virtual table module whose cursors produce rows in columnar batches.
+///
+/// A batched module is registered using `Database.addModule(_:type:eponymous:)` and behaves
+/// as a `VirtualTableModule` does, except that cursors fill a `ColumnarBatch` instead of
+/// returning individual column values.
+///
+/// - seealso: [The Virtual Table Mechanism Of SQLite](https://sqlite.org/vtab.html)
+public protocol BatchedVirtualTableModule: AnyObject {
+	/// Opens a connection to an SQLite virtual table module.
+	///
+	/// - parameter database: The database to which this virtual table module is being added.
+	/// - parameter arguments: The arguments used to create the virtual table module. The first argument is the name of the module being invoked.
+	/// The second argument is the name of the database in which the virtual table is being created. The third argument is the name of the new virtual table.
+	/// Any additional arguments are those passed to the module name in the `CREATE VIRTUAL TABLE` statement.
+	/// - parameter create: Whether the virtual table module is being initialized as the result of a `CREATE VIRTUAL TABLE` statement
+	/// and should create any persistent state.  This is always `false` for eponymous modules.
+	///
+	/// - throws: `SQLiteError` if the module could not be created
+	init(database: Database, arguments: [String], create: Bool) throws
+
+	/// The options supported by this virtual table module
+	var options: Database.VirtualTableModuleOptions { get }
+
+	/// The SQL `CREATE TABLE` statement used to tell SQLite about the virtual table's columns and datatypes.
+	///
+	/// - note: The name of the table and any constraints are ignored.
+	var declaration: String { get }
+
+	/// The type and nullability of each column in `declaration`, in order
+	///
+	/// - note: Columns beyond the end of the schema are returned as `NULL`.
+	var schema: [ColumnarBatch.Field] { get }
+
+	/// The maximum number of rows in each batch
+	var batchSize: Int { get }
+
+	/// Destroys any persistent state associated with the virtual table module
+	///
+	/// - note: This is only called as the result of a `DROP TABLE` statement.
+	func destroy() throws
+
+	/// Determines the query plan to use for a given query
+	///
+	/// - parameter indexInfo: An `sqlite3_index_info` struct containing information on the query
+	///
+	/// - returns: `.ok` on success or `.constraint` if the configuration of unusable flags in `indexInfo` cannot result in a usable query plan
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func bestIndex(_ indexInfo: inout sqlite3_index_info) throws -> VirtualTableModuleBestIndexResult
+
+	/// Opens and returns a cursor for the virtual table
+	///
+	/// - returns: An initalized cursor for the virtual table
+	///
+	/// - throws: `SQLiteError` error if the cursor could not be created
+	func openCursor() throws -> BatchedVirtualTableCursor
+}
+
+extension BatchedVirtualTableModule {
+	public var options: Database.VirtualTableModuleOptions {
+		return []
+	}
+
+	public var batchSize: Int {
+		return 1024
+	}
+
+	public func destroy() {
+	}
+}
+
+extension Database {
+	/// Glue for creating a generic Swift type in a C callback
+	final class BatchedVirtualTableModuleClientData {
+		/// The constructor closure
+		let construct: (_ arguments : [String], _ create: Bool) throws -> BatchedVirtualTableModule
+
+		/// Persistent sqlite3_module instance
+		let module: UnsafeMutablePointer<sqlite3_module>
+
+		/// Creates client data for a module
+		init(module: inout sqlite3_module, _ construct: @escaping (_ arguments: [String], _ create: Bool) throws -> BatchedVirtualTableModule) {
+			let module_ptr = UnsafeMutablePointer<sqlite3_module>.allocate(capacity: 1)
+			module_ptr.assign(from: &module, count: 1)
+			self.module = module_ptr
+			self.construct = construct
+		}
+
+		deinit {
+			module.deallocate()
+		}
+	}
+
+	/// Adds a batched virtual table module to the database.
+	///
+	/// For example, an eponymous virtual table module returning the natural numbers and their squares could be implemented as:
+	/// ```swift
+	/// class SquaresModule: BatchedVirtualTableModule {
+	/// 	class Cursor: BatchedVirtualTableCursor {
+	/// 		var value: Int64 = 0
+	///
+	/// 		func filter(_ arguments: SQLArguments, indexNumber: Int32, indexName: String?) {
+	/// 			value = 0
+	/// 		}
+	///
+	/// 		func fill(_ batch: ColumnarBatch, rowids: inout [Int64]) {
+	/// 			while !batch.isFull && value < 1_000_000 {
+	/// 				value += 1
+	/// 				batch.columns[0].append(value)
+	/// 				batch.columns[1].append(value * value)
+	/// 			}
+	/// 		}
+	/// 	}
+	///
+	/// 	required init(database: Database, arguments: [String], create: Bool) {
+	/// 	}
+	///
+	/// 	var declaration: String {
+	/// 		"CREATE TABLE x(value, square)"
+	/// 	}
+	///
+	/// 	var schema: [ColumnarBatch.Field] {
+	/// 		[.init(.int64, nullable: false), .init(.int64, nullable: false)]
+	/// 	}
+	///
+	/// 	func bestIndex(_ indexInfo: inout sqlite3_index_info) -> VirtualTableModuleBestIndexResult {
+	/// 		.ok
+	/// 	}
+	///
+	/// 	func openCursor() -> BatchedVirtualTableCursor {
+	/// 		Cursor()
+	/// 	}
+	/// }
+	///
+	/// try db.addModule("squares", type: SquaresModule.self, eponymous: true)
+	/// ```
+	///
+	/// - parameter name: The name of the virtual table module
+	/// - parameter type: The class implementing the virtual table module
+	/// - parameter eponymous: Whether the module presents a virtual table with the same name as the module
+	/// that does not require a `CREATE VIRTUAL TABLE` statement
+	///
+	/// - throws:  An error if the virtual table module can't be registered
+	///
+	/// - seealso: [Register A Virtual Table Implementation](https://www.sqlite.org/c3ref/create_module.html)
+	/// - seealso: [The Virtual Table Mechanism Of SQLite](https://sqlite.org/vtab.html)
+	public func addModule<T: BatchedVirtualTableModule>(_ name: String, type: T.Type, eponymous: Bool = false) throws {
+		// Flesh out the struct containing the virtual table functions used by SQLite
+		var module_struct = sqlite3_module(iVersion: 0, xCreate: eponymous ? nil : xBatchedCreate, xConnect: xBatchedConnect, xBestIndex: xBatchedBestIndex, xDisconnect: xBatchedDisconnect, xDestroy: eponymous ? nil : xBatchedDestroy,
+										   xOpen: xBatchedOpen, xClose: xBatchedClose, xFilter: xBatchedFilter, xNext: xBatchedNext, xEof: xBatchedEof, xColumn: xBatchedColumn, xRowid: xBatchedRowid, xUpdate: nil, xBegin: nil, xSync: nil, xCommit: nil, xRollback: nil, xFindFunction: nil, xRename: nil, xSavepoint: nil, xRelease: nil, xRollbackTo: nil, xShadowName: nil)
+
+		if T.self is WritableVirtualTable.Type {
+			set_writable_vtab_callbacks(&module_struct)
+		}
+
+		// client_data must live until the xDestroy function is invoked; store it as a +1 object
+		let client_data = BatchedVirtualTableModuleClientData(module: &module_struct) { [weak self] args, create -> BatchedVirtualTableModule in
+			guard let database = self else {
+				throw DatabaseError("Database instance missing (weak reference was set to nil)")
+			}
+			return try T(database: database, arguments: args, create: create)
+		}
+		let client_data_ptr = Unmanaged.passRetained(client_data).toOpaque()
+
+		guard sqlite3_create_module_v2(db, name, client_data.module, client_data_ptr, { client_data in
+			// Balance the +1 retain above
+			Unmanaged<BatchedVirtualTableModuleClientData>.fromOpaque(UnsafeRawPointer(client_data.unsafelyUnwrapped)).release()
+		}) == SQLITE_OK else {
+			throw SQLiteError("Error adding module \"\(name)\"", takingDescriptionFromDatabase: db)
+		}
+	}
+}
+
+/// A batched virtual table module stored as a concrete type in the `sqlite3_vtab` so no dynamic cast is required per callback
+final class BatchedVirtualTable {
+	/// The client module
+	let module: BatchedVirtualTableModule
+
+	init(module: BatchedVirtualTableModule) {
+		self.module = module
+	}
+}
+
+/// The state of a batched virtual table cursor
+///
+/// The cursor state is stored as the concrete type in the `sqlite3_vtab_cursor` so no dynamic cast is required per callback.
+final class BatchedVirtualTableCursorState {
+	/// The client cursor
+	let cursor: BatchedVirtualTableCursor
+	/// The current batch of rows
+	let batch: ColumnarBatch
+	/// The rowids of the rows in `batch`, or empty to use row positions
+	var rowids = [Int64]()
+	/// The index of the current row in `batch`
+	var index = 0
+	/// The number of rows produced before the current batch
+	var rowOffset: Int64 = 0
+	/// `true` if the cursor has produced its final batch
+	var isExhausted = false
+
+	init(cursor: BatchedVirtualTableCursor, schema: [ColumnarBatch.Field], batchSize: Int) {
+		self.cursor = cursor
+		self.batch = ColumnarBatch(fields: schema, capacity: batchSize)
+		rowids.reserveCapacity(batchSize)
+	}
+
+	/// `true` if the cursor has been moved off the last row of output
+	var eof: Bool {
+		return index >= batch.count
+	}
+
+	/// The rowid of the current row
+	var rowid: Int64 {
+		return rowids.isEmpty ? rowOffset + Int64(index) + 1 : rowids[index]
+	}
+
+	/// Applies a filter and fills the first batch.
+	func filter(_ arguments: SQLArguments, indexNumber: Int32, indexName: String?) throws {
+		batch.removeAll()
+		rowids.removeAll(keepingCapacity: true)
+		index = 0
+		rowOffset = 0
+		isExhausted = false
+		try cursor.filter(arguments, indexNumber: indexNumber, indexName: indexName)
+		try refill()
+	}
+
+	/// Advances to the next row, filling the next batch if required.
+	func next() throws {
+		index += 1
+		if index >= batch.count && !isExhausted {
+			try refill()
+		}
+	}
+
+	/// Replaces the current batch with the next batch of rows.
+	func refill() throws {
+		rowOffset += Int64(batch.count)
+		batch.removeAll()
+		rowids.removeAll(keepingCapacity: true)
+		index = 0
+
+		try cursor.fill(batch, rowids: &rowids)
+		guard rowids.isEmpty || rowids.count == batch.count else {
+			throw DatabaseError("Batch contains \(batch.count) rows but \(rowids.count) rowids")
+		}
+		isExhausted = !batch.isFull
+	}
+}
+
+// MARK: - Implementations
+
+/// Sets `error` as the error message for `vtab` and returns the corresponding SQLite result code
+func set_vtab_error(_ vtab: UnsafeMutablePointer<sqlite3_vtab>, _ error: Swift.Error, in function: String) -> Int32 {
+	sqlite3_free(vtab.pointee.zErrMsg)
+	if let error = error as? SQLiteError {
+		os_log("Error in %{public}@: %{public}@", type: .info, function, error.description)
+		vtab.pointee.zErrMsg = feisty_db_sqlite3_strdup(error.message)
+		return error.code.code
+	}
+	else {
+		os_log("Error in %{public}@: %{public}@", type: .info, function, error.localizedDescription)
+		vtab.pointee.zErrMsg = feisty_db_sqlite3_strdup(error.localizedDescription)
+		return SQLITE_ERROR
+	}
+}
+
+/// Returns the batched virtual table module stored in `pVTab`
+func batched_vtab_module(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> BatchedVirtualTableModule {
+	return pVTab.unsafelyUnwrapped.withMemoryRebound(to: feisty_db_sqlite3_vtab.self, capacity: 1) { vtab in
+		return Unmanaged<BatchedVirtualTable>.fromOpaque(UnsafeRawPointer(vtab.pointee.virtual_table_module_ptr.unsafelyUnwrapped)).takeUnretainedValue().module
+	}
+}
+
+/// Returns the batched virtual table cursor state stored in `pCursor`
+func batched_vtab_cursor_state(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?) -> BatchedVirtualTableCursorState {
+	return pCursor.unsafelyUnwrapped.withMemoryRebound(to: feisty_db_sqlite3_vtab_cursor.self, capacity: 1) { curs in
+		return Unmanaged<BatchedVirtualTableCursorState>.fromOpaque(UnsafeRawPointer(curs.pointee.virtual_table_cursor_ptr.unsafelyUnwrapped)).takeUnretainedValue()
+	}
+}
+
+func xBatchedCreate(_ db: OpaquePointer?, _ pAux: UnsafeMutableRawPointer?, _ argc: Int32, _ argv: UnsafePointer<UnsafePointer<Int8>?>?, _ ppVTab:UnsafeMutablePointer<UnsafeMutablePointer<sqlite3_vtab>?>?, _ pzErr: UnsafeMutablePointer<UnsafeMutablePointer<Int8>?>?) -> Int32 {
+	return init_batched_vtab(db, pAux, argc, argv, ppVTab, pzErr, true)
+}
+
+func xBatchedConnect(_ db: OpaquePointer?, _ pAux: UnsafeMutableRawPointer?, _ argc: Int32, _ argv: UnsafePointer<UnsafePointer<Int8>?>?, _ ppVTab: UnsafeMutablePointer<UnsafeMutablePointer<sqlite3_vtab>?>?, _ pzErr: UnsafeMutablePointer<UnsafeMutablePointer<Int8>?>?) -> Int32 {
+	return init_batched_vtab(db, pAux, argc, argv, ppVTab, pzErr, false)
+}
+
+func init_batched_vtab(_ db: OpaquePointer?, _ pAux: UnsafeMutableRawPointer?, _ argc: Int32, _ argv: UnsafePointer<UnsafePointer<Int8>?>?, _ ppVTab: UnsafeMutablePointer<UnsafeMutablePointer<sqlite3_vtab>?>?, _ pzErr: UnsafeMutablePointer<UnsafeMutablePointer<Int8>?>?, _ create: Bool) -> Int32 {
+	let args = UnsafeBufferPointer(start: argv, count: Int(argc))
+	let arguments = args.map { String(utf8String: $0.unsafelyUnwrapped).unsafelyUnwrapped }
+
+	let virtualTable: BatchedVirtualTableModule
+	do {
+		let clientData = Unmanaged<Database.BatchedVirtualTableModuleClientData>.fromOpaque(UnsafeRawPointer(pAux.unsafelyUnwrapped)).takeUnretainedValue()
+		virtualTable = try clientData.construct(arguments, create)
+	}
+
+	catch let error as SQLiteError {
+		os_log("Error connecting to virtual table module: %{public}@", type: .info, error.description)
+		pzErr.unsafelyUnwrapped.pointee = feisty_db_sqlite3_strdup(error.message)
+		return error.code.code
+	}
+
+	catch let error {
+		os_log("Error connecting to virtual table module: %{public}@", type: .info, error.localizedDescription)
+		pzErr.unsafelyUnwrapped.pointee = feisty_db_sqlite3_strdup(error.localizedDescription)
+		return SQLITE_ERROR
+	}
+
+	let rc = sqlite3_declare_vtab(db, virtualTable.declaration)
+	guard rc == SQLITE_OK else {
+		return rc
+	}
+
+	let options = virtualTable.options
+	feisty_db_sqlite3_vtab_config_constraint_support(db, options.contains(.constraintSupport) ? 1 : 0)
+	if options.contains(.innocuous) {
+		feisty_db_sqlite3_vtab_config_innocuous(db)
+	}
+	if options.contains(.directOnly) {
+		feisty_db_sqlite3_vtab_config_directonly(db)
+	}
+
+	let vtab = sqlite3_malloc(Int32(MemoryLayout<feisty_db_sqlite3_vtab>.size))
+	guard vtab != nil else {
+		return SQLITE_NOMEM
+	}
+
+	// virtualTable must live until the xDisconnect function is invoked; store it as a +1 object in ptr
+	let ptr = Unmanaged.passRetained(BatchedVirtualTable(module: virtualTable)).toOpaque()
+
+	let vtab_ptr = vtab.unsafelyUnwrapped.bindMemory(to: feisty_db_sqlite3_vtab.self, capacity: 1)
+	vtab_ptr.pointee.virtual_table_module_ptr = ptr
+	set_vtab_writer(vtab_ptr, virtualTable as? WritableVirtualTable)
+	vtab_ptr.withMemoryRebound(to: sqlite3_vtab.self, capacity: 1) {
+		ppVTab.unsafelyUnwrapped.pointee = $0
+	}
+
+	return SQLITE_OK
+}
+
+func xBatchedDestroy(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> Int32 {
+	do {
+		try batched_vtab_module(pVTab).destroy()
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "destroy()")
+	}
+
+	return xBatchedDisconnect(pVTab)
+}
+
+func xBatchedDisconnect(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> Int32 {
+	pVTab.unsafelyUnwrapped.withMemoryRebound(to: feisty_db_sqlite3_vtab.self, capacity: 1) { vtab in
+		// Balance the +1 retain in init_batched_vtab()
+		Unmanaged<BatchedVirtualTable>.fromOpaque(UnsafeRawPointer(vtab.pointee.virtual_table_module_ptr)).release()
+		free_vtab_writer(vtab)
+	}
+	sqlite3_free(pVTab)
+	return SQLITE_OK
+}
+
+func xBatchedBestIndex(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?, _ pIdxInfo: UnsafeMutablePointer<sqlite3_index_info>?) -> Int32  {
+	do {
+		switch try batched_vtab_module(pVTab).bestIndex(&pIdxInfo.unsafelyUnwrapped.pointee) {
+		case .ok: 			return SQLITE_OK
+		case .constraint: 	return SQLITE_CONSTRAINT
+		}
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "bestIndex()")
+	}
+}
+
+func xBatchedOpen(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?, _ ppCursor: UnsafeMutablePointer<UnsafeMutablePointer<sqlite3_vtab_cursor>?>?) -> Int32 {
+	let virtualTable = batched_vtab_module(pVTab)
+
+	let state: BatchedVirtualTableCursorState
+	do {
+		let cursor = try virtualTable.openCursor()
+		state = BatchedVirtualTableCursorState(cursor: cursor, schema: virtualTable.schema, batchSize: max(1, virtualTable.batchSize))
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "openCursor()")
+	}
+
+	let curs = sqlite3_malloc(Int32(MemoryLayout<feisty_db_sqlite3_vtab_cursor>.size))
+	guard curs != nil else {
+		return SQLITE_NOMEM
+	}
+
+	// state must live until the xClose function is invoked; store it as a +1 object in ptr
+	let ptr = Unmanaged.passRetained(state).toOpaque()
+
+	let curs_ptr = curs.unsafelyUnwrapped.bindMemory(to: feisty_db_sqlite3_vtab_cursor.self, capacity: 1)
+	curs_ptr.pointee.virtual_table_cursor_ptr = ptr
+	curs_ptr.withMemoryRebound(to: sqlite3_vtab_cursor.self, capacity: 1) {
+		ppCursor.unsafelyUnwrapped.pointee = $0
+	}
+
+	return SQLITE_OK
+}
+
+func xBatchedClose(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?) -> Int32 {
+	pCursor.unsafelyUnwrapped.withMemoryRebound(to: feisty_db_sqlite3_vtab_cursor.self, capacity: 1) { curs in
+		// Balance the +1 retain in xBatchedOpen()
+		Unmanaged<BatchedVirtualTableCursorState>.fromOpaque(UnsafeRawPointer(curs.pointee.virtual_table_cursor_ptr)).release()
+	}
+	sqlite3_free(pCursor)
+	return SQLITE_OK
+}
+
+func xBatchedFilter(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?, _ idxNum: Int32, _ idxStr: UnsafePointer<Int8>?, _ argc: Int32, _ argv: UnsafeMutablePointer<OpaquePointer?>?) -> Int32 {
+	let state = batched_vtab_cursor_state(pCursor)
+	let name = idxStr.map { String(cString: $0) }
+	do {
+		try state.filter(SQLArguments(argc: argc, argv: argv), indexNumber: idxNum, indexName: name)
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pCursor.unsafelyUnwrapped.pointee.pVtab, error, in: "filter()")
+	}
+}
+
+func xBatchedNext(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?) -> Int32 {
+	let state = batched_vtab_cursor_state(pCursor)
+	do {
+		try state.next()
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pCursor.unsafelyUnwrapped.pointee.pVtab, error, in: "fill()")
+	}
+}
+
+func xBatchedEof(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?) -> Int32 {
+	return batched_vtab_cursor_state(pCursor).eof ? 1 : 0
+}
+
+func xBatchedColumn(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?, _ pCtx: OpaquePointer?, _ i: Int32) -> Int32 {
+	let state = batched_vtab_cursor_state(pCursor)
+	let columns = state.batch.columns
+	let row = state.index
+
+	guard Int(i) < columns.count else {
+		sqlite3_result_null(pCtx)
+		return SQLITE_OK
+	}
+
+	set_sqlite3_result(pCtx, column: columns[Int(i)], row: row)
+	return SQLITE_OK
+}
+
+/// Sets the result of an SQL function or virtual table column to the value at `row` in `column`
+///
+/// - parameter destructor: `SQLITE_STATIC` if `column` is unmodified for as long as SQLite may use the result,
+/// otherwise `SQLITE_TRANSIENT` to have SQLite copy `text` and `blob` values
+func set_sqlite3_result(_ sqlite_context: OpaquePointer?, column: ColumnarBatch.Column, row: Int, destructor: sqlite3_destructor_type = SQLITE_TRANSIENT) {
+	guard column.isValid(at: row) else {
+		sqlite3_result_null(sqlite_context)
+		return
+	}
+
+	switch column.field.type {
+	case .int64:
+		sqlite3_result_int64(sqlite_context, column.int64Values[row])
+	case .double:
+		sqlite3_result_double(sqlite_context, column.doubleValues[row])
+	case .text:
+		column.withUnsafeBytes(at: row) { bytes in
+			if let text = bytes.baseAddress, bytes.count > 0 {
+				sqlite3_result_text(sqlite_context, text.assumingMemoryBound(to: Int8.self), Int32(bytes.count), destructor)
+			}
+			else {
+				sqlite3_result_text(sqlite_context, "", 0, SQLITE_TRANSIENT)
+			}
+		}
+	case .blob:
+		column.withUnsafeBytes(at: row) { bytes in
+			if let blob = bytes.baseAddress, bytes.count > 0 {
+				sqlite3_result_blob(sqlite_context, blob, Int32(bytes.count), destructor)
+			}
+			else {
+				sqlite3_result_zeroblob(sqlite_context, 0)
+			}
+		}
+	}
+}
+
+func xBatchedRowid(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?, _ pRowid: UnsafeMutablePointer<sqlite3_int64>?) -> Int32 {
+	pRowid.unsafelyUnwrapped.pointee = batched_vtab_cursor_state(pCursor).rowid
+	return SQLITE_OK
+}
@@ -0,0 +1,205 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+extension Database {
+	/// Connection settings applied when a database is opened.
+	///
+	/// Settings with a value of `nil` are left at the SQLite default.
+	///
+	/// ```swift
+	/// var configuration = Database.Configuration()
+	/// configuration.lookaside = .init(slotSize: 1200, slotCount: 500)
+	/// configuration.cacheSize = -16 * 1024
+	/// configuration.journalMode = .wal
+	/// let db = try Database(url: url, configuration: configuration)
+	/// ```
+	public struct Configuration {
+		/// The size and number of lookaside memory slots for a database connection.
+		///
+		/// - seealso: [Lookaside Memory Allocator](https://www.sqlite.org/malloc.html#lookaside)
+		public struct Lookaside {
+			/// The size of each lookaside slot in bytes
+			public var slotSize: Int
+			/// The number of lookaside slots
+			public var slotCount: Int
+
+			/// Creates a lookaside configuration.
+			///
+			/// - parameter slotSize: The size of each lookaside slot in bytes
+			/// - parameter slotCount: The number of lookaside slots
+			public init(slotSize: Int, slotCount: Int) {
+				self.slotSize = slotSize
+				self.slotCount = slotCount
+			}
+		}
+
+		/// Database journal modes.
+		///
+		/// - seealso: [PRAGMA journal_mode](https://www.sqlite.org/pragma.html#pragma_journal_mode)
+		public enum JournalMode: String {
+			/// The rollback journal is deleted at the conclusion of each transaction
+			case delete
+			/// The rollback journal is truncated to zero length at the conclusion of each transaction
+			case truncate
+			/// The header of the rollback journal is overwritten with zeros at the conclusion of each transaction
+			case persist
+			/// The rollback journal is stored in volatile RAM
+			case memory
+			/// A write-ahead log is used instead of a rollback journal
+			case wal
+			/// The rollback journal is disabled
+			case off
+		}
+
+		/// The lookaside memory configuration for the connection, allocated by SQLite
+		///
+		/// - seealso: [SQLITE_DBCONFIG_LOOKASIDE](https://www.sqlite.org/c3ref/c_dbconfig_defensive.html#sqlitedbconfiglookaside)
+		public var lookaside: Lookaside?
+
+		/// The suggested maximum number of database pages held in memory, or if negative the number of KiB of memory to use for the page cache
+		///
+		/// - seealso: [PRAGMA cache_size](https://www.sqlite.org/pragma.html#pragma_cache_size)
+		public var cacheSize: Int?
+
+		/// The maximum number of bytes of the database file that will be accessed using memory-mapped I/O
+		///
+		/// - seealso: [PRAGMA mmap_size](https://www.sqlite.org/pragma.html#pragma_mmap_size)
+		public var mmapSize: Int64?
+
+		/// The page size of the database, which only takes effect before the database is created or when it is vacuumed
+		///
+		/// - seealso: [PRAGMA page_size](https://www.sqlite.org/pragma.html#pragma_page_size)
+		public var pageSize: Int?
+
+		/// The journal mode of the database
+		///
+		/// - seealso: [PRAGMA journal_mode](https://www.sqlite.org/pragma.html#pragma_journal_mode)
+		public var journalMode: JournalMode?
+
+		/// The write-ahead log size in pages at which a checkpoint is automatically performed, or less than or equal to `0` to disable automatic checkpoints
+		///
+		/// - seealso: [PRAGMA wal_autocheckpoint](https://www.sqlite.org/pragma.html#pragma_wal_autocheckpoint)
+		public var walAutocheckpoint: Int?
+
+		/// The size in bytes to which a write-ahead log or rollback journal is truncated after use, or a negative value for no limit
+		///
+		/// - seealso: [PRAGMA journal_size_limit](https://www.sqlite.org/pragma.html#pragma_journal_size_limit)
+		public var journalSizeLimit: Int64?
+
+		/// Creates a configuration.
+		///
+		/// - parameter lookaside: The lookaside memory configuration for the connection
+		/// - parameter cacheSize: The suggested maximum number of pages held in memory, or if negative the number of KiB to use
+		/// - parameter mmapSize: The maximum number of bytes of the database file accessed using memory-mapped I/O
+		/// - parameter pageSize: The page size of the database
+		/// - parameter journalMode: The journal mode of the database
+		/// - parameter walAutocheckpoint: The write-ahead log size in pages at which a checkpoint is automatically performed
+		/// - parameter journalSizeLimit: The size in bytes to which a write-ahead log or rollback journal is truncated after use
+		public init(lookaside: Lookaside? = nil, cacheSize: Int? = nil, mmapSize: Int64? = nil, pageSize: Int? = nil, journalMode: JournalMode? = nil, walAutocheckpoint: Int? = nil, journalSizeLimit: Int64? = nil) {
+			self.lookaside = lookaside
+			self.cacheSize = cacheSize
+			self.mmapSize = mmapSize
+			self.pageSize = pageSize
+			self.journalMode = journalMode
+			self.walAutocheckpoint = walAutocheckpoint
+			self.journalSizeLimit = journalSizeLimit
+		}
+	}
+
+	/// Applies `configuration` to the database connection.
+	///
+	/// - note: The lookaside configuration can only be changed when no lookaside memory is in use,
+	/// which is normally only the case immediately after the connection is opened.
+	///
+	/// - parameter configuration: The settings to apply
+	///
+	/// - throws: An error if any setting could not be applied
+	func apply(_ configuration: Configuration) throws {
+		if let lookaside = configuration.lookaside {
+			let rc = feisty_db_sqlite3_db_config_lookaside(db, nil, Int32(lookaside.slotSize), Int32(lookaside.slotCount))
+			guard rc == SQLITE_OK else {
+				throw SQLiteError("Error configuring lookaside memory", code: rc)
+			}
+		}
+
+		// The page size must be set before the journal mode since it is fixed once a WAL database is created
+		if let pageSize = configuration.pageSize {
+			try execute(sql: "PRAGMA page_size = \(pageSize);")
+		}
+
+		if let journalMode = configuration.journalMode {
+			let mode: String = try prepare(sql: "PRAGMA journal_mode = \(journalMode.rawValue);").front()
+			guard mode.lowercased() == journalMode.rawValue else {
+				throw DatabaseError("Unable to set journal mode to \(journalMode.rawValue); journal mode is \(mode)")
+			}
+		}
+
+		if let cacheSize = configuration.cacheSize {
+			try execute(sql: "PRAGMA cache_size = \(cacheSize);")
+		}
+
+		if let mmapSize = configuration.mmapSize {
+			try execute(sql: "PRAGMA mmap_size = \(mmapSize);")
+		}
+
+		if let walAutocheckpoint = configuration.walAutocheckpoint {
+			try setWALAutocheckpoint(pageCount: walAutocheckpoint)
+		}
+
+		if let journalSizeLimit = configuration.journalSizeLimit {
+			try setJournalSizeLimit(journalSizeLimit)
+		}
+	}
+}
+
+extension SQLite {
+	/// The memory arena used by the page cache, retained for the lifetime of the process
+	static var pageCacheArena: UnsafeMutableRawPointer?
+
+	/// Configures SQLite to satisfy page cache allocations from a pre-allocated arena.
+	///
+	/// The arena is sized to hold `pageCount` pages of `pageSize` bytes plus the per-page header used by SQLite.
+	/// Allocations that don't fit in the arena, either because they are larger than a slot or because the arena is full,
+	/// fall back to `sqlite3_malloc()`.
+	///
+	/// - important: The page cache may only be configured before SQLite is initialized or after it is shut down.
+	/// SQLite is initialized automatically when the first database is opened.
+	///
+	/// - note: The arena is shared by all database connections and is never deallocated.
+	///
+	/// - parameter pageSize: The largest database page size to be used
+	/// - parameter pageCount: The number of pages the arena can hold
+	///
+	/// - throws: An error if SQLite has already been initialized or the page cache has already been configured
+	///
+	/// - seealso: [Page Cache Memory](https://www.sqlite.org/malloc.html#pagecache)
+	public static func configurePageCache(pageSize: Int = 4096, pageCount: Int) throws {
+		precondition(pageSize > 0 && pageCount > 0)
+
+		guard pageCacheArena == nil else {
+			throw DatabaseError("The page cache has already been configured")
+		}
+
+		var headerSize: Int32 = 0
+		var rc = feisty_db_sqlite3_config_pcache_hdrsz(&headerSize)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error determining page cache header size", code: rc)
+		}
+
+		let slotSize = pageSize + Int(headerSize)
+		let arena = UnsafeMutableRawPointer.allocate(byteCount: slotSize * pageCount, alignment: 8)
+		rc = feisty_db_sqlite3_config_pagecache(arena, Int32(slotSize), Int32(pageCount))
+		guard rc == SQLITE_OK else {
+			arena.deallocate()
+			throw SQLiteError("Error configuring page cache", code: rc)
+		}
+
+		pageCacheArena = arena
+	}
+}
@@ -218,6 +218,189 @@ extension Database {
 	}
 }
 
+/// An interface to a custom FTS5 tokenizer operating directly on UTF-8 text.
+///
+/// Unlike `FTS5Tokenizer`, the text to be tokenized is passed as the UTF-8 buffer supplied by FTS5
+/// and tokens are emitted as byte ranges of that buffer, so no `String` conversions are performed.
+public protocol FTS5UTF8Tokenizer: AnyObject {
+	/// Initializes an FTS5 tokenizer.
+	///
+	/// - parameter arguments: The tokenizer arguments used to create the FTS5 table.
+	init(arguments: [String])
+
+	/// Tokenizes text.
+	///
+	/// - important: `text` is owned by FTS5 and must not be used after this method returns.
+	///
+	/// - parameter text: The UTF-8 text to be tokenized
+	/// - parameter reason: The reason tokenization is being requested
+	/// - parameter tokens: The destination for tokens found in `text`
+	///
+	/// - throws: An error if tokenization fails or `tokens` rejects a token
+	func tokenize(_ text: UnsafeRawBufferPointer, reason: Database.FTS5TokenizationReason, tokens: FTS5TokenSink) throws
+}
+
+/// The destination for tokens produced by an `FTS5UTF8Tokenizer`.
+///
+/// - seealso: [Custom Tokenizers](https://www.sqlite.org/fts5.html#custom_tokenizers)
+public struct FTS5TokenSink {
+	/// The `pCtx` argument to `xToken`
+	let context: UnsafeMutableRawPointer?
+	/// The FTS5 token callback
+	let xToken: @convention(c) (UnsafeMutableRawPointer?, Int32, UnsafePointer<Int8>?, Int32, Int32, Int32) -> Int32
+	/// The text being tokenized
+	public let text: UnsafeRawBufferPointer
+
+	/// Emits the bytes of `text` in `range` as a token.
+	///
+	/// - parameter range: The byte range of the token in `text`
+	/// - parameter colocated: Whether the token is a synonym occupying the same position as the previous token
+	///
+	/// - throws: An error if FTS5 rejects the token, in which case tokenization should stop
+	public func emit(_ range: Range<Int>, colocated: Bool = false) throws {
+		precondition(range.lowerBound >= 0 && range.upperBound <= text.count, "Token range out of bounds")
+		let token = text.baseAddress.map { $0.advanced(by: range.lowerBound).assumingMemoryBound(to: Int8.self) }
+		try emit(token, byteCount: range.count, sourceRange: range, colocated: colocated)
+	}
+
+	/// Emits `token` for the bytes of `text` in `sourceRange`.
+	///
+	/// This is used for tokens that differ from the source text, for example after case folding or stemming.
+	///
+	/// - parameter token: The UTF-8 bytes of the token, which are copied by FTS5
+	/// - parameter sourceRange: The byte range in `text` from which `token` was derived
+	/// - parameter colocated: Whether the token is a synonym occupying the same position as the previous token
+	///
+	/// - throws: An error if FTS5 rejects the token, in which case tokenization should stop
+	public func emit(_ token: UnsafeRawBufferPointer, sourceRange: Range<Int>, colocated: Bool = false) throws {
+		try emit(token.baseAddress?.assumingMemoryBound(to: Int8.self), byteCount: token.count, sourceRange: sourceRange, colocated: colocated)
+	}
+
+	/// Emits `token` for the bytes of `text` in `sourceRange`.
+	///
+	/// - parameter token: The token
+	/// - parameter sourceRange: The byte range in `text` from which `token` was derived
+	/// - parameter colocated: Whether the token is a synonym occupying the same position as the previous token
+	///
+	/// - throws: An error if FTS5 rejects the token, in which case tokenization should stop
+	public func emit(_ token: String, sourceRange: Range<Int>, colocated: Bool = false) throws {
+		var token = token
+		try token.withUTF8 { utf8 in
+			try emit(UnsafeRawBufferPointer(utf8), sourceRange: sourceRange, colocated: colocated)
+		}
+	}
+
+	/// Passes a token to FTS5
+	func emit(_ token: UnsafePointer<Int8>?, byteCount: Int, sourceRange: Range<Int>, colocated: Bool) throws {
+		let flags = colocated ? FTS5_TOKEN_COLOCATED : 0
+		let rc = xToken(context, flags, token, Int32(byteCount), Int32(sourceRange.lowerBound), Int32(sourceRange.upperBound))
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error passing token to FTS5", code: rc)
+		}
+	}
+}
+
+extension Database {
+	/// Glue for creating a generic Swift type in a C callback
+	final class FTS5UTF8TokenizerCreator {
+		/// The constructor closure
+		let construct: (_ arguments : [String]) -> FTS5UTF8Tokenizer
+
+		/// Creates a new FTS5UTF8TokenizerCreator.
+		///
+		/// - parameter construct: A closure that creates the tokenizer
+		init(_ construct: @escaping (_ arguments: [String]) -> FTS5UTF8Tokenizer) {
+			self.construct = construct
+		}
+	}
+
+	/// Adds a custom FTS5 tokenizer operating directly on UTF-8 text.
+	///
+	/// For example, a tokenizer splitting ASCII text on spaces could be implemented as:
+	/// ```swift
+	/// final class SpaceTokenizer: FTS5UTF8Tokenizer {
+	/// 	init(arguments: [String]) {
+	/// 	}
+	///
+	/// 	func tokenize(_ text: UnsafeRawBufferPointer, reason: Database.FTS5TokenizationReason, tokens: FTS5TokenSink) throws {
+	/// 		var start = 0
+	/// 		for (i, byte) in text.enumerated() where byte == 0x20 {
+	/// 			if i > start {
+	/// 				try tokens.emit(start ..< i)
+	/// 			}
+	/// 			start = i + 1
+	/// 		}
+	/// 		if text.count > start {
+	/// 			try tokens.emit(start ..< text.count)
+	/// 		}
+	/// 	}
+	/// }
+	/// ```
+	///
+	/// - parameter name: The name of the tokenizer
+	/// - parameter type: The class implementing the tokenizer
+	///
+	/// - throws:  An error if the tokenizer can't be added
+	///
+	/// - seealso: [Custom Tokenizers](https://www.sqlite.org/fts5.html#custom_tokenizers)
+	public func addTokenizer<T: FTS5UTF8Tokenizer>(_ name: String, type: T.Type) throws {
+		// Fail early if FTS5 isn't available
+		let api_ptr = try get_fts5_api(for: db)
+
+		var tokenizer_struct = fts5_tokenizer(xCreate: { (user_data, argv, argc, out) -> Int32 in
+			let args = UnsafeBufferPointer(start: argv, count: Int(argc))
+			let arguments = args.map { String(utf8String: $0.unsafelyUnwrapped).unsafelyUnwrapped }
+
+			let creator = Unmanaged<FTS5UTF8TokenizerCreator>.fromOpaque(UnsafeRawPointer(user_data.unsafelyUnwrapped)).takeUnretainedValue()
+			let tokenizer = creator.construct(arguments)
+
+			// tokenizer must live until the xDelete function is invoked; store it as a +1 object in ptr
+			let ptr = Unmanaged.passRetained(tokenizer as AnyObject).toOpaque()
+			out?.initialize(to: OpaquePointer(ptr))
+
+			return SQLITE_OK
+		}, xDelete: { p in
+			// Balance the +1 retain above
+			Unmanaged<AnyObject>.fromOpaque(UnsafeRawPointer(p.unsafelyUnwrapped)).release()
+		}, xTokenize: { (tokenizer_ptr, context, flags, text_utf8, text_len, xToken) -> Int32 in
+			let tokenizer = Unmanaged<AnyObject>.fromOpaque(UnsafeRawPointer(tokenizer_ptr.unsafelyUnwrapped)).takeUnretainedValue() as! FTS5UTF8Tokenizer
+
+			let text = UnsafeRawBufferPointer(start: text_utf8, count: Int(text_len))
+			let tokens = FTS5TokenSink(context: context, xToken: xToken.unsafelyUnwrapped, text: text)
+
+			do {
+				try tokenizer.tokenize(text, reason: FTS5TokenizationReason(flags), tokens: tokens)
+			}
+
+			catch let error as SQLiteError {
+				return error.code.code
+			}
+
+			catch let error {
+				os_log("Error tokenizing text: %{public}@", type: .info, error.localizedDescription)
+				return SQLITE_ERROR
+			}
+
+			return SQLITE_OK
+		})
+
+		// user_data must live until the xDestroy function is invoked; store it as a +1 object
+		let user_data = FTS5UTF8TokenizerCreator { (args) -> FTS5UTF8Tokenizer in
+			return T(arguments: args)
+		}
+		let user_data_ptr = Unmanaged.passRetained(user_data).toOpaque()
+
+		guard api_ptr.pointee.xCreateTokenizer(UnsafeMutablePointer(mutating: api_ptr), name, user_data_ptr, &tokenizer_struct, { user_data in
+			// Balance the +1 retain above
+			Unmanaged<FTS5UTF8TokenizerCreator>.fromOpaque(UnsafeRawPointer(user_data.unsafelyUnwrapped)).release()
+		}) == SQLITE_OK else {
+			// xDestroy is not called if fts5_api.xCreateTokenizer() fails
+			Unmanaged<FTS5UTF8TokenizerCreator>.fromOpaque(user_data_ptr).release()
+			throw SQLiteError("Error creating FTS5 tokenizer", takingDescriptionFromDatabase: db)
+		}
+	}
+}
+
 extension Database.FTS5TokenizationReason {
 	/// Convenience initializer for conversion of `FTS5_TOKENIZE_` values
 	///
@@ -0,0 +1,341 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// An instance of a phrase match in the current row of an FTS5 query.
+public struct FTS5PhraseInstance: Equatable {
+	/// The index of the matched phrase
+	public let phrase: Int
+	/// The column containing the match
+	public let column: Int
+	/// The token offset of the match within the column
+	public let offset: Int
+}
+
+/// The interface to the current row of an FTS5 query available to an auxiliary function.
+///
+/// - important: A context is only valid for the duration of the invocation to which it is passed
+/// and must not be stored or used outside of it.
+///
+/// - seealso: [Custom Auxiliary Functions](https://www.sqlite.org/fts5.html#custom_auxiliary_functions)
+public struct FTS5ExtensionContext {
+	/// The FTS5 extension API
+	let api: UnsafePointer<Fts5ExtensionApi>
+	/// The `Fts5Context *` object
+	let fts: OpaquePointer
+
+	/// The number of columns in the FTS5 table
+	public var columnCount: Int {
+		return Int(api.pointee.xColumnCount(fts))
+	}
+
+	/// The number of phrases in the current query expression
+	public var phraseCount: Int {
+		return Int(api.pointee.xPhraseCount(fts))
+	}
+
+	/// The rowid of the current row
+	public var rowid: Int64 {
+		return api.pointee.xRowid(fts)
+	}
+
+	/// Returns the number of tokens in `phrase`.
+	///
+	/// - parameter phrase: The index of the desired phrase
+	public func phraseSize(_ phrase: Int) -> Int {
+		return Int(api.pointee.xPhraseSize(fts, Int32(phrase)))
+	}
+
+	/// Returns the number of rows in the FTS5 table.
+	///
+	/// - throws: An error if the row count couldn't be determined
+	public func rowCount() throws -> Int64 {
+		var count: Int64 = 0
+		let rc = api.pointee.xRowCount(fts, &count)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error retrieving FTS5 row count", code: rc)
+		}
+		return count
+	}
+
+	/// Returns the total number of tokens in `column` across all rows of the FTS5 table.
+	///
+	/// - parameter column: The index of the desired column, or `-1` for all columns
+	///
+	/// - throws: An error if the size couldn't be determined
+	public func columnTotalSize(_ column: Int = -1) throws -> Int64 {
+		var size: Int64 = 0
+		let rc = api.pointee.xColumnTotalSize(fts, Int32(column), &size)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error retrieving FTS5 column total size", code: rc)
+		}
+		return size
+	}
+
+	/// Returns the number of tokens in `column` of the current row.
+	///
+	/// - parameter column: The index of the desired column, or `-1` for all columns
+	///
+	/// - throws: An error if the size couldn't be determined
+	public func columnSize(_ column: Int = -1) throws -> Int {
+		var size: Int32 = 0
+		let rc = api.pointee.xColumnSize(fts, Int32(column), &size)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error retrieving FTS5 column size", code: rc)
+		}
+		return Int(size)
+	}
+
+	/// Invokes `body` with the UTF-8 text of `column` in the current row.
+	///
+	/// The bytes are owned by FTS5 and are not copied.
+	///
+	/// - important: The buffer passed to `body` must not be used outside of `body`.
+	///
+	/// - parameter column: The index of the desired column
+	/// - parameter body: A closure accessing the column's text
+	/// - parameter text: The column's text
+	///
+	/// - throws: An error if the text couldn't be retrieved or any error thrown in `body`
+	///
+	/// - returns: The value returned by `body`
+	public func withUnsafeColumnText<T>(_ column: Int, _ body: (_ text: UnsafeRawBufferPointer) throws -> T) throws -> T {
+		var text: UnsafePointer<Int8>?
+		var length: Int32 = 0
+		let rc = api.pointee.xColumnText(fts, Int32(column), &text, &length)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error retrieving FTS5 column text", code: rc)
+		}
+		return try body(UnsafeRawBufferPointer(start: text, count: text != nil ? Int(length) : 0))
+	}
+
+	/// Returns the text of `column` in the current row.
+	///
+	/// - parameter column: The index of the desired column
+	///
+	/// - throws: An error if the text couldn't be retrieved
+	public func columnText(_ column: Int) throws -> String {
+		return try withUnsafeColumnText(column) { String(decoding: $0, as: UTF8.self) }
+	}
+
+	/// Returns the number of phrase matches in the current row.
+	///
+	/// - throws: An error if the count couldn't be determined
+	public func instanceCount() throws -> Int {
+		var count: Int32 = 0
+		let rc = api.pointee.xInstCount(fts, &count)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error retrieving FTS5 instance count", code: rc)
+		}
+		return Int(count)
+	}
+
+	/// Returns a phrase match in the current row.
+	///
+	/// - parameter index: The index of the desired match, in `0 ..< instanceCount()`
+	///
+	/// - throws: An error if the match couldn't be retrieved
+	public func instance(at index: Int) throws -> FTS5PhraseInstance {
+		var phrase: Int32 = 0
+		var column: Int32 = 0
+		var offset: Int32 = 0
+		let rc = api.pointee.xInst(fts, Int32(index), &phrase, &column, &offset)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error retrieving FTS5 instance", code: rc)
+		}
+		return FTS5PhraseInstance(phrase: Int(phrase), column: Int(column), offset: Int(offset))
+	}
+
+	/// Returns all phrase matches in the current row.
+	///
+	/// - throws: An error if the matches couldn't be retrieved
+	public func instances() throws -> [FTS5PhraseInstance] {
+		return try (0 ..< instanceCount()).map { try instance(at: $0) }
+	}
+
+	/// Returns the matches of `phrase` in the current row.
+	///
+	/// This is more efficient than filtering `instances()` when only a single phrase is of interest.
+	///
+	/// - parameter phrase: The index of the desired phrase
+	///
+	/// - throws: An error if the matches couldn't be retrieved
+	public func instances(ofPhrase phrase: Int) throws -> [FTS5PhraseInstance] {
+		var iterator = Fts5PhraseIter()
+		var column: Int32 = 0
+		var offset: Int32 = 0
+		let rc = api.pointee.xPhraseFirst(fts, Int32(phrase), &iterator, &column, &offset)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error retrieving FTS5 phrase instances", code: rc)
+		}
+		var instances = [FTS5PhraseInstance]()
+		while column >= 0 {
+			instances.append(FTS5PhraseInstance(phrase: phrase, column: Int(column), offset: Int(offset)))
+			api.pointee.xPhraseNext(fts, &iterator, &column, &offset)
+		}
+		return instances
+	}
+
+	/// Invokes `body` for each row of the FTS5 table matching `phrase`.
+	///
+	/// This is typically used to compute statistics such as the number of rows containing a phrase,
+	/// which should then be cached using `cachedValue(_:)`.
+	///
+	/// - parameter phrase: The index of the desired phrase
+	/// - parameter body: A closure called with each matching row
+	/// - parameter row: A context for the matching row
+	///
+	/// - throws: An error if the query failed or any error thrown in `body`
+	public func queryPhrase(_ phrase: Int, _ body: (_ row: FTS5ExtensionContext) throws -> Bool) throws {
+		try withoutActuallyEscaping(body) { body in
+			var query = FTS5PhraseQuery(body: body)
+			let rc = api.pointee.xQueryPhrase(fts, Int32(phrase), &query, { api, fts, user_data in
+				let query = user_data.unsafelyUnwrapped.assumingMemoryBound(to: FTS5PhraseQuery.self)
+				do {
+					return try query.pointee.body(FTS5ExtensionContext(api: api.unsafelyUnwrapped, fts: fts.unsafelyUnwrapped)) ? SQLITE_OK : SQLITE_DONE
+				}
+				catch let error {
+					query.pointee.error = error
+					return SQLITE_ERROR
+				}
+			})
+			if let error = query.error {
+				throw error
+			}
+			guard rc == SQLITE_OK else {
+				throw SQLiteError("Error querying FTS5 phrase", code: rc)
+			}
+		}
+	}
+
+	/// Tokenizes `text` using the FTS5 table's tokenizer.
+	///
+	/// - parameter text: The UTF-8 text to tokenize
+	/// - parameter body: A closure called with each token
+	/// - parameter token: The token's bytes
+	/// - parameter range: The byte range in `text` from which `token` was derived
+	///
+	/// - throws: An error if tokenization failed or any error thrown in `body`
+	public func tokenize(_ text: UnsafeRawBufferPointer, _ body: (_ token: UnsafeRawBufferPointer, _ range: Range<Int>) throws -> Bool) throws {
+		try withoutActuallyEscaping(body) { body in
+			var tokenization = FTS5AuxiliaryTokenization(body: body)
+			let rc = api.pointee.xTokenize(fts, text.baseAddress?.assumingMemoryBound(to: Int8.self), Int32(text.count), &tokenization, { user_data, flags, token, token_len, start, end in
+				let tokenization = user_data.unsafelyUnwrapped.assumingMemoryBound(to: FTS5AuxiliaryTokenization.self)
+				do {
+					return try tokenization.pointee.body(UnsafeRawBufferPointer(start: token, count: Int(token_len)), Int(start) ..< Int(end)) ? SQLITE_OK : SQLITE_DONE
+				}
+				catch let error {
+					tokenization.pointee.error = error
+					return SQLITE_ERROR
+				}
+			})
+			if let error = tokenization.error {
+				throw error
+			}
+			guard rc == SQLITE_OK || rc == SQLITE_DONE else {
+				throw SQLiteError("Error tokenizing text", code: rc)
+			}
+		}
+	}
+
+	/// Returns a value computed once per query, such as per-phrase statistics for ranking.
+	///
+	/// `body` is invoked the first time this method is called during a query and the
+	/// result is retained by FTS5 until the query completes.
+	///
+	/// - parameter body: A closure computing the value
+	///
+	/// - throws: An error if the value couldn't be cached or any error thrown in `body`
+	///
+	/// - returns: The cached value
+	public func cachedValue<T>(_ body: () throws -> T) throws -> T {
+		if let auxdata = api.pointee.xGetAuxdata(fts, 0), let box = Unmanaged<AnyObject>.fromOpaque(auxdata).takeUnretainedValue() as? AuxiliaryDataBox<T> {
+			return box.value
+		}
+		let box = AuxiliaryDataBox(try body())
+		// xSetAuxdata invokes the destructor on failure
+		let rc = api.pointee.xSetAuxdata(fts, Unmanaged.passRetained(box as AnyObject).toOpaque(), { auxdata in
+			Unmanaged<AnyObject>.fromOpaque(auxdata.unsafelyUnwrapped).release()
+		})
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error caching FTS5 auxiliary data", code: rc)
+		}
+		return box.value
+	}
+}
+
+/// State for `FTS5ExtensionContext.queryPhrase(_:_:)`
+struct FTS5PhraseQuery {
+	let body: (FTS5ExtensionContext) throws -> Bool
+	var error: Swift.Error? = nil
+}
+
+/// State for `FTS5ExtensionContext.tokenize(_:_:)`
+struct FTS5AuxiliaryTokenization {
+	let body: (UnsafeRawBufferPointer, Range<Int>) throws -> Bool
+	var error: Swift.Error? = nil
+}
+
+/// A type-erased invocation of an FTS5 auxiliary function setting its result in `context`
+typealias FTS5AuxiliaryFunctionInvocation = (_ fts: FTS5ExtensionContext, _ context: SQLFunctionContext, _ arguments: SQLArguments) throws -> Void
+
+extension Database {
+	/// Adds a custom FTS5 auxiliary function.
+	///
+	/// Auxiliary functions are evaluated within the query, so ranking and snippet generation
+	/// don't require fetching every match. A ranking function may also be used as the
+	/// table's `rank` so `ORDER BY rank LIMIT n` is evaluated by FTS5.
+	///
+	/// For example, a ranking function favoring rows with many matches could be implemented as:
+	/// ```swift
+	/// try db.addAuxiliaryFunction("match_density") { fts, arguments -> Double in
+	///     let size = try fts.columnSize()
+	///     return size > 0 ? -Double(try fts.instanceCount()) / Double(size) : 0
+	/// }
+	/// try db.execute(sql: "select * from t1 where t1 match 'fox' order by match_density(t1) limit 20;")
+	/// ```
+	///
+	/// - parameter name: The name of the auxiliary function
+	/// - parameter block: A closure that returns the result of the function for the current row
+	/// - parameter fts: The current row of the FTS5 query
+	/// - parameter arguments: The arguments following the table name in the function invocation
+	///
+	/// - throws: An error if the auxiliary function couldn't be added
+	///
+	/// - seealso: [Custom Auxiliary Functions](https://www.sqlite.org/fts5.html#custom_auxiliary_functions)
+	public func addAuxiliaryFunction<R: SQLFunctionResult>(_ name: String, _ block: @escaping (_ fts: FTS5ExtensionContext, _ arguments: SQLArguments) throws -> R) throws {
+		// Fail early if FTS5 isn't available
+		let api_ptr = try get_fts5_api(for: db)
+
+		let function_ptr = UnsafeMutablePointer<FTS5AuxiliaryFunctionInvocation>.allocate(capacity: 1)
+		function_ptr.initialize(to: { fts, context, arguments in
+			try block(fts, arguments).setResult(in: context)
+		})
+
+		guard api_ptr.pointee.xCreateFunction(UnsafeMutablePointer(mutating: api_ptr), name, function_ptr, { api, fts, sqlite_context, argc, argv in
+			let fts = FTS5ExtensionContext(api: api.unsafelyUnwrapped, fts: fts.unsafelyUnwrapped)
+			let function_ptr = fts.api.pointee.xUserData(fts.fts).unsafelyUnwrapped.assumingMemoryBound(to: FTS5AuxiliaryFunctionInvocation.self)
+			do {
+				try function_ptr.pointee(fts, SQLFunctionContext(sqlite_context.unsafelyUnwrapped), SQLArguments(argc: argc, argv: argv))
+			}
+
+			catch let error {
+				sqlite3_result_error(sqlite_context, "\(error)", -1)
+			}
+		}, { user_data in
+			let function_ptr = user_data.unsafelyUnwrapped.assumingMemoryBound(to: FTS5AuxiliaryFunctionInvocation.self)
+			function_ptr.deinitialize(count: 1)
+			function_ptr.deallocate()
+		}) == SQLITE_OK else {
+			// xDestroy is not called if fts5_api.xCreateFunction() fails
+			function_ptr.deinitialize(count: 1)
+			function_ptr.deallocate()
+			throw SQLiteError("Error creating FTS5 auxiliary function \"\(name)\"", takingDescriptionFromDatabase: db)
+		}
+	}
+}
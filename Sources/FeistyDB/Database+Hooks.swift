@@ -89,26 +89,29 @@ extension Database {
 		let context = UnsafeMutablePointer<WALCommitHook>.allocate(capacity: 1)
 		context.initialize(to: block)
 
-		if let old = sqlite3_wal_hook(db, { context, db, db_name, pageCount in
+		// The context returned by `sqlite3_wal_hook()` isn't necessarily a `WALCommitHook`;
+		// when automatic checkpoints are enabled it is the checkpoint page count
+		sqlite3_wal_hook(db, { context, db, db_name, pageCount in
 			//			guard db == self.db else {
 			//				fatalError("Unexpected database connection handle from sqlite3_wal_hook")
 			//			}
 			let database = String(utf8String: db_name.unsafelyUnwrapped).unsafelyUnwrapped
 			return context.unsafelyUnwrapped.assumingMemoryBound(to: WALCommitHook.self).pointee(database, Int(pageCount))
-		}, context) {
-			let oldContext = old.assumingMemoryBound(to: WALCommitHook.self)
-			oldContext.deinitialize(count: 1)
-			oldContext.deallocate()
-		}
+		}, context)
+
+		walCommitHook?.deinitialize(count: 1)
+		walCommitHook?.deallocate()
+		walCommitHook = context
 	}
 
 	/// Removes the write-ahead log commit hook.
+	///
+	/// - note: This also disables automatic checkpoints
 	public func removeWALCommitHook() {
-		if let old = sqlite3_wal_hook(db, nil, nil) {
-			let oldContext = old.assumingMemoryBound(to: WALCommitHook.self)
-			oldContext.deinitialize(count: 1)
-			oldContext.deallocate()
-		}
+		sqlite3_wal_hook(db, nil, nil)
+		walCommitHook?.deinitialize(count: 1)
+		walCommitHook?.deallocate()
+		walCommitHook = nil
 	}
 }
 
@@ -250,6 +253,47 @@ extension Database {
 	}
 }
 
+extension Database {
+	/// A hook called periodically during long-running SQL statements.
+	///
+	/// - returns: `true` if the current operation should be interrupted, `false` to continue
+	///
+	/// - seealso: [Query Progress Callbacks](https://www.sqlite.org/c3ref/progress_handler.html)
+	public typealias ProgressHandler = () -> Bool
+
+	/// Sets a callback invoked periodically during long-running SQL statements.
+	///
+	/// - note: An interrupted operation fails with `SQLITE_INTERRUPT`
+	///
+	/// - parameter instructionCount: The approximate number of virtual machine instructions evaluated between invocations of `block`
+	/// - parameter block: A closure called periodically during long-running SQL statements
+	public func setProgressHandler(instructionCount: Int = 1000, _ block: @escaping ProgressHandler) {
+		precondition(instructionCount > 0, "instructionCount must be positive")
+		if progressHandler == nil {
+			progressHandler = UnsafeMutablePointer<ProgressHandler>.allocate(capacity: 1)
+		}
+		else {
+			progressHandler?.deinitialize(count: 1)
+		}
+
+		progressHandler?.initialize(to: block)
+		progressHandlerInstructionCount = instructionCount
+
+		sqlite3_progress_handler(db, Int32(instructionCount), { context in
+			return context.unsafelyUnwrapped.assumingMemoryBound(to: ProgressHandler.self).pointee() ? 1 : 0
+		}, progressHandler)
+	}
+
+	/// Removes the progress handler.
+	public func removeProgressHandler() {
+		sqlite3_progress_handler(db, 0, nil, nil)
+		progressHandler?.deinitialize(count: 1)
+		progressHandler?.deallocate()
+		progressHandler = nil
+		progressHandlerInstructionCount = 0
+	}
+}
+
 // The pre-update hook is not compiled into FeistyDB by default
 // because it is not one of the recommended SQLite compile-time
 // options: https://www.sqlite.org/compile.html
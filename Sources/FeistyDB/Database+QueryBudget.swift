@@ -0,0 +1,194 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// A thread-safe flag used to cancel database operations running under a `Database.QueryBudget`.
+///
+/// Unlike `Database.interrupt()`, cancelling a token only affects operations using the token.
+public final class QueryCancellationToken {
+	/// The lock protecting `_isCancelled`
+	let lock = NSLock()
+	/// `true` if the token has been cancelled
+	var _isCancelled = false
+
+	/// Creates a token.
+	public init() {
+	}
+
+	/// `true` if the token has been cancelled
+	public var isCancelled: Bool {
+		lock.lock()
+		defer {
+			lock.unlock()
+		}
+		return _isCancelled
+	}
+
+	/// Cancels operations using the token.
+	///
+	/// - note: This method may be called from any thread
+	public func cancel() {
+		lock.lock()
+		_isCancelled = true
+		lock.unlock()
+	}
+}
+
+/// An error thrown when a database operation exceeds its `Database.QueryBudget`.
+public struct QueryBudgetExceededError: Error {
+	/// Possible reasons a budget was exceeded
+	public enum Reason {
+		/// The time limit elapsed
+		case timeLimit
+		/// The virtual machine instruction limit was reached
+		case instructionLimit
+		/// The operation was cancelled
+		case cancelled
+	}
+
+	/// The reason the budget was exceeded
+	public let reason: Reason
+
+	/// A brief message describing the error
+	public var message: String {
+		switch reason {
+		case .timeLimit:			return "Query time limit exceeded"
+		case .instructionLimit:		return "Query instruction limit exceeded"
+		case .cancelled:			return "Query cancelled"
+		}
+	}
+
+	/// A more detailed description of the error's cause
+	public let details: String?
+}
+
+extension QueryBudgetExceededError: CustomStringConvertible {
+	public var description: String {
+		if let details = details {
+			return "\(message): \(details)"
+		}
+		else {
+			return message
+		}
+	}
+}
+
+extension QueryBudgetExceededError: LocalizedError {
+	public var errorDescription: String? {
+		return message
+	}
+
+	public var failureReason: String? {
+		return details
+	}
+}
+
+extension Database {
+	/// Limits on the resources used by database operations.
+	///
+	/// Budgets are enforced by a progress handler, so a limit is detected within roughly `checkInterval`
+	/// virtual machine instructions of being reached.
+	///
+	/// - seealso: [Query Progress Callbacks](https://www.sqlite.org/c3ref/progress_handler.html)
+	public struct QueryBudget {
+		/// The maximum time in seconds, or `nil` for no limit
+		public var timeLimit: TimeInterval?
+		/// The maximum number of virtual machine instructions, or `nil` for no limit
+		public var instructionLimit: Int?
+		/// A token used to cancel operations, or `nil` if operations may not be cancelled
+		public var cancellationToken: QueryCancellationToken?
+		/// The approximate number of virtual machine instructions between budget checks
+		public var checkInterval: Int
+
+		/// Creates a budget.
+		///
+		/// - parameter timeLimit: The maximum time in seconds, or `nil` for no limit
+		/// - parameter instructionLimit: The maximum number of virtual machine instructions, or `nil` for no limit
+		/// - parameter cancellationToken: A token used to cancel operations
+		/// - parameter checkInterval: The approximate number of virtual machine instructions between budget checks
+		public init(timeLimit: TimeInterval? = nil, instructionLimit: Int? = nil, cancellationToken: QueryCancellationToken? = nil, checkInterval: Int = 1000) {
+			precondition(checkInterval > 0, "checkInterval must be positive")
+			self.timeLimit = timeLimit
+			self.instructionLimit = instructionLimit
+			self.cancellationToken = cancellationToken
+			self.checkInterval = checkInterval
+		}
+
+		/// `true` if the budget places no limits on database operations
+		var isUnlimited: Bool {
+			return timeLimit == nil && instructionLimit == nil && cancellationToken == nil
+		}
+	}
+
+	/// Performs database operations subject to a budget.
+	///
+	/// If `budget` is exceeded the SQL statement being evaluated is interrupted and
+	/// `QueryBudgetExceededError` is thrown.  Other operations on the connection are unaffected.
+	///
+	/// ```swift
+	/// let rows: [Report] = try db.withBudget(.init(timeLimit: 0.5)) { db in
+	///     try db.prepare(sql: "select * from report;").decode(Report.self)
+	/// }
+	/// ```
+	///
+	/// - note: Any existing progress handler is suspended while `block` executes
+	///
+	/// - parameter budget: The limits for operations in `block`
+	/// - parameter block: A closure performing the database operations
+	/// - parameter database: A `Database` used for database access within `block`
+	///
+	/// - throws: `QueryBudgetExceededError` if `budget` is exceeded, otherwise any error thrown in `block`
+	///
+	/// - returns: The value returned by `block`
+	public func withBudget<T>(_ budget: QueryBudget, _ block: (_ database: Database) throws -> T) throws -> T {
+		let previousHandler = progressHandler?.pointee
+		let previousInstructionCount = progressHandlerInstructionCount
+		defer {
+			if let previousHandler = previousHandler {
+				setProgressHandler(instructionCount: previousInstructionCount, previousHandler)
+			}
+			else {
+				removeProgressHandler()
+			}
+		}
+
+		let start = DispatchTime.now().uptimeNanoseconds
+		let deadline = budget.timeLimit.map { start + UInt64(max($0, 0) * Double(NSEC_PER_SEC)) }
+		var instructionCount = 0
+		var reason: QueryBudgetExceededError.Reason? = nil
+
+		setProgressHandler(instructionCount: budget.checkInterval) {
+			instructionCount += budget.checkInterval
+			if let token = budget.cancellationToken, token.isCancelled {
+				reason = .cancelled
+			}
+			else if let limit = budget.instructionLimit, instructionCount >= limit {
+				reason = .instructionLimit
+			}
+			else if let deadline = deadline, DispatchTime.now().uptimeNanoseconds >= deadline {
+				reason = .timeLimit
+			}
+			return reason != nil
+		}
+
+		if let token = budget.cancellationToken, token.isCancelled {
+			throw QueryBudgetExceededError(reason: .cancelled, details: nil)
+		}
+
+		do {
+			return try block(self)
+		}
+		catch let error {
+			guard let reason = reason else {
+				throw error
+			}
+			let elapsed = Double(DispatchTime.now().uptimeNanoseconds - start) / Double(NSEC_PER_SEC)
+			throw QueryBudgetExceededError(reason: reason, details: "Interrupted after approximately \(instructionCount) instructions and \(elapsed) seconds")
+		}
+	}
+}
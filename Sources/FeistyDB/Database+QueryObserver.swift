@@ -0,0 +1,407 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import os.log
+import Foundation
+import CSQLite
+
+/// Information on a completed execution of an SQL statement.
+public struct QueryEvent {
+	/// The original SQL text of the statement
+	public let sql: String
+	/// The wall-clock time taken to execute the statement, in nanoseconds
+	public let elapsedNanoseconds: Int64
+	/// The number of result rows stepped or `nil` if row counting is disabled
+	public let rowCount: Int?
+	/// The number of times SQLite stepped forward in a table as part of a full table scan
+	public let fullscanSteps: Int
+	/// The number of sort operations performed
+	public let sorts: Int
+	/// The number of rows inserted into automatic indexes
+	public let autoindexRows: Int
+	/// The number of virtual machine operations executed
+	public let vmSteps: Int
+
+	/// The wall-clock time taken to execute the statement, in seconds
+	public var elapsedTime: TimeInterval {
+		return Double(elapsedNanoseconds) / Double(NSEC_PER_SEC)
+	}
+}
+
+/// A type receiving information on SQL statement execution.
+///
+/// - note: `queryDidComplete(_:)` is called synchronously on the thread executing the statement.
+public protocol QueryObserver: AnyObject {
+	/// Called after an SQL statement finishes executing.
+	///
+	/// - parameter event: Information on the statement execution
+	func queryDidComplete(_ event: QueryEvent)
+}
+
+/// The context for `sqlite3_trace_v2()` callbacks.
+final class QueryTracer {
+	/// The state of an executing statement
+	struct Execution {
+		/// The statement's full-scan step counter when execution began
+		let fullscanSteps: Int32
+		/// The statement's sort counter when execution began
+		let sorts: Int32
+		/// The statement's autoindex counter when execution began
+		let autoindexRows: Int32
+		/// The statement's virtual machine step counter when execution began
+		let vmSteps: Int32
+		/// The number of rows stepped
+		var rowCount = 0
+
+		init(_ stmt: SQLitePreparedStatement) {
+			fullscanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0)
+			sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 0)
+			autoindexRows = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 0)
+			vmSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 0)
+		}
+	}
+
+	/// The observer receiving query events
+	let observer: QueryObserver
+	/// Whether `SQLITE_TRACE_ROW` events are counted
+	let countsRows: Bool
+	/// The state of each executing statement
+	var executions = [SQLitePreparedStatement: Execution]()
+
+	init(observer: QueryObserver, countsRows: Bool) {
+		self.observer = observer
+		self.countsRows = countsRows
+	}
+
+	/// Processes an `SQLITE_TRACE_STMT` event.
+	func statement(_ stmt: SQLitePreparedStatement) {
+		// Trigger programs generate additional events while the statement is executing
+		if executions[stmt] == nil {
+			executions[stmt] = Execution(stmt)
+		}
+	}
+
+	/// Processes an `SQLITE_TRACE_ROW` event.
+	func row(_ stmt: SQLitePreparedStatement) {
+		executions[stmt]?.rowCount += 1
+	}
+
+	/// Processes an `SQLITE_TRACE_PROFILE` event.
+	func profile(_ stmt: SQLitePreparedStatement, nanoseconds: Int64) {
+		guard let execution = executions.removeValue(forKey: stmt) else {
+			return
+		}
+		let event = QueryEvent(sql: String(cString: sqlite3_sql(stmt)),
+							   elapsedNanoseconds: nanoseconds,
+							   rowCount: countsRows ? execution.rowCount : nil,
+							   fullscanSteps: Int(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0) - execution.fullscanSteps),
+							   sorts: Int(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 0) - execution.sorts),
+							   autoindexRows: Int(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 0) - execution.autoindexRows),
+							   vmSteps: Int(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 0) - execution.vmSteps))
+		observer.queryDidComplete(event)
+	}
+}
+
+extension Database {
+	/// Sets the observer notified when SQL statements finish executing.
+	///
+	/// - note: The observer is notified from an `SQLITE_TRACE_PROFILE` trace callback.  The full-scan step, sort,
+	/// autoindex, and virtual machine step counters reported in each event are the changes in the statement's
+	/// counters during a single execution; the counters themselves are not reset, so `Statement.count(of:)` is unaffected.
+	///
+	/// - note: Row counting invokes a trace callback for every result row, adding overhead to each step.
+	///
+	/// - parameter observer: The observer to notify
+	/// - parameter countingRows: Whether to count the result rows stepped by each statement using `SQLITE_TRACE_ROW`
+	///
+	/// - seealso: [SQL Trace Hook](https://www.sqlite.org/c3ref/trace_v2.html)
+	public func setQueryObserver(_ observer: QueryObserver, countingRows: Bool = false) {
+		let tracer = QueryTracer(observer: observer, countsRows: countingRows)
+
+		var mask = UInt32(SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE)
+		if countingRows {
+			mask |= UInt32(SQLITE_TRACE_ROW)
+		}
+
+		sqlite3_trace_v2(db, mask, { (T, C, P, X) -> Int32 in
+			let tracer = Unmanaged<QueryTracer>.fromOpaque(UnsafeRawPointer(C.unsafelyUnwrapped)).takeUnretainedValue()
+			let stmt = SQLitePreparedStatement(P.unsafelyUnwrapped)
+			if T == UInt32(SQLITE_TRACE_STMT) {
+				tracer.statement(stmt)
+			}
+			else if T == UInt32(SQLITE_TRACE_PROFILE) {
+				let nanoseconds = X.unsafelyUnwrapped.assumingMemoryBound(to: Int64.self).pointee
+				tracer.profile(stmt, nanoseconds: nanoseconds)
+			}
+			else if T == UInt32(SQLITE_TRACE_ROW) {
+				tracer.row(stmt)
+			}
+			return 0
+		}, Unmanaged.passUnretained(tracer).toOpaque())
+
+		queryTracer = tracer
+	}
+
+	/// Removes the query observer.
+	public func removeQueryObserver() {
+		sqlite3_trace_v2(db, 0, nil, nil)
+		queryTracer = nil
+	}
+}
+
+/// A query observer aggregating latency statistics per normalized SQL statement and reporting slow queries.
+///
+/// SQL is normalized by replacing literals with `?` and collapsing whitespace and comments so
+/// statements differing only in literal values are aggregated together.
+///
+/// ```swift
+/// let statistics = QueryStatistics(slowQueryThreshold: 0.1)
+/// db.setQueryObserver(statistics)
+/// // ...
+/// for summary in statistics.summaries() {
+///     print("\(summary.sql): p95 \(summary.p95) sec")
+/// }
+/// ```
+///
+/// - note: A single instance may be shared by multiple databases.
+public final class QueryStatistics: QueryObserver {
+	/// Aggregated latency statistics for a normalized SQL statement.
+	public struct Summary {
+		/// The normalized SQL text
+		public let sql: String
+		/// The number of completed executions
+		public let count: Int
+		/// The total time spent executing the statement, in seconds
+		public let totalTime: TimeInterval
+		/// The longest execution time, in seconds
+		public let maximumTime: TimeInterval
+		/// The median execution time of the sampled executions, in seconds
+		public let p50: TimeInterval
+		/// The 95th percentile execution time of the sampled executions, in seconds
+		public let p95: TimeInterval
+		/// The 99th percentile execution time of the sampled executions, in seconds
+		public let p99: TimeInterval
+	}
+
+	/// The statistics accumulated for a normalized SQL statement
+	struct Entry {
+		var count = 0
+		var totalNanoseconds: Int64 = 0
+		var maximumNanoseconds: Int64 = 0
+		/// Recent execution times, used as a ring buffer once full
+		var samples = [Int64]()
+		/// The index of the oldest sample once `samples` is full
+		var nextSample = 0
+	}
+
+	/// Executions taking at least this long are reported as slow queries, or `nil` to disable slow query reporting
+	public let slowQueryThreshold: TimeInterval?
+	/// The maximum number of recent execution times retained per statement for percentile calculations
+	public let sampleCapacity: Int
+
+	/// The closure called for slow queries
+	let slowQueryHandler: (QueryEvent) -> Void
+
+	/// The accumulated statistics keyed by normalized SQL
+	var entries = [String: Entry]()
+	/// The lock protecting `entries`
+	let lock = NSLock()
+
+	/// Creates a query statistics aggregator.
+	///
+	/// - parameter slowQueryThreshold: Executions taking at least this many seconds are passed to `slowQueryHandler`, or `nil` to disable slow query reporting
+	/// - parameter sampleCapacity: The maximum number of recent execution times retained per statement for percentile calculations
+	/// - parameter slowQueryHandler: A closure called for each slow query.  The default logs the query using `os_log`.
+	public init(slowQueryThreshold: TimeInterval? = nil, sampleCapacity: Int = 1024, slowQueryHandler: ((QueryEvent) -> Void)? = nil) {
+		precondition(sampleCapacity > 0)
+		self.slowQueryThreshold = slowQueryThreshold
+		self.sampleCapacity = sampleCapacity
+		self.slowQueryHandler = slowQueryHandler ?? { event in
+			os_log("Slow query (%{public}f sec): %{public}@", type: .info, event.elapsedTime, event.sql)
+		}
+	}
+
+	public func queryDidComplete(_ event: QueryEvent) {
+		let sql = QueryStatistics.normalize(event.sql)
+
+		lock.lock()
+		var entry = entries.removeValue(forKey: sql) ?? Entry()
+		entry.count += 1
+		entry.totalNanoseconds += event.elapsedNanoseconds
+		entry.maximumNanoseconds = max(entry.maximumNanoseconds, event.elapsedNanoseconds)
+		if entry.samples.count < sampleCapacity {
+			entry.samples.append(event.elapsedNanoseconds)
+		}
+		else {
+			entry.samples[entry.nextSample] = event.elapsedNanoseconds
+			entry.nextSample = (entry.nextSample + 1) % sampleCapacity
+		}
+		entries[sql] = entry
+		lock.unlock()
+
+		if let threshold = slowQueryThreshold, event.elapsedTime >= threshold {
+			slowQueryHandler(event)
+		}
+	}
+
+	/// Returns the aggregated statistics for each normalized SQL statement, ordered by descending total execution time.
+	public func summaries() -> [Summary] {
+		lock.lock()
+		let entries = self.entries
+		lock.unlock()
+
+		func seconds(_ nanoseconds: Int64) -> TimeInterval {
+			return Double(nanoseconds) / Double(NSEC_PER_SEC)
+		}
+
+		return entries.map { element -> Summary in
+			let (sql, entry) = element
+			let samples = entry.samples.sorted()
+			func percentile(_ p: Double) -> TimeInterval {
+				let rank = Int((p * Double(samples.count - 1)).rounded())
+				return seconds(samples[rank])
+			}
+			return Summary(sql: sql, count: entry.count, totalTime: seconds(entry.totalNanoseconds), maximumTime: seconds(entry.maximumNanoseconds), p50: percentile(0.5), p95: percentile(0.95), p99: percentile(0.99))
+		}.sorted { $0.totalTime > $1.totalTime }
+	}
+
+	/// Returns the aggregated statistics for `sql` or `nil` if no executions of `sql` have been observed.
+	///
+	/// - parameter sql: An SQL statement, which is normalized before lookup
+	public func summary(for sql: String) -> Summary? {
+		let normalized = QueryStatistics.normalize(sql)
+		return summaries().first { $0.sql == normalized }
+	}
+
+	/// Discards all accumulated statistics.
+	public func reset() {
+		lock.lock()
+		entries.removeAll()
+		lock.unlock()
+	}
+
+	/// Returns `sql` with literals replaced by `?` and comments and runs of whitespace replaced by a single space.
+	///
+	/// - parameter sql: The SQL text to normalize
+	///
+	/// - returns: The normalized SQL text
+	public static func normalize(_ sql: String) -> String {
+		let bytes = Array(sql.utf8)
+		let n = bytes.count
+		var output = [UInt8]()
+		output.reserveCapacity(n)
+
+		let space = UInt8(ascii: " ")
+		let quote = UInt8(ascii: "'")
+		let placeholder = UInt8(ascii: "?")
+
+		func isIdentifierByte(_ c: UInt8) -> Bool {
+			switch c {
+			case UInt8(ascii: "a") ... UInt8(ascii: "z"), UInt8(ascii: "A") ... UInt8(ascii: "Z"), UInt8(ascii: "0") ... UInt8(ascii: "9"), UInt8(ascii: "_"), UInt8(ascii: "$"), 0x80...:
+				return true
+			default:
+				return false
+			}
+		}
+
+		func isDigit(_ c: UInt8) -> Bool {
+			return c >= UInt8(ascii: "0") && c <= UInt8(ascii: "9")
+		}
+
+		var pendingSpace = false
+		var i = 0
+		while i < n {
+			let c = bytes[i]
+
+			// Whitespace
+			if c == space || c == UInt8(ascii: "\t") || c == UInt8(ascii: "\n") || c == UInt8(ascii: "\r") {
+				pendingSpace = true
+				i += 1
+				continue
+			}
+
+			// Comments
+			if c == UInt8(ascii: "-") && i + 1 < n && bytes[i + 1] == UInt8(ascii: "-") {
+				while i < n && bytes[i] != UInt8(ascii: "\n") {
+					i += 1
+				}
+				pendingSpace = true
+				continue
+			}
+			if c == UInt8(ascii: "/") && i + 1 < n && bytes[i + 1] == UInt8(ascii: "*") {
+				i += 2
+				while i < n && !(bytes[i] == UInt8(ascii: "*") && i + 1 < n && bytes[i + 1] == UInt8(ascii: "/")) {
+					i += 1
+				}
+				i = min(i + 2, n)
+				pendingSpace = true
+				continue
+			}
+
+			if pendingSpace && !output.isEmpty {
+				output.append(space)
+			}
+			pendingSpace = false
+
+			if c == quote {
+				// String literal; a preceding x or X denotes a BLOB literal
+				if let last = output.last, last == UInt8(ascii: "x") || last == UInt8(ascii: "X") {
+					if output.count == 1 || !isIdentifierByte(output[output.count - 2]) {
+						output.removeLast()
+					}
+				}
+				i += 1
+				while i < n {
+					if bytes[i] == quote {
+						if i + 1 < n && bytes[i + 1] == quote {
+							i += 2
+							continue
+						}
+						i += 1
+						break
+					}
+					i += 1
+				}
+				output.append(placeholder)
+			}
+			else if c == UInt8(ascii: "\"") || c == UInt8(ascii: "`") || c == UInt8(ascii: "[") {
+				// Quoted identifier
+				let terminator = c == UInt8(ascii: "[") ? UInt8(ascii: "]") : c
+				output.append(c)
+				i += 1
+				while i < n {
+					output.append(bytes[i])
+					i += 1
+					if bytes[i - 1] == terminator {
+						break
+					}
+				}
+			}
+			else if isDigit(c) && !(output.last.map({ isIdentifierByte($0) || $0 == placeholder }) ?? false) {
+				// Numeric literal (digits following an identifier or a ? parameter are not literals)
+				while i < n {
+					let d = bytes[i]
+					if isIdentifierByte(d) || d == UInt8(ascii: ".") {
+						i += 1
+					}
+					else if (d == UInt8(ascii: "+") || d == UInt8(ascii: "-")) && (bytes[i - 1] == UInt8(ascii: "e") || bytes[i - 1] == UInt8(ascii: "E")) {
+						i += 1
+					}
+					else {
+						break
+					}
+				}
+				output.append(placeholder)
+			}
+			else {
+				output.append(c)
+				i += 1
+			}
+		}
+
+		return String(decoding: output, as: UTF8.self)
+	}
+}
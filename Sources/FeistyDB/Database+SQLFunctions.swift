@@ -368,8 +368,13 @@ func set_sqlite3_result(_ sqlite_context: OpaquePointer!, value: DatabaseValue)
 	case .text(let t):
 		sqlite3_result_text(sqlite_context, t, -1, SQLITE_TRANSIENT)
 	case .blob(let b):
-		b.withUnsafeBytes { bytes in
-			sqlite3_result_blob(sqlite_context, bytes.baseAddress, Int32(b.count), SQLITE_TRANSIENT)
+		if b.isEmpty {
+			sqlite3_result_zeroblob(sqlite_context, 0)
+		}
+		else {
+			b.withUnsafeBytes { bytes in
+				sqlite3_result_blob(sqlite_context, bytes.baseAddress, Int32(b.count), SQLITE_TRANSIENT)
+			}
 		}
 	case .null:
 		sqlite3_result_null(sqlite_context)
@@ -0,0 +1,217 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// A size-bounded least recently used cache of compiled SQL statements keyed by SQL text.
+///
+/// A statement is removed from the cache while it is in use and is returned to the cache,
+/// reset and with its bindings cleared, when it is no longer referenced.
+final class StatementCache {
+	/// A cached statement
+	final class Entry {
+		/// The SQL text of the statement
+		let key: String
+		/// The underlying `sqlite3_stmt *` object
+		let stmt: SQLitePreparedStatement
+		/// The next more recently used entry
+		weak var previous: Entry?
+		/// The next less recently used entry
+		var next: Entry?
+
+		init(key: String, stmt: SQLitePreparedStatement) {
+			self.key = key
+			self.stmt = stmt
+		}
+	}
+
+	/// The maximum number of statements held in the cache
+	var capacity: Int {
+		didSet {
+			trim()
+		}
+	}
+
+	/// The cached statements keyed by SQL text
+	var entries = [String: Entry]()
+	/// The most recently used entry
+	var head: Entry?
+	/// The least recently used entry
+	var tail: Entry?
+
+	/// The number of lookups satisfied from the cache
+	var hits = 0
+	/// The number of lookups not satisfied from the cache
+	var misses = 0
+	/// The number of statements finalized to keep the cache within `capacity`
+	var evictions = 0
+
+	init(capacity: Int) {
+		precondition(capacity > 0)
+		self.capacity = capacity
+	}
+
+	deinit {
+		removeAll()
+	}
+
+	/// Removes and returns the cached statement for `key`.
+	///
+	/// - parameter key: The SQL text of the statement
+	///
+	/// - returns: The cached statement or `nil` if no statement for `key` is cached
+	func removeStatement(forKey key: String) -> SQLitePreparedStatement? {
+		guard let entry = entries.removeValue(forKey: key) else {
+			misses += 1
+			return nil
+		}
+		hits += 1
+		unlink(entry)
+		return entry.stmt
+	}
+
+	/// Resets `stmt`, clears its bindings, and inserts it into the cache as the most recently used statement.
+	///
+	/// - note: If a statement for `key` is already cached `stmt` is finalized.
+	///
+	/// - parameter stmt: An `sqlite3_stmt *` object
+	/// - parameter key: The SQL text of the statement
+	func insert(_ stmt: SQLitePreparedStatement, forKey key: String) {
+		sqlite3_reset(stmt)
+		sqlite3_clear_bindings(stmt)
+
+		guard entries[key] == nil else {
+			sqlite3_finalize(stmt)
+			return
+		}
+
+		let entry = Entry(key: key, stmt: stmt)
+		entries[key] = entry
+		entry.next = head
+		head?.previous = entry
+		head = entry
+		if tail == nil {
+			tail = entry
+		}
+
+		trim()
+	}
+
+	/// Finalizes all cached statements.
+	func removeAll() {
+		for entry in entries.values {
+			sqlite3_finalize(entry.stmt)
+		}
+		entries.removeAll()
+		head = nil
+		tail = nil
+	}
+
+	/// Evicts the least recently used statements until the cache holds no more than `capacity` statements.
+	func trim() {
+		while entries.count > capacity, let entry = tail {
+			unlink(entry)
+			entries.removeValue(forKey: entry.key)
+			sqlite3_finalize(entry.stmt)
+			evictions += 1
+		}
+	}
+
+	/// Removes `entry` from the recently used list.
+	func unlink(_ entry: Entry) {
+		if let previous = entry.previous {
+			previous.next = entry.next
+		}
+		else {
+			head = entry.next
+		}
+		if let next = entry.next {
+			next.previous = entry.previous
+		}
+		else {
+			tail = entry.previous
+		}
+		entry.previous = nil
+		entry.next = nil
+	}
+}
+
+extension Database {
+	/// Statement cache statistics.
+	public struct StatementCacheStatistics {
+		/// The number of statements currently held in the cache
+		public let count: Int
+		/// The number of lookups satisfied from the cache
+		public let hits: Int
+		/// The number of lookups that required compiling a statement
+		public let misses: Int
+		/// The number of statements finalized to keep the cache within its capacity
+		public let evictions: Int
+	}
+
+	/// The maximum number of compiled statements retained by the statement cache.
+	///
+	/// The statement cache is disabled by default.  When enabled, `execute(sql:)`, `results(sql:_:)`, and the
+	/// `execute(sql:parameterValues:_:)` and `execute(sql:parameters:_:)` families reuse compiled statements
+	/// keyed by SQL text instead of compiling `sql` on each call.  Cached statements are compiled with
+	/// `SQLITE_PREPARE_PERSISTENT` and are reset and have their bindings cleared when returned to the cache.
+	///
+	/// Setting this property to `0` disables the cache and finalizes all cached statements.
+	///
+	/// - seealso: [Prepare Flags](https://www.sqlite.org/c3ref/c_prepare_normalize.html)
+	public var statementCacheCapacity: Int {
+		get {
+			return statementCache?.capacity ?? 0
+		}
+		set {
+			precondition(newValue >= 0)
+			if newValue == 0 {
+				statementCache = nil
+			}
+			else if let cache = statementCache {
+				cache.capacity = newValue
+			}
+			else {
+				statementCache = StatementCache(capacity: newValue)
+			}
+		}
+	}
+
+	/// The statement cache statistics or `nil` if the statement cache is disabled
+	public var statementCacheStatistics: StatementCacheStatistics? {
+		guard let cache = statementCache else {
+			return nil
+		}
+		return StatementCacheStatistics(count: cache.entries.count, hits: cache.hits, misses: cache.misses, evictions: cache.evictions)
+	}
+
+	/// Finalizes all statements held in the statement cache.
+	///
+	/// - note: The statement cache remains enabled and its statistics are preserved.
+	public func clearStatementCache() {
+		statementCache?.removeAll()
+	}
+
+	/// Returns a compiled SQL statement from the statement cache, compiling `sql` if necessary.
+	///
+	/// If the statement cache is disabled this is equivalent to `prepare(sql:)`.
+	///
+	/// - parameter sql: The SQL statement to compile
+	///
+	/// - throws: An error if `sql` could not be compiled
+	///
+	/// - returns: A compiled SQL statement
+	func cachedStatement(sql: String) throws -> Statement {
+		guard let cache = statementCache else {
+			return try prepare(sql: sql)
+		}
+		if let stmt = cache.removeStatement(forKey: sql) {
+			return Statement(database: self, cachedStatement: stmt, cacheKey: sql)
+		}
+		return try Statement(database: self, sql: sql, prepareFlags: UInt32(SQLITE_PREPARE_PERSISTENT), cacheKey: sql)
+	}
+}
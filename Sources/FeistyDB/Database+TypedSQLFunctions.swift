@@ -0,0 +1,511 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// The context in which a custom SQL function is invoked.
+///
+/// - important: A context is only valid for the duration of the invocation to which it is passed
+/// and must not be stored or used outside of it.
+///
+/// - seealso: [SQL Function Context Object](https://www.sqlite.org/c3ref/context.html)
+public struct SQLFunctionContext {
+	/// The underlying `sqlite3_context *` object
+	let context: OpaquePointer
+
+	/// Creates a context for `context`.
+	///
+	/// - parameter context: An `sqlite3_context *` object
+	init(_ context: OpaquePointer) {
+		self.context = context
+	}
+
+	/// Returns a value derived from the argument at `index`, caching it for subsequent invocations.
+	///
+	/// When the argument at `index` is a constant, such as a pattern or path literal,
+	/// SQLite retains the cached value while the statement is executing and `body`
+	/// is only invoked when the value is first needed.
+	/// For non-constant arguments `body` is invoked each time.
+	///
+	/// ```swift
+	/// try db.addFunction("regexp_match", arity: 2) { context, arguments -> Bool in
+	///     let regex = try context.cachedValue(forArgument: 0) {
+	///         try NSRegularExpression(pattern: arguments.string(at: 0) ?? "")
+	///     }
+	///     let s = arguments.string(at: 1) ?? ""
+	///     return regex.firstMatch(in: s, range: NSRange(s.startIndex..., in: s)) != nil
+	/// }
+	/// ```
+	///
+	/// - parameter index: The index of the argument from which the value is derived
+	/// - parameter body: A closure deriving the value from the argument at `index`
+	///
+	/// - throws: Any error thrown in `body`
+	///
+	/// - returns: The cached value
+	///
+	/// - seealso: [Function Auxiliary Data](https://www.sqlite.org/c3ref/get_auxdata.html)
+	public func cachedValue<T>(forArgument index: Int, _ body: () throws -> T) rethrows -> T {
+		if let auxdata = sqlite3_get_auxdata(context, Int32(index)), let box = Unmanaged<AnyObject>.fromOpaque(auxdata).takeUnretainedValue() as? AuxiliaryDataBox<T> {
+			return box.value
+		}
+		let box = AuxiliaryDataBox(try body())
+		// SQLite may invoke the destructor immediately, so the box is retained locally until this function returns
+		sqlite3_set_auxdata(context, Int32(index), Unmanaged.passRetained(box as AnyObject).toOpaque(), { auxdata in
+			Unmanaged<AnyObject>.fromOpaque(auxdata.unsafelyUnwrapped).release()
+		})
+		return box.value
+	}
+}
+
+/// A class holding a cached function argument value
+final class AuxiliaryDataBox<T> {
+	/// The cached value
+	let value: T
+
+	init(_ value: T) {
+		self.value = value
+	}
+}
+
+/// A type that may be read directly from a custom SQL function argument.
+///
+/// Conforming types read the underlying `sqlite3_value *` without creating a `DatabaseValue`.
+public protocol SQLFunctionArgument {
+	/// Returns the argument at `index` as `Self`.
+	///
+	/// - parameter arguments: The SQL function arguments
+	/// - parameter index: The index of the desired argument
+	///
+	/// - throws: An error if the argument can't be represented as `Self`
+	static func argument(_ arguments: SQLArguments, at index: Int) throws -> Self
+}
+
+/// A type that may be passed directly as the result of a custom SQL function.
+public protocol SQLFunctionResult {
+	/// Sets `self` as the result of the function invocation in `context`.
+	///
+	/// - parameter context: The context of the function invocation
+	func setResult(in context: SQLFunctionContext)
+}
+
+/// A custom SQL aggregate function reading its arguments directly.
+///
+/// This is equivalent to `SQLAggregateFunction` except arguments are passed as a borrowed `SQLArguments`
+/// view and the result is a `SQLFunctionResult`, so no `DatabaseValue` is created for each row.
+public protocol SQLArgumentsAggregateFunction: AnyObject {
+	/// The type of the aggregate function's result
+	associatedtype Result: SQLFunctionResult
+
+	/// Invokes the aggregate function for one or more values in a row.
+	///
+	/// - parameter arguments: The SQL function arguments
+	///
+	/// - throws: `Error`
+	func step(_ arguments: SQLArguments) throws
+
+	/// Returns the current value of the aggregate function.
+	///
+	/// - note: This should also reset any function context to defaults.
+	///
+	/// - throws: `Error`
+	///
+	/// - returns: The current value of the aggregate function.
+	func final() throws -> Result
+}
+
+/// A custom SQL aggregate window function reading its arguments directly.
+public protocol SQLArgumentsAggregateWindowFunction: SQLArgumentsAggregateFunction {
+	/// Invokes the inverse aggregate function for one or more values in a row.
+	///
+	/// - parameter arguments: The SQL function arguments
+	///
+	/// - throws: `Error`
+	func inverse(_ arguments: SQLArguments) throws
+
+	/// Returns the current value of the aggregate window function.
+	///
+	/// - throws: `Error`
+	///
+	/// - returns: The current value of the aggregate window function.
+	func value() throws -> Result
+}
+
+extension Database {
+	/// Adds a custom SQL scalar function reading its arguments directly.
+	///
+	/// For example, a function computing the length of a BLOB without copying it could be implemented as:
+	/// ```swift
+	/// try db.addFunction("blob_length", arity: 1) { context, arguments -> Int64 in
+	///     return arguments.withUnsafeBLOB(at: 0) { Int64($0.count) }
+	/// }
+	/// ```
+	///
+	/// - parameter name: The name of the function
+	/// - parameter arity: The number of arguments the function accepts
+	/// - parameter flags: Flags affecting the function's use by SQLite
+	/// - parameter block: A closure that returns the result of applying the function to the supplied arguments
+	///
+	/// - throws: An error if the SQL scalar function couldn't be added
+	///
+	/// - seealso: [Create Or Redefine SQL Functions](https://sqlite.org/c3ref/create_function.html)
+	public func addFunction<R: SQLFunctionResult>(_ name: String, arity: Int = -1, flags: SQLFunctionFlags = [.deterministic, .directOnly], _ block: @escaping (_ context: SQLFunctionContext, _ arguments: SQLArguments) throws -> R) throws {
+		try addSQLFunction(name, arity: arity, flags: flags, invocation: { context, arguments in
+			try block(context, arguments).setResult(in: context)
+		})
+	}
+
+	/// Adds a custom SQL scalar function accepting one typed argument.
+	///
+	/// ```swift
+	/// try db.addFunction("square") { (x: Double) -> Double in
+	///     return x * x
+	/// }
+	/// ```
+	///
+	/// - parameter name: The name of the function
+	/// - parameter flags: Flags affecting the function's use by SQLite
+	/// - parameter block: A closure that returns the result of applying the function to the supplied argument
+	///
+	/// - throws: An error if the SQL scalar function couldn't be added
+	public func addFunction<A: SQLFunctionArgument, R: SQLFunctionResult>(_ name: String, flags: SQLFunctionFlags = [.deterministic, .directOnly], _ block: @escaping (A) throws -> R) throws {
+		try addSQLFunction(name, arity: 1, flags: flags, invocation: { context, arguments in
+			try block(A.argument(arguments, at: 0)).setResult(in: context)
+		})
+	}
+
+	/// Adds a custom SQL scalar function accepting two typed arguments.
+	///
+	/// - parameter name: The name of the function
+	/// - parameter flags: Flags affecting the function's use by SQLite
+	/// - parameter block: A closure that returns the result of applying the function to the supplied arguments
+	///
+	/// - throws: An error if the SQL scalar function couldn't be added
+	public func addFunction<A: SQLFunctionArgument, B: SQLFunctionArgument, R: SQLFunctionResult>(_ name: String, flags: SQLFunctionFlags = [.deterministic, .directOnly], _ block: @escaping (A, B) throws -> R) throws {
+		try addSQLFunction(name, arity: 2, flags: flags, invocation: { context, arguments in
+			try block(A.argument(arguments, at: 0), B.argument(arguments, at: 1)).setResult(in: context)
+		})
+	}
+
+	/// Adds a custom SQL scalar function accepting three typed arguments.
+	///
+	/// - parameter name: The name of the function
+	/// - parameter flags: Flags affecting the function's use by SQLite
+	/// - parameter block: A closure that returns the result of applying the function to the supplied arguments
+	///
+	/// - throws: An error if the SQL scalar function couldn't be added
+	public func addFunction<A: SQLFunctionArgument, B: SQLFunctionArgument, C: SQLFunctionArgument, R: SQLFunctionResult>(_ name: String, flags: SQLFunctionFlags = [.deterministic, .directOnly], _ block: @escaping (A, B, C) throws -> R) throws {
+		try addSQLFunction(name, arity: 3, flags: flags, invocation: { context, arguments in
+			try block(A.argument(arguments, at: 0), B.argument(arguments, at: 1), C.argument(arguments, at: 2)).setResult(in: context)
+		})
+	}
+
+	/// Adds a custom SQL scalar function accepting four typed arguments.
+	///
+	/// For example, the great-circle distance between two points could be implemented as:
+	/// ```swift
+	/// try db.addFunction("haversine") { (lat1: Double, lon1: Double, lat2: Double, lon2: Double) -> Double in
+	///     let dlat = (lat2 - lat1) * .pi / 180
+	///     let dlon = (lon2 - lon1) * .pi / 180
+	///     let a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1 * .pi / 180) * cos(lat2 * .pi / 180) * sin(dlon / 2) * sin(dlon / 2)
+	///     return 6_371_000 * 2 * atan2(sqrt(a), sqrt(1 - a))
+	/// }
+	/// ```
+	///
+	/// - parameter name: The name of the function
+	/// - parameter flags: Flags affecting the function's use by SQLite
+	/// - parameter block: A closure that returns the result of applying the function to the supplied arguments
+	///
+	/// - throws: An error if the SQL scalar function couldn't be added
+	public func addFunction<A: SQLFunctionArgument, B: SQLFunctionArgument, C: SQLFunctionArgument, D: SQLFunctionArgument, R: SQLFunctionResult>(_ name: String, flags: SQLFunctionFlags = [.deterministic, .directOnly], _ block: @escaping (A, B, C, D) throws -> R) throws {
+		try addSQLFunction(name, arity: 4, flags: flags, invocation: { context, arguments in
+			try block(A.argument(arguments, at: 0), B.argument(arguments, at: 1), C.argument(arguments, at: 2), D.argument(arguments, at: 3)).setResult(in: context)
+		})
+	}
+
+	/// Adds a custom SQL aggregate function reading its arguments directly.
+	///
+	/// - parameter name: The name of the aggregate function
+	/// - parameter arity: The number of arguments the function accepts
+	/// - parameter flags: Flags affecting the function's use by SQLite
+	/// - parameter function: An object defining the aggregate function
+	///
+	/// - throws:  An error if the SQL aggregate function can't be added
+	///
+	/// - seealso: [Create Or Redefine SQL Functions](https://sqlite.org/c3ref/create_function.html)
+	public func addAggregateFunction<F: SQLArgumentsAggregateFunction>(_ name: String, arity: Int = -1, flags: SQLFunctionFlags = [.deterministic, .directOnly], _ function: F) throws {
+		let invocations = AggregateFunctionInvocations(step: function.step, final: { context in
+			try function.final().setResult(in: context)
+		})
+
+		let function_flags = SQLITE_UTF8 | flags.asSQLiteFlags()
+		guard sqlite3_create_function_v2(db, name, Int32(arity), function_flags, Unmanaged.passRetained(invocations).toOpaque(), nil, xAggregateStep, xAggregateFinal, xAggregateDestroy) == SQLITE_OK else {
+			throw SQLiteError("Error adding SQL aggregate function \"\(name)\"", takingDescriptionFromDatabase: db)
+		}
+	}
+
+	/// Adds a custom SQL aggregate window function reading its arguments directly.
+	///
+	/// - parameter name: The name of the aggregate window function
+	/// - parameter arity: The number of arguments the function accepts
+	/// - parameter flags: Flags affecting the function's use by SQLite
+	/// - parameter function: An object defining the aggregate window function
+	///
+	/// - throws:  An error if the SQL aggregate window function can't be added
+	///
+	/// - seealso: [User-Defined Aggregate Window Functions](https://sqlite.org/windowfunctions.html#udfwinfunc)
+	public func addAggregateWindowFunction<F: SQLArgumentsAggregateWindowFunction>(_ name: String, arity: Int = -1, flags: SQLFunctionFlags = [.deterministic, .directOnly], _ function: F) throws {
+		let invocations = AggregateFunctionInvocations(step: function.step, final: { context in
+			try function.final().setResult(in: context)
+		}, value: { context in
+			try function.value().setResult(in: context)
+		}, inverse: function.inverse)
+
+		let function_flags = SQLITE_UTF8 | flags.asSQLiteFlags()
+		guard sqlite3_create_window_function(db, name, Int32(arity), function_flags, Unmanaged.passRetained(invocations).toOpaque(), xAggregateStep, xAggregateFinal, xAggregateValue, xAggregateInverse, xAggregateDestroy) == SQLITE_OK else {
+			throw SQLiteError("Error adding SQL aggregate window function \"\(name)\"", takingDescriptionFromDatabase: db)
+		}
+	}
+
+	/// Adds a custom SQL scalar function using a type-erased invocation.
+	///
+	/// - parameter name: The name of the function
+	/// - parameter arity: The number of arguments the function accepts
+	/// - parameter flags: Flags affecting the function's use by SQLite
+	/// - parameter invocation: A closure that sets the result of applying the function to the supplied arguments
+	///
+	/// - throws: An error if the SQL scalar function couldn't be added
+	func addSQLFunction(_ name: String, arity: Int, flags: SQLFunctionFlags, invocation: @escaping SQLFunctionInvocation) throws {
+		let function_ptr = UnsafeMutablePointer<SQLFunctionInvocation>.allocate(capacity: 1)
+		function_ptr.initialize(to: invocation)
+
+		let function_flags = SQLITE_UTF8 | flags.asSQLiteFlags()
+		guard sqlite3_create_function_v2(db, name, Int32(arity), function_flags, function_ptr, { sqlite_context, argc, argv in
+			let function_ptr = sqlite3_user_data(sqlite_context).unsafelyUnwrapped.assumingMemoryBound(to: SQLFunctionInvocation.self)
+			do {
+				try function_ptr.pointee(SQLFunctionContext(sqlite_context.unsafelyUnwrapped), SQLArguments(argc: argc, argv: argv))
+			}
+
+			catch let error {
+				sqlite3_result_error(sqlite_context, "\(error)", -1)
+			}
+		}, nil, nil, { context in
+			let function_ptr = context.unsafelyUnwrapped.assumingMemoryBound(to: SQLFunctionInvocation.self)
+			function_ptr.deinitialize(count: 1)
+			function_ptr.deallocate()
+		}) == SQLITE_OK else {
+			throw SQLiteError("Error adding SQL scalar function \"\(name)\"", takingDescriptionFromDatabase: db)
+		}
+	}
+}
+
+/// A type-erased invocation of a custom SQL function setting its result in `context`
+typealias SQLFunctionInvocation = (_ context: SQLFunctionContext, _ arguments: SQLArguments) throws -> Void
+
+/// The type-erased callbacks for a custom SQL aggregate or aggregate window function
+final class AggregateFunctionInvocations {
+	let step: (SQLArguments) throws -> Void
+	let final: (SQLFunctionContext) throws -> Void
+	let value: ((SQLFunctionContext) throws -> Void)?
+	let inverse: ((SQLArguments) throws -> Void)?
+
+	init(step: @escaping (SQLArguments) throws -> Void, final: @escaping (SQLFunctionContext) throws -> Void, value: ((SQLFunctionContext) throws -> Void)? = nil, inverse: ((SQLArguments) throws -> Void)? = nil) {
+		self.step = step
+		self.final = final
+		self.value = value
+		self.inverse = inverse
+	}
+}
+
+/// Returns the aggregate function callbacks stored in the user data of `sqlite_context`
+func aggregate_invocations(_ sqlite_context: OpaquePointer?) -> AggregateFunctionInvocations {
+	return Unmanaged<AggregateFunctionInvocations>.fromOpaque(sqlite3_user_data(sqlite_context).unsafelyUnwrapped).takeUnretainedValue()
+}
+
+func xAggregateStep(_ sqlite_context: OpaquePointer?, _ argc: Int32, _ argv: UnsafeMutablePointer<OpaquePointer?>?) {
+	do {
+		try aggregate_invocations(sqlite_context).step(SQLArguments(argc: argc, argv: argv))
+	}
+	catch let error {
+		sqlite3_result_error(sqlite_context, "\(error)", -1)
+	}
+}
+
+func xAggregateFinal(_ sqlite_context: OpaquePointer?) {
+	do {
+		try aggregate_invocations(sqlite_context).final(SQLFunctionContext(sqlite_context.unsafelyUnwrapped))
+	}
+	catch let error {
+		sqlite3_result_error(sqlite_context, "\(error)", -1)
+	}
+}
+
+func xAggregateValue(_ sqlite_context: OpaquePointer?) {
+	do {
+		try aggregate_invocations(sqlite_context).value.unsafelyUnwrapped(SQLFunctionContext(sqlite_context.unsafelyUnwrapped))
+	}
+	catch let error {
+		sqlite3_result_error(sqlite_context, "\(error)", -1)
+	}
+}
+
+func xAggregateInverse(_ sqlite_context: OpaquePointer?, _ argc: Int32, _ argv: UnsafeMutablePointer<OpaquePointer?>?) {
+	do {
+		try aggregate_invocations(sqlite_context).inverse.unsafelyUnwrapped(SQLArguments(argc: argc, argv: argv))
+	}
+	catch let error {
+		sqlite3_result_error(sqlite_context, "\(error)", -1)
+	}
+}
+
+func xAggregateDestroy(_ context: UnsafeMutableRawPointer?) {
+	Unmanaged<AggregateFunctionInvocations>.fromOpaque(context.unsafelyUnwrapped).release()
+}
+
+// MARK: - Arguments
+
+/// Throws an error if the argument at `index` is `NULL`
+private func require_non_null(_ arguments: SQLArguments, at index: Int) throws {
+	guard !arguments.isNull(at: index) else {
+		throw DatabaseError("Unexpected NULL for SQL function argument \(index)")
+	}
+}
+
+extension Int64: SQLFunctionArgument {
+	public static func argument(_ arguments: SQLArguments, at index: Int) throws -> Int64 {
+		try require_non_null(arguments, at: index)
+		return arguments.int64(at: index)
+	}
+}
+
+extension Int: SQLFunctionArgument {
+	public static func argument(_ arguments: SQLArguments, at index: Int) throws -> Int {
+		try require_non_null(arguments, at: index)
+		return Int(arguments.int64(at: index))
+	}
+}
+
+extension Double: SQLFunctionArgument {
+	public static func argument(_ arguments: SQLArguments, at index: Int) throws -> Double {
+		try require_non_null(arguments, at: index)
+		return arguments.double(at: index)
+	}
+}
+
+extension Bool: SQLFunctionArgument {
+	public static func argument(_ arguments: SQLArguments, at index: Int) throws -> Bool {
+		try require_non_null(arguments, at: index)
+		return arguments.int64(at: index) != 0
+	}
+}
+
+extension String: SQLFunctionArgument {
+	public static func argument(_ arguments: SQLArguments, at index: Int) throws -> String {
+		guard let s = arguments.string(at: index) else {
+			throw DatabaseError("Unexpected NULL for SQL function argument \(index)")
+		}
+		return s
+	}
+}
+
+extension Data: SQLFunctionArgument {
+	public static func argument(_ arguments: SQLArguments, at index: Int) throws -> Data {
+		try require_non_null(arguments, at: index)
+		return arguments.withUnsafeBLOB(at: index) { Data($0) }
+	}
+}
+
+/// The bytes of a TEXT or BLOB argument are borrowed from SQLite without copying.
+///
+/// - important: The buffer is only valid for the duration of the function invocation.
+extension UnsafeRawBufferPointer: SQLFunctionArgument {
+	public static func argument(_ arguments: SQLArguments, at index: Int) throws -> UnsafeRawBufferPointer {
+		let value = arguments.value(at: index)
+		let bytes = sqlite3_value_blob(value)
+		let byteCount = Int(sqlite3_value_bytes(value))
+		return UnsafeRawBufferPointer(start: bytes, count: bytes != nil ? byteCount : 0)
+	}
+}
+
+extension DatabaseValue: SQLFunctionArgument {
+	public static func argument(_ arguments: SQLArguments, at index: Int) throws -> DatabaseValue {
+		return arguments[index]
+	}
+}
+
+/// `NULL` arguments are passed as `nil`.
+extension Optional: SQLFunctionArgument where Wrapped: SQLFunctionArgument {
+	public static func argument(_ arguments: SQLArguments, at index: Int) throws -> Optional<Wrapped> {
+		if arguments.isNull(at: index) {
+			return nil
+		}
+		return try Wrapped.argument(arguments, at: index)
+	}
+}
+
+// MARK: - Results
+
+extension Int64: SQLFunctionResult {
+	public func setResult(in context: SQLFunctionContext) {
+		sqlite3_result_int64(context.context, self)
+	}
+}
+
+extension Int: SQLFunctionResult {
+	public func setResult(in context: SQLFunctionContext) {
+		sqlite3_result_int64(context.context, Int64(self))
+	}
+}
+
+extension Double: SQLFunctionResult {
+	public func setResult(in context: SQLFunctionContext) {
+		sqlite3_result_double(context.context, self)
+	}
+}
+
+extension Bool: SQLFunctionResult {
+	public func setResult(in context: SQLFunctionContext) {
+		sqlite3_result_int(context.context, self ? 1 : 0)
+	}
+}
+
+extension String: SQLFunctionResult {
+	public func setResult(in context: SQLFunctionContext) {
+		sqlite3_result_text(context.context, self, -1, SQLITE_TRANSIENT)
+	}
+}
+
+extension Data: SQLFunctionResult {
+	public func setResult(in context: SQLFunctionContext) {
+		// sqlite3_result_blob() with a NULL pointer sets a NULL result, so empty data is passed as a zero-length BLOB
+		guard !isEmpty else {
+			sqlite3_result_zeroblob(context.context, 0)
+			return
+		}
+		withUnsafeBytes { bytes in
+			sqlite3_result_blob(context.context, bytes.baseAddress, Int32(bytes.count), SQLITE_TRANSIENT)
+		}
+	}
+}
+
+extension DatabaseValue: SQLFunctionResult {
+	public func setResult(in context: SQLFunctionContext) {
+		set_sqlite3_result(context.context, value: self)
+	}
+}
+
+/// `nil` results are passed as `NULL`.
+extension Optional: SQLFunctionResult where Wrapped: SQLFunctionResult {
+	public func setResult(in context: SQLFunctionContext) {
+		switch self {
+		case .some(let value):
+			value.setResult(in: context)
+		case .none:
+			sqlite3_result_null(context.context)
+		}
+	}
+}
@@ -194,6 +194,10 @@ extension Database {
 		var module_struct = sqlite3_module(iVersion: 0, xCreate: xCreate, xConnect: xConnect, xBestIndex: xBestIndex, xDisconnect: xDisconnect, xDestroy: xDestroy,
 		   xOpen: xOpen, xClose: xClose, xFilter: xFilter, xNext: xNext, xEof: xEof, xColumn: xColumn, xRowid: xRowid, xUpdate: nil, xBegin: nil, xSync: nil, xCommit: nil, xRollback: nil, xFindFunction: nil, xRename: nil, xSavepoint: nil, xRelease: nil, xRollbackTo: nil, xShadowName: nil)
 
+		if T.self is WritableVirtualTable.Type {
+			set_writable_vtab_callbacks(&module_struct)
+		}
+
 		// client_data must live until the xDestroy function is invoked; store it as a +1 object
 		let client_data = VirtualTableModuleClientData(module: &module_struct) { [weak self] args, create -> VirtualTableModule in
 			guard let database = self else {
@@ -277,6 +281,10 @@ extension Database {
 		var module_struct = sqlite3_module(iVersion: 0, xCreate: nil, xConnect: xConnect, xBestIndex: xBestIndex, xDisconnect: xDisconnect, xDestroy: nil,
 										   xOpen: xOpen, xClose: xClose, xFilter: xFilter, xNext: xNext, xEof: xEof, xColumn: xColumn, xRowid: xRowid, xUpdate: nil, xBegin: nil, xSync: nil, xCommit: nil, xRollback: nil, xFindFunction: nil, xRename: nil, xSavepoint: nil, xRelease: nil, xRollbackTo: nil, xShadowName: nil)
 
+		if T.self is WritableVirtualTable.Type {
+			set_writable_vtab_callbacks(&module_struct)
+		}
+
 		// client_data must live until the xDestroy function is invoked; store it as a +1 object
 		let client_data = VirtualTableModuleClientData(module: &module_struct) { [weak self] args, create -> VirtualTableModule in
 			guard let database = self else {
@@ -424,6 +432,7 @@ func init_vtab(_ db: OpaquePointer?, _ pAux: UnsafeMutableRawPointer?, _ argc: I
 
 	let vtab_ptr = vtab.unsafelyUnwrapped.bindMemory(to: feisty_db_sqlite3_vtab.self, capacity: 1)
 	vtab_ptr.pointee.virtual_table_module_ptr = ptr
+	set_vtab_writer(vtab_ptr, virtualTable as? WritableVirtualTable)
 	vtab_ptr.withMemoryRebound(to: sqlite3_vtab.self, capacity: 1) {
 		ppVTab.unsafelyUnwrapped.pointee = $0
 	}
@@ -435,6 +444,7 @@ func xDisconnect(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> Int32 {
 	pVTab.unsafelyUnwrapped.withMemoryRebound(to: feisty_db_sqlite3_vtab.self, capacity: 1) { vtab in
 		// Balance the +1 retain in xConnect()
 		Unmanaged<AnyObject>.fromOpaque(UnsafeRawPointer(vtab.pointee.virtual_table_module_ptr)).release()
+		free_vtab_writer(vtab)
 	}
 	sqlite3_free(pVTab)
 	return SQLITE_OK
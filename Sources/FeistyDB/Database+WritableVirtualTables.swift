@@ -0,0 +1,258 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// Write and transaction callbacks for an SQLite virtual table.
+///
+/// A `VirtualTableModule` or `BatchedVirtualTableModule` that also conforms to `WritableVirtualTable`
+/// accepts `INSERT`, `UPDATE`, and `DELETE` statements and participates in transactions.
+///
+/// Column values are passed as a borrowed `SQLArguments` view so they may be copied directly
+/// into the table's storage without intermediate allocations.
+///
+/// - seealso: [The xUpdate Method](https://www.sqlite.org/vtab.html#xupdate)
+public protocol WritableVirtualTable: AnyObject {
+	/// Inserts a row into the virtual table.
+	///
+	/// - parameter rowid: The rowid for the new row, or `nil` if the virtual table should choose one
+	/// - parameter values: The values of each column in the new row, in declaration order
+	///
+	/// - throws: `SQLiteError` if an error occurs, for example `SQLITE_CONSTRAINT` for a constraint violation
+	///
+	/// - returns: The rowid of the inserted row
+	func insert(rowid: Int64?, values: SQLArguments) throws -> Int64
+
+	/// Updates a row in the virtual table.
+	///
+	/// - parameter rowid: The rowid of the row to update
+	/// - parameter newRowid: The new rowid for the row, which is the same as `rowid` unless the rowid is being changed
+	/// - parameter values: The new values of each column in the row, in declaration order
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func update(rowid: Int64, newRowid: Int64, values: SQLArguments) throws
+
+	/// Deletes a row from the virtual table.
+	///
+	/// - parameter rowid: The rowid of the row to delete
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func delete(rowid: Int64) throws
+
+	/// Begins a transaction on the virtual table.
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func begin() throws
+
+	/// Starts the first phase of a two-phase commit.
+	///
+	/// - throws: `SQLiteError` if an error occurs, in which case the transaction is rolled back
+	func sync() throws
+
+	/// Commits the current transaction.
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func commit() throws
+
+	/// Rolls back the current transaction.
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func rollback() throws
+
+	/// Saves the current state of the virtual table as savepoint `index`.
+	///
+	/// - parameter index: The savepoint number
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func savepoint(_ index: Int32) throws
+
+	/// Releases savepoint `index` and all savepoints with higher numbers.
+	///
+	/// - parameter index: The savepoint number
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func release(savepoint index: Int32) throws
+
+	/// Reverts the state of the virtual table to savepoint `index`.
+	///
+	/// - parameter index: The savepoint number
+	///
+	/// - throws: `SQLiteError` if an error occurs
+	func rollback(toSavepoint index: Int32) throws
+}
+
+extension WritableVirtualTable {
+	public func begin() {
+	}
+
+	public func sync() {
+	}
+
+	public func commit() {
+	}
+
+	public func rollback() {
+	}
+
+	public func savepoint(_ index: Int32) {
+	}
+
+	public func release(savepoint index: Int32) {
+	}
+
+	public func rollback(toSavepoint index: Int32) {
+	}
+}
+
+/// A writable SQLite virtual table module
+public typealias WritableVirtualTableModule = VirtualTableModule & WritableVirtualTable
+
+/// A writable SQLite virtual table module whose cursors produce rows in columnar batches
+public typealias WritableBatchedVirtualTableModule = BatchedVirtualTableModule & WritableVirtualTable
+
+/// Adds the write and transaction callbacks to `module`
+func set_writable_vtab_callbacks(_ module: inout sqlite3_module) {
+	// xSavepoint, xRelease, and xRollbackTo require version 2
+	module.iVersion = max(module.iVersion, 2)
+	module.xUpdate = xUpdate
+	module.xBegin = xBegin
+	module.xSync = xSync
+	module.xCommit = xCommit
+	module.xRollback = xRollback
+	module.xSavepoint = xSavepoint
+	module.xRelease = xRelease
+	module.xRollbackTo = xRollbackTo
+}
+
+// MARK: - Implementations
+
+/// Stores `writer` in `vtab` so the write and transaction callbacks require no dynamic cast
+///
+/// - parameter vtab: A newly allocated virtual table
+/// - parameter writer: The virtual table's write and transaction callbacks, or `nil` if it is read-only
+func set_vtab_writer(_ vtab: UnsafeMutablePointer<feisty_db_sqlite3_vtab>, _ writer: WritableVirtualTable?) {
+	guard let writer = writer else {
+		vtab.pointee.writable_virtual_table_ptr = nil
+		return
+	}
+	let writer_ptr = UnsafeMutablePointer<WritableVirtualTable>.allocate(capacity: 1)
+	writer_ptr.initialize(to: writer)
+	vtab.pointee.writable_virtual_table_ptr = UnsafeMutableRawPointer(writer_ptr)
+}
+
+/// Releases the writer stored in `vtab` by `set_vtab_writer()`
+func free_vtab_writer(_ vtab: UnsafeMutablePointer<feisty_db_sqlite3_vtab>) {
+	guard let ptr = vtab.pointee.writable_virtual_table_ptr else {
+		return
+	}
+	let writer_ptr = ptr.assumingMemoryBound(to: WritableVirtualTable.self)
+	writer_ptr.deinitialize(count: 1)
+	writer_ptr.deallocate()
+	vtab.pointee.writable_virtual_table_ptr = nil
+}
+
+/// Returns the writable virtual table stored in `pVTab`
+func vtab_writer(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> WritableVirtualTable {
+	return pVTab.unsafelyUnwrapped.withMemoryRebound(to: feisty_db_sqlite3_vtab.self, capacity: 1) { vtab in
+		return vtab.pointee.writable_virtual_table_ptr.unsafelyUnwrapped.assumingMemoryBound(to: WritableVirtualTable.self).pointee
+	}
+}
+
+func xUpdate(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?, _ argc: Int32, _ argv: UnsafeMutablePointer<OpaquePointer?>?, _ pRowid: UnsafeMutablePointer<sqlite3_int64>?) -> Int32 {
+	let virtualTable = vtab_writer(pVTab)
+	let arguments = SQLArguments(argc: argc, argv: argv)
+
+	do {
+		if argc == 1 {
+			try virtualTable.delete(rowid: arguments.int64(at: 0))
+		}
+		else {
+			let values = SQLArguments(argc: argc - 2, argv: argv.unsafelyUnwrapped + 2)
+			if arguments.isNull(at: 0) {
+				let rowid = arguments.isNull(at: 1) ? nil : arguments.int64(at: 1)
+				pRowid.unsafelyUnwrapped.pointee = try virtualTable.insert(rowid: rowid, values: values)
+			}
+			else {
+				try virtualTable.update(rowid: arguments.int64(at: 0), newRowid: arguments.int64(at: 1), values: values)
+			}
+		}
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "update()")
+	}
+}
+
+func xBegin(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> Int32 {
+	do {
+		try vtab_writer(pVTab).begin()
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "begin()")
+	}
+}
+
+func xSync(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> Int32 {
+	do {
+		try vtab_writer(pVTab).sync()
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "sync()")
+	}
+}
+
+func xCommit(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> Int32 {
+	do {
+		try vtab_writer(pVTab).commit()
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "commit()")
+	}
+}
+
+func xRollback(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> Int32 {
+	do {
+		try vtab_writer(pVTab).rollback()
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "rollback()")
+	}
+}
+
+func xSavepoint(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?, _ iSavepoint: Int32) -> Int32 {
+	do {
+		try vtab_writer(pVTab).savepoint(iSavepoint)
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "savepoint()")
+	}
+}
+
+func xRelease(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?, _ iSavepoint: Int32) -> Int32 {
+	do {
+		try vtab_writer(pVTab).release(savepoint: iSavepoint)
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "release(savepoint:)")
+	}
+}
+
+func xRollbackTo(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?, _ iSavepoint: Int32) -> Int32 {
+	do {
+		try vtab_writer(pVTab).rollback(toSavepoint: iSavepoint)
+		return SQLITE_OK
+	}
+	catch let error {
+		return set_vtab_error(pVTab.unsafelyUnwrapped, error, in: "rollback(toSavepoint:)")
+	}
+}
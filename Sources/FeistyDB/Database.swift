@@ -34,15 +34,30 @@ public final class Database {
 	/// The database's custom busy handler
 	var busyHandler: UnsafeMutablePointer<BusyHandler>?
 
+	/// The database's progress handler
+	var progressHandler: UnsafeMutablePointer<ProgressHandler>?
+	/// The number of virtual machine instructions between invocations of `progressHandler`
+	var progressHandlerInstructionCount = 0
+
+	/// The database's write-ahead log commit hook, or `nil` if the hook was not installed by `setWALCommitHook(_:)`
+	var walCommitHook: UnsafeMutablePointer<WALCommitHook>?
+
 	/// Prepared statements
 	var preparedStatements = [AnyHashable: Statement]()
 
+	/// The cache of compiled statements used by the convenience execution methods
+	var statementCache: StatementCache?
+
+	/// The database's query tracer
+	var queryTracer: QueryTracer?
+
 	/// Creates a temporary database.
 	///
 	/// - parameter inMemory: Whether the temporary database should be created in-memory or on-disk
+	/// - parameter configuration: The settings to apply to the connection
 	///
-	/// - throws: An error if the database could not be created
-	public init(inMemory: Bool = true) throws {
+	/// - throws: An error if the database could not be created or configured
+	public init(inMemory: Bool = true, configuration: Configuration = Configuration()) throws {
 		var db: SQLiteDatabaseConnection?
 		let path = inMemory ? ":memory:" : ""
 		let result = sqlite3_open_v2(path, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nil)
@@ -52,14 +67,16 @@ public final class Database {
 		}
 
 		self.db =  db!
+		try apply(configuration)
 	}
 
 	/// Creates a read-only database from a file.
 	///
 	/// - parameter url: The location of the SQLite database
+	/// - parameter configuration: The settings to apply to the connection
 	///
-	/// - throws: An error if the database could not be opened
-	public init(readingFrom url: URL) throws {
+	/// - throws: An error if the database could not be opened or configured
+	public init(readingFrom url: URL, configuration: Configuration = Configuration()) throws {
 		var db: SQLiteDatabaseConnection?
 		try url.withUnsafeFileSystemRepresentation { path in
 			let result = sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, nil)
@@ -70,15 +87,50 @@ public final class Database {
 		}
 
 		self.db = db!
+		try apply(configuration)
+	}
+
+	/// Creates a read-only database from an immutable file.
+	///
+	/// The database is opened with the `immutable=1` URI parameter so SQLite performs no locking and
+	/// no change detection.  By default the entire file, up to the compile-time limit `SQLITE_MAX_MMAP_SIZE`, is
+	/// accessed using memory-mapped I/O so pages are read directly from the OS page cache.  Any number of
+	/// connections may open the same file; mapped pages are shared and not copied into each connection's page cache.
+	///
+	/// - important: The file must not be modified by any process while the database is open.
+	/// Changes made to an immutable database may cause incorrect query results or `SQLITE_CORRUPT` errors.
+	///
+	/// - parameter url: The location of the SQLite database
+	/// - parameter configuration: The settings to apply to the connection
+	///
+	/// - throws: An error if the database could not be opened or configured
+	///
+	/// - seealso: [URI Filenames](https://www.sqlite.org/uri.html#uriimmutable)
+	/// - seealso: [Memory-Mapped I/O](https://www.sqlite.org/mmap.html)
+	public init(immutableReadingFrom url: URL, configuration: Configuration = Configuration(mmapSize: .max)) throws {
+		guard let path = url.standardizedFileURL.path.addingPercentEncoding(withAllowedCharacters: .urlPathAllowed) else {
+			throw DatabaseError("Unable to create URI for database \(url)")
+		}
+
+		var db: SQLiteDatabaseConnection?
+		let result = sqlite3_open_v2("file:\(path)?immutable=1", &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI | SQLITE_OPEN_NOMUTEX, nil)
+		guard result == SQLITE_OK else {
+			sqlite3_close(db)
+			throw SQLiteError("Error opening database \(url)", code: result)
+		}
+
+		self.db = db!
+		try apply(configuration)
 	}
 
 	/// Creates a read-write database from a file.
 	///
 	/// - parameter url: The location of the SQLite database
 	/// - parameter create: Whether to create the database if it doesn't exist
+	/// - parameter configuration: The settings to apply to the connection
 	///
-	/// - throws: An error if the database could not be opened
-	public init(url: URL, create: Bool = true) throws {
+	/// - throws: An error if the database could not be opened or configured
+	public init(url: URL, create: Bool = true, configuration: Configuration = Configuration()) throws {
 		var db: SQLiteDatabaseConnection?
 		try url.withUnsafeFileSystemRepresentation { path in
 			var flags = SQLITE_OPEN_READWRITE
@@ -94,6 +146,7 @@ public final class Database {
 		}
 
 		self.db = db!
+		try apply(configuration)
 	}
 
 	/// Creates a database from an existing `sqlite3 *` database connection handle.
@@ -103,33 +156,18 @@ public final class Database {
 	/// - parameter db: An `sqlite3 *` database connection handle
 	public init(rawSQLiteDatabase db: SQLiteDatabaseConnection) {
 		self.db = db
-
-		#if false
-			sqlite3_trace_v2(db, UInt32(SQLITE_TRACE_PROFILE), { (T, C, P, X) -> Int32 in
-				if T == UInt32(SQLITE_TRACE_PROFILE) {
-					// P = sqlite3_stmt
-					// X = int64_t*
-
-					let stmt = SQLitePreparedStatement(P)
-					let sql = String(cString: sqlite3_sql(stmt))
-
-					if let nanos = X?.assumingMemoryBound(to: Int64.self).pointee {
-						let seconds = Double(nanos) / Double(NSEC_PER_SEC)
-						print("\"\(sql)\" took \(seconds) sec")
-					}
-
-				}
-
-				return 0
-			}, nil)
-		#endif
 	}
 
 	deinit {
 		preparedStatements.removeAll()
+		statementCache = nil
 		sqlite3_close(db)
 		busyHandler?.deinitialize(count: 1)
 		busyHandler?.deallocate()
+		progressHandler?.deinitialize(count: 1)
+		progressHandler?.deallocate()
+		walCommitHook?.deinitialize(count: 1)
+		walCommitHook?.deallocate()
 	}
 
 	/// `true` if this database is read only, `false` otherwise
@@ -205,26 +243,30 @@ extension Database {
 	///
 	/// This is a shortcut for `prepare(sql: sql).execute()`.
 	///
+	/// - note: If the statement cache is enabled the compiled statement is taken from and returned to the cache.
+	///
 	/// - requires: `sql` does not return any result rows
 	///
 	/// - parameter sql: The SQL statement to execute
 	///
 	/// - throws: An error if `sql` returned any result rows or could not be compiled or executed
 	public func execute(sql: String) throws {
-		try prepare(sql: sql).execute()
+		try cachedStatement(sql: sql).execute()
 	}
 
 	/// Executes an SQL statement and applies `block` to each result row.
 	///
 	/// This is a shortcut for `prepare(sql: sql).results(block)`.
 	///
+	/// - note: If the statement cache is enabled the compiled statement is taken from and returned to the cache.
+	///
 	/// - parameter sql: The SQL statement to execute
 	/// - parameter block: A closure applied to each result row
 	/// - parameter row: A result row of returned data
 	///
 	/// - throws: An error if `sql` could not be compiled or executed
 	public func results(sql: String, _ block: ((_ row: Row) throws -> ())) throws {
-		try prepare(sql: sql).results(block)
+		try cachedStatement(sql: sql).results(block)
 	}
 
 	/// Executes one or more SQL statements and optionally applies `block` to each result row.
@@ -515,9 +557,11 @@ extension Database {
 	///
 	/// - throws: An error if the checkpoint failed or if the database isn't in WAL mode
 	///
+	/// - returns: The number of frames in the log file and the number of frames in the log file that were checkpointed
+	///
 	/// - seealso: [Checkpoint a database](https://www.sqlite.org/c3ref/wal_checkpoint_v2.html)
 	/// - seealso: [PRAGMA wal_checkpoint](https://www.sqlite.org/pragma.html#pragma_wal_checkpoint)
-	public func walCheckpoint(type: WALCheckpointType = .passive) throws {
+	@discardableResult public func walCheckpoint(type: WALCheckpointType = .passive) throws -> (logFrameCount: Int, checkpointedFrameCount: Int) {
 		let mode: Int32
 		switch type {
 		case .passive:		mode = SQLITE_CHECKPOINT_PASSIVE
@@ -526,9 +570,88 @@ extension Database {
 		case .truncate:		mode = SQLITE_CHECKPOINT_TRUNCATE
 		}
 
-		guard sqlite3_wal_checkpoint_v2(db, nil, mode, nil, nil) == SQLITE_OK else {
+		var logFrameCount: Int32 = 0
+		var checkpointedFrameCount: Int32 = 0
+		guard sqlite3_wal_checkpoint_v2(db, nil, mode, &logFrameCount, &checkpointedFrameCount) == SQLITE_OK else {
 			throw SQLiteError("Error performing WAL checkpoint", takingDescriptionFromDatabase: db)
 		}
+		return (Int(logFrameCount), Int(checkpointedFrameCount))
+	}
+
+	/// Sets the write-ahead log size in pages at which a checkpoint is automatically performed after a commit.
+	///
+	/// - note: Setting an automatic checkpoint replaces any write-ahead log commit hook
+	///
+	/// - parameter pageCount: The number of pages, or a value less than or equal to `0` to disable automatic checkpoints
+	///
+	/// - throws: An error if the automatic checkpoint could not be set
+	///
+	/// - seealso: [Configure an auto-checkpoint](https://www.sqlite.org/c3ref/wal_autocheckpoint.html)
+	public func setWALAutocheckpoint(pageCount: Int) throws {
+		guard sqlite3_wal_autocheckpoint(db, Int32(pageCount)) == SQLITE_OK else {
+			throw SQLiteError("Error setting WAL automatic checkpoint", takingDescriptionFromDatabase: db)
+		}
+		// The automatic checkpoint replaced any hook installed by `setWALCommitHook(_:)`
+		walCommitHook?.deinitialize(count: 1)
+		walCommitHook?.deallocate()
+		walCommitHook = nil
+	}
+
+	/// Sets the size in bytes to which a write-ahead log or rollback journal is truncated after use.
+	///
+	/// - parameter limit: The size limit in bytes or a negative value for no limit
+	///
+	/// - throws: An error if the limit could not be set
+	///
+	/// - returns: The new size limit
+	///
+	/// - seealso: [PRAGMA journal_size_limit](https://www.sqlite.org/pragma.html#pragma_journal_size_limit)
+	@discardableResult public func setJournalSizeLimit(_ limit: Int64) throws -> Int64 {
+		return try prepare(sql: "PRAGMA journal_size_limit = \(limit);").front()
+	}
+
+	/// Sets the approximate number of rows examined in each index by `ANALYZE` and `optimize()`.
+	///
+	/// A limit produces approximate statistics much faster than a full analysis of large tables.
+	///
+	/// - parameter limit: The number of rows, or `0` for no limit
+	///
+	/// - throws: An error if the limit could not be set
+	///
+	/// - returns: The new analysis limit
+	///
+	/// - seealso: [PRAGMA analysis_limit](https://www.sqlite.org/pragma.html#pragma_analysis_limit)
+	@discardableResult public func setAnalysisLimit(_ limit: Int) throws -> Int {
+		return try prepare(sql: "PRAGMA analysis_limit = \(limit);").front()
+	}
+
+	/// Attempts to optimize the database by running `ANALYZE` on tables whose statistics are stale.
+	///
+	/// Applications with long-lived connections should call this periodically and before closing the connection.
+	/// A connection opened by a short-lived process may pass `0x10002` as `mask` when opening the database so
+	/// that tables are only analyzed once the statistics are needed.
+	///
+	/// - parameter analysisLimit: The approximate number of rows examined in each index while optimizing, or `nil` to use the connection's limit
+	/// - parameter mask: The optimizations to perform, or `nil` for the default optimizations
+	///
+	/// - throws: An error if the optimization failed
+	///
+	/// - seealso: [PRAGMA optimize](https://www.sqlite.org/pragma.html#pragma_optimize)
+	public func optimize(analysisLimit: Int? = nil, mask: Int? = nil) throws {
+		var previousLimit: Int? = nil
+		if let analysisLimit = analysisLimit {
+			previousLimit = try prepare(sql: "PRAGMA analysis_limit;").front()
+			try setAnalysisLimit(analysisLimit)
+		}
+		defer {
+			if let previousLimit = previousLimit {
+				_ = try? setAnalysisLimit(previousLimit)
+			}
+		}
+
+		// With mask bit 0x01 the statements that would have been run are returned instead
+		let sql = mask.map { "PRAGMA optimize(\($0));" } ?? "PRAGMA optimize;"
+		try prepare(sql: sql).results { _ in }
 	}
 }
 
@@ -618,33 +741,176 @@ extension Database {
 	/// - parameter total: The total number of database pages
 	public typealias BackupProgress = (_ remaining: Int, _ total: Int) -> Void
 
+	/// Options controlling the pacing of a database backup.
+	public struct BackupOptions {
+		/// The number of pages copied by each backup step, or `-1` to copy all pages in a single step
+		///
+		/// - requires: `pagesPerStep > 0 || pagesPerStep == -1`
+		public var pagesPerStep: Int {
+			didSet {
+				precondition(pagesPerStep > 0 || pagesPerStep == -1, "pagesPerStep must be positive or -1")
+			}
+		}
+		/// The time to sleep when yielding to other connections between steps
+		public var sleepInterval: TimeInterval
+		/// If `true` the backup only yields when the source or destination is busy or locked,
+		/// otherwise the backup yields after every step
+		public var isAdaptive: Bool
+		/// The maximum time allowed for the backup, or `nil` for no limit
+		public var timeBudget: TimeInterval?
+
+		/// Creates backup options.
+		///
+		/// - parameter pagesPerStep: The number of pages copied by each backup step, or `-1` to copy all pages in a single step
+		/// - parameter sleepInterval: The time to sleep when yielding to other connections between steps
+		/// - parameter adaptive: Whether the backup should only yield when the source or destination is busy or locked
+		/// - parameter timeBudget: The maximum time allowed for the backup, or `nil` for no limit
+		///
+		/// - requires: `pagesPerStep > 0 || pagesPerStep == -1`
+		public init(pagesPerStep: Int = 1024, sleepInterval: TimeInterval = 0.01, adaptive: Bool = true, timeBudget: TimeInterval? = nil) {
+			precondition(pagesPerStep > 0 || pagesPerStep == -1, "pagesPerStep must be positive or -1")
+			self.pagesPerStep = pagesPerStep
+			self.sleepInterval = sleepInterval
+			self.isAdaptive = adaptive
+			self.timeBudget = timeBudget
+		}
+	}
+
 	/// Backs up the database to the specified URL.
 	///
 	/// - parameter url: The destination for the backup.
+	/// - parameter options: Options controlling the pacing of the backup
 	/// - parameter callback: An optional closure to receive progress information
 	///
 	/// - throws: An error if the backup could not be completed
 	///
 	/// - seealso: [Online Backup API](https://www.sqlite.org/c3ref/backup_finish.html)
 	/// - seealso: [Using the SQLite Online Backup API](https://www.sqlite.org/backup.html)
-	public func backup(to url: URL, progress callback: BackupProgress? = nil) throws {
+	public func backup(to url: URL, options: BackupOptions = BackupOptions(), progress callback: BackupProgress? = nil) throws {
 		let destination = try Database(url: url)
+		try backup(to: destination, options: options, progress: callback)
+	}
 
-		if let backup = sqlite3_backup_init(destination.db, "main", self.db, "main") {
-			var result: Int32
-			repeat {
-				result = sqlite3_backup_step(backup, 5)
-				callback?(Int(sqlite3_backup_remaining(backup)), Int(sqlite3_backup_pagecount(backup)))
-				if result == SQLITE_OK || result == SQLITE_BUSY || result == SQLITE_LOCKED {
-					sqlite3_sleep(250)
-				}
-			} while result == SQLITE_OK || result == SQLITE_BUSY || result == SQLITE_LOCKED
+	/// Backs up a database to another database.
+	///
+	/// The destination may be any open database, including an in-memory database.
+	/// The destination's existing contents for `destinationName` are replaced.
+	///
+	/// - note: If the time budget is exceeded the backup is abandoned and the destination is left unchanged
+	/// unless the destination is an in-memory database, which may be partially overwritten.
+	///
+	/// - parameter destination: The database to receive the backup
+	/// - parameter name: The name of the source database to back up
+	/// - parameter destinationName: The name of the database in `destination` to overwrite
+	/// - parameter options: Options controlling the pacing of the backup
+	/// - parameter callback: An optional closure to receive progress information
+	///
+	/// - throws: An error if the backup could not be completed or the time budget was exceeded
+	///
+	/// - seealso: [Online Backup API](https://www.sqlite.org/c3ref/backup_finish.html)
+	/// - seealso: [Using the SQLite Online Backup API](https://www.sqlite.org/backup.html)
+	public func backup(to destination: Database, name: String = "main", destinationName: String = "main", options: BackupOptions = BackupOptions(), progress callback: BackupProgress? = nil) throws {
+		guard let backup = sqlite3_backup_init(destination.db, destinationName, self.db, name) else {
+			throw SQLiteError("Unable to initialize backup", takingDescriptionFromDatabase: destination.db)
+		}
+
+		let sleepMilliseconds = Int32(options.sleepInterval * 1000)
+		let deadline = options.timeBudget.map { DispatchTime.now().uptimeNanoseconds + UInt64($0 * Double(NSEC_PER_SEC)) }
+
+		var result: Int32
+		repeat {
+			result = sqlite3_backup_step(backup, Int32(clamping: options.pagesPerStep))
+			callback?(Int(sqlite3_backup_remaining(backup)), Int(sqlite3_backup_pagecount(backup)))
+
+			guard result == SQLITE_OK || result == SQLITE_BUSY || result == SQLITE_LOCKED else {
+				break
+			}
 
-			sqlite3_backup_finish(backup)
+			if let deadline = deadline, DispatchTime.now().uptimeNanoseconds >= deadline {
+				sqlite3_backup_finish(backup)
+				throw DatabaseError("Backup time budget of \(options.timeBudget!) seconds exceeded")
+			}
 
-			guard sqlite3_errcode(destination.db) == SQLITE_OK else {
-				throw SQLiteError("Unable to backup database", takingDescriptionFromDatabase: destination.db)
+			if !options.isAdaptive || result != SQLITE_OK {
+				sqlite3_sleep(sleepMilliseconds)
 			}
+		} while true
+
+		let rc = sqlite3_backup_finish(backup)
+		guard result == SQLITE_DONE, rc == SQLITE_OK else {
+			throw SQLiteError("Unable to backup database", takingDescriptionFromDatabase: destination.db)
+		}
+	}
+}
+
+extension Database {
+	/// Returns the serialized contents of a database.
+	///
+	/// The serialization is the same sequence of bytes that would be written to disk for the database.
+	///
+	/// - parameter name: The name of the database to serialize
+	///
+	/// - throws: An error if the database could not be serialized
+	///
+	/// - returns: The serialized database
+	///
+	/// - seealso: [Serialize a database](https://www.sqlite.org/c3ref/serialize.html)
+	public func serialize(name: String = "main") throws -> Data {
+		var size: sqlite3_int64 = 0
+		guard let bytes = sqlite3_serialize(db, name, &size, 0) else {
+			throw SQLiteError("Error serializing database \(name)", takingDescriptionFromDatabase: db)
+		}
+		return Data(bytesNoCopy: bytes, count: Int(size), deallocator: .custom({ bytes, _ in sqlite3_free(bytes) }))
+	}
+
+	/// Invokes `body` with the in-memory contents of a database without copying.
+	///
+	/// - important: The bytes are only valid within `body` and must not be accessed after `body` returns
+	/// or after the database is modified.
+	///
+	/// - requires: The database is an in-memory database stored in contiguous memory, such as one created by `deserialize(_:name:readOnly:)`
+	///
+	/// - parameter name: The name of the database to access
+	/// - parameter body: A closure accessing the serialized database
+	/// - parameter bytes: The serialized database
+	///
+	/// - throws: Any error thrown in `body` or an error if the database is not stored in contiguous memory
+	///
+	/// - returns: The value returned by `body`
+	///
+	/// - seealso: [Serialize a database](https://www.sqlite.org/c3ref/serialize.html)
+	public func withUnsafeSerialization<T>(name: String = "main", _ body: (_ bytes: UnsafeRawBufferPointer) throws -> T) throws -> T {
+		var size: sqlite3_int64 = 0
+		guard let bytes = sqlite3_serialize(db, name, &size, UInt32(SQLITE_SERIALIZE_NOCOPY)) else {
+			throw DatabaseError("Database \(name) is not stored in contiguous memory")
+		}
+		return try body(UnsafeRawBufferPointer(start: bytes, count: Int(size)))
+	}
+
+	/// Replaces the contents of a database with a serialized database.
+	///
+	/// The database becomes an in-memory database containing a copy of `data`.
+	///
+	/// - parameter data: The serialized database
+	/// - parameter name: The name of the database to replace
+	/// - parameter readOnly: Whether the deserialized database should be read-only
+	///
+	/// - throws: An error if the database could not be deserialized
+	///
+	/// - seealso: [Deserialize a database](https://www.sqlite.org/c3ref/deserialize.html)
+	public func deserialize(_ data: Data, name: String = "main", readOnly: Bool = false) throws {
+		guard let bytes = sqlite3_malloc64(sqlite3_uint64(max(data.count, 1))) else {
+			throw SQLiteError("Error allocating memory for deserialization", code: SQLITE_NOMEM)
+		}
+		data.copyBytes(to: bytes.assumingMemoryBound(to: UInt8.self), count: data.count)
+
+		var flags = SQLITE_DESERIALIZE_FREEONCLOSE
+		flags |= readOnly ? SQLITE_DESERIALIZE_READONLY : SQLITE_DESERIALIZE_RESIZEABLE
+
+		// sqlite3_deserialize() frees the buffer on failure when SQLITE_DESERIALIZE_FREEONCLOSE is set
+		let size = sqlite3_int64(data.count)
+		guard sqlite3_deserialize(db, name, bytes.assumingMemoryBound(to: UInt8.self), size, size, UInt32(flags)) == SQLITE_OK else {
+			throw SQLiteError("Error deserializing database \(name)", takingDescriptionFromDatabase: db)
 		}
 	}
 }
@@ -0,0 +1,245 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import os.log
+import Foundation
+import CSQLite
+
+/// A pool of database connections providing concurrent read access and serialized write access to a database.
+///
+/// A database pool consists of a single writer connection and a fixed number of read-only reader connections.
+/// The database is placed in write-ahead log (WAL) mode so readers and the writer do not block one another.
+///
+/// Each connection in the pool is pinned to its own serial dispatch queue and is only ever used on that queue.
+/// Because FeistyDB compiles SQLite with `SQLITE_THREADSAFE=0` a connection must never be used
+/// concurrently from more than one thread; the pool enforces this by handing each reader to at most one
+/// operation at a time and by running every operation on the connection's queue.
+///
+/// ```swift
+/// let pool = try DatabasePool(url: url, label: "com.example.pool")
+/// try pool.write { db in
+///     try db.execute(sql: "insert into t1 default values;")
+/// }
+/// let rowCount: Int = try pool.read { db in
+///     try db.prepare(sql: "select count(*) from t1;").front()
+/// }
+/// ```
+///
+/// - attention: Database pool operations may not be nested.  Calling `read` or `write` from within
+/// a block executing on a pool connection is a programming error.
+///
+/// - seealso: [Write-Ahead Logging](https://www.sqlite.org/wal.html)
+public final class DatabasePool {
+	/// A reader connection and the dispatch queue to which it is pinned
+	final class Reader {
+		/// The underlying read-only database
+		let database: Database
+		/// The dispatch queue used to serialize access to `database`
+		let queue: DispatchQueue
+
+		init(database: Database, queue: DispatchQueue) {
+			self.database = database
+			self.queue = queue
+		}
+	}
+
+	/// The underlying writer database
+	let writer: Database
+	/// The dispatch queue used to serialize access to the writer connection
+	public let writeQueue: DispatchQueue
+
+	/// The reader connections
+	let readers: [Reader]
+	/// Reader connections available for checkout
+	var availableReaders: [Reader]
+	/// The lock protecting `availableReaders`
+	let lock = NSLock()
+	/// A semaphore counting the reader connections available for checkout
+	let readerSemaphore: DispatchSemaphore
+
+	/// The key used to identify dispatch queues owned by the pool
+	let queueKey = DispatchSpecificKey<ObjectIdentifier>()
+
+	/// Creates a database pool for the database in a file.
+	///
+	/// The database is created if it doesn't exist and is placed in WAL mode.
+	///
+	/// - parameter url: The location of the SQLite database
+	/// - parameter maximumReaderCount: The number of reader connections in the pool
+	/// - parameter label: The label used as a prefix for the labels of the pool's queues
+	/// - parameter qos: The quality of service class for the work performed by the pool
+	///
+	/// - throws: An error if the database could not be opened or placed in WAL mode
+	public init(url: URL, maximumReaderCount: Int = 4, label: String, qos: DispatchQoS = .default) throws {
+		precondition(maximumReaderCount > 0, "A database pool requires at least one reader")
+
+		let writer = try Database(url: url)
+		let journalMode: String = try writer.prepare(sql: "PRAGMA journal_mode = WAL;").front()
+		guard journalMode.lowercased() == "wal" else {
+			throw DatabaseError("Unable to place database \(url) in WAL mode")
+		}
+
+		self.writer = writer
+		self.writeQueue = DispatchQueue(label: "\(label).writer", qos: qos)
+
+		var readers = [Reader]()
+		for i in 0 ..< maximumReaderCount {
+			let database = try Database(readingFrom: url)
+			let queue = DispatchQueue(label: "\(label).reader.\(i)", qos: qos)
+			readers.append(Reader(database: database, queue: queue))
+		}
+
+		self.readers = readers
+		self.availableReaders = readers
+		self.readerSemaphore = DispatchSemaphore(value: maximumReaderCount)
+
+		let identifier = ObjectIdentifier(self)
+		writeQueue.setSpecific(key: queueKey, value: identifier)
+		for reader in readers {
+			reader.queue.setSpecific(key: queueKey, value: identifier)
+		}
+
+		MemoryReleaseRegistry.shared.register(self)
+	}
+
+	/// The number of reader connections in the pool
+	public var maximumReaderCount: Int {
+		return readers.count
+	}
+
+	/// `true` if the current thread is executing a block on one of the pool's connections
+	var isExecutingOnPoolQueue: Bool {
+		return DispatchQueue.getSpecific(key: queueKey) == ObjectIdentifier(self)
+	}
+
+	/// Removes and returns an available reader, waiting for one if necessary.
+	func checkoutReader() -> Reader {
+		precondition(!isExecutingOnPoolQueue, "Database pool operations may not be nested")
+		readerSemaphore.wait()
+		lock.lock()
+		let reader = availableReaders.removeLast()
+		lock.unlock()
+		return reader
+	}
+
+	/// Returns a reader previously obtained from `checkoutReader()` to the pool.
+	func checkinReader(_ reader: Reader) {
+		lock.lock()
+		availableReaders.append(reader)
+		lock.unlock()
+		readerSemaphore.signal()
+	}
+
+	/// Performs a synchronous read operation on one of the pool's reader connections.
+	///
+	/// `block` is executed within a read transaction so all statements executed in `block`
+	/// observe the same consistent state of the database.
+	///
+	/// - note: If all readers are in use this method blocks until one becomes available.
+	///
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	///
+	/// - throws: Any error thrown in `block` or an error if the read transaction could not be started
+	///
+	/// - returns: The value returned by `block`
+	public func read<T>(_ block: (_ database: Database) throws -> (T)) throws -> T {
+		let reader = checkoutReader()
+		defer {
+			checkinReader(reader)
+		}
+		return try reader.queue.sync {
+			let database = reader.database
+			try database.beginReadTransaction()
+			defer {
+				try? database.endReadTransaction()
+			}
+			return try block(database)
+		}
+	}
+
+	/// Submits an asynchronous read operation to one of the pool's reader connections.
+	///
+	/// - parameter group: An optional `DispatchGroup` with which to associate `block`
+	/// - parameter qos: The quality of service for `block`
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	public func asyncRead(group: DispatchGroup? = nil, qos: DispatchQoS = .default, block: @escaping (_ database: Database) -> (Void)) {
+		DispatchQueue.global(qos: qos.qosClass).async(group: group) {
+			do {
+				try self.read(block)
+			}
+			catch let error as Error {
+				os_log("Error performing database read: %{public}@", type: .info, String(describing: error))
+			}
+			catch let error {
+				os_log("Error performing database read: %{public}@", type: .info, error.localizedDescription)
+			}
+		}
+	}
+
+	/// Performs a synchronous write operation on the pool's writer connection.
+	///
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	///
+	/// - throws: Any error thrown in `block`
+	///
+	/// - returns: The value returned by `block`
+	public func write<T>(_ block: (_ database: Database) throws -> (T)) rethrows -> T {
+		precondition(!isExecutingOnPoolQueue, "Database pool operations may not be nested")
+		return try writeQueue.sync {
+			return try block(self.writer)
+		}
+	}
+
+	/// Submits an asynchronous write operation to the pool's writer connection.
+	///
+	/// - parameter group: An optional `DispatchGroup` with which to associate `block`
+	/// - parameter qos: The quality of service for `block`
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	public func asyncWrite(group: DispatchGroup? = nil, qos: DispatchQoS = .default, block: @escaping (_ database: Database) -> (Void)) {
+		writeQueue.async(group: group, qos: qos) {
+			block(self.writer)
+		}
+	}
+
+	/// Performs a synchronous transaction on the pool's writer connection.
+	///
+	/// - parameter type: The type of transaction to perform
+	/// - parameter block: A closure performing the database operation
+	///
+	/// - throws: Any error thrown in `block` or an error if the transaction could not be started, rolled back, or committed
+	///
+	/// - note: If `block` throws an error the transaction will be rolled back and the error will be re-thrown
+	/// - note: If an error occurs committing the transaction a rollback will be attempted and the error will be re-thrown
+	public func writeTransaction(type: Database.TransactionType = .immediate, _ block: Database.TransactionBlock) throws {
+		try write { db in
+			try db.transaction(type: type, block)
+		}
+	}
+
+	/// Submits an asynchronous transaction to the pool's writer connection.
+	///
+	/// - parameter type: The type of transaction to perform
+	/// - parameter group: An optional `DispatchGroup` with which to associate `block`
+	/// - parameter qos: The quality of service for `block`
+	/// - parameter block: A closure performing the database operation
+	public func asyncWriteTransaction(type: Database.TransactionType = .immediate, group: DispatchGroup? = nil, qos: DispatchQoS = .default, _ block: @escaping Database.TransactionBlock) {
+		writeQueue.async(group: group, qos: qos) {
+			do {
+				try self.writer.transaction(type: type, block)
+			}
+			catch let error as Error {
+				os_log("Error performing database transaction: %{public}@", type: .info, String(describing: error))
+			}
+			catch let error {
+				os_log("Error performing database transaction: %{public}@", type: .info, error.localizedDescription)
+			}
+		}
+	}
+}
@@ -0,0 +1,366 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+#if compiler(>=5.6) && canImport(_Concurrency)
+
+@available(macOS 10.15, iOS 13.0, watchOS 6.0, tvOS 13.0, *)
+extension DatabaseQueue {
+	/// Performs an operation on the database without blocking the calling task.
+	///
+	/// `block` is executed on the database queue and the calling task is suspended until it completes.
+	///
+	/// If the calling task is cancelled the SQL statement being evaluated by `block` is interrupted.
+	///
+	/// - parameter budget: The limits for database operations in `block`
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	///
+	/// - throws: `QueryBudgetExceededError` if `budget` is exceeded or the task is cancelled, otherwise any error thrown in `block`
+	///
+	/// - returns: The value returned by `block`
+	public func read<T>(budget: Database.QueryBudget = Database.QueryBudget(), _ block: @escaping (_ database: Database) throws -> T) async throws -> T {
+		return try await perform(on: database, queue: queue, budget: budget, block)
+	}
+
+	/// Performs a transaction on the database without blocking the calling task.
+	///
+	/// `block` is executed within a transaction on the database queue and the calling task is suspended until it completes.
+	/// The transaction is committed when `block` returns.
+	///
+	/// - note: If `block` throws an error the transaction will be rolled back and the error will be re-thrown
+	/// - note: If an error occurs committing the transaction a rollback will be attempted and the error will be re-thrown
+	///
+	/// If the calling task is cancelled the SQL statement being evaluated by `block` is interrupted and the transaction is rolled back.
+	///
+	/// - parameter type: The type of transaction to perform
+	/// - parameter budget: The limits for database operations in `block`
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	///
+	/// - throws: `QueryBudgetExceededError` if `budget` is exceeded or the task is cancelled, otherwise any error thrown in `block` or an error if the transaction could not be started or committed
+	///
+	/// - returns: The value returned by `block`
+	public func write<T>(type: Database.TransactionType = .immediate, budget: Database.QueryBudget = Database.QueryBudget(), _ block: @escaping (_ database: Database) throws -> T) async throws -> T {
+		return try await perform(on: database, queue: queue, budget: budget) { database in
+			try database.begin(type: type)
+			do {
+				let value = try block(database)
+				try database.commit()
+				return value
+			}
+			catch let error {
+				if !database.isInAutocommitMode {
+					try? database.rollback()
+				}
+				throw error
+			}
+		}
+	}
+
+	/// Returns an asynchronous sequence of the values produced by applying `transform` to each result row of `sql`.
+	///
+	/// The statement is stepped on the database queue in chunks of up to `chunkSize` rows.  A new chunk is not
+	/// requested until the consumer has received all values from the previous chunk so at most one chunk is
+	/// buffered at a time and no thread is blocked while the consumer processes values.
+	///
+	/// Other work submitted to the database queue may execute between chunks.
+	///
+	/// If the consuming task is cancelled while a chunk is being produced the SQL statement is interrupted
+	/// and the sequence throws `QueryBudgetExceededError`.
+	///
+	/// - parameter sql: The SQL statement to execute
+	/// - parameter values: A series of values to bind to SQL parameters
+	/// - parameter chunkSize: The maximum number of rows stepped per trip to the database queue
+	/// - parameter transform: A closure converting a result row to a value
+	/// - parameter row: A result row of returned data
+	///
+	/// - returns: An asynchronous sequence of the transformed result rows
+	public func rows<T>(sql: String, parameterValues values: [ParameterBindable?] = [], chunkSize: Int = 256, _ transform: @escaping (_ row: Row) throws -> T) -> AsyncThrowingStream<T, Swift.Error> {
+		let producer = RowStreamProducer(database: database, queue: queue, sql: sql, parameterValues: values, chunkSize: chunkSize, transform: transform)
+		return AsyncThrowingStream(unfolding: producer.next)
+	}
+}
+
+@available(macOS 10.15, iOS 13.0, watchOS 6.0, tvOS 13.0, *)
+extension DatabaseReadQueue {
+	/// Performs a read operation on the database without blocking the calling task.
+	///
+	/// `block` is executed on the database queue and the calling task is suspended until it completes.
+	///
+	/// If the calling task is cancelled the SQL statement being evaluated by `block` is interrupted.
+	///
+	/// - parameter budget: The limits for database operations in `block`
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	///
+	/// - throws: `QueryBudgetExceededError` if `budget` is exceeded or the task is cancelled, otherwise any error thrown in `block`
+	///
+	/// - returns: The value returned by `block`
+	public func read<T>(budget: Database.QueryBudget = Database.QueryBudget(), _ block: @escaping (_ database: Database) throws -> T) async throws -> T {
+		return try await perform(on: database, queue: queue, budget: budget, block)
+	}
+
+	/// Returns an asynchronous sequence of the values produced by applying `transform` to each result row of `sql`.
+	///
+	/// The statement is stepped on the database queue in chunks of up to `chunkSize` rows.  A new chunk is not
+	/// requested until the consumer has received all values from the previous chunk.
+	///
+	/// If the consuming task is cancelled while a chunk is being produced the SQL statement is interrupted
+	/// and the sequence throws `QueryBudgetExceededError`.
+	///
+	/// - parameter sql: The SQL statement to execute
+	/// - parameter values: A series of values to bind to SQL parameters
+	/// - parameter chunkSize: The maximum number of rows stepped per trip to the database queue
+	/// - parameter transform: A closure converting a result row to a value
+	/// - parameter row: A result row of returned data
+	///
+	/// - returns: An asynchronous sequence of the transformed result rows
+	public func rows<T>(sql: String, parameterValues values: [ParameterBindable?] = [], chunkSize: Int = 256, _ transform: @escaping (_ row: Row) throws -> T) -> AsyncThrowingStream<T, Swift.Error> {
+		let producer = RowStreamProducer(database: database, queue: queue, sql: sql, parameterValues: values, chunkSize: chunkSize, transform: transform)
+		return AsyncThrowingStream(unfolding: producer.next)
+	}
+}
+
+/// Performs a database operation on `queue` subject to `budget` without blocking the calling task.
+///
+/// Cancelling the calling task cancels the operation.  If `budget` has no limits the operation is interrupted
+/// using `sqlite3_interrupt()` instead of a progress handler, avoiding the cost of periodic budget checks.
+///
+/// - parameter database: The database on which to perform the operation
+/// - parameter queue: The queue serializing access to `database`
+/// - parameter budget: The limits for database operations in `block`
+/// - parameter interrupted: A closure releasing any statements left active by `block`, called on `queue` if `block` was interrupted
+/// - parameter block: A closure performing the database operation
+///
+/// - returns: The value returned by `block`
+@available(macOS 10.15, iOS 13.0, watchOS 6.0, tvOS 13.0, *)
+func perform<T>(on database: Database, queue: DispatchQueue, budget: Database.QueryBudget, interrupted: (() -> Void)? = nil, _ block: @escaping (_ database: Database) throws -> T) async throws -> T {
+	guard !budget.isUnlimited else {
+		let interrupter = TaskInterrupter(database: database)
+		do {
+			return try await withTaskCancellationHandler(operation: {
+				try await withCheckedThrowingContinuation { continuation in
+					queue.async {
+						continuation.resume(with: Result { try interrupter.execute(block, interrupted: interrupted) })
+					}
+				}
+			}, onCancel: {
+				interrupter.cancel()
+			})
+		}
+		catch let error {
+			// The task is checked after the operation completes because a cancellation may arrive after the last statement finished
+			if Task.isCancelled {
+				throw QueryBudgetExceededError(reason: .cancelled, details: nil)
+			}
+			throw error
+		}
+	}
+
+	var budget = budget
+	let token = budget.cancellationToken ?? QueryCancellationToken()
+	budget.cancellationToken = token
+	return try await withTaskCancellationHandler(operation: {
+		try await withCheckedThrowingContinuation { continuation in
+			queue.async {
+				continuation.resume(with: Result { try database.withBudget(budget, block) })
+			}
+		}
+	}, onCancel: {
+		token.cancel()
+	})
+}
+
+/// Interrupts an operation on a database queue when the calling task is cancelled.
+///
+/// `sqlite3_interrupt()` is called only while the operation is executing so other work on the queue is unaffected.
+///
+/// An interrupt that arrives after the operation's last statement completed remains pending in SQLite
+/// as long as any statement on the connection is active, and would abort the next statement stepped.
+/// Operations that leave statements active across queue turns must release them when interrupted.
+@available(macOS 10.15, iOS 13.0, watchOS 6.0, tvOS 13.0, *)
+final class TaskInterrupter {
+	/// The database on which the operation is performed
+	let database: Database
+	/// The lock protecting `isExecuting`, `isCancelled`, and `didInterrupt`
+	let lock = NSLock()
+	/// `true` while the operation is executing
+	var isExecuting = false
+	/// `true` if the operation has been cancelled
+	var isCancelled = false
+	/// `true` if `sqlite3_interrupt()` was called while the operation was executing
+	var didInterrupt = false
+
+	init(database: Database) {
+		self.database = database
+	}
+
+	/// Executes `block` unless the operation has been cancelled.
+	///
+	/// - note: This must be called on the database queue
+	///
+	/// - parameter block: A closure performing the database operation
+	/// - parameter interrupted: A closure releasing any statements left active by `block`, called if `block` was interrupted
+	///
+	/// - throws: `QueryBudgetExceededError` if the operation is cancelled before it begins, otherwise any error thrown in `block`
+	func execute<T>(_ block: (_ database: Database) throws -> T, interrupted: (() -> Void)? = nil) throws -> T {
+		lock.lock()
+		guard !isCancelled else {
+			lock.unlock()
+			throw QueryBudgetExceededError(reason: .cancelled, details: nil)
+		}
+		isExecuting = true
+		lock.unlock()
+
+		let result = Result { try block(database) }
+
+		lock.lock()
+		isExecuting = false
+		let didInterrupt = self.didInterrupt
+		lock.unlock()
+
+		// SQLite clears a pending interrupt once no statements are active
+		if didInterrupt {
+			interrupted?()
+		}
+		return try result.get()
+	}
+
+	/// Cancels the operation, interrupting it if it is executing.
+	///
+	/// - note: This method may be called from any thread
+	func cancel() {
+		lock.lock()
+		isCancelled = true
+		if isExecuting {
+			database.interrupt()
+			didInterrupt = true
+		}
+		lock.unlock()
+	}
+}
+
+/// Produces transformed result rows for an asynchronous stream by stepping a statement on a database queue in chunks.
+@available(macOS 10.15, iOS 13.0, watchOS 6.0, tvOS 13.0, *)
+final class RowStreamProducer<T> {
+	/// The database on which the statement is executed
+	let database: Database
+	/// The queue serializing access to `database`
+	let queue: DispatchQueue
+	/// The SQL statement to execute
+	let sql: String
+	/// The values to bind to SQL parameters
+	let parameterValues: [ParameterBindable?]
+	/// The maximum number of rows stepped per chunk
+	let chunkSize: Int
+	/// The closure converting result rows to values
+	let transform: (Row) throws -> T
+
+	/// The statement being stepped, accessed only on `queue`
+	var statement: Statement?
+	/// `true` once the statement has run to completion or failed, accessed only on `queue`
+	var isFinished = false
+
+	/// The most recently produced chunk, accessed only by the consumer
+	var buffer = [T]()
+	/// The index of the next value in `buffer` to return, accessed only by the consumer
+	var index = 0
+
+	init(database: Database, queue: DispatchQueue, sql: String, parameterValues: [ParameterBindable?], chunkSize: Int, transform: @escaping (Row) throws -> T) {
+		precondition(chunkSize > 0)
+		self.database = database
+		self.queue = queue
+		self.sql = sql
+		self.parameterValues = parameterValues
+		self.chunkSize = chunkSize
+		self.transform = transform
+	}
+
+	deinit {
+		// The statement must be finalized on the database queue
+		if let statement = statement {
+			queue.async {
+				withExtendedLifetime(statement) {}
+			}
+		}
+	}
+
+	/// Returns the next value or `nil` if the statement has run to completion.
+	func next() async throws -> T? {
+		if index == buffer.count {
+			buffer = try await nextChunk()
+			index = 0
+			guard !buffer.isEmpty else {
+				return nil
+			}
+		}
+		let value = buffer[index]
+		index += 1
+		return value
+	}
+
+	/// Steps the statement on the database queue and returns the next chunk of values.
+	///
+	/// The statement is interrupted if the calling task is cancelled.  An interrupt pending after the chunk
+	/// completed is cleared by releasing the statement, which is still active.
+	func nextChunk() async throws -> [T] {
+		let chunk = try await perform(on: database, queue: queue, budget: Database.QueryBudget(), interrupted: { self.finish() }) { _ in
+			try self.step()
+		}
+		// The statement may have been released by a cancellation that arrived after the last row was stepped
+		if Task.isCancelled {
+			throw QueryBudgetExceededError(reason: .cancelled, details: nil)
+		}
+		return chunk
+	}
+
+	/// Steps the statement up to `chunkSize` times and returns the transformed rows.
+	///
+	/// - note: This must be called on `queue`
+	func step() throws -> [T] {
+		guard !isFinished else {
+			return []
+		}
+
+		do {
+			if statement == nil {
+				let statement = try database.prepare(sql: sql)
+				try statement.bind(parameterValues: parameterValues)
+				self.statement = statement
+			}
+
+			let statement = self.statement.unsafelyUnwrapped
+			var chunk = [T]()
+			chunk.reserveCapacity(chunkSize)
+			while chunk.count < chunkSize, let row = try statement.nextRow() {
+				chunk.append(try transform(row))
+			}
+
+			if chunk.count < chunkSize {
+				finish()
+			}
+
+			return chunk
+		}
+		catch let error {
+			finish()
+			throw error
+		}
+	}
+
+	/// Releases the statement.
+	///
+	/// - note: This must be called on `queue`
+	func finish() {
+		isFinished = true
+		statement = nil
+	}
+}
+
+#endif
@@ -49,19 +49,22 @@ public final class DatabaseQueue {
 	public init(label: String, qos: DispatchQoS = .default, target: DispatchQueue? = nil) throws {
 		self.database = try Database()
 		self.queue = DispatchQueue(label: label, qos: qos, target: target)
+		MemoryReleaseRegistry.shared.register(self)
 	}
 
 	/// Creates a database queue for serialized access to a database from a file.
 	///
 	/// - parameter url: The location of the SQLite database
+	/// - parameter configuration: The settings to apply to the connection
 	/// - parameter label: The label to attach to the queue
 	/// - parameter qos: The quality of service class for the work performed by the database queue
 	/// - parameter target: The target dispatch queue on which to execute blocks
 	///
 	/// - throws: An error if the database could not be opened
-	public init(url: URL, label: String, qos: DispatchQoS = .default, target: DispatchQueue? = nil) throws {
-		self.database = try Database(url: url)
+	public init(url: URL, configuration: Database.Configuration = Database.Configuration(), label: String, qos: DispatchQoS = .default, target: DispatchQueue? = nil) throws {
+		self.database = try Database(url: url, configuration: configuration)
 		self.queue = DispatchQueue(label: label, qos: qos, target: target)
+		MemoryReleaseRegistry.shared.register(self)
 	}
 
 	/// Creates a database queue for serialized access to an existing database.
@@ -75,6 +78,7 @@ public final class DatabaseQueue {
 	public init(database: Database, label: String, qos: DispatchQoS = .default, target: DispatchQueue? = nil) {
 		self.database = database
 		self.queue = DispatchQueue(label: label, qos: qos, target: target)
+		MemoryReleaseRegistry.shared.register(self)
 	}
 
 	/// Performs a synchronous operation on the database.
@@ -32,14 +32,37 @@ public final class DatabaseReadQueue {
 	/// Creates a database read queue for serialized read access to a database from a file.
 	///
 	/// - parameter url: The location of the SQLite database
+	/// - parameter configuration: The settings to apply to the connection
 	/// - parameter label: The label to attach to the queue
 	/// - parameter qos: The quality of service class for the work performed by the database queue
 	/// - parameter target: The target dispatch queue on which to execute blocks
 	///
 	/// - throws: An error if the database could not be opened
-	public init(url: URL, label: String, qos: DispatchQoS = .default, target: DispatchQueue? = nil) throws {
-		self.database = try Database(readingFrom: url)
+	public init(url: URL, configuration: Database.Configuration = Database.Configuration(), label: String, qos: DispatchQoS = .default, target: DispatchQueue? = nil) throws {
+		self.database = try Database(readingFrom: url, configuration: configuration)
 		self.queue = DispatchQueue(label: label, qos: qos, target: target)
+		MemoryReleaseRegistry.shared.register(self)
+	}
+
+	/// Creates a database read queue for serialized read access to an immutable database from a file.
+	///
+	/// The database is opened using `Database(immutableReadingFrom:configuration:)`.  Because immutable
+	/// databases require no locking, many read queues may be created for the same file and all share the
+	/// memory-mapped pages in the OS page cache.
+	///
+	/// - important: The file must not be modified by any process while the database is open.
+	///
+	/// - parameter url: The location of the SQLite database
+	/// - parameter configuration: The settings to apply to the connection
+	/// - parameter label: The label to attach to the queue
+	/// - parameter qos: The quality of service class for the work performed by the database queue
+	/// - parameter target: The target dispatch queue on which to execute blocks
+	///
+	/// - throws: An error if the database could not be opened
+	public init(immutableURL url: URL, configuration: Database.Configuration = Database.Configuration(mmapSize: .max), label: String, qos: DispatchQoS = .default, target: DispatchQueue? = nil) throws {
+		self.database = try Database(immutableReadingFrom: url, configuration: configuration)
+		self.queue = DispatchQueue(label: label, qos: qos, target: target)
+		MemoryReleaseRegistry.shared.register(self)
 	}
 
 	/// Creates a database read queue for serialized read access to an existing database.
@@ -53,6 +76,7 @@ public final class DatabaseReadQueue {
 	public init(database: Database, label: String, qos: DispatchQoS = .default, target: DispatchQueue? = nil) {
 		self.database = database
 		self.queue = DispatchQueue(label: label, qos: qos, target: target)
+		MemoryReleaseRegistry.shared.register(self)
 	}
 
 	/// Begins a long-running read transaction on the database.
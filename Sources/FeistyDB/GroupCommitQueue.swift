@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import os.log
+import Foundation
+import CSQLite
+
+/// Coalesces small write operations on a database queue into shared transactions.
+///
+/// Blocks submitted within `maximumDelay` of one another, up to `maximumBatchSize` blocks, are executed
+/// in a single transaction so they share the cost of one commit.  Each block runs in its own savepoint,
+/// so a block that throws or requests a rollback discards only its own changes.
+///
+/// A block's completion handler is called once the shared transaction has been committed, or with an error
+/// if the block failed or the transaction could not be committed.
+///
+/// ```swift
+/// let writer = GroupCommitQueue(databaseQueue: dbQueue)
+/// writer.submit({ db in
+///     try db.execute(sql: "insert into events(name) values (?);", parameterValues: [name])
+///     return .release
+/// }, completion: { result in
+///     // The insert is committed
+/// })
+/// ```
+///
+/// - note: Completion handlers are called on the database queue and should not block.
+///
+/// - note: Whether a committed transaction survives a power loss depends on the database's `PRAGMA synchronous` setting.
+public final class GroupCommitQueue {
+	/// A closure called with the outcome of a submitted block
+	public typealias Completion = (_ result: Result<Void, Swift.Error>) -> Void
+
+	/// A submitted block and its completion handler
+	struct WorkItem {
+		let block: Database.SavepointBlock
+		let completion: Completion?
+	}
+
+	/// The database queue on which transactions are executed
+	public let databaseQueue: DatabaseQueue
+	/// The maximum number of blocks executed in one transaction
+	public let maximumBatchSize: Int
+	/// The maximum time in seconds a block waits for other blocks to join its transaction
+	public let maximumDelay: TimeInterval
+	/// The type of transaction used for each batch
+	public let transactionType: Database.TransactionType
+
+	/// Blocks waiting for execution
+	var pending = [WorkItem]()
+	/// `true` if a batch has been submitted to the database queue
+	var isBatchScheduled = false
+	/// The lock protecting `pending` and `isBatchScheduled`
+	let lock = NSLock()
+
+	/// Creates a group commit queue.
+	///
+	/// - parameter databaseQueue: The database queue on which transactions are executed
+	/// - parameter maximumBatchSize: The maximum number of blocks executed in one transaction
+	/// - parameter maximumDelay: The maximum time in seconds a block waits for other blocks to join its transaction
+	/// - parameter transactionType: The type of transaction used for each batch
+	public init(databaseQueue: DatabaseQueue, maximumBatchSize: Int = 64, maximumDelay: TimeInterval = 0.002, transactionType: Database.TransactionType = .immediate) {
+		precondition(maximumBatchSize > 0, "maximumBatchSize must be positive")
+		self.databaseQueue = databaseQueue
+		self.maximumBatchSize = maximumBatchSize
+		self.maximumDelay = maximumDelay
+		self.transactionType = transactionType
+	}
+
+	/// Submits a block for execution in a shared transaction.
+	///
+	/// - parameter block: A closure performing the database operation within a savepoint
+	/// - parameter completion: An optional closure called after the shared transaction is committed or the block fails
+	public func submit(_ block: @escaping Database.SavepointBlock, completion: Completion? = nil) {
+		lock.lock()
+		pending.append(WorkItem(block: block, completion: completion))
+		let isBatchFull = pending.count >= maximumBatchSize
+		let scheduleBatch = !isBatchScheduled
+		if scheduleBatch {
+			isBatchScheduled = true
+		}
+		lock.unlock()
+
+		// A full batch is executed immediately; otherwise later blocks may join the batch until the delay elapses
+		if isBatchFull {
+			databaseQueue.queue.async {
+				self.executeBatches()
+			}
+		}
+		else if scheduleBatch {
+			databaseQueue.queue.asyncAfter(deadline: .now() + maximumDelay) {
+				self.executeBatches()
+			}
+		}
+	}
+
+	/// Executes all pending blocks and waits for their transactions to be committed.
+	public func flush() {
+		databaseQueue.queue.sync {
+			executeBatches()
+		}
+	}
+
+	/// Executes pending blocks in batches of up to `maximumBatchSize`.
+	///
+	/// - note: Must be called on the database queue
+	func executeBatches() {
+		while true {
+			lock.lock()
+			guard !pending.isEmpty else {
+				isBatchScheduled = false
+				lock.unlock()
+				return
+			}
+			let count = min(pending.count, maximumBatchSize)
+			let batch = Array(pending[0 ..< count])
+			pending.removeFirst(count)
+			lock.unlock()
+
+			execute(batch)
+		}
+	}
+
+	/// Executes `batch` in a single transaction and reports the outcome of each block.
+	///
+	/// - parameter batch: The blocks to execute
+	func execute(_ batch: [WorkItem]) {
+		let database = databaseQueue.database
+		var results = [Result<Void, Swift.Error>]()
+		results.reserveCapacity(batch.count)
+
+		do {
+			try database.begin(type: transactionType)
+			for item in batch {
+				results.append(savepoint(item.block, on: database))
+				// A failed savepoint may have ended the transaction
+				if database.isInAutocommitMode {
+					throw DatabaseError("Transaction ended unexpectedly")
+				}
+			}
+			try database.commit()
+		}
+		catch let error {
+			if !database.isInAutocommitMode {
+				try? database.rollback()
+			}
+			os_log("Error committing group transaction: %{public}@", type: .info, String(describing: error))
+			for item in batch {
+				item.completion?(.failure(error))
+			}
+			return
+		}
+
+		for (item, result) in zip(batch, results) {
+			item.completion?(result)
+		}
+	}
+
+	/// Executes `block` in a savepoint, rolling the savepoint back if `block` throws or requests a rollback.
+	///
+	/// - returns: The outcome of `block`
+	func savepoint(_ block: Database.SavepointBlock, on database: Database) -> Result<Void, Swift.Error> {
+		let name = "group_commit"
+		do {
+			try database.begin(savepoint: name)
+		}
+		catch let error {
+			return .failure(error)
+		}
+
+		do {
+			switch try block(database) {
+			case .release:
+				try database.release(savepoint: name)
+				return .success(())
+			case .rollback:
+				try database.rollback(to: name)
+				try database.release(savepoint: name)
+				return .success(())
+			}
+		}
+		catch let error {
+			// Rolling back to a savepoint leaves it on the stack
+			try? database.rollback(to: name)
+			try? database.release(savepoint: name)
+			return .failure(error)
+		}
+	}
+}
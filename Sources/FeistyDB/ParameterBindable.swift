@@ -47,7 +47,7 @@ extension Database {
 	///
 	/// - throws: Any error thrown in `block` or an error if `sql` couldn't be compiled, `values` couldn't be bound, or the statement couldn't be executed
 	public func execute<C: Collection>(sql: String, parameterValues values: C, _ block: ((_ row: Row) throws -> ())? = nil) throws where C.Element: ParameterBindable {
-		let statement = try prepare(sql: sql)
+		let statement = try cachedStatement(sql: sql)
 		try statement.bind(parameterValues: values)
 		if let block = block {
 			try statement.results(block)
@@ -66,7 +66,7 @@ extension Database {
 	///
 	/// - throws: Any error thrown in `block` or an error if `sql` couldn't be compiled, `parameters` couldn't be bound, or the statement couldn't be executed
 	public func execute<C: Collection>(sql: String, parameters: C, _ block: ((_ row: Row) throws -> ())? = nil) throws where C.Element == (String, V: ParameterBindable) {
-		let statement = try prepare(sql: sql)
+		let statement = try cachedStatement(sql: sql)
 		try statement.bind(parameters: parameters)
 		if let block = block {
 			try statement.results(block)
@@ -87,7 +87,7 @@ extension Database {
 	///
 	/// - throws: Any error thrown in `block` or an error if `sql` couldn't be compiled, `values` couldn't be bound, or the statement couldn't be executed
 	public func execute(sql: String, parameterValues values: [ParameterBindable?], _ block: ((_ row: Row) throws -> ())? = nil) throws {
-		let statement = try prepare(sql: sql)
+		let statement = try cachedStatement(sql: sql)
 		try statement.bind(parameterValues: values)
 		if let block = block {
 			try statement.results(block)
@@ -106,7 +106,7 @@ extension Database {
 	///
 	/// - throws: Any error thrown in `block` or an error if `sql` couldn't be compiled, `parameters` couldn't be bound, or the statement couldn't be executed
 	public func execute(sql: String, parameters: [String: ParameterBindable?], _ block: ((_ row: Row) throws -> ())? = nil) throws {
-		let statement = try prepare(sql: sql)
+		let statement = try cachedStatement(sql: sql)
 		try statement.bind(parameters: parameters)
 		if let block = block {
 			try statement.results(block)
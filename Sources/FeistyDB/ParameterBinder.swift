@@ -0,0 +1,257 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// An empty C string used when binding zero-length borrowed text
+let emptyCString: StaticString = ""
+
+/// Binds values to a statement's SQL parameters using parameter indexes resolved once.
+///
+/// A binder is intended for statements executed many times.  Parameter names are resolved when the binder
+/// is created and values are bound using fixed-arity generic methods, avoiding the existential containers,
+/// arrays, and dictionaries used by `bind(parameterValues:)` and `bind(parameters:)`.
+///
+/// ```swift
+/// let statement = try db.prepare(sql: "insert into t1(a, b) values (:a, :b);")
+/// let binder = try statement.binder(names: [":a", ":b"])
+/// for (a, b) in pairs {
+///     try binder.bind(a, b)
+///     try statement.execute()
+///     try statement.reset()
+/// }
+/// ```
+public struct ParameterBinder {
+	/// The statement whose parameters are bound
+	public let statement: Statement
+	/// The SQL parameter index for each binder position
+	public let indexes: [Int32]
+
+	/// Creates a binder for the SQL parameters at `indexes`.
+	///
+	/// - parameter statement: The statement whose parameters are bound
+	/// - parameter indexes: The 1-based SQL parameter index for each binder position
+	init(statement: Statement, indexes: [Int32]) {
+		self.statement = statement
+		self.indexes = indexes
+	}
+
+	/// Binds `value` to the SQL parameter at binder position `position`.
+	///
+	/// - parameter value: The desired value of the SQL parameter
+	/// - parameter position: The 0-based binder position
+	///
+	/// - throws: An error if `value` couldn't be bound
+	@inline(__always) public func bind<T: ParameterBindable>(_ value: T?, at position: Int) throws {
+		let idx = indexes[position]
+		if let value = value {
+			try value.bind(to: statement.stmt, parameter: idx)
+		}
+		else {
+			guard sqlite3_bind_null(statement.stmt, idx) == SQLITE_OK else {
+				throw SQLiteError("Error binding null to parameter \(idx)", takingDescriptionFromStatement: statement.stmt)
+			}
+		}
+	}
+
+	/// Binds `a` to the first binder position.
+	///
+	/// - requires: `indexes.count >= 1`
+	///
+	/// - throws: An error if a value couldn't be bound
+	public func bind<A: ParameterBindable>(_ a: A?) throws {
+		try bind(a, at: 0)
+	}
+
+	/// Binds `a` and `b` to the first two binder positions.
+	///
+	/// - requires: `indexes.count >= 2`
+	///
+	/// - throws: An error if a value couldn't be bound
+	public func bind<A: ParameterBindable, B: ParameterBindable>(_ a: A?, _ b: B?) throws {
+		try bind(a, at: 0)
+		try bind(b, at: 1)
+	}
+
+	/// Binds `a`, `b`, and `c` to the first three binder positions.
+	///
+	/// - requires: `indexes.count >= 3`
+	///
+	/// - throws: An error if a value couldn't be bound
+	public func bind<A: ParameterBindable, B: ParameterBindable, C: ParameterBindable>(_ a: A?, _ b: B?, _ c: C?) throws {
+		try bind(a, at: 0)
+		try bind(b, at: 1)
+		try bind(c, at: 2)
+	}
+
+	/// Binds `a` through `d` to the first four binder positions.
+	///
+	/// - requires: `indexes.count >= 4`
+	///
+	/// - throws: An error if a value couldn't be bound
+	public func bind<A: ParameterBindable, B: ParameterBindable, C: ParameterBindable, D: ParameterBindable>(_ a: A?, _ b: B?, _ c: C?, _ d: D?) throws {
+		try bind(a, at: 0)
+		try bind(b, at: 1)
+		try bind(c, at: 2)
+		try bind(d, at: 3)
+	}
+
+	/// Binds `a` through `e` to the first five binder positions.
+	///
+	/// - requires: `indexes.count >= 5`
+	///
+	/// - throws: An error if a value couldn't be bound
+	public func bind<A: ParameterBindable, B: ParameterBindable, C: ParameterBindable, D: ParameterBindable, E: ParameterBindable>(_ a: A?, _ b: B?, _ c: C?, _ d: D?, _ e: E?) throws {
+		try bind(a, at: 0)
+		try bind(b, at: 1)
+		try bind(c, at: 2)
+		try bind(d, at: 3)
+		try bind(e, at: 4)
+	}
+
+	/// Binds `a` through `f` to the first six binder positions.
+	///
+	/// - requires: `indexes.count >= 6`
+	///
+	/// - throws: An error if a value couldn't be bound
+	public func bind<A: ParameterBindable, B: ParameterBindable, C: ParameterBindable, D: ParameterBindable, E: ParameterBindable, F: ParameterBindable>(_ a: A?, _ b: B?, _ c: C?, _ d: D?, _ e: E?, _ f: F?) throws {
+		try bind(a, at: 0)
+		try bind(b, at: 1)
+		try bind(c, at: 2)
+		try bind(d, at: 3)
+		try bind(e, at: 4)
+		try bind(f, at: 5)
+	}
+
+	/// Binds the UTF-8 bytes of `text` to the SQL parameter at binder position `position` without copying for the duration of `body`.
+	///
+	/// - seealso: `Statement.withBorrowedText(_:toParameter:_:)`
+	public func withBorrowedText<R>(_ text: String, at position: Int, _ body: () throws -> R) throws -> R {
+		return try statement.withBorrowedText(text, toParameter: Int(indexes[position]), body)
+	}
+
+	/// Binds the bytes of `data` to the SQL parameter at binder position `position` without copying for the duration of `body`.
+	///
+	/// - seealso: `Statement.withBorrowedBLOB(_:toParameter:_:)`
+	public func withBorrowedBLOB<R>(_ data: Data, at position: Int, _ body: () throws -> R) throws -> R {
+		return try statement.withBorrowedBLOB(data, toParameter: Int(indexes[position]), body)
+	}
+}
+
+extension Statement {
+	/// Returns a binder for the first *n* SQL parameters of `self`.
+	///
+	/// - parameter count: The number of SQL parameters, or `nil` for all parameters
+	///
+	/// - returns: A binder whose positions correspond to SQL parameters `1 ... count`
+	public func binder(count: Int? = nil) -> ParameterBinder {
+		let count = count ?? parameterCount
+		precondition(count <= parameterCount, "Statement has \(parameterCount) parameters")
+		return ParameterBinder(statement: self, indexes: (0 ..< count).map { Int32($0 + 1) })
+	}
+
+	/// Returns a binder for the SQL parameters named `names`.
+	///
+	/// - parameter names: The names of the SQL parameters, including the prefix character
+	///
+	/// - throws: An error if one of `names` isn't an SQL parameter of `self`
+	///
+	/// - returns: A binder whose positions correspond to the SQL parameters in `names`
+	public func binder(names: [String]) throws -> ParameterBinder {
+		let indexes = try names.map { name -> Int32 in
+			let idx = sqlite3_bind_parameter_index(stmt, name)
+			guard idx > 0 else {
+				throw DatabaseError("Unknown parameter \"\(name)\"")
+			}
+			return idx
+		}
+		return ParameterBinder(statement: self, indexes: indexes)
+	}
+
+	/// Binds the UTF-8 bytes of `text` to the SQL parameter at `index` without copying for the duration of `body`.
+	///
+	/// The parameter is bound using `SQLITE_STATIC`.  When `body` returns the statement is reset and the
+	/// parameter is bound to `NULL`, so the statement must be stepped within `body`.
+	///
+	/// - note: Parameter indexes are 1-based.  The leftmost parameter in a statement has index 1.
+	///
+	/// - parameter text: The desired value of the SQL parameter
+	/// - parameter index: The index of the SQL parameter to bind
+	/// - parameter body: A closure executing the statement
+	///
+	/// - throws: An error if `text` couldn't be bound or any error thrown by `body`
+	///
+	/// - returns: The value returned by `body`
+	public func withBorrowedText<R>(_ text: String, toParameter index: Int, _ body: () throws -> R) throws -> R {
+		let idx = Int32(index)
+		var text = text
+		return try text.withUTF8 { utf8 in
+			let bytes = utf8.baseAddress.map { UnsafeRawPointer($0) } ?? UnsafeRawPointer(emptyCString.utf8Start)
+			guard sqlite3_bind_text(stmt, idx, bytes.assumingMemoryBound(to: Int8.self), Int32(utf8.count), SQLITE_STATIC) == SQLITE_OK else {
+				throw SQLiteError("Error binding borrowed text to parameter \(idx)", takingDescriptionFromStatement: stmt)
+			}
+			return try withBorrowedParameter(idx, body)
+		}
+	}
+
+	/// Executes `body` then resets the statement and binds `NULL` to the borrowed parameter at `idx`.
+	///
+	/// - parameter idx: The index of the SQL parameter bound using `SQLITE_STATIC`
+	/// - parameter body: A closure executing the statement
+	///
+	/// - throws: Any error thrown by `body` or an error if the parameter couldn't be unbound
+	///
+	/// - returns: The value returned by `body`
+	func withBorrowedParameter<R>(_ idx: Int32, _ body: () throws -> R) throws -> R {
+		let result: R
+		do {
+			result = try body()
+		}
+		catch let error {
+			sqlite3_reset(stmt)
+			sqlite3_bind_null(stmt, idx)
+			throw error
+		}
+		// A parameter can't be rebound while the statement is running
+		sqlite3_reset(stmt)
+		guard sqlite3_bind_null(stmt, idx) == SQLITE_OK else {
+			throw SQLiteError("Error unbinding borrowed value from parameter \(idx)", takingDescriptionFromStatement: stmt)
+		}
+		return result
+	}
+
+	/// Binds the bytes of `data` to the SQL parameter at `index` without copying for the duration of `body`.
+	///
+	/// The parameter is bound using `SQLITE_STATIC`.  When `body` returns the statement is reset and the
+	/// parameter is bound to `NULL`, so the statement must be stepped within `body`.
+	///
+	/// - note: Parameter indexes are 1-based.  The leftmost parameter in a statement has index 1.
+	///
+	/// - parameter data: The desired value of the SQL parameter
+	/// - parameter index: The index of the SQL parameter to bind
+	/// - parameter body: A closure executing the statement
+	///
+	/// - throws: An error if `data` couldn't be bound or any error thrown by `body`
+	///
+	/// - returns: The value returned by `body`
+	public func withBorrowedBLOB<R>(_ data: Data, toParameter index: Int, _ body: () throws -> R) throws -> R {
+		let idx = Int32(index)
+		return try data.withUnsafeBytes { bytes in
+			let rc: Int32
+			if let baseAddress = bytes.baseAddress, bytes.count > 0 {
+				rc = sqlite3_bind_blob(stmt, idx, baseAddress, Int32(bytes.count), SQLITE_STATIC)
+			}
+			else {
+				rc = sqlite3_bind_zeroblob(stmt, idx, 0)
+			}
+			guard rc == SQLITE_OK else {
+				throw SQLiteError("Error binding borrowed BLOB to parameter \(idx)", takingDescriptionFromStatement: stmt)
+			}
+			return try withBorrowedParameter(idx, body)
+		}
+	}
+}
@@ -0,0 +1,570 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// Binds the properties of `Encodable` values to SQL parameters.
+///
+/// Each coding key is matched against the SQL parameter `:key`, `@key`, or `$key`.  The parameter indexes of a type's
+/// coding keys are resolved once per statement and values are bound using the `sqlite3_bind_*` functions.
+/// Keys without a matching parameter are ignored and `nil` values are bound as SQL `NULL`.
+///
+/// Values other than the standard library scalars, `Data`, `Date`, and `ParameterBindable` types,
+/// such as nested structures and arrays, are bound as JSON using `JSONEncoder`, as is done by `ParameterBindable`
+/// for `Encodable` types.  `RowDecoder` decodes such values from JSON.
+///
+/// Nested keyed and unkeyed containers are not supported.  Values written to a nested container are discarded
+/// and encoding throws an error once it completes.
+///
+/// ```swift
+/// struct Person: Encodable {
+///     let id: Int64
+///     let name: String
+///     let email: String?
+/// }
+///
+/// let encoder = ParameterEncoder()
+/// let statement = try db.prepare(sql: "insert into people(id, name, email) values (:id, :name, :email);")
+/// for person in people {
+///     try encoder.encode(person, to: statement)
+///     try statement.execute()
+///     try statement.reset()
+/// }
+/// ```
+public struct ParameterEncoder {
+	/// Contextual information made available to `Encodable` types
+	public var userInfo: [CodingUserInfoKey: Any] = [:]
+
+	/// Creates a parameter encoder.
+	public init() {
+	}
+
+	/// Binds the properties of `value` to the SQL parameters in `statement`.
+	///
+	/// - parameter value: The value to bind
+	/// - parameter statement: The statement to which the value should be bound
+	///
+	/// - throws: An error if the value could not be encoded or bound
+	public func encode<T: Encodable>(_ value: T, to statement: Statement) throws {
+		let key = ObjectIdentifier(T.self)
+		let plan: CodingPlan
+		if let existing = statement.encodingPlans[key] {
+			plan = existing
+		}
+		else {
+			plan = CodingPlan()
+			statement.encodingPlans[key] = plan
+		}
+
+		let encoder = ParameterEncoding(stmt: statement.stmt, plan: plan, userInfo: userInfo)
+		try value.encode(to: encoder)
+		if let error = encoder.nestedContainerError {
+			throw error
+		}
+		plan.isComplete = true
+	}
+}
+
+extension Statement {
+	/// Binds the properties of `value` to the SQL parameters of the same names using `ParameterEncoder`.
+	///
+	/// - parameter value: The value to bind
+	///
+	/// - throws: An error if the value could not be encoded or bound
+	public func bind<T: Encodable>(encoding value: T) throws {
+		try ParameterEncoder().encode(value, to: self)
+	}
+}
+
+/// The `Encoder` used by `ParameterEncoder`
+final class ParameterEncoding: Encoder {
+	/// The underlying `sqlite3_stmt *` object
+	let stmt: SQLitePreparedStatement
+	/// The coding key parameter indexes for the type being encoded
+	let plan: CodingPlan
+	/// The position of the next expected key in `plan`
+	var position = 0
+	/// The encoder that requested this encoder's nested container, or `nil` if this is the top-level encoder
+	let parent: ParameterEncoding?
+	/// The error thrown when encoding completes if a nested container was requested
+	var nestedContainerError: EncodingError?
+
+	let codingPath: [CodingKey]
+	let userInfo: [CodingUserInfoKey: Any]
+
+	init(stmt: SQLitePreparedStatement, plan: CodingPlan, userInfo: [CodingUserInfoKey: Any], codingPath: [CodingKey] = [], parent: ParameterEncoding? = nil) {
+		self.stmt = stmt
+		self.plan = plan
+		self.userInfo = userInfo
+		self.codingPath = codingPath
+		self.parent = parent
+	}
+
+	func container<Key: CodingKey>(keyedBy type: Key.Type) -> KeyedEncodingContainer<Key> {
+		return KeyedEncodingContainer(ParameterKeyedEncodingContainer<Key>(encoder: self))
+	}
+
+	func unkeyedContainer() -> UnkeyedEncodingContainer {
+		return ParameterUnkeyedEncodingContainer(encoder: self)
+	}
+
+	func singleValueContainer() -> SingleValueEncodingContainer {
+		return ParameterSingleValueEncodingContainer(encoder: self)
+	}
+
+	/// Returns the index of the SQL parameter for `key` or `0` if none
+	func parameterIndex(for key: CodingKey) -> Int32 {
+		let stmt = self.stmt
+		return plan.index(for: key, position: &position) { name in
+			for prefix in [":", "@", "$"] {
+				let idx = sqlite3_bind_parameter_index(stmt, prefix + name)
+				if idx > 0 {
+					return idx
+				}
+			}
+			return 0
+		}
+	}
+
+	/// Throws an error if `rc` is not `SQLITE_OK`
+	func check(_ rc: Int32, _ idx: Int32) throws {
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error binding value to parameter \(idx)", takingDescriptionFromStatement: stmt)
+		}
+	}
+
+	func bindNull(_ idx: Int32) throws {
+		guard parent == nil else {
+			return
+		}
+		try check(sqlite3_bind_null(stmt, idx), idx)
+	}
+
+	func bind(_ value: Int64, _ idx: Int32) throws {
+		guard parent == nil else {
+			return
+		}
+		try check(sqlite3_bind_int64(stmt, idx, value), idx)
+	}
+
+	func bind(_ value: Double, _ idx: Int32) throws {
+		guard parent == nil else {
+			return
+		}
+		try check(sqlite3_bind_double(stmt, idx, value), idx)
+	}
+
+	func bind(_ value: String, _ idx: Int32) throws {
+		guard parent == nil else {
+			return
+		}
+		try check(sqlite3_bind_text(stmt, idx, value, -1, SQLITE_TRANSIENT), idx)
+	}
+
+	/// Returns an encoder for a nested container of type `type` at `codingPath`, whose values are discarded
+	///
+	/// Nested containers are not supported, so the top-level encoder records an error that is thrown when encoding completes.
+	func nestedEncoder(for type: Any.Type, codingPath: [CodingKey]) -> ParameterEncoding {
+		var root = self
+		while let parent = root.parent {
+			root = parent
+		}
+		if root.nestedContainerError == nil {
+			root.nestedContainerError = EncodingError.invalidValue(type, EncodingError.Context(codingPath: codingPath, debugDescription: "Nested containers are not supported by ParameterEncoder"))
+		}
+		return ParameterEncoding(stmt: stmt, plan: CodingPlan(), userInfo: userInfo, codingPath: codingPath, parent: self)
+	}
+
+	func bind<T: Encodable>(value: T, _ idx: Int32) throws {
+		guard parent == nil else {
+			return
+		}
+		if let value = value as? Data {
+			try value.bind(to: stmt, parameter: idx)
+		}
+		else if let value = value as? Date {
+			try value.bind(to: stmt, parameter: idx)
+		}
+		else if let bindable = value as? ParameterBindable {
+			try bindable.bind(to: stmt, parameter: idx)
+		}
+		else {
+			// Other types are stored as JSON
+			let encoder = JSONEncoder()
+			encoder.userInfo = userInfo
+			let data = try encoder.encode(value)
+			try data.bind(to: stmt, parameter: idx)
+		}
+	}
+}
+
+/// A keyed container mapping coding keys to SQL parameters
+struct ParameterKeyedEncodingContainer<Key: CodingKey>: KeyedEncodingContainerProtocol {
+	let encoder: ParameterEncoding
+
+	var codingPath: [CodingKey] {
+		return encoder.codingPath
+	}
+
+	mutating func encodeNil(forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bindNull(idx)
+		}
+	}
+
+	mutating func encode(_ value: Bool, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(value ? 1 : 0), idx)
+		}
+	}
+
+	mutating func encode(_ value: String, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(value, idx)
+		}
+	}
+
+	mutating func encode(_ value: Double, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(value, idx)
+		}
+	}
+
+	mutating func encode(_ value: Float, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Double(value), idx)
+		}
+	}
+
+	mutating func encode(_ value: Int, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(value), idx)
+		}
+	}
+
+	mutating func encode(_ value: Int8, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(value), idx)
+		}
+	}
+
+	mutating func encode(_ value: Int16, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(value), idx)
+		}
+	}
+
+	mutating func encode(_ value: Int32, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(value), idx)
+		}
+	}
+
+	mutating func encode(_ value: Int64, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(value, idx)
+		}
+	}
+
+	mutating func encode(_ value: UInt, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(bitPattern: UInt64(value)), idx)
+		}
+	}
+
+	mutating func encode(_ value: UInt8, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(value), idx)
+		}
+	}
+
+	mutating func encode(_ value: UInt16, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(value), idx)
+		}
+	}
+
+	mutating func encode(_ value: UInt32, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(value), idx)
+		}
+	}
+
+	mutating func encode(_ value: UInt64, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(Int64(bitPattern: value), idx)
+		}
+	}
+
+	mutating func encode<T: Encodable>(_ value: T, forKey key: Key) throws {
+		let idx = encoder.parameterIndex(for: key)
+		if idx > 0 {
+			try encoder.bind(value: value, idx)
+		}
+	}
+
+	// The default implementations of encodeIfPresent() skip nil values, which would leave any previous binding in place
+
+	mutating func encodeIfPresent(_ value: Bool?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: String?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: Double?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: Float?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: Int?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: Int8?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: Int16?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: Int32?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: Int64?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: UInt?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: UInt8?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: UInt16?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: UInt32?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent(_ value: UInt64?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func encodeIfPresent<T: Encodable>(_ value: T?, forKey key: Key) throws {
+		if let value = value { try encode(value, forKey: key) } else { try encodeNil(forKey: key) }
+	}
+
+	mutating func nestedContainer<NestedKey: CodingKey>(keyedBy keyType: NestedKey.Type, forKey key: Key) -> KeyedEncodingContainer<NestedKey> {
+		return encoder.nestedEncoder(for: keyType, codingPath: codingPath + [key]).container(keyedBy: keyType)
+	}
+
+	mutating func nestedUnkeyedContainer(forKey key: Key) -> UnkeyedEncodingContainer {
+		return encoder.nestedEncoder(for: UnkeyedEncodingContainer.self, codingPath: codingPath + [key]).unkeyedContainer()
+	}
+
+	mutating func superEncoder() -> Encoder {
+		return encoder
+	}
+
+	mutating func superEncoder(forKey key: Key) -> Encoder {
+		return encoder
+	}
+}
+
+/// An unkeyed container binding successive positional SQL parameters
+struct ParameterUnkeyedEncodingContainer: UnkeyedEncodingContainer {
+	let encoder: ParameterEncoding
+
+	var codingPath: [CodingKey] {
+		return encoder.codingPath
+	}
+
+	private(set) var count = 0
+
+	/// Returns the index of the next SQL parameter and increments `count`
+	mutating func nextParameter() -> Int32 {
+		count += 1
+		return Int32(count)
+	}
+
+	mutating func encodeNil() throws {
+		try encoder.bindNull(nextParameter())
+	}
+
+	mutating func encode(_ value: Bool) throws {
+		try encoder.bind(Int64(value ? 1 : 0), nextParameter())
+	}
+
+	mutating func encode(_ value: String) throws {
+		try encoder.bind(value, nextParameter())
+	}
+
+	mutating func encode(_ value: Double) throws {
+		try encoder.bind(value, nextParameter())
+	}
+
+	mutating func encode(_ value: Float) throws {
+		try encoder.bind(Double(value), nextParameter())
+	}
+
+	mutating func encode(_ value: Int) throws {
+		try encoder.bind(Int64(value), nextParameter())
+	}
+
+	mutating func encode(_ value: Int8) throws {
+		try encoder.bind(Int64(value), nextParameter())
+	}
+
+	mutating func encode(_ value: Int16) throws {
+		try encoder.bind(Int64(value), nextParameter())
+	}
+
+	mutating func encode(_ value: Int32) throws {
+		try encoder.bind(Int64(value), nextParameter())
+	}
+
+	mutating func encode(_ value: Int64) throws {
+		try encoder.bind(value, nextParameter())
+	}
+
+	mutating func encode(_ value: UInt) throws {
+		try encoder.bind(Int64(bitPattern: UInt64(value)), nextParameter())
+	}
+
+	mutating func encode(_ value: UInt8) throws {
+		try encoder.bind(Int64(value), nextParameter())
+	}
+
+	mutating func encode(_ value: UInt16) throws {
+		try encoder.bind(Int64(value), nextParameter())
+	}
+
+	mutating func encode(_ value: UInt32) throws {
+		try encoder.bind(Int64(value), nextParameter())
+	}
+
+	mutating func encode(_ value: UInt64) throws {
+		try encoder.bind(Int64(bitPattern: value), nextParameter())
+	}
+
+	mutating func encode<T: Encodable>(_ value: T) throws {
+		try encoder.bind(value: value, nextParameter())
+	}
+
+	mutating func nestedContainer<NestedKey: CodingKey>(keyedBy keyType: NestedKey.Type) -> KeyedEncodingContainer<NestedKey> {
+		_ = nextParameter()
+		return encoder.nestedEncoder(for: keyType, codingPath: codingPath).container(keyedBy: keyType)
+	}
+
+	mutating func nestedUnkeyedContainer() -> UnkeyedEncodingContainer {
+		_ = nextParameter()
+		return encoder.nestedEncoder(for: UnkeyedEncodingContainer.self, codingPath: codingPath).unkeyedContainer()
+	}
+
+	mutating func superEncoder() -> Encoder {
+		return encoder
+	}
+}
+
+/// A single value container binding the first SQL parameter
+struct ParameterSingleValueEncodingContainer: SingleValueEncodingContainer {
+	let encoder: ParameterEncoding
+
+	var codingPath: [CodingKey] {
+		return encoder.codingPath
+	}
+
+	mutating func encodeNil() throws {
+		try encoder.bindNull(1)
+	}
+
+	mutating func encode(_ value: Bool) throws {
+		try encoder.bind(Int64(value ? 1 : 0), 1)
+	}
+
+	mutating func encode(_ value: String) throws {
+		try encoder.bind(value, 1)
+	}
+
+	mutating func encode(_ value: Double) throws {
+		try encoder.bind(value, 1)
+	}
+
+	mutating func encode(_ value: Float) throws {
+		try encoder.bind(Double(value), 1)
+	}
+
+	mutating func encode(_ value: Int) throws {
+		try encoder.bind(Int64(value), 1)
+	}
+
+	mutating func encode(_ value: Int8) throws {
+		try encoder.bind(Int64(value), 1)
+	}
+
+	mutating func encode(_ value: Int16) throws {
+		try encoder.bind(Int64(value), 1)
+	}
+
+	mutating func encode(_ value: Int32) throws {
+		try encoder.bind(Int64(value), 1)
+	}
+
+	mutating func encode(_ value: Int64) throws {
+		try encoder.bind(value, 1)
+	}
+
+	mutating func encode(_ value: UInt) throws {
+		try encoder.bind(Int64(bitPattern: UInt64(value)), 1)
+	}
+
+	mutating func encode(_ value: UInt8) throws {
+		try encoder.bind(Int64(value), 1)
+	}
+
+	mutating func encode(_ value: UInt16) throws {
+		try encoder.bind(Int64(value), 1)
+	}
+
+	mutating func encode(_ value: UInt32) throws {
+		try encoder.bind(Int64(value), 1)
+	}
+
+	mutating func encode(_ value: UInt64) throws {
+		try encoder.bind(Int64(bitPattern: value), 1)
+	}
+
+	mutating func encode<T: Encodable>(_ value: T) throws {
+		try encoder.bind(value: value, 1)
+	}
+}
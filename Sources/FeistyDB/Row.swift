@@ -89,3 +89,134 @@ public struct Row {
 		return try statement.index(ofColumn: name)
 	}
 }
+
+extension Row {
+	/// Returns `true` if the value of the column at `index` is SQL `NULL`.
+	///
+	/// - note: Column indexes are 0-based.  The leftmost column in a row has index 0.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.columnCount`
+	///
+	/// - parameter index: The index of the desired column
+	///
+	/// - throws: An error if `index` is out of bounds
+	///
+	/// - returns: `true` if the column's value is `NULL`, `false` otherwise
+	public func isNull(at index: Int) throws -> Bool {
+		guard index >= 0, index < self.columnCount else {
+			throw DatabaseError("Column index \(index) out of bounds")
+		}
+		return sqlite3_column_type(statement.stmt, Int32(index)) == SQLITE_NULL
+	}
+
+	/// Returns the value of the column at `index` as a 64-bit signed integer without creating a `DatabaseValue`.
+	///
+	/// The column's value is converted to an integer using SQLite's type conversion rules.  `NULL` is converted to `0`.
+	///
+	/// - note: Column indexes are 0-based.  The leftmost column in a row has index 0.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.columnCount`
+	///
+	/// - parameter index: The index of the desired column
+	///
+	/// - throws: An error if `index` is out of bounds
+	///
+	/// - returns: The column's value as an integer
+	///
+	/// - seealso: [Result Values From A Query](https://www.sqlite.org/c3ref/column_blob.html)
+	public func int64(at index: Int) throws -> Int64 {
+		guard index >= 0, index < self.columnCount else {
+			throw DatabaseError("Column index \(index) out of bounds")
+		}
+		return sqlite3_column_int64(statement.stmt, Int32(index))
+	}
+
+	/// Returns the value of the column at `index` as a double-precision floating-point number without creating a `DatabaseValue`.
+	///
+	/// The column's value is converted to a floating-point number using SQLite's type conversion rules.  `NULL` is converted to `0.0`.
+	///
+	/// - note: Column indexes are 0-based.  The leftmost column in a row has index 0.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.columnCount`
+	///
+	/// - parameter index: The index of the desired column
+	///
+	/// - throws: An error if `index` is out of bounds
+	///
+	/// - returns: The column's value as a floating-point number
+	///
+	/// - seealso: [Result Values From A Query](https://www.sqlite.org/c3ref/column_blob.html)
+	public func double(at index: Int) throws -> Double {
+		guard index >= 0, index < self.columnCount else {
+			throw DatabaseError("Column index \(index) out of bounds")
+		}
+		return sqlite3_column_double(statement.stmt, Int32(index))
+	}
+
+	/// Invokes `body` with the UTF-8 bytes of the text value of the column at `index`.
+	///
+	/// The bytes are owned by SQLite and are not copied.  The buffer does not include a terminating `NUL`.
+	/// A `NULL` column value is passed to `body` as an empty buffer.
+	///
+	/// - important: The buffer passed to `body` must not be used outside of `body`.
+	///
+	/// - note: Column indexes are 0-based.  The leftmost column in a row has index 0.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.columnCount`
+	///
+	/// - parameter index: The index of the desired column
+	/// - parameter body: A closure accessing the column's UTF-8 bytes
+	/// - parameter bytes: The column's UTF-8 bytes
+	///
+	/// - throws: Any error thrown in `body` or an error if `index` is out of bounds
+	///
+	/// - returns: The value returned by `body`
+	///
+	/// - seealso: [Result Values From A Query](https://www.sqlite.org/c3ref/column_blob.html)
+	public func withUnsafeText<T>(at index: Int, _ body: (_ bytes: UnsafeRawBufferPointer) throws -> T) throws -> T {
+		guard index >= 0, index < self.columnCount else {
+			throw DatabaseError("Column index \(index) out of bounds")
+		}
+		let idx = Int32(index)
+		// sqlite3_column_text() must be called before sqlite3_column_bytes() to obtain the length of the UTF-8 conversion
+		let text = sqlite3_column_text(statement.stmt, idx)
+		let byteCount = Int(sqlite3_column_bytes(statement.stmt, idx))
+		return try body(UnsafeRawBufferPointer(start: text, count: text != nil ? byteCount : 0))
+	}
+
+	/// Invokes `body` with the bytes of the BLOB value of the column at `index`.
+	///
+	/// The bytes are owned by SQLite and are not copied.
+	/// A `NULL` or zero-length column value is passed to `body` as an empty buffer.
+	///
+	/// - important: The buffer passed to `body` must not be used outside of `body`.
+	///
+	/// - note: Column indexes are 0-based.  The leftmost column in a row has index 0.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.columnCount`
+	///
+	/// - parameter index: The index of the desired column
+	/// - parameter body: A closure accessing the column's bytes
+	/// - parameter bytes: The column's bytes
+	///
+	/// - throws: Any error thrown in `body` or an error if `index` is out of bounds
+	///
+	/// - returns: The value returned by `body`
+	///
+	/// - seealso: [Result Values From A Query](https://www.sqlite.org/c3ref/column_blob.html)
+	public func withUnsafeBLOB<T>(at index: Int, _ body: (_ bytes: UnsafeRawBufferPointer) throws -> T) throws -> T {
+		guard index >= 0, index < self.columnCount else {
+			throw DatabaseError("Column index \(index) out of bounds")
+		}
+		let idx = Int32(index)
+		// sqlite3_column_blob() must be called before sqlite3_column_bytes()
+		let blob = sqlite3_column_blob(statement.stmt, idx)
+		let byteCount = Int(sqlite3_column_bytes(statement.stmt, idx))
+		return try body(UnsafeRawBufferPointer(start: blob, count: blob != nil ? byteCount : 0))
+	}
+}
@@ -0,0 +1,555 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// The column or parameter index of each coding key used by a `Codable` type, cached per statement.
+///
+/// A synthesized `Codable` implementation accesses its keys in the same order for every value. The first
+/// value records the key order and subsequent values match keys against the recorded order by position, so no
+/// dictionary lookup is required.  Keys accessed out of order are resolved directly.
+final class CodingPlan {
+	/// The coding keys in the order in which they were first accessed and their indexes
+	var entries = [(name: String, index: Int32)]()
+
+	/// `true` once the first value has been fully coded
+	var isComplete = false
+
+	/// Returns the index for `key`.
+	///
+	/// - parameter key: The coding key
+	/// - parameter position: The position of the next expected key in `entries`
+	/// - parameter resolve: A closure returning the index for a key name or a negative value if none
+	func index(for key: CodingKey, position: inout Int, _ resolve: (String) -> Int32) -> Int32 {
+		let name = key.stringValue
+
+		// Keys are commonly accessed several times in succession, such as by decodeIfPresent()
+		if position > 0 && entries[position - 1].name == name {
+			return entries[position - 1].index
+		}
+
+		if position < entries.count {
+			guard entries[position].name == name else {
+				return resolve(name)
+			}
+			position += 1
+			return entries[position - 1].index
+		}
+
+		let index = resolve(name)
+		if !isComplete {
+			entries.append((name, index))
+			position += 1
+		}
+		return index
+	}
+}
+
+/// Decodes `Decodable` values directly from result rows.
+///
+/// Each coding key is matched against the column of the same name.  The column indexes of a type's coding keys
+/// are resolved once per statement and values are read using the `sqlite3_column_*` functions without creating
+/// intermediate `DatabaseValue` instances.
+///
+/// Values other than the standard library scalars, `Data`, `Date`, `UUID`, `URL`, and `ColumnConvertible`
+/// types, such as nested structures and arrays, are decoded from JSON using `JSONDecoder`, as is done by
+/// `ColumnConvertible` for `Decodable` types.  `ParameterEncoder` binds such values as JSON.
+///
+/// Nested keyed and unkeyed containers are not supported and throw an error.
+///
+/// ```swift
+/// struct Person: Decodable {
+///     let id: Int64
+///     let name: String
+///     let email: String?
+/// }
+///
+/// let decoder = RowDecoder()
+/// let statement = try db.prepare(sql: "select id, name, email from people;")
+/// try statement.results { row in
+///     let person = try decoder.decode(Person.self, from: row)
+/// }
+/// ```
+public struct RowDecoder {
+	/// Contextual information made available to `Decodable` types
+	public var userInfo: [CodingUserInfoKey: Any] = [:]
+
+	/// Creates a row decoder.
+	public init() {
+	}
+
+	/// Decodes a value of type `type` from `row`.
+	///
+	/// - parameter type: The type of the value to decode
+	/// - parameter row: The row containing the value
+	///
+	/// - throws: An error if the value could not be decoded
+	///
+	/// - returns: The decoded value
+	public func decode<T: Decodable>(_ type: T.Type, from row: Row) throws -> T {
+		let statement = row.statement
+		let key = ObjectIdentifier(type)
+		let plan: CodingPlan
+		if let existing = statement.decodingPlans[key] {
+			plan = existing
+		}
+		else {
+			plan = CodingPlan()
+			statement.decodingPlans[key] = plan
+		}
+
+		let decoder = RowDecoding(statement: statement, plan: plan, columnCount: Int32(row.columnCount), userInfo: userInfo)
+		let value = try T(from: decoder)
+		plan.isComplete = true
+		return value
+	}
+}
+
+extension Row {
+	/// Decodes a value of type `type` from the row using `RowDecoder`.
+	///
+	/// - parameter type: The type of the value to decode
+	///
+	/// - throws: An error if the value could not be decoded
+	///
+	/// - returns: The decoded value
+	public func decode<T: Decodable>(_ type: T.Type = T.self) throws -> T {
+		return try RowDecoder().decode(type, from: self)
+	}
+}
+
+extension Statement {
+	/// Executes the statement and decodes each result row as a value of type `type`.
+	///
+	/// - parameter type: The type of the values to decode
+	/// - parameter decoder: The decoder to use
+	///
+	/// - throws: An error if the statement did not successfully run to completion or a value could not be decoded
+	///
+	/// - returns: The decoded values
+	public func decode<T: Decodable>(_ type: T.Type = T.self, using decoder: RowDecoder = RowDecoder()) throws -> [T] {
+		var values = [T]()
+		try results { row in
+			values.append(try decoder.decode(type, from: row))
+		}
+		return values
+	}
+}
+
+/// The `Decoder` used by `RowDecoder`
+final class RowDecoding: Decoder {
+	/// The statement whose current row is being decoded
+	let statement: Statement
+	/// The underlying `sqlite3_stmt *` object
+	let stmt: SQLitePreparedStatement
+	/// The coding key column indexes for the type being decoded
+	let plan: CodingPlan
+	/// The position of the next expected key in `plan`
+	var position = 0
+	/// The number of columns in the row
+	let columnCount: Int32
+
+	let codingPath: [CodingKey] = []
+	let userInfo: [CodingUserInfoKey: Any]
+
+	init(statement: Statement, plan: CodingPlan, columnCount: Int32, userInfo: [CodingUserInfoKey: Any]) {
+		self.statement = statement
+		self.stmt = statement.stmt
+		self.plan = plan
+		self.columnCount = columnCount
+		self.userInfo = userInfo
+	}
+
+	func container<Key: CodingKey>(keyedBy type: Key.Type) throws -> KeyedDecodingContainer<Key> {
+		return KeyedDecodingContainer(RowKeyedDecodingContainer<Key>(decoder: self))
+	}
+
+	func unkeyedContainer() throws -> UnkeyedDecodingContainer {
+		return RowUnkeyedDecodingContainer(decoder: self)
+	}
+
+	func singleValueContainer() throws -> SingleValueDecodingContainer {
+		return RowSingleValueDecodingContainer(decoder: self)
+	}
+
+	/// Returns the index of the column for `key` or a negative value if none
+	func columnIndex(for key: CodingKey) -> Int32 {
+		let statement = self.statement
+		return plan.index(for: key, position: &position) { name in
+			return statement.columnNamesAndIndexes[name].map({ Int32($0) }) ?? -1
+		}
+	}
+
+	/// Returns `true` if the column at `idx` is `NULL`
+	func isNull(_ idx: Int32) -> Bool {
+		return sqlite3_column_type(stmt, idx) == SQLITE_NULL
+	}
+
+	/// Returns the coding path for an error decoding the value for `key`
+	///
+	/// The path is built only when an error is thrown to avoid an array allocation for each decoded value.
+	func errorCodingPath(_ key: CodingKey?) -> [CodingKey] {
+		guard let key = key else {
+			return codingPath
+		}
+		return codingPath + [key]
+	}
+
+	/// Throws an error if the column at `idx` is `NULL`
+	func checkNotNull<T>(_ idx: Int32, _ type: T.Type, _ key: CodingKey?) throws {
+		if sqlite3_column_type(stmt, idx) == SQLITE_NULL {
+			throw DecodingError.valueNotFound(type, DecodingError.Context(codingPath: errorCodingPath(key), debugDescription: "Database null encountered at column \(idx)"))
+		}
+	}
+
+	/// Decodes the integer in the column at `idx` as `T`
+	func decodeInteger<T: BinaryInteger>(_ type: T.Type, at idx: Int32, _ key: CodingKey?) throws -> T {
+		try checkNotNull(idx, type, key)
+		let value = sqlite3_column_int64(stmt, idx)
+		guard let result = T(exactly: value) else {
+			throw DecodingError.dataCorrupted(DecodingError.Context(codingPath: errorCodingPath(key), debugDescription: "Value \(value) at column \(idx) does not fit in \(T.self)"))
+		}
+		return result
+	}
+
+	func decodeBool(at idx: Int32, _ key: CodingKey?) throws -> Bool {
+		try checkNotNull(idx, Bool.self, key)
+		return sqlite3_column_int64(stmt, idx) != 0
+	}
+
+	func decodeString(at idx: Int32, _ key: CodingKey?) throws -> String {
+		try checkNotNull(idx, String.self, key)
+		// sqlite3_column_text() must be called before sqlite3_column_bytes() to obtain the length of the UTF-8 conversion
+		let text = sqlite3_column_text(stmt, idx)
+		let byteCount = Int(sqlite3_column_bytes(stmt, idx))
+		return String(decoding: UnsafeRawBufferPointer(start: text, count: text != nil ? byteCount : 0), as: UTF8.self)
+	}
+
+	func decodeDouble(at idx: Int32, _ key: CodingKey?) throws -> Double {
+		try checkNotNull(idx, Double.self, key)
+		return sqlite3_column_double(stmt, idx)
+	}
+
+	func decodeUInt64(at idx: Int32, _ key: CodingKey?) throws -> UInt64 {
+		try checkNotNull(idx, UInt64.self, key)
+		return UInt64(bitPattern: sqlite3_column_int64(stmt, idx))
+	}
+
+	/// Decodes the value in the column at `idx` as `T`
+	func decodeValue<T: Decodable>(_ type: T.Type, at idx: Int32, _ key: CodingKey?) throws -> T {
+		try checkNotNull(idx, type, key)
+
+		if T.self == Data.self {
+			return Data(stmt, column: idx) as! T
+		}
+		else if T.self == Date.self {
+			return Date(stmt, column: idx) as! T
+		}
+		else if let convertible = T.self as? ColumnConvertible.Type {
+			return try convertible.init(stmt, column: idx) as! T
+		}
+
+		// Other types are stored as JSON
+		let blob = sqlite3_column_blob(stmt, idx)
+		let byteCount = Int(sqlite3_column_bytes(stmt, idx))
+		let data = blob.map({ Data(bytes: $0, count: byteCount) }) ?? Data()
+		let decoder = JSONDecoder()
+		decoder.userInfo = userInfo
+		return try decoder.decode(type, from: data)
+	}
+}
+
+/// A keyed container mapping coding keys to columns
+struct RowKeyedDecodingContainer<Key: CodingKey>: KeyedDecodingContainerProtocol {
+	let decoder: RowDecoding
+
+	var codingPath: [CodingKey] {
+		return decoder.codingPath
+	}
+
+	var allKeys: [Key] {
+		return decoder.statement.columnNamesAndIndexes.keys.compactMap { Key(stringValue: $0) }
+	}
+
+	/// Returns the index of the column for `key`
+	func columnIndex(for key: Key) throws -> Int32 {
+		let idx = decoder.columnIndex(for: key)
+		guard idx >= 0, idx < decoder.columnCount else {
+			throw DecodingError.keyNotFound(key, DecodingError.Context(codingPath: codingPath, debugDescription: "No column named \"\(key.stringValue)\""))
+		}
+		return idx
+	}
+
+	func contains(_ key: Key) -> Bool {
+		let idx = decoder.columnIndex(for: key)
+		return idx >= 0 && idx < decoder.columnCount
+	}
+
+	func decodeNil(forKey key: Key) throws -> Bool {
+		return decoder.isNull(try columnIndex(for: key))
+	}
+
+	func decode(_ type: Bool.Type, forKey key: Key) throws -> Bool {
+		return try decoder.decodeBool(at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: String.Type, forKey key: Key) throws -> String {
+		return try decoder.decodeString(at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: Double.Type, forKey key: Key) throws -> Double {
+		return try decoder.decodeDouble(at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: Float.Type, forKey key: Key) throws -> Float {
+		return Float(try decoder.decodeDouble(at: columnIndex(for: key), key))
+	}
+
+	func decode(_ type: Int.Type, forKey key: Key) throws -> Int {
+		return try decoder.decodeInteger(type, at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: Int8.Type, forKey key: Key) throws -> Int8 {
+		return try decoder.decodeInteger(type, at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: Int16.Type, forKey key: Key) throws -> Int16 {
+		return try decoder.decodeInteger(type, at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: Int32.Type, forKey key: Key) throws -> Int32 {
+		return try decoder.decodeInteger(type, at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: Int64.Type, forKey key: Key) throws -> Int64 {
+		return try decoder.decodeInteger(type, at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: UInt.Type, forKey key: Key) throws -> UInt {
+		return UInt(try decoder.decodeUInt64(at: columnIndex(for: key), key))
+	}
+
+	func decode(_ type: UInt8.Type, forKey key: Key) throws -> UInt8 {
+		return try decoder.decodeInteger(type, at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: UInt16.Type, forKey key: Key) throws -> UInt16 {
+		return try decoder.decodeInteger(type, at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: UInt32.Type, forKey key: Key) throws -> UInt32 {
+		return try decoder.decodeInteger(type, at: columnIndex(for: key), key)
+	}
+
+	func decode(_ type: UInt64.Type, forKey key: Key) throws -> UInt64 {
+		return try decoder.decodeUInt64(at: columnIndex(for: key), key)
+	}
+
+	func decode<T: Decodable>(_ type: T.Type, forKey key: Key) throws -> T {
+		return try decoder.decodeValue(type, at: columnIndex(for: key), key)
+	}
+
+	func nestedContainer<NestedKey: CodingKey>(keyedBy type: NestedKey.Type, forKey key: Key) throws -> KeyedDecodingContainer<NestedKey> {
+		throw DecodingError.typeMismatch(type, DecodingError.Context(codingPath: codingPath + [key], debugDescription: "Nested containers are not supported by RowDecoder"))
+	}
+
+	func nestedUnkeyedContainer(forKey key: Key) throws -> UnkeyedDecodingContainer {
+		throw DecodingError.typeMismatch(UnkeyedDecodingContainer.self, DecodingError.Context(codingPath: codingPath + [key], debugDescription: "Nested containers are not supported by RowDecoder"))
+	}
+
+	func superDecoder() throws -> Decoder {
+		return decoder
+	}
+
+	func superDecoder(forKey key: Key) throws -> Decoder {
+		return decoder
+	}
+}
+
+/// An unkeyed container decoding successive columns
+struct RowUnkeyedDecodingContainer: UnkeyedDecodingContainer {
+	let decoder: RowDecoding
+
+	var codingPath: [CodingKey] {
+		return decoder.codingPath
+	}
+
+	var count: Int? {
+		return Int(decoder.columnCount)
+	}
+
+	var isAtEnd: Bool {
+		return currentIndex >= Int(decoder.columnCount)
+	}
+
+	private(set) var currentIndex = 0
+
+	/// Returns the index of the next column and advances `currentIndex`
+	mutating func nextColumn<T>(_ type: T.Type) throws -> Int32 {
+		guard !isAtEnd else {
+			throw DecodingError.valueNotFound(type, DecodingError.Context(codingPath: codingPath, debugDescription: "No columns remain"))
+		}
+		currentIndex += 1
+		return Int32(currentIndex - 1)
+	}
+
+	mutating func decodeNil() throws -> Bool {
+		guard !isAtEnd else {
+			throw DecodingError.valueNotFound(Any?.self, DecodingError.Context(codingPath: codingPath, debugDescription: "No columns remain"))
+		}
+		if decoder.isNull(Int32(currentIndex)) {
+			currentIndex += 1
+			return true
+		}
+		return false
+	}
+
+	mutating func decode(_ type: Bool.Type) throws -> Bool {
+		return try decoder.decodeBool(at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: String.Type) throws -> String {
+		return try decoder.decodeString(at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: Double.Type) throws -> Double {
+		return try decoder.decodeDouble(at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: Float.Type) throws -> Float {
+		return Float(try decoder.decodeDouble(at: nextColumn(type), nil))
+	}
+
+	mutating func decode(_ type: Int.Type) throws -> Int {
+		return try decoder.decodeInteger(type, at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: Int8.Type) throws -> Int8 {
+		return try decoder.decodeInteger(type, at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: Int16.Type) throws -> Int16 {
+		return try decoder.decodeInteger(type, at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: Int32.Type) throws -> Int32 {
+		return try decoder.decodeInteger(type, at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: Int64.Type) throws -> Int64 {
+		return try decoder.decodeInteger(type, at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: UInt.Type) throws -> UInt {
+		return UInt(try decoder.decodeUInt64(at: nextColumn(type), nil))
+	}
+
+	mutating func decode(_ type: UInt8.Type) throws -> UInt8 {
+		return try decoder.decodeInteger(type, at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: UInt16.Type) throws -> UInt16 {
+		return try decoder.decodeInteger(type, at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: UInt32.Type) throws -> UInt32 {
+		return try decoder.decodeInteger(type, at: nextColumn(type), nil)
+	}
+
+	mutating func decode(_ type: UInt64.Type) throws -> UInt64 {
+		return try decoder.decodeUInt64(at: nextColumn(type), nil)
+	}
+
+	mutating func decode<T: Decodable>(_ type: T.Type) throws -> T {
+		return try decoder.decodeValue(type, at: nextColumn(type), nil)
+	}
+
+	mutating func nestedContainer<NestedKey: CodingKey>(keyedBy type: NestedKey.Type) throws -> KeyedDecodingContainer<NestedKey> {
+		throw DecodingError.typeMismatch(type, DecodingError.Context(codingPath: codingPath, debugDescription: "Nested containers are not supported by RowDecoder"))
+	}
+
+	mutating func nestedUnkeyedContainer() throws -> UnkeyedDecodingContainer {
+		throw DecodingError.typeMismatch(UnkeyedDecodingContainer.self, DecodingError.Context(codingPath: codingPath, debugDescription: "Nested containers are not supported by RowDecoder"))
+	}
+
+	mutating func superDecoder() throws -> Decoder {
+		return decoder
+	}
+}
+
+/// A single value container decoding the leftmost column
+struct RowSingleValueDecodingContainer: SingleValueDecodingContainer {
+	let decoder: RowDecoding
+
+	var codingPath: [CodingKey] {
+		return decoder.codingPath
+	}
+
+	func decodeNil() -> Bool {
+		return decoder.columnCount == 0 || decoder.isNull(0)
+	}
+
+	func decode(_ type: Bool.Type) throws -> Bool {
+		return try decoder.decodeBool(at: 0, nil)
+	}
+
+	func decode(_ type: String.Type) throws -> String {
+		return try decoder.decodeString(at: 0, nil)
+	}
+
+	func decode(_ type: Double.Type) throws -> Double {
+		return try decoder.decodeDouble(at: 0, nil)
+	}
+
+	func decode(_ type: Float.Type) throws -> Float {
+		return Float(try decoder.decodeDouble(at: 0, nil))
+	}
+
+	func decode(_ type: Int.Type) throws -> Int {
+		return try decoder.decodeInteger(type, at: 0, nil)
+	}
+
+	func decode(_ type: Int8.Type) throws -> Int8 {
+		return try decoder.decodeInteger(type, at: 0, nil)
+	}
+
+	func decode(_ type: Int16.Type) throws -> Int16 {
+		return try decoder.decodeInteger(type, at: 0, nil)
+	}
+
+	func decode(_ type: Int32.Type) throws -> Int32 {
+		return try decoder.decodeInteger(type, at: 0, nil)
+	}
+
+	func decode(_ type: Int64.Type) throws -> Int64 {
+		return try decoder.decodeInteger(type, at: 0, nil)
+	}
+
+	func decode(_ type: UInt.Type) throws -> UInt {
+		return UInt(try decoder.decodeUInt64(at: 0, nil))
+	}
+
+	func decode(_ type: UInt8.Type) throws -> UInt8 {
+		return try decoder.decodeInteger(type, at: 0, nil)
+	}
+
+	func decode(_ type: UInt16.Type) throws -> UInt16 {
+		return try decoder.decodeInteger(type, at: 0, nil)
+	}
+
+	func decode(_ type: UInt32.Type) throws -> UInt32 {
+		return try decoder.decodeInteger(type, at: 0, nil)
+	}
+
+	func decode(_ type: UInt64.Type) throws -> UInt64 {
+		return try decoder.decodeUInt64(at: 0, nil)
+	}
+
+	func decode<T: Decodable>(_ type: T.Type) throws -> T {
+		return try decoder.decodeValue(type, at: 0, nil)
+	}
+}
@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// A borrowed view of the argument values passed by SQLite to a callback.
+///
+/// Values are read directly from the underlying `sqlite3_value *` objects without allocating a `DatabaseValue`
+/// unless an element is accessed through the `Collection` interface.
+///
+/// - important: Arguments are only valid for the duration of the callback to which they are passed
+/// and must not be stored or used outside of it.
+///
+/// - note: Argument indexes are 0-based.
+///
+/// - seealso: [Obtaining SQL Values](https://sqlite.org/c3ref/value_blob.html)
+public struct SQLArguments {
+	/// The underlying `sqlite3_value *` objects
+	let values: UnsafeBufferPointer<SQLiteValue?>
+
+	/// Creates a view of `argc` values in `argv`.
+	///
+	/// - parameter argc: The number of values in `argv`
+	/// - parameter argv: An array of `sqlite3_value *` objects
+	init(argc: Int32, argv: UnsafeMutablePointer<SQLiteValue?>?) {
+		self.values = UnsafeBufferPointer(start: argv, count: Int(argc))
+	}
+
+	/// Returns the underlying `sqlite3_value *` object at `index`.
+	func value(at index: Int) -> SQLiteValue {
+		precondition(index >= 0 && index < values.count, "Argument index out of bounds")
+		return values[index].unsafelyUnwrapped
+	}
+
+	/// Returns `true` if the argument at `index` is `NULL`.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.count`
+	///
+	/// - parameter index: The index of the desired argument
+	public func isNull(at index: Int) -> Bool {
+		return sqlite3_value_type(value(at: index)) == SQLITE_NULL
+	}
+
+	/// Returns the argument at `index` converted to a 64-bit integer.
+	///
+	/// `NULL` is converted to `0`.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.count`
+	///
+	/// - parameter index: The index of the desired argument
+	public func int64(at index: Int) -> Int64 {
+		return sqlite3_value_int64(value(at: index))
+	}
+
+	/// Returns the argument at `index` converted to a double-precision floating-point number.
+	///
+	/// `NULL` is converted to `0`.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.count`
+	///
+	/// - parameter index: The index of the desired argument
+	public func double(at index: Int) -> Double {
+		return sqlite3_value_double(value(at: index))
+	}
+
+	/// Returns the argument at `index` converted to text or `nil` if the argument is `NULL`.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.count`
+	///
+	/// - parameter index: The index of the desired argument
+	public func string(at index: Int) -> String? {
+		let value = self.value(at: index)
+		guard sqlite3_value_type(value) != SQLITE_NULL else {
+			return nil
+		}
+		return String(cString: sqlite3_value_text(value))
+	}
+
+	/// Invokes `body` with the UTF-8 bytes of the argument at `index` converted to text.
+	///
+	/// The bytes are owned by SQLite and are not copied.
+	/// A `NULL` argument is passed to `body` as an empty buffer.
+	///
+	/// - important: The buffer passed to `body` must not be used outside of `body`.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.count`
+	///
+	/// - parameter index: The index of the desired argument
+	/// - parameter body: A closure accessing the argument's bytes
+	/// - parameter bytes: The argument's bytes
+	///
+	/// - throws: Any error thrown in `body`
+	///
+	/// - returns: The value returned by `body`
+	public func withUnsafeText<T>(at index: Int, _ body: (_ bytes: UnsafeRawBufferPointer) throws -> T) rethrows -> T {
+		let value = self.value(at: index)
+		// sqlite3_value_text() must be called before sqlite3_value_bytes() to obtain the length of the UTF-8 conversion
+		let text = sqlite3_value_text(value)
+		let byteCount = Int(sqlite3_value_bytes(value))
+		return try body(UnsafeRawBufferPointer(start: text, count: text != nil ? byteCount : 0))
+	}
+
+	/// Invokes `body` with the bytes of the argument at `index` as a BLOB.
+	///
+	/// The bytes are owned by SQLite and are not copied.
+	/// A `NULL` or zero-length argument is passed to `body` as an empty buffer.
+	///
+	/// - important: The buffer passed to `body` must not be used outside of `body`.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.count`
+	///
+	/// - parameter index: The index of the desired argument
+	/// - parameter body: A closure accessing the argument's bytes
+	/// - parameter bytes: The argument's bytes
+	///
+	/// - throws: Any error thrown in `body`
+	///
+	/// - returns: The value returned by `body`
+	public func withUnsafeBLOB<T>(at index: Int, _ body: (_ bytes: UnsafeRawBufferPointer) throws -> T) rethrows -> T {
+		let value = self.value(at: index)
+		let blob = sqlite3_value_blob(value)
+		let byteCount = Int(sqlite3_value_bytes(value))
+		return try body(UnsafeRawBufferPointer(start: blob, count: blob != nil ? byteCount : 0))
+	}
+}
+
+extension SQLArguments: RandomAccessCollection {
+	public var startIndex: Int {
+		return 0
+	}
+
+	public var endIndex: Int {
+		return values.count
+	}
+
+	/// Returns a copy of the argument at `index`.
+	///
+	/// - requires: `index >= 0`
+	/// - requires: `index < self.count`
+	///
+	/// - parameter index: The index of the desired argument
+	public subscript(index: Int) -> DatabaseValue {
+		return DatabaseValue(value(at: index))
+	}
+}
@@ -0,0 +1,250 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import os.log
+import Foundation
+import CSQLite
+
+extension SQLite {
+	/// Enables or disables the collection of memory allocation statistics.
+	///
+	/// Memory statistics are disabled by default because FeistyDB compiles SQLite with `SQLITE_DEFAULT_MEMSTATUS=0`.
+	/// The soft and hard heap limits are only enforced when memory statistics are enabled.
+	///
+	/// - important: Memory statistics may only be changed before SQLite is initialized or after it is shut down.
+	/// SQLite is initialized automatically when the first database is opened.
+	///
+	/// - parameter enabled: Whether memory statistics should be collected
+	///
+	/// - throws: An error if SQLite has already been initialized
+	///
+	/// - seealso: [Configuration Options](https://www.sqlite.org/c3ref/c_config_covering_index_scan.html#sqliteconfigmemstatus)
+	public static func setMemoryStatisticsEnabled(_ enabled: Bool) throws {
+		let rc = feisty_db_sqlite3_config_memstatus(enabled ? 1 : 0)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error configuring memory statistics", code: rc)
+		}
+	}
+
+	/// Available global status parameters.
+	///
+	/// - seealso: [Status Parameters](https://www.sqlite.org/c3ref/c_status_malloc_count.html)
+	public enum StatusParameter {
+		/// The amount of memory checked out using `sqlite3_malloc()`
+		case memoryUsed
+		/// The number of pages used out of the page cache memory allocator
+		case pageCacheUsed
+		/// The number of bytes of page cache allocation which could not be satisfied by the page cache memory allocator and were forced to overflow to `sqlite3_malloc()`
+		case pageCacheOverflow
+		/// The largest memory allocation request handed to `sqlite3_malloc()` (highwater only)
+		case mallocSize
+		/// The deepest parser stack (highwater only)
+		case parserStack
+		/// The largest memory allocation request handed to the page cache memory allocator (highwater only)
+		case pageCacheSize
+		/// The number of separate memory allocations currently checked out
+		case mallocCount
+	}
+
+	/// Returns information on a global SQLite status parameter.
+	///
+	/// - note: Most parameters are only tracked when memory statistics are enabled.
+	///
+	/// - parameter parameter: The desired status parameter
+	/// - parameter resetHighwater: If `true` the highwater mark, if applicable, is reset to the current value
+	///
+	/// - throws: An error if the status could not be retrieved
+	///
+	/// - returns: A tuple containing the current value of the parameter and its highwater mark
+	///
+	/// - seealso: [SQLite Runtime Status](https://www.sqlite.org/c3ref/status.html)
+	public static func status(ofParameter parameter: StatusParameter, resetHighwater: Bool = false) throws -> (Int64, Int64) {
+		let op: Int32
+		switch parameter {
+		case .memoryUsed:			op = SQLITE_STATUS_MEMORY_USED
+		case .pageCacheUsed:		op = SQLITE_STATUS_PAGECACHE_USED
+		case .pageCacheOverflow:	op = SQLITE_STATUS_PAGECACHE_OVERFLOW
+		case .mallocSize:			op = SQLITE_STATUS_MALLOC_SIZE
+		case .parserStack:			op = SQLITE_STATUS_PARSER_STACK
+		case .pageCacheSize:		op = SQLITE_STATUS_PAGECACHE_SIZE
+		case .mallocCount:			op = SQLITE_STATUS_MALLOC_COUNT
+		}
+
+		var current: Int64 = 0
+		var highwater: Int64 = 0
+		let rc = sqlite3_status64(op, &current, &highwater, resetHighwater ? 1 : 0)
+		guard rc == SQLITE_OK else {
+			throw SQLiteError("Error retrieving status", code: rc)
+		}
+
+		return (current, highwater)
+	}
+
+	/// The soft limit on the amount of heap memory that may be allocated by SQLite, or `0` for no limit.
+	///
+	/// When the soft heap limit is exceeded SQLite attempts to reduce memory usage by releasing page cache memory.
+	///
+	/// - seealso: [Impose A Limit On Heap Size](https://www.sqlite.org/c3ref/hard_heap_limit64.html)
+	public static var softHeapLimit: Int64 {
+		get {
+			return sqlite3_soft_heap_limit64(-1)
+		}
+		set {
+			_ = sqlite3_soft_heap_limit64(newValue)
+		}
+	}
+
+	/// The hard limit on the amount of heap memory that may be allocated by SQLite, or `0` for no limit.
+	///
+	/// When the hard heap limit is reached memory allocations by SQLite fail.
+	///
+	/// - seealso: [Impose A Limit On Heap Size](https://www.sqlite.org/c3ref/hard_heap_limit64.html)
+	public static var hardHeapLimit: Int64 {
+		get {
+			return sqlite3_hard_heap_limit64(-1)
+		}
+		set {
+			_ = sqlite3_hard_heap_limit64(newValue)
+		}
+	}
+
+	/// Requests that SQLite free non-essential memory held by open database connections.
+	///
+	/// Memory is released from every open `DatabaseQueue`, `DatabaseReadQueue`, and `DatabasePool`.
+	/// Each connection releases its memory asynchronously on the queue to which it is pinned.
+	///
+	/// - note: A `Database` not owned by a queue or pool is not thread-safe and is not included.
+	/// Use `Database.releaseMemory()` for such databases.
+	///
+	/// - seealso: [Free Memory Used By A Database Connection](https://www.sqlite.org/c3ref/db_release_memory.html)
+	public static func releaseMemoryFromAllDatabases() {
+		MemoryReleaseRegistry.shared.releaseMemory()
+	}
+
+	/// The dispatch source delivering memory pressure events
+	static var memoryPressureSource: DispatchSourceMemoryPressure?
+	/// The lock protecting `memoryPressureSource`
+	static let memoryPressureLock = NSLock()
+
+	/// Begins releasing memory from all open databases when the system reports memory pressure.
+	///
+	/// On warning and critical memory pressure events `releaseMemoryFromAllDatabases()` is invoked.
+	///
+	/// - parameter queue: The dispatch queue on which to process memory pressure events
+	public static func beginReleasingMemoryOnMemoryPressure(queue: DispatchQueue = .global(qos: .utility)) {
+		memoryPressureLock.lock()
+		defer {
+			memoryPressureLock.unlock()
+		}
+
+		guard memoryPressureSource == nil else {
+			return
+		}
+
+		let source = DispatchSource.makeMemoryPressureSource(eventMask: [.warning, .critical], queue: queue)
+		source.setEventHandler {
+			os_log("Releasing SQLite memory due to memory pressure", type: .info)
+			releaseMemoryFromAllDatabases()
+		}
+		source.resume()
+		memoryPressureSource = source
+	}
+
+	/// Stops releasing memory from open databases when the system reports memory pressure.
+	public static func endReleasingMemoryOnMemoryPressure() {
+		memoryPressureLock.lock()
+		defer {
+			memoryPressureLock.unlock()
+		}
+
+		memoryPressureSource?.cancel()
+		memoryPressureSource = nil
+	}
+}
+
+extension Database {
+	/// Frees as much heap memory held by the database connection as possible.
+	///
+	/// - throws: An error if the memory could not be released
+	///
+	/// - seealso: [Free Memory Used By A Database Connection](https://www.sqlite.org/c3ref/db_release_memory.html)
+	public func releaseMemory() throws {
+		guard sqlite3_db_release_memory(db) == SQLITE_OK else {
+			throw SQLiteError("Error releasing memory", takingDescriptionFromDatabase: db)
+		}
+	}
+}
+
+/// An object able to release memory held by the database connections it owns
+protocol MemoryReleasing: AnyObject {
+	/// Asynchronously releases memory held by the object's database connections on the queues to which they are pinned.
+	func releaseMemory()
+}
+
+/// The registry of objects owning database connections from which memory may be released
+final class MemoryReleaseRegistry {
+	/// A weak reference to a registered object
+	struct WeakReference {
+		weak var object: MemoryReleasing?
+	}
+
+	/// The shared registry
+	static let shared = MemoryReleaseRegistry()
+
+	/// The registered objects
+	var references = [WeakReference]()
+	/// The lock protecting `references`
+	let lock = NSLock()
+
+	/// Registers `object`, which is held weakly.
+	func register(_ object: MemoryReleasing) {
+		lock.lock()
+		references.removeAll { $0.object == nil }
+		references.append(WeakReference(object: object))
+		lock.unlock()
+	}
+
+	/// Releases memory from all registered objects.
+	func releaseMemory() {
+		lock.lock()
+		references.removeAll { $0.object == nil }
+		let objects = references.compactMap { $0.object }
+		lock.unlock()
+
+		for object in objects {
+			object.releaseMemory()
+		}
+	}
+}
+
+extension DatabaseQueue: MemoryReleasing {
+	func releaseMemory() {
+		queue.async {
+			try? self.database.releaseMemory()
+		}
+	}
+}
+
+extension DatabaseReadQueue: MemoryReleasing {
+	func releaseMemory() {
+		queue.async {
+			try? self.database.releaseMemory()
+		}
+	}
+}
+
+extension DatabasePool: MemoryReleasing {
+	func releaseMemory() {
+		writeQueue.async {
+			try? self.writer.releaseMemory()
+		}
+		for reader in readers {
+			reader.queue.async {
+				try? reader.database.releaseMemory()
+			}
+		}
+	}
+}
@@ -207,9 +207,11 @@ extension Statement {
 
 		let count = array.count
 
-		let utf8_character_counts = array.map { $0.utf8.count + 1 }
-		let utf8_offsets = [ 0 ] + scan(utf8_character_counts, 0, +)
-		let utf8_buf_size = utf8_offsets.last!
+		// Size the buffer in a single pass; the UTF-8 count of native strings is O(1)
+		var utf8_buf_size = 0
+		for s in array {
+			utf8_buf_size += s.utf8.count + 1
+		}
 
 		let ptr_size = MemoryLayout<UnsafePointer<Int8>>.stride * count
 		let alloc_size = ptr_size + utf8_buf_size
@@ -217,12 +219,19 @@ extension Statement {
 		let mem = UnsafeMutableRawPointer.allocate(byteCount: alloc_size, alignment: MemoryLayout<UnsafePointer<Int8>>.alignment)
 
 		let ptrs = mem.bindMemory(to: UnsafeMutablePointer<Int8>.self, capacity: count)
-		let utf8 = (mem + ptr_size).bindMemory(to: Int8.self, capacity: utf8_buf_size)
+		var pos = (mem + ptr_size).bindMemory(to: Int8.self, capacity: utf8_buf_size)
 
-		for(i, s) in array.enumerated() {
-			let pos = utf8 + utf8_offsets[i]
+		for (i, s) in array.enumerated() {
 			ptrs[i] = pos
-			memcpy(pos, s, utf8_offsets[i + 1] - utf8_offsets[i])
+			var s = s
+			let utf8_count = s.withUTF8 { utf8 -> Int in
+				if let base = utf8.baseAddress {
+					memcpy(pos, base, utf8.count)
+				}
+				return utf8.count
+			}
+			pos[utf8_count] = 0
+			pos += utf8_count + 1
 		}
 
 		guard sqlite3_carray_bind(stmt, idx, mem, Int32(array.count), CARRAY_TEXT, {
@@ -256,28 +265,132 @@ extension Statement {
 	}
 }
 
-// MARK: - Internals
+// MARK: - Unsafe buffers
+
+/// A fixed-width type whose values may be bound by reference using the sqlite3 Carray extension
+public protocol CArrayElement {
+	/// The Carray type flag for the type
+	static var carrayType: Int32 { get }
+}
+
+extension Int32: CArrayElement {
+	public static var carrayType: Int32 {
+		return CARRAY_INT32
+	}
+}
+
+extension Int64: CArrayElement {
+	public static var carrayType: Int32 {
+		return CARRAY_INT64
+	}
+}
 
-/// Computes the accumulated result  of `seq`
-private func accumulate<S: Sequence, U>(_ seq: S, _ initial: U, _ combine: (U, S.Element) -> U) -> [U] {
-	var result: [U] = []
-	result.reserveCapacity(seq.underestimatedCount)
-	var runningResult = initial
-	for element in seq {
-		runningResult = combine(runningResult, element)
-		result.append(runningResult)
+extension Double: CArrayElement {
+	public static var carrayType: Int32 {
+		return CARRAY_DOUBLE
 	}
-	return result
 }
 
-/// Computes the prefix sum of `seq`.
-private func scan<S: Sequence, U>(_ seq: S, _ initial: U, _ combine: (U, S.Element) -> U) -> [U] {
-	var result: [U] = []
-	result.reserveCapacity(seq.underestimatedCount)
-	var runningResult = initial
-	for element in seq {
-		runningResult = combine(runningResult, element)
-		result.append(runningResult)
+extension Statement {
+	/// Binds the values in `buffer` to the SQL parameter at `index` using the sqlite3 Carray extension without copying
+	///
+	/// ```
+	/// let ids = UnsafeMutableBufferPointer<Int64>.allocate(capacity: 100_000)
+	/// // Fill `ids`
+	/// let statement = try db.prepare(sql: "SELECT * FROM items WHERE id IN carray(?1);")
+	/// try statement.bind(buffer: UnsafeBufferPointer(ids), toParameter: 1)
+	/// ```
+	///
+	/// - important: The memory referenced by `buffer` is not copied and must remain valid and unmodified
+	/// until the statement is finalized or the parameter is rebound.
+	///
+	/// - note: Parameter indexes are 1-based.  The leftmost parameter in a statement has index 1.
+	///
+	/// - requires: `index > 0`
+	/// - requires: `index < parameterCount`
+	///
+	/// - parameter buffer: A buffer of values to bind to the SQL parameter
+	/// - parameter index: The index of the SQL parameter to bind
+	///
+	/// - throws: An error if `buffer` couldn't be bound
+	///
+	/// - seealso: [The Carray() Table-Valued Function](https://www.sqlite.org/carray.html)
+	public func bind<T: CArrayElement>(buffer: UnsafeBufferPointer<T>, toParameter index: Int) throws {
+		let idx = Int32(index)
+
+		// A nil destructor is SQLITE_STATIC
+		guard sqlite3_carray_bind(stmt, idx, UnsafeMutableRawPointer(mutating: buffer.baseAddress), Int32(buffer.count), T.carrayType, nil) == SQLITE_OK else {
+			throw SQLiteError("Error binding carray (\(T.self)) to parameter \(idx)", takingDescriptionFromStatement: stmt)
+		}
+	}
+
+	/// Binds the values in `buffer` to SQL parameter `name` using the sqlite3 Carray extension without copying
+	///
+	/// - important: The memory referenced by `buffer` is not copied and must remain valid and unmodified
+	/// until the statement is finalized or the parameter is rebound.
+	///
+	/// - parameter buffer: A buffer of values to bind to the SQL parameter
+	/// - parameter name: The name of the SQL parameter to bind
+	///
+	/// - throws: An error if the SQL parameter `name` doesn't exist or `buffer` couldn't be bound
+	///
+	/// - seealso: [The Carray() Table-Valued Function](https://www.sqlite.org/carray.html)
+	public func bind<T: CArrayElement>(buffer: UnsafeBufferPointer<T>, toParameter name: String) throws {
+		let idx = sqlite3_bind_parameter_index(stmt, name)
+		guard idx > 0 else {
+			throw DatabaseError("Unknown parameter \"\(name)\"")
+		}
+
+		try bind(buffer: buffer, toParameter: Int(idx))
+	}
+
+	/// Binds the values in `array` to the SQL parameter at `index` using the sqlite3 Carray extension for the duration of `body`
+	///
+	/// The contiguous storage of `array`, such as that of an `Array` or `ContiguousArray`, is bound without copying.
+	/// Collections without contiguous storage are copied.  When `body` returns the statement is reset
+	/// and the parameter is set to `NULL`.
+	///
+	/// ```
+	/// let ids: ContiguousArray<Int64> = [ 1, 10, 100 ]
+	/// let statement = try db.prepare(sql: "SELECT * FROM items WHERE id IN carray(?1);")
+	/// let names: [String] = try statement.withCArray(ids, boundToParameter: 1) {
+	///     try statement.column(1)
+	/// }
+	/// ```
+	///
+	/// - note: Parameter indexes are 1-based.  The leftmost parameter in a statement has index 1.
+	///
+	/// - requires: `index > 0`
+	/// - requires: `index < parameterCount`
+	///
+	/// - parameter array: A collection of values to bind to the SQL parameter
+	/// - parameter index: The index of the SQL parameter to bind
+	/// - parameter body: A closure using the statement
+	///
+	/// - throws: An error if `array` couldn't be bound or any error thrown by `body`
+	///
+	/// - returns: The value returned by `body`
+	///
+	/// - seealso: [The Carray() Table-Valued Function](https://www.sqlite.org/carray.html)
+	public func withCArray<C: Collection, R>(_ array: C, boundToParameter index: Int, _ body: () throws -> R) throws -> R where C.Element: CArrayElement {
+		let invoke = { (buffer: UnsafeBufferPointer<C.Element>) throws -> R in
+			try self.bind(buffer: buffer, toParameter: index)
+			defer {
+				sqlite3_reset(self.stmt)
+				sqlite3_bind_null(self.stmt, Int32(index))
+			}
+			return try body()
+		}
+
+		if let result = try array.withContiguousStorageIfAvailable(invoke) {
+			return result
+		}
+
+		let mem = UnsafeMutableBufferPointer<C.Element>.allocate(capacity: array.count)
+		defer {
+			mem.deallocate()
+		}
+		_ = mem.initialize(from: array)
+		return try invoke(UnsafeBufferPointer(mem))
 	}
-	return result
 }
@@ -0,0 +1,396 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// The maximum number of columns in a tuple array
+public let tupleArrayMaximumColumnCount = 8
+
+/// The pointer type used to pass columnar batches to the `tuples` table-valued function
+private let tupleArrayPointerType: StaticString = "feisty-db-tuples"
+
+/// Returns `tupleArrayPointerType` as a C string
+private var tuple_array_pointer_type: UnsafePointer<Int8> {
+	return UnsafeRawPointer(tupleArrayPointerType.utf8Start).assumingMemoryBound(to: Int8.self)
+}
+
+extension Database {
+	/// Adds the `tuples` table-valued function to the database.
+	///
+	/// `tuples` is an eponymous virtual table returning the rows of a `ColumnarBatch` bound to its argument
+	/// using `Statement.bind(tuples:toParameter:)`.  The columns of the batch are returned as `c0` through `c7`;
+	/// columns not present in the batch are `NULL`.  It is the multi-column and BLOB counterpart of `carray()`:
+	///
+	/// ```swift
+	/// try db.addTupleArrayModule()
+	/// let keys = ColumnarBatch(fields: [.init(.int64, nullable: false), .init(.text, nullable: false)], capacity: 2)
+	/// keys.columns[0].append(Int64(1))
+	/// keys.columns[1].append("a")
+	/// keys.columns[0].append(Int64(2))
+	/// keys.columns[1].append("b")
+	/// let statement = try db.prepare(sql: "SELECT * FROM t WHERE (x, y) IN (SELECT c0, c1 FROM tuples(?1));")
+	/// try statement.bind(tuples: keys, toParameter: 1)
+	/// ```
+	///
+	/// - throws: An error if the virtual table module can't be registered
+	///
+	/// - seealso: [Table-valued functions](https://www.sqlite.org/vtab.html#tabfunc2)
+	public func addTupleArrayModule() throws {
+		guard sqlite3_create_module_v2(db, "tuples", tuple_array_module, nil, nil) == SQLITE_OK else {
+			throw SQLiteError("Error adding module \"tuples\"", takingDescriptionFromDatabase: db)
+		}
+	}
+}
+
+extension Statement {
+	/// Binds the rows of `batch` to the SQL parameter at `index` for use with the `tuples` table-valued function
+	///
+	/// ```
+	/// let statement = try db.prepare(sql: "SELECT * FROM t WHERE (x, y) IN (SELECT c0, c1 FROM tuples(?1));")
+	/// try statement.bind(tuples: keys, toParameter: 1)
+	/// ```
+	///
+	/// - important: `batch` is retained but not copied and must not be modified while bound.
+	///
+	/// - note: Parameter indexes are 1-based.  The leftmost parameter in a statement has index 1.
+	///
+	/// - requires: The database to which the statement belongs has called `addTupleArrayModule()`
+	/// - requires: `batch.columns.count <= tupleArrayMaximumColumnCount`
+	/// - requires: `index > 0`
+	/// - requires: `index < parameterCount`
+	///
+	/// - parameter batch: The rows to bind to the SQL parameter
+	/// - parameter index: The index of the SQL parameter to bind
+	///
+	/// - throws: An error if `batch` couldn't be bound
+	public func bind(tuples batch: ColumnarBatch, toParameter index: Int) throws {
+		let idx = Int32(index)
+
+		guard batch.columns.count <= tupleArrayMaximumColumnCount else {
+			throw DatabaseError("Tuple arrays may contain at most \(tupleArrayMaximumColumnCount) columns")
+		}
+
+		// The binding holds a +1 reference to batch which is released by the destructor
+		let ptr = Unmanaged.passRetained(batch).toOpaque()
+		guard sqlite3_bind_pointer(stmt, idx, ptr, tuple_array_pointer_type, {
+			Unmanaged<ColumnarBatch>.fromOpaque(UnsafeRawPointer($0.unsafelyUnwrapped)).release()
+		}) == SQLITE_OK else {
+			throw SQLiteError("Error binding tuples to parameter \(idx)", takingDescriptionFromStatement: stmt)
+		}
+	}
+
+	/// Binds the rows of `batch` to SQL parameter `name` for use with the `tuples` table-valued function
+	///
+	/// - important: `batch` is retained but not copied and must not be modified while bound.
+	///
+	/// - requires: The database to which the statement belongs has called `addTupleArrayModule()`
+	/// - requires: `batch.columns.count <= tupleArrayMaximumColumnCount`
+	///
+	/// - parameter batch: The rows to bind to the SQL parameter
+	/// - parameter name: The name of the SQL parameter to bind
+	///
+	/// - throws: An error if the SQL parameter `name` doesn't exist or `batch` couldn't be bound
+	public func bind(tuples batch: ColumnarBatch, toParameter name: String) throws {
+		let idx = sqlite3_bind_parameter_index(stmt, name)
+		guard idx > 0 else {
+			throw DatabaseError("Unknown parameter \"\(name)\"")
+		}
+
+		try bind(tuples: batch, toParameter: Int(idx))
+	}
+
+	/// Binds the values in `array` as BLOBs to the SQL parameter at `index` for use with the `tuples` table-valued function
+	///
+	/// The values are copied once into a single contiguous buffer which is then read by `tuples` without further copying.
+	///
+	/// ```
+	/// let statement = try db.prepare(sql: "SELECT * FROM files WHERE digest IN (SELECT c0 FROM tuples(?1));")
+	/// try statement.bind(blobs: digests, toParameter: 1)
+	/// ```
+	///
+	/// - note: Parameter indexes are 1-based.  The leftmost parameter in a statement has index 1.
+	///
+	/// - requires: The database to which the statement belongs has called `addTupleArrayModule()`
+	/// - requires: `index > 0`
+	/// - requires: `index < parameterCount`
+	///
+	/// - parameter array: An array of values to bind to the SQL parameter
+	/// - parameter index: The index of the SQL parameter to bind
+	///
+	/// - throws: An error if `array` couldn't be bound
+	public func bind<S: Collection>(blobs array: S, toParameter index: Int) throws where S.Element == Data {
+		let batch = ColumnarBatch(fields: [.init(.blob, nullable: false)], capacity: max(array.count, 1))
+		let column = batch.columns[0]
+		column.reserveByteCapacity(array.reduce(0) { $0 + $1.count })
+		for value in array {
+			value.withUnsafeBytes {
+				column.append($0)
+			}
+		}
+		try bind(tuples: batch, toParameter: index)
+	}
+
+	/// Binds the values in `array` as BLOBs to SQL parameter `name` for use with the `tuples` table-valued function
+	///
+	/// - requires: The database to which the statement belongs has called `addTupleArrayModule()`
+	///
+	/// - parameter array: An array of values to bind to the SQL parameter
+	/// - parameter name: The name of the SQL parameter to bind
+	///
+	/// - throws: An error if the SQL parameter `name` doesn't exist or `array` couldn't be bound
+	public func bind<S: Collection>(blobs array: S, toParameter name: String) throws where S.Element == Data {
+		let idx = sqlite3_bind_parameter_index(stmt, name)
+		guard idx > 0 else {
+			throw DatabaseError("Unknown parameter \"\(name)\"")
+		}
+
+		try bind(blobs: array, toParameter: Int(idx))
+	}
+}
+
+// MARK: - Key sets
+
+/// A set of keys usable as the right-hand side of an `IN` operator.
+///
+/// The keys are either bound directly to the `tuples` table-valued function or loaded into an indexed temporary table.
+public struct KeySet {
+	/// The strategy used to provide the keys
+	public enum Strategy {
+		/// The keys are bound to each statement using the `tuples` table-valued function
+		case tableValuedFunction
+		/// The keys are loaded into an indexed temporary table
+		case temporaryTable
+		/// A temporary table is used if the number of keys exceeds `threshold`
+		case automatic(threshold: Int)
+	}
+
+	/// The keys
+	public let keys: ColumnarBatch
+	/// The name of the temporary table or SQL parameter
+	public let name: String
+	/// `true` if the keys were loaded into a temporary table
+	public let isTemporaryTable: Bool
+
+	/// A subquery selecting the keys suitable for use as `(a, b) IN (\(keySet.subquery))`
+	///
+	/// - important: If the key set does not use a temporary table statements containing the subquery must be bound using `bind(to:)`
+	public var subquery: String {
+		let columns = (0 ..< keys.columns.count).map({ "c\($0)" }).joined(separator: ", ")
+		if isTemporaryTable {
+			return "SELECT \(columns) FROM temp.\(BulkInserter.quote(name))"
+		}
+		return "SELECT \(columns) FROM tuples(:\(name))"
+	}
+
+	/// Binds the keys to `statement` if required by the subquery
+	///
+	/// - parameter statement: A statement containing `subquery`
+	///
+	/// - throws: An error if the keys couldn't be bound
+	public func bind(to statement: Statement) throws {
+		if !isTemporaryTable {
+			try statement.bind(tuples: keys, toParameter: ":\(name)")
+		}
+	}
+}
+
+extension Database {
+	/// Provides `keys` as a key set for the duration of `body`.
+	///
+	/// Binding keys to `tuples` avoids any copying, but a temporary table with a primary key index on all columns
+	/// is preferable for very large key sets that are probed repeatedly or used by multiple statements.
+	/// The temporary table, if any, is dropped when `body` returns.  Rows containing `NULL` are not loaded
+	/// into a temporary table since they never match an `IN` operator.
+	///
+	/// ```swift
+	/// try db.withKeySet(keys) { keySet in
+	///     let statement = try db.prepare(sql: "SELECT * FROM t WHERE (x, y) IN (\(keySet.subquery));")
+	///     try keySet.bind(to: statement)
+	///     // Use `statement`
+	/// }
+	/// ```
+	///
+	/// - requires: `addTupleArrayModule()` has been called
+	/// - requires: `name` is a valid SQL parameter name that does not conflict with a table in the `temp` schema
+	///
+	/// - parameter keys: The keys
+	/// - parameter name: The name of the temporary table or SQL parameter
+	/// - parameter strategy: The strategy used to provide the keys
+	/// - parameter body: A closure using the key set
+	/// - parameter keySet: The key set
+	///
+	/// - throws: An error if the temporary table couldn't be created or any error thrown by `body`
+	///
+	/// - returns: The value returned by `body`
+	public func withKeySet<R>(_ keys: ColumnarBatch, name: String = "keys", strategy: KeySet.Strategy = .automatic(threshold: 10_000), _ body: (_ keySet: KeySet) throws -> R) throws -> R {
+		precondition(!keys.columns.isEmpty, "A key set must contain at least one column")
+
+		let useTemporaryTable: Bool
+		switch strategy {
+		case .tableValuedFunction:
+			useTemporaryTable = false
+		case .temporaryTable:
+			useTemporaryTable = true
+		case .automatic(let threshold):
+			useTemporaryTable = keys.count > threshold
+		}
+
+		let keySet = KeySet(keys: keys, name: name, isTemporaryTable: useTemporaryTable)
+		guard useTemporaryTable else {
+			return try body(keySet)
+		}
+
+		let table = "temp.\(BulkInserter.quote(name))"
+		let columns = (0 ..< keys.columns.count).map({ "c\($0)" }).joined(separator: ", ")
+		try execute(sql: "CREATE TEMP TABLE \(table)(\(columns), PRIMARY KEY(\(columns))) WITHOUT ROWID;")
+		defer {
+			_ = try? execute(sql: "DROP TABLE \(table);")
+		}
+
+		// OR IGNORE skips duplicate keys and rows violating the NOT NULL primary key constraint
+		let statement = try prepare(sql: "INSERT OR IGNORE INTO \(table) SELECT \(columns) FROM tuples(?1);")
+		try statement.bind(tuples: keys, toParameter: 1)
+		try statement.execute()
+
+		return try body(keySet)
+	}
+}
+
+// MARK: - Implementation
+
+/// Column number of the hidden argument column
+private let tuple_array_argument_column = Int32(tupleArrayMaximumColumnCount)
+
+/// The cursor for the `tuples` virtual table
+final class TupleArrayCursor {
+	/// The bound batch, or `nil` if none
+	var batch: ColumnarBatch?
+	/// The index of the current row in `batch`
+	var row = 0
+}
+
+/// The persistent `sqlite3_module` for the `tuples` virtual table
+let tuple_array_module: UnsafeMutablePointer<sqlite3_module> = {
+	let module = UnsafeMutablePointer<sqlite3_module>.allocate(capacity: 1)
+	module.initialize(to: sqlite3_module(iVersion: 0, xCreate: nil, xConnect: xTupleArrayConnect, xBestIndex: xTupleArrayBestIndex, xDisconnect: xTupleArrayDisconnect, xDestroy: nil,
+										 xOpen: xTupleArrayOpen, xClose: xTupleArrayClose, xFilter: xTupleArrayFilter, xNext: xTupleArrayNext, xEof: xTupleArrayEof, xColumn: xTupleArrayColumn, xRowid: xTupleArrayRowid, xUpdate: nil, xBegin: nil, xSync: nil, xCommit: nil, xRollback: nil, xFindFunction: nil, xRename: nil, xSavepoint: nil, xRelease: nil, xRollbackTo: nil, xShadowName: nil))
+	return module
+}()
+
+/// Returns the tuple array cursor stored in `pCursor`
+func tuple_array_cursor(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?) -> TupleArrayCursor {
+	return pCursor.unsafelyUnwrapped.withMemoryRebound(to: feisty_db_sqlite3_vtab_cursor.self, capacity: 1) { curs in
+		return Unmanaged<TupleArrayCursor>.fromOpaque(UnsafeRawPointer(curs.pointee.virtual_table_cursor_ptr.unsafelyUnwrapped)).takeUnretainedValue()
+	}
+}
+
+func xTupleArrayConnect(_ db: OpaquePointer?, _ pAux: UnsafeMutableRawPointer?, _ argc: Int32, _ argv: UnsafePointer<UnsafePointer<Int8>?>?, _ ppVTab: UnsafeMutablePointer<UnsafeMutablePointer<sqlite3_vtab>?>?, _ pzErr: UnsafeMutablePointer<UnsafeMutablePointer<Int8>?>?) -> Int32 {
+	let columns = (0 ..< tupleArrayMaximumColumnCount).map({ "c\($0)" }).joined(separator: ", ")
+	let rc = sqlite3_declare_vtab(db, "CREATE TABLE x(\(columns), tuples HIDDEN)")
+	guard rc == SQLITE_OK else {
+		return rc
+	}
+
+	feisty_db_sqlite3_vtab_config_innocuous(db)
+
+	let vtab = sqlite3_malloc(Int32(MemoryLayout<sqlite3_vtab>.size))
+	guard vtab != nil else {
+		return SQLITE_NOMEM
+	}
+
+	let vtab_ptr = vtab.unsafelyUnwrapped.bindMemory(to: sqlite3_vtab.self, capacity: 1)
+	vtab_ptr.initialize(to: sqlite3_vtab())
+	ppVTab.unsafelyUnwrapped.pointee = vtab_ptr
+
+	return SQLITE_OK
+}
+
+func xTupleArrayDisconnect(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?) -> Int32 {
+	sqlite3_free(pVTab)
+	return SQLITE_OK
+}
+
+func xTupleArrayBestIndex(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?, _ pIdxInfo: UnsafeMutablePointer<sqlite3_index_info>?) -> Int32 {
+	let indexInfo = pIdxInfo.unsafelyUnwrapped
+	for constraint in indexInfo.pointee.constraints where constraint.isUsable && constraint.column == tuple_array_argument_column && constraint.op == .equal {
+		indexInfo.pointee.use(constraint, argumentIndex: 1, omit: true)
+		indexInfo.pointee.indexNumber = 1
+		indexInfo.pointee.estimatedCost = 1
+		indexInfo.pointee.estimatedRows = 100
+		return SQLITE_OK
+	}
+
+	// Without an argument the table is empty
+	indexInfo.pointee.indexNumber = 0
+	indexInfo.pointee.estimatedCost = 2147483647
+	indexInfo.pointee.estimatedRows = 2147483647
+	return SQLITE_OK
+}
+
+func xTupleArrayOpen(_ pVTab: UnsafeMutablePointer<sqlite3_vtab>?, _ ppCursor: UnsafeMutablePointer<UnsafeMutablePointer<sqlite3_vtab_cursor>?>?) -> Int32 {
+	let curs = sqlite3_malloc(Int32(MemoryLayout<feisty_db_sqlite3_vtab_cursor>.size))
+	guard curs != nil else {
+		return SQLITE_NOMEM
+	}
+
+	// The cursor must live until the xClose function is invoked; store it as a +1 object in ptr
+	let ptr = Unmanaged.passRetained(TupleArrayCursor()).toOpaque()
+
+	let curs_ptr = curs.unsafelyUnwrapped.bindMemory(to: feisty_db_sqlite3_vtab_cursor.self, capacity: 1)
+	curs_ptr.pointee.virtual_table_cursor_ptr = ptr
+	curs_ptr.withMemoryRebound(to: sqlite3_vtab_cursor.self, capacity: 1) {
+		ppCursor.unsafelyUnwrapped.pointee = $0
+	}
+
+	return SQLITE_OK
+}
+
+func xTupleArrayClose(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?) -> Int32 {
+	pCursor.unsafelyUnwrapped.withMemoryRebound(to: feisty_db_sqlite3_vtab_cursor.self, capacity: 1) { curs in
+		// Balance the +1 retain in xTupleArrayOpen()
+		Unmanaged<TupleArrayCursor>.fromOpaque(UnsafeRawPointer(curs.pointee.virtual_table_cursor_ptr)).release()
+	}
+	sqlite3_free(pCursor)
+	return SQLITE_OK
+}
+
+func xTupleArrayFilter(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?, _ idxNum: Int32, _ idxStr: UnsafePointer<Int8>?, _ argc: Int32, _ argv: UnsafeMutablePointer<OpaquePointer?>?) -> Int32 {
+	let cursor = tuple_array_cursor(pCursor)
+	cursor.row = 0
+	cursor.batch = nil
+	if idxNum == 1 && argc == 1, let ptr = sqlite3_value_pointer(argv.unsafelyUnwrapped[0], tuple_array_pointer_type) {
+		cursor.batch = Unmanaged<ColumnarBatch>.fromOpaque(UnsafeRawPointer(ptr)).takeUnretainedValue()
+	}
+	return SQLITE_OK
+}
+
+func xTupleArrayNext(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?) -> Int32 {
+	tuple_array_cursor(pCursor).row += 1
+	return SQLITE_OK
+}
+
+func xTupleArrayEof(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?) -> Int32 {
+	let cursor = tuple_array_cursor(pCursor)
+	return cursor.row >= (cursor.batch?.count ?? 0) ? 1 : 0
+}
+
+func xTupleArrayColumn(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?, _ pCtx: OpaquePointer?, _ i: Int32) -> Int32 {
+	let cursor = tuple_array_cursor(pCursor)
+	guard let columns = cursor.batch?.columns, Int(i) < columns.count else {
+		sqlite3_result_null(pCtx)
+		return SQLITE_OK
+	}
+
+	// The batch is retained by the binding and may not be modified while bound, so its buffers outlive the result
+	set_sqlite3_result(pCtx, column: columns[Int(i)], row: cursor.row, destructor: SQLITE_STATIC)
+	return SQLITE_OK
+}
+
+func xTupleArrayRowid(_ pCursor: UnsafeMutablePointer<sqlite3_vtab_cursor>?, _ pRowid: UnsafeMutablePointer<sqlite3_int64>?) -> Int32 {
+	pRowid.unsafelyUnwrapped.pointee = Int64(tuple_array_cursor(pCursor).row) + 1
+	return SQLITE_OK
+}
@@ -0,0 +1,190 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+#if SQLITE_ENABLE_PREUPDATE_HOOK && SQLITE_ENABLE_SESSION
+
+/// A closure receiving changeset data in chunks.
+///
+/// - parameter chunk: The next chunk of changeset data
+///
+/// - throws: An error to abort the operation producing the changeset
+public typealias ChangesetOutput = (_ chunk: UnsafeRawBufferPointer) throws -> Void
+
+/// A closure providing changeset data in chunks.
+///
+/// - parameter buffer: A buffer to receive the next chunk of changeset data
+///
+/// - throws: An error to abort the operation consuming the changeset
+///
+/// - returns: The number of bytes written to `buffer`, or `0` if no data remains
+public typealias ChangesetInput = (_ buffer: UnsafeMutableRawBufferPointer) throws -> Int
+
+/// The state passed to a streaming changeset `xOutput` callback
+struct ChangesetOutputContext {
+	let output: ChangesetOutput
+	var error: Swift.Error? = nil
+}
+
+/// The state passed to a streaming changeset `xInput` callback
+struct ChangesetInputContext {
+	let input: ChangesetInput
+	var error: Swift.Error? = nil
+}
+
+/// The `xOutput` callback for streaming changeset functions
+func changeset_stream_output(_ context: UnsafeMutableRawPointer?, _ data: UnsafeRawPointer?, _ count: Int32) -> Int32 {
+	let context_ptr = context.unsafelyUnwrapped.assumingMemoryBound(to: ChangesetOutputContext.self)
+	do {
+		try context_ptr.pointee.output(UnsafeRawBufferPointer(start: data, count: Int(count)))
+		return SQLITE_OK
+	}
+	catch let error {
+		context_ptr.pointee.error = error
+		return SQLITE_ABORT
+	}
+}
+
+/// The `xInput` callback for streaming changeset functions
+func changeset_stream_input(_ context: UnsafeMutableRawPointer?, _ data: UnsafeMutableRawPointer?, _ count: UnsafeMutablePointer<Int32>?) -> Int32 {
+	let context_ptr = context.unsafelyUnwrapped.assumingMemoryBound(to: ChangesetInputContext.self)
+	do {
+		let buffer = UnsafeMutableRawBufferPointer(start: data, count: Int(count.unsafelyUnwrapped.pointee))
+		let bytesRead = try context_ptr.pointee.input(buffer)
+		precondition(bytesRead >= 0 && bytesRead <= buffer.count, "Invalid changeset input byte count")
+		count.unsafelyUnwrapped.pointee = Int32(bytesRead)
+		return SQLITE_OK
+	}
+	catch let error {
+		context_ptr.pointee.error = error
+		return SQLITE_ABORT
+	}
+}
+
+/// Invokes `body` with an `xOutput` context for `output` and throws any error recorded by the callback.
+///
+/// - parameter output: The destination for changeset data
+/// - parameter message: The message for an error returned by `body`
+/// - parameter body: A closure invoking a streaming changeset function
+func with_changeset_output(_ output: ChangesetOutput, _ message: String, _ body: (UnsafeMutableRawPointer) -> Int32) throws {
+	try withoutActuallyEscaping(output) { output in
+		var context = ChangesetOutputContext(output: output)
+		let rc = body(&context)
+		if let error = context.error {
+			throw error
+		}
+		guard rc == SQLITE_OK else {
+			throw SQLiteError(message, code: rc)
+		}
+	}
+}
+
+/// Invokes `body` with an `xInput` context for `input` and throws any error recorded by the callback.
+///
+/// - parameter input: The source of changeset data
+/// - parameter message: The message for an error returned by `body`
+/// - parameter body: A closure invoking a streaming changeset function
+func with_changeset_input(_ input: ChangesetInput, _ message: String, _ body: (UnsafeMutableRawPointer) -> Int32) throws {
+	try withoutActuallyEscaping(input) { input in
+		var context = ChangesetInputContext(input: input)
+		let rc = body(&context)
+		if let error = context.error {
+			throw error
+		}
+		guard rc == SQLITE_OK else {
+			throw SQLiteError(message, code: rc)
+		}
+	}
+}
+
+extension Session {
+	/// Generates a changeset and passes it to `output` in chunks.
+	///
+	/// Unlike `changeset()`, the changeset is never held in memory in its entirety.
+	///
+	/// - parameter output: A closure receiving the changeset data
+	///
+	/// - throws: An error if the changeset could not be created or any error thrown by `output`
+	///
+	/// - seealso: [Streaming Versions of API functions](https://www.sqlite.org/session/sqlite3changegroup_add_strm.html)
+	public func changeset(streamingTo output: ChangesetOutput) throws {
+		try with_changeset_output(output, "Error creating changeset for database session") { context in
+			sqlite3session_changeset_strm(session, changeset_stream_output, context)
+		}
+	}
+}
+
+extension Changegroup {
+	/// Adds the changes in a changeset read from `input` to `self`.
+	///
+	/// - parameter input: A closure providing the changeset data
+	///
+	/// - throws: An error if the changeset could not be added or any error thrown by `input`
+	///
+	/// - seealso: [Streaming Versions of API functions](https://www.sqlite.org/session/sqlite3changegroup_add_strm.html)
+	public func add(streamingFrom input: ChangesetInput) throws {
+		try with_changeset_input(input, "Error adding changeset to changegroup") { context in
+			sqlite3changegroup_add_strm(changegroup, changeset_stream_input, context)
+		}
+	}
+
+	/// Generates a changeset containing the changes in `self` and passes it to `output` in chunks.
+	///
+	/// - parameter output: A closure receiving the changeset data
+	///
+	/// - throws: An error if the changeset could not be created or any error thrown by `output`
+	///
+	/// - seealso: [Streaming Versions of API functions](https://www.sqlite.org/session/sqlite3changegroup_add_strm.html)
+	public func changeset(streamingTo output: ChangesetOutput) throws {
+		try with_changeset_output(output, "Error creating changeset for changegroup") { context in
+			sqlite3changegroup_output_strm(changegroup, changeset_stream_output, context)
+		}
+	}
+}
+
+extension Database {
+	/// Applies a changeset read from `input` to the database.
+	///
+	/// Unlike `apply(_:options:_:_:)`, the changeset is never held in memory in its entirety.
+	///
+	/// - parameter input: A closure providing the changeset data
+	/// - parameter options: Options affecting how the changeset is applied
+	/// - parameter isIncluded: An optional closure returning `true` if changes to the named table should be applied. If `nil`, all tables will be included.
+	/// - parameter onConflict: A closure indicating how conflicts should be handled
+	///
+	/// - throws: An error if the changeset could not be applied or any error thrown by `input`
+	///
+	/// - seealso: [Streaming Versions of API functions](https://www.sqlite.org/session/sqlite3changegroup_add_strm.html)
+	public func apply(streamingFrom input: ChangesetInput, options: ChangesetApplyOptions = [], _ isIncluded: ChangesetTableFilter? = nil, _ onConflict: @escaping ChangesetConflictHandler) throws {
+		var context = ChangesetApplyContext(isIncluded: isIncluded, onConflict: onConflict)
+		try with_changeset_input(input, "Error applying changeset") { input_context in
+			sqlite3changeset_apply_v2_strm(db, changeset_stream_input, input_context, changeset_apply_filter, changeset_apply_conflict, &context, nil, nil, options.rawValue)
+		}
+	}
+}
+
+extension Changeset {
+	/// Passes the changeset data to `output` in chunks.
+	///
+	/// - parameter chunkSize: The maximum number of bytes in each chunk
+	/// - parameter output: A closure receiving the changeset data
+	///
+	/// - throws: Any error thrown by `output`
+	public func write(chunkSize: Int = 64 * 1024, to output: ChangesetOutput) throws {
+		try data.withUnsafeBytes { bytes in
+			var offset = 0
+			while offset < bytes.count {
+				let count = Swift.min(chunkSize, bytes.count - offset)
+				try output(UnsafeRawBufferPointer(rebasing: bytes[offset ..< offset + count]))
+				offset += count
+			}
+		}
+	}
+}
+
+#endif
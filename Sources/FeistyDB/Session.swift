@@ -34,7 +34,7 @@ public final class Session {
 	/// - parameter schema: The database schema to track
 	///
 	/// - throws: An error if the session could not be created
-	init(database: Database, schema: String) throws {
+	public init(database: Database, schema: String) throws {
 		self.database = database
 
 		var session: SQLiteSession? = nil
@@ -53,7 +53,7 @@ public final class Session {
 	/// The indirect change flag
 	///
 	/// - seealso: [Set Or Clear the Indirect Change Flag](https://www.sqlite.org/session/sqlite3session_indirect.html)
-	var indirect: Bool {
+	public var indirect: Bool {
 		get {
 			sqlite3session_indirect(session, -1) != 0
 		}
@@ -65,14 +65,14 @@ public final class Session {
 	/// Returns `true` if the session contains no changes.
 	///
 	/// - seealso: [Test if a changeset has recorded any changes.](https://www.sqlite.org/session/sqlite3session_isempty.html)
-	var isEmpty: Bool {
+	public var isEmpty: Bool {
 		sqlite3session_isempty(session) != 0
 	}
 
 	/// Returns the total amount of heap memory in bytes currently used by the session.
 	///
 	/// - seealso: [Query for the amount of heap memory used by a session object.](https://www.sqlite.org/session/sqlite3session_memory_used.html)
-	var memoryUsed: Int {
+	public var memoryUsed: Int {
 		Int(sqlite3session_memory_used(session))
 	}
 
@@ -83,7 +83,7 @@ public final class Session {
 	/// - throws: An error if the table could not be attached to the session
 	/// 
 	/// - seealso: [Attach A Table To A Session Object](https://www.sqlite.org/session/sqlite3session_attach.html)
-	func attach(_ table: String) throws {
+	public func attach(_ table: String) throws {
 		let rc = sqlite3session_attach(session, table)
 		guard rc == SQLITE_OK else {
 			throw SQLiteError("Error attaching table \"\(table)\" to database session", code: rc)
@@ -95,7 +95,7 @@ public final class Session {
 	/// - throws: An error if the tables could not be attached to the session
 	///
 	/// - seealso: [Attach A Table To A Session Object](https://www.sqlite.org/session/sqlite3session_attach.html)
-	func attachAll() throws {
+	public func attachAll() throws {
 		let rc = sqlite3session_attach(session, nil)
 		guard rc == SQLITE_OK else {
 			throw SQLiteError("Error attaching all tables to database session", code: rc)
@@ -105,7 +105,7 @@ public final class Session {
 	/// Creates and returns a changeset.
 	///
 	/// - throws: An error if the changeset could not be created
-	func changeset() throws -> Changeset {
+	public func changeset() throws -> Changeset {
 		var changeset: SQLiteChangeset? = nil
 		var size: Int32 = 0
 		defer {
@@ -411,7 +411,7 @@ public final class Changegroup {
 	/// Initializes a new changegroup
 	///
 	/// - throws: An error if the changegroup could not be created
-	init() throws {
+	public init() throws {
 		var changegroup: SQLiteChangegroup? = nil
 		let rc = sqlite3changegroup_new(&changegroup)
 		guard rc == SQLITE_OK else {
@@ -445,7 +445,7 @@ public final class Changegroup {
 	/// Creates and returns a changeset containing the changes in `self`.
 	///
 	/// - throws: An error if the changeset could not be created
-	func changeset() throws -> Changeset {
+	public func changeset() throws -> Changeset {
 		var changeset: SQLiteChangeset? = nil
 		var size: Int32 = 0
 		defer {
@@ -544,69 +544,11 @@ extension Database {
 		var rebaser: SQLiteRebaser? = nil
 		var size: Int32 = 0
 
-		struct ChangesetApplyContext {
-			let isIncluded: ChangesetTableFilter?
-			let onConflict: ChangesetConflictHandler
-		}
-
-		let context = ChangesetApplyContext(isIncluded: isIncluded, onConflict: onConflict)
-		let context_ptr = UnsafeMutablePointer<ChangesetApplyContext>.allocate(capacity: 1)
-		context_ptr.initialize(to: context)
-		defer {
-			context_ptr.deinitialize(count: 1)
-			context_ptr.deallocate()
-		}
+		var context = ChangesetApplyContext(isIncluded: isIncluded, onConflict: onConflict)
 
 		let rc = changeset.data.withUnsafeBytes { buf -> Int32 in
 			let ptr = UnsafeMutableRawPointer(mutating: buf.baseAddress)
-			return sqlite3changeset_apply_v2(db, Int32(changeset.data.count), ptr, { (context, table_name) -> Int32 in
-				let context_ptr = context.unsafelyUnwrapped.assumingMemoryBound(to: ChangesetApplyContext.self)
-
-				guard let isIncluded = context_ptr.pointee.isIncluded else {
-					return 1
-				}
-
-				let ptr = UnsafeMutableRawPointer(mutating: table_name.unsafelyUnwrapped)
-				let table = String(bytesNoCopy: ptr, length: strlen(table_name.unsafelyUnwrapped), encoding: .utf8, freeWhenDone: false).unsafelyUnwrapped
-//				let table = String(utf8String: table_name.unsafelyUnwrapped).unsafelyUnwrapped
-				return isIncluded(table) ? 1 : 0
-			}, { (context, raw_conflict, iter) -> Int32 in
-				let context_ptr = context.unsafelyUnwrapped.assumingMemoryBound(to: ChangesetApplyContext.self)
-				let onConflict = context_ptr.pointee.onConflict
-
-				let conflict: ChangesetConflictHandlerConflict
-				do {
-					switch raw_conflict {
-					case SQLITE_CHANGESET_DATA:
-						let operation = try ChangesetOperation(iter.unsafelyUnwrapped, true)
-						conflict = .data(operation)
-					case SQLITE_CHANGESET_NOTFOUND:
-						let operation = try ChangesetOperation(iter.unsafelyUnwrapped)
-						conflict = .notFound(operation)
-					case SQLITE_CHANGESET_CONFLICT:
-						let operation = try ChangesetOperation(iter.unsafelyUnwrapped, true)
-						conflict = .conflict(operation)
-					case SQLITE_CHANGESET_CONSTRAINT:
-						conflict = .constraint
-					case SQLITE_CHANGESET_FOREIGN_KEY:
-						var fk_conflicts: Int32 = 0
-						guard sqlite3changeset_fk_conflicts(iter.unsafelyUnwrapped, &fk_conflicts) == SQLITE_OK else {
-							return SQLITE_CHANGESET_ABORT
-						}
-						conflict = .foreignKey(Int(fk_conflicts))
-					default:
-						preconditionFailure("Unexpected conflict type")
-					}
-				}
-
-				catch let error {
-					os_log("Error processing changeset conflict: %{public}@", type: .info, (error as? SQLiteError)?.description ?? error.localizedDescription)
-					return SQLITE_CHANGESET_ABORT
-				}
-
-				let result = onConflict(conflict)
-				return result.rawValue
-			}, context_ptr, &rebaser, &size, options.rawValue)
+			return sqlite3changeset_apply_v2(db, Int32(changeset.data.count), ptr, changeset_apply_filter, changeset_apply_conflict, &context, &rebaser, &size, options.rawValue)
 		}
 		guard rc == SQLITE_OK else {
 			throw SQLiteError("Error applying changeset", code: rc)
@@ -620,6 +562,65 @@ extension Database {
 	}
 }
 
+/// The state passed to changeset application callbacks
+struct ChangesetApplyContext {
+	let isIncluded: ChangesetTableFilter?
+	let onConflict: ChangesetConflictHandler
+}
+
+/// The `xFilter` callback for changeset application
+func changeset_apply_filter(_ context: UnsafeMutableRawPointer?, _ table_name: UnsafePointer<Int8>?) -> Int32 {
+	let context_ptr = context.unsafelyUnwrapped.assumingMemoryBound(to: ChangesetApplyContext.self)
+
+	guard let isIncluded = context_ptr.pointee.isIncluded else {
+		return 1
+	}
+
+	let ptr = UnsafeMutableRawPointer(mutating: table_name.unsafelyUnwrapped)
+	let table = String(bytesNoCopy: ptr, length: strlen(table_name.unsafelyUnwrapped), encoding: .utf8, freeWhenDone: false).unsafelyUnwrapped
+//	let table = String(utf8String: table_name.unsafelyUnwrapped).unsafelyUnwrapped
+	return isIncluded(table) ? 1 : 0
+}
+
+/// The `xConflict` callback for changeset application
+func changeset_apply_conflict(_ context: UnsafeMutableRawPointer?, _ raw_conflict: Int32, _ iter: SQLiteChangesetIterator?) -> Int32 {
+	let context_ptr = context.unsafelyUnwrapped.assumingMemoryBound(to: ChangesetApplyContext.self)
+	let onConflict = context_ptr.pointee.onConflict
+
+	let conflict: ChangesetConflictHandlerConflict
+	do {
+		switch raw_conflict {
+		case SQLITE_CHANGESET_DATA:
+			let operation = try ChangesetOperation(iter.unsafelyUnwrapped, true)
+			conflict = .data(operation)
+		case SQLITE_CHANGESET_NOTFOUND:
+			let operation = try ChangesetOperation(iter.unsafelyUnwrapped)
+			conflict = .notFound(operation)
+		case SQLITE_CHANGESET_CONFLICT:
+			let operation = try ChangesetOperation(iter.unsafelyUnwrapped, true)
+			conflict = .conflict(operation)
+		case SQLITE_CHANGESET_CONSTRAINT:
+			conflict = .constraint
+		case SQLITE_CHANGESET_FOREIGN_KEY:
+			var fk_conflicts: Int32 = 0
+			guard sqlite3changeset_fk_conflicts(iter.unsafelyUnwrapped, &fk_conflicts) == SQLITE_OK else {
+				return SQLITE_CHANGESET_ABORT
+			}
+			conflict = .foreignKey(Int(fk_conflicts))
+		default:
+			preconditionFailure("Unexpected conflict type")
+		}
+	}
+
+	catch let error {
+		os_log("Error processing changeset conflict: %{public}@", type: .info, (error as? SQLiteError)?.description ?? error.localizedDescription)
+		return SQLITE_CHANGESET_ABORT
+	}
+
+	let result = onConflict(conflict)
+	return result.rawValue
+}
+
 extension ChangesetConflictHandlerResult: RawRepresentable {
 	public init?(rawValue: Int32) {
 		switch rawValue {
@@ -0,0 +1,635 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import os.log
+import Foundation
+import CSQLite
+
+/// A set of read-only databases with identical schemas queried in parallel.
+///
+/// A sharded database keeps one connection per shard, each pinned to its own serial dispatch queue.
+/// Queries are executed on all shards concurrently using `DispatchQueue.concurrentPerform` and the results
+/// are combined: ordered results using a streaming k-way merge and grouped results by combining partial aggregates.
+///
+/// Each operation executes within a read transaction on every shard. If snapshots are pinned using `pinSnapshots()`
+/// each shard holds a read transaction open and every operation executes within it, so successive operations
+/// see the same consistent state.
+///
+/// ```swift
+/// let shards = try ShardedDatabase(urls: monthlyURLs, label: "com.example.reports")
+/// try shards.merge(sql: "select day, total from sales order by day;", orderBy: [.init(column: 0)]) { row in
+///     // Rows from all shards in `day` order
+/// }
+/// ```
+///
+/// - note: Operations on a sharded database are serialized; each operation is parallelized across shards.
+///
+/// - attention: Sharded database operations may not be nested.
+public final class ShardedDatabase {
+	/// A shard connection and the dispatch queue to which it is pinned
+	final class Shard {
+		/// The underlying database
+		let database: Database
+		/// The dispatch queue used to serialize access to `database`
+		let queue: DispatchQueue
+		/// `true` if a read transaction is held open to pin the shard's state
+		var isPinned = false
+
+		init(database: Database, queue: DispatchQueue) {
+			self.database = database
+			self.queue = queue
+		}
+
+		/// Begins a read transaction unless one is held open by `pin()`.
+		///
+		/// - note: Must be called on `queue`
+		func beginReadTransaction() throws {
+			if !isPinned {
+				try database.beginReadTransaction()
+			}
+		}
+
+		/// Ends a read transaction begun by `beginReadTransaction()`.
+		///
+		/// - note: Must be called on `queue`
+		func endReadTransaction() {
+			if !isPinned {
+				try? database.endReadTransaction()
+			}
+		}
+
+		/// Begins a read transaction that is held open until `unpin()` is called.
+		///
+		/// - note: Must be called on `queue`
+		func pin() throws {
+			unpin()
+			try database.beginReadTransaction()
+			do {
+				// A read transaction observes a specific state once the database is first read
+				_ = try database.prepare(sql: "PRAGMA schema_version;").front() as Int64
+			}
+			catch let error {
+				try? database.endReadTransaction()
+				throw error
+			}
+			isPinned = true
+		}
+
+		/// Ends the read transaction begun by `pin()`, if any.
+		///
+		/// - note: Must be called on `queue`
+		func unpin() {
+			if isPinned {
+				isPinned = false
+				try? database.endReadTransaction()
+			}
+		}
+	}
+
+	/// A result ordering term
+	public struct SortKey {
+		/// The index of the result column
+		public let column: Int
+		/// `true` for descending order
+		public let isDescending: Bool
+
+		/// Creates a sort key.
+		///
+		/// - parameter column: The index of the result column
+		/// - parameter descending: `true` for descending order
+		public init(column: Int, descending: Bool = false) {
+			self.column = column
+			self.isDescending = descending
+		}
+	}
+
+	/// A partial aggregate that may be combined across shards
+	public enum Aggregate {
+		/// The partial values are counts and are summed
+		case count
+		/// The partial values are sums and are summed
+		case sum
+		/// The minimum of the partial values
+		case min
+		/// The maximum of the partial values
+		case max
+	}
+
+	/// The shards
+	let shards: [Shard]
+
+	/// The lock serializing operations
+	let lock = NSLock()
+
+	/// Creates a sharded database from database files.
+	///
+	/// - parameter urls: The locations of the shards
+	/// - parameter immutable: Whether the shards should be opened using `Database(immutableReadingFrom:configuration:)`
+	/// - parameter label: The label used as a prefix for the labels of the shards' queues
+	/// - parameter qos: The quality of service class for the work performed by the shards
+	///
+	/// - throws: An error if a database could not be opened
+	public init(urls: [URL], immutable: Bool = false, label: String, qos: DispatchQoS = .default) throws {
+		precondition(!urls.isEmpty, "A sharded database requires at least one shard")
+		self.shards = try urls.enumerated().map { i, url in
+			let database = immutable ? try Database(immutableReadingFrom: url) : try Database(readingFrom: url)
+			return Shard(database: database, queue: DispatchQueue(label: "\(label).shard.\(i)", qos: qos))
+		}
+		MemoryReleaseRegistry.shared.register(self)
+	}
+
+	/// Creates a sharded database from existing databases.
+	///
+	/// - attention: The sharded database takes ownership of `databases`.  The result of further use of `databases` is undefined.
+	///
+	/// - parameter databases: The shards
+	/// - parameter label: The label used as a prefix for the labels of the shards' queues
+	/// - parameter qos: The quality of service class for the work performed by the shards
+	public init(databases: [Database], label: String, qos: DispatchQoS = .default) {
+		precondition(!databases.isEmpty, "A sharded database requires at least one shard")
+		self.shards = databases.enumerated().map { i, database in
+			return Shard(database: database, queue: DispatchQueue(label: "\(label).shard.\(i)", qos: qos))
+		}
+		MemoryReleaseRegistry.shared.register(self)
+	}
+
+	/// The number of shards
+	public var shardCount: Int {
+		return shards.count
+	}
+
+	/// Runs `body` for each shard in parallel and throws the first error, if any.
+	///
+	/// - parameter body: A closure executed for each shard index
+	func forEachShard(_ body: (_ index: Int) throws -> Void) throws {
+		var errors = [Swift.Error?](repeating: nil, count: shards.count)
+		errors.withUnsafeMutableBufferPointer { errors in
+			DispatchQueue.concurrentPerform(iterations: shards.count) { i in
+				do {
+					try body(i)
+				}
+				catch let error {
+					errors[i] = error
+				}
+			}
+		}
+		if let error = errors.lazy.compactMap({ $0 }).first {
+			throw error
+		}
+	}
+
+	/// Pins every shard to a snapshot of its current state.
+	///
+	/// Each shard holds a read transaction open and subsequent operations execute within it, observing
+	/// the pinned state until `unpinSnapshots()` is called.
+	///
+	/// - important: In WAL mode the open read transactions prevent checkpoints from completing, so the shards'
+	/// WAL files grow until `unpinSnapshots()` is called.  In rollback journal mode they prevent writers from committing.
+	///
+	/// - throws: An error if a read transaction could not be started, in which case no shards are pinned
+	public func pinSnapshots() throws {
+		lock.lock()
+		defer {
+			lock.unlock()
+		}
+		do {
+			try forEachShard { i in
+				let shard = shards[i]
+				try shard.queue.sync {
+					try shard.pin()
+				}
+			}
+		}
+		catch let error {
+			for shard in shards {
+				shard.queue.sync {
+					shard.unpin()
+				}
+			}
+			throw error
+		}
+	}
+
+	/// Removes any pinned snapshots so subsequent operations observe the latest state of each shard.
+	public func unpinSnapshots() {
+		lock.lock()
+		defer {
+			lock.unlock()
+		}
+		for shard in shards {
+			shard.queue.sync {
+				shard.unpin()
+			}
+		}
+	}
+
+	/// Performs a read operation on every shard in parallel.
+	///
+	/// `block` is executed within a read transaction on each shard.
+	///
+	/// - parameter block: A closure performing the database operation
+	/// - parameter shard: The index of the shard
+	/// - parameter database: A `Database` used for database access within `block`
+	///
+	/// - throws: The first error thrown in `block` or an error if a read transaction could not be started
+	///
+	/// - returns: The values returned by `block` in shard order
+	public func read<T>(_ block: (_ shard: Int, _ database: Database) throws -> T) throws -> [T] {
+		lock.lock()
+		defer {
+			lock.unlock()
+		}
+
+		var results = [T?](repeating: nil, count: shards.count)
+		try results.withUnsafeMutableBufferPointer { results in
+			try forEachShard { i in
+				let shard = shards[i]
+				results[i] = try shard.queue.sync {
+					try shard.beginReadTransaction()
+					defer {
+						shard.endReadTransaction()
+					}
+					return try block(i, shard.database)
+				}
+			}
+		}
+		return results.map { $0! }
+	}
+
+	/// Executes `sql` on every shard and passes the combined result rows to `block` in order.
+	///
+	/// Each shard's results must already be ordered by `orderBy`.  Shards fill batches of rows in parallel
+	/// and prefetch the next batch while the current batch is merged, so memory use is proportional
+	/// to `batchSize` and the number of shards rather than to the number of result rows.
+	///
+	/// - note: Text is compared using the `BINARY` collation
+	///
+	/// - parameter sql: The SQL statement to execute on each shard
+	/// - parameter values: Values to bind to the statement's SQL parameters
+	/// - parameter orderBy: The ordering of the results
+	/// - parameter batchSize: The maximum number of rows read from a shard at once
+	/// - parameter block: A closure applied to each result row
+	/// - parameter row: The values of the row's columns
+	///
+	/// - throws: An error if `sql` could not be executed on a shard or any error thrown in `block`
+	public func merge(sql: String, parameterValues values: [ParameterBindable?] = [], orderBy: [SortKey], batchSize: Int = 256, _ block: (_ row: [DatabaseValue]) throws -> Void) throws {
+		precondition(batchSize > 0, "batchSize must be positive")
+		lock.lock()
+		defer {
+			lock.unlock()
+		}
+
+		let cursors = shards.map { MergeCursor(shard: $0, batchSize: batchSize) }
+		defer {
+			for cursor in cursors {
+				cursor.close()
+			}
+		}
+
+		try forEachShard { i in
+			try cursors[i].open(sql: sql, parameterValues: values)
+		}
+
+		let precedes = { (lhs: MergeCursor, rhs: MergeCursor) -> Bool in
+			return ShardedDatabase.compare(lhs.current, rhs.current, orderBy) < 0
+		}
+
+		var heap = MergeHeap(cursors.filter({ !$0.isAtEnd }), precedes)
+		while let cursor = heap.first {
+			try block(cursor.current)
+			try cursor.advance()
+			if cursor.isAtEnd {
+				heap.removeFirst()
+			}
+			else {
+				heap.siftDownFirst()
+			}
+		}
+	}
+
+	/// Executes `sql` on every shard and combines the partial aggregates for each group.
+	///
+	/// The result columns of `sql` must consist of `groupColumnCount` grouping columns followed by one column
+	/// for each element of `aggregates`, and the results must be ordered by the grouping columns:
+	///
+	/// ```swift
+	/// try shards.aggregate(sql: "select region, count(*), sum(total), max(total) from sales group by region order by region;",
+	///                      groupColumnCount: 1, aggregates: [.count, .sum, .max]) { row in
+	///     // One row per region combining all shards
+	/// }
+	/// ```
+	///
+	/// - note: Averages may be computed from combined `count` and `sum` aggregates
+	///
+	/// - parameter sql: The SQL statement to execute on each shard
+	/// - parameter values: Values to bind to the statement's SQL parameters
+	/// - parameter groupColumnCount: The number of grouping columns
+	/// - parameter aggregates: The partial aggregates following the grouping columns
+	/// - parameter block: A closure applied to each combined group
+	/// - parameter row: The grouping columns followed by the combined aggregates
+	///
+	/// - throws: An error if `sql` could not be executed on a shard or any error thrown in `block`
+	public func aggregate(sql: String, parameterValues values: [ParameterBindable?] = [], groupColumnCount: Int, aggregates: [Aggregate], _ block: (_ row: [DatabaseValue]) throws -> Void) throws {
+		let orderBy = (0 ..< groupColumnCount).map { SortKey(column: $0) }
+		let columnCount = groupColumnCount + aggregates.count
+
+		var group: [DatabaseValue]? = nil
+		try merge(sql: sql, parameterValues: values, orderBy: orderBy) { row in
+			guard row.count >= columnCount else {
+				throw DatabaseError("Row contains \(row.count) columns but \(columnCount) were expected")
+			}
+
+			if var current = group {
+				if ShardedDatabase.compare(current, row, orderBy) == 0 {
+					for (i, aggregate) in aggregates.enumerated() {
+						let column = groupColumnCount + i
+						current[column] = ShardedDatabase.combine(current[column], row[column], aggregate)
+					}
+					group = current
+					return
+				}
+				try block(current)
+			}
+			group = Array(row[0 ..< columnCount])
+		}
+
+		if let current = group {
+			try block(current)
+		}
+	}
+}
+
+extension ShardedDatabase: MemoryReleasing {
+	func releaseMemory() {
+		for shard in shards {
+			shard.queue.async {
+				try? shard.database.releaseMemory()
+			}
+		}
+	}
+}
+
+extension ShardedDatabase {
+	/// Compares two values using SQLite's ordering for the `BINARY` collation.
+	///
+	/// `NULL` values precede numeric values, which precede text, which precedes BLOBs.
+	///
+	/// - returns: A negative value if `lhs` precedes `rhs`, zero if they are equal, and a positive value otherwise
+	static func compare(_ lhs: DatabaseValue, _ rhs: DatabaseValue) -> Int {
+		func rank(_ value: DatabaseValue) -> Int {
+			switch value {
+			case .null:				return 0
+			case .integer, .float:	return 1
+			case .text:				return 2
+			case .blob:				return 3
+			}
+		}
+
+		switch (lhs, rhs) {
+		case (.null, .null):
+			return 0
+		case (.integer(let l), .integer(let r)):
+			return l < r ? -1 : (l > r ? 1 : 0)
+		case (.integer(let l), .float(let r)):
+			return Double(l) < r ? -1 : (Double(l) > r ? 1 : 0)
+		case (.float(let l), .integer(let r)):
+			return l < Double(r) ? -1 : (l > Double(r) ? 1 : 0)
+		case (.float(let l), .float(let r)):
+			return l < r ? -1 : (l > r ? 1 : 0)
+		case (.text(let l), .text(let r)):
+			return l.utf8.lexicographicallyPrecedes(r.utf8) ? -1 : (r.utf8.lexicographicallyPrecedes(l.utf8) ? 1 : 0)
+		case (.blob(let l), .blob(let r)):
+			return l.lexicographicallyPrecedes(r) ? -1 : (r.lexicographicallyPrecedes(l) ? 1 : 0)
+		default:
+			return rank(lhs) - rank(rhs)
+		}
+	}
+
+	/// Compares two rows using `orderBy`.
+	static func compare(_ lhs: [DatabaseValue], _ rhs: [DatabaseValue], _ orderBy: [SortKey]) -> Int {
+		for key in orderBy {
+			let result = compare(lhs[key.column], rhs[key.column])
+			if result != 0 {
+				return key.isDescending ? -result : result
+			}
+		}
+		return 0
+	}
+
+	/// Combines two partial aggregates.
+	static func combine(_ lhs: DatabaseValue, _ rhs: DatabaseValue, _ aggregate: Aggregate) -> DatabaseValue {
+		// NULL partial aggregates are produced by groups without non-NULL values
+		if case .null = lhs {
+			return rhs
+		}
+		if case .null = rhs {
+			return lhs
+		}
+
+		switch aggregate {
+		case .count, .sum:
+			if case .integer(let l) = lhs, case .integer(let r) = rhs {
+				let (sum, overflow) = l.addingReportingOverflow(r)
+				if !overflow {
+					return .integer(sum)
+				}
+			}
+			return .float(numericValue(lhs) + numericValue(rhs))
+		case .min:
+			return compare(rhs, lhs) < 0 ? rhs : lhs
+		case .max:
+			return compare(rhs, lhs) > 0 ? rhs : lhs
+		}
+	}
+
+	/// Returns the numeric value of `value` or `0` if not numeric
+	static func numericValue(_ value: DatabaseValue) -> Double {
+		switch value {
+		case .integer(let i):	return Double(i)
+		case .float(let f):		return f
+		default:				return 0
+		}
+	}
+}
+
+/// A cursor over the ordered results of a statement on one shard
+final class MergeCursor {
+	/// The shard
+	let shard: ShardedDatabase.Shard
+	/// The maximum number of rows in a batch
+	let batchSize: Int
+	/// The statement, which must only be used and released on the shard's queue
+	var statement: Statement?
+	/// `true` if a read transaction is active on the shard
+	var isInTransaction = false
+
+	/// The current batch
+	var batch = [[DatabaseValue]]()
+	/// The index of the current row in `batch`
+	var index = 0
+	/// `true` if no rows remain after `batch`
+	var isExhausted = false
+
+	/// The batch being prefetched on the shard's queue
+	var pending = [[DatabaseValue]]()
+	/// `true` if no rows remain after `pending`
+	var pendingIsExhausted = false
+	/// An error that occurred while prefetching
+	var pendingError: Swift.Error?
+
+	init(shard: ShardedDatabase.Shard, batchSize: Int) {
+		self.shard = shard
+		self.batchSize = batchSize
+		batch.reserveCapacity(batchSize)
+		pending.reserveCapacity(batchSize)
+	}
+
+	/// The current row
+	var current: [DatabaseValue] {
+		return batch[index]
+	}
+
+	/// `true` if all rows have been consumed
+	var isAtEnd: Bool {
+		return index >= batch.count && isExhausted
+	}
+
+	/// Begins a read transaction, prepares the statement and reads the first batch.
+	func open(sql: String, parameterValues values: [ParameterBindable?]) throws {
+		try shard.queue.sync {
+			try shard.beginReadTransaction()
+			isInTransaction = true
+			let statement = try shard.database.prepare(sql: sql)
+			try statement.bind(parameterValues: values)
+			self.statement = statement
+			try fill(&batch, &isExhausted)
+		}
+		prefetch()
+	}
+
+	/// Reads the next batch of rows into `rows`.
+	///
+	/// - note: Must be called on the shard's queue
+	func fill(_ rows: inout [[DatabaseValue]], _ exhausted: inout Bool) throws {
+		rows.removeAll(keepingCapacity: true)
+		guard let statement = statement else {
+			exhausted = true
+			return
+		}
+		while rows.count < batchSize {
+			guard let row = try statement.nextRow() else {
+				exhausted = true
+				return
+			}
+			var values = [DatabaseValue]()
+			values.reserveCapacity(row.columnCount)
+			for i in 0 ..< row.columnCount {
+				values.append(try row.value(at: i))
+			}
+			rows.append(values)
+		}
+	}
+
+	/// Begins reading the next batch on the shard's queue.
+	func prefetch() {
+		guard !isExhausted else {
+			return
+		}
+		shard.queue.async {
+			do {
+				try self.fill(&self.pending, &self.pendingIsExhausted)
+			}
+			catch let error {
+				self.pendingError = error
+			}
+		}
+	}
+
+	/// Moves to the next row, waiting for the prefetched batch if required.
+	func advance() throws {
+		index += 1
+		guard index >= batch.count, !isExhausted else {
+			return
+		}
+
+		// Wait for the prefetch to complete
+		shard.queue.sync {
+		}
+		if let error = pendingError {
+			throw error
+		}
+		swap(&batch, &pending)
+		isExhausted = pendingIsExhausted
+		index = 0
+		prefetch()
+	}
+
+	/// Releases the statement and ends the read transaction.
+	func close() {
+		shard.queue.sync {
+			statement = nil
+			if isInTransaction {
+				shard.endReadTransaction()
+				isInTransaction = false
+			}
+		}
+	}
+}
+
+/// A binary min-heap of merge cursors
+struct MergeHeap {
+	/// The heap storage
+	var elements: [MergeCursor]
+	/// Returns `true` if the first cursor's row precedes the second's
+	let precedes: (MergeCursor, MergeCursor) -> Bool
+
+	init(_ elements: [MergeCursor], _ precedes: @escaping (MergeCursor, MergeCursor) -> Bool) {
+		self.elements = elements
+		self.precedes = precedes
+		for i in stride(from: elements.count / 2 - 1, through: 0, by: -1) {
+			siftDown(i)
+		}
+	}
+
+	/// The cursor with the least current row
+	var first: MergeCursor? {
+		return elements.first
+	}
+
+	/// Removes the first cursor
+	mutating func removeFirst() {
+		elements.swapAt(0, elements.count - 1)
+		elements.removeLast()
+		if !elements.isEmpty {
+			siftDown(0)
+		}
+	}
+
+	/// Restores the heap after the first cursor has advanced
+	mutating func siftDownFirst() {
+		siftDown(0)
+	}
+
+	mutating func siftDown(_ index: Int) {
+		var parent = index
+		while true {
+			let left = 2 * parent + 1
+			let right = left + 1
+			var least = parent
+			if left < elements.count && precedes(elements[left], elements[least]) {
+				least = left
+			}
+			if right < elements.count && precedes(elements[right], elements[least]) {
+				least = right
+			}
+			if least == parent {
+				return
+			}
+			elements.swapAt(parent, least)
+			parent = least
+		}
+	}
+}
@@ -0,0 +1,459 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import os.log
+import Foundation
+import CSQLite
+
+/// A database pool whose readers all observe the same snapshot of the database.
+///
+/// Reads are grouped into generations.  Every read in a generation observes the same `Snapshot`,
+/// regardless of which reader connection performs it or of writes committed in the meantime.
+/// A dedicated anchor connection holds a read transaction on the current snapshot so it remains
+/// available to readers; when the snapshot is advanced the anchor's transaction is restarted
+/// and the previous snapshot is released as soon as reads using it complete.
+///
+/// Because at most one generation is anchored at a time, readers never hold back checkpoints for
+/// longer than the refresh policy allows and the write-ahead log does not grow without bound.
+/// With `RefreshPolicy.manual` the anchored snapshot pins the write-ahead log until `refreshSnapshot()`
+/// is called, so checkpoints can't reset the log and it grows with every commit in the meantime.
+///
+/// ```swift
+/// let pool = try SnapshotDatabasePool(url: url, refreshPolicy: .interval(.milliseconds(50)), label: "com.example.pool")
+/// try pool.write { db in
+///     try db.execute(sql: "insert into t1 default values;")
+/// }
+/// let rowCount: Int = try pool.read { db in
+///     try db.prepare(sql: "select count(*) from t1;").front()
+/// }
+/// ```
+///
+/// - note: The pool installs a write-ahead log commit hook on the writer connection.  The hook performs the
+/// automatic checkpoints that SQLite would otherwise perform.
+///
+/// - attention: Database pool operations may not be nested.
+///
+/// - seealso: [Database Snapshot](https://www.sqlite.org/c3ref/snapshot.html)
+public final class SnapshotDatabasePool {
+	/// Policies controlling when the pool's snapshot is advanced
+	public enum RefreshPolicy {
+		/// The snapshot is only advanced by `refreshSnapshot()`
+		///
+		/// - attention: The write-ahead log can't be reset while a snapshot is anchored, so it grows
+		/// without bound unless `refreshSnapshot()` is called periodically.
+		case manual
+		/// The snapshot is advanced after each transaction committed on the writer
+		case afterCommit
+		/// The snapshot is advanced periodically if transactions have been committed on the writer
+		case interval(DispatchTimeInterval)
+	}
+
+	/// A connection and the dispatch queue to which it is pinned
+	final class Reader {
+		/// The underlying read-only database
+		let database: Database
+		/// The dispatch queue used to serialize access to `database`
+		let queue: DispatchQueue
+
+		init(database: Database, queue: DispatchQueue) {
+			self.database = database
+			self.queue = queue
+		}
+	}
+
+	/// A snapshot shared by the reads in a generation
+	final class Generation {
+		/// The generation number
+		let number: UInt64
+		/// The snapshot or `nil` if a snapshot could not be recorded
+		let snapshot: Snapshot?
+
+		init(number: UInt64, snapshot: Snapshot?) {
+			self.number = number
+			self.snapshot = snapshot
+		}
+	}
+
+	/// The underlying writer database
+	let writer: Database
+	/// The dispatch queue used to serialize access to the writer connection
+	public let writeQueue: DispatchQueue
+
+	/// The connection holding a read transaction on the current snapshot
+	let anchor: Reader
+	/// `true` if `anchor` has an active read transaction
+	var isAnchored = false
+
+	/// The reader connections
+	let readers: [Reader]
+	/// Reader connections available for checkout
+	var availableReaders: [Reader]
+	/// A semaphore counting the reader connections available for checkout
+	let readerSemaphore: DispatchSemaphore
+
+	/// The current generation
+	var generation: Generation
+	/// `true` if transactions have been committed since the current snapshot was recorded
+	var isStale = false
+	/// `true` if a snapshot refresh has been submitted to the anchor's queue
+	var isRefreshScheduled = false
+	/// The lock protecting `availableReaders`, `generation`, `isStale`, and `isRefreshScheduled`
+	let lock = NSLock()
+
+	/// The refresh policy
+	public let refreshPolicy: RefreshPolicy
+	/// The timer used by `RefreshPolicy.interval`
+	var timer: DispatchSourceTimer?
+	/// The write-ahead log size in pages triggering an automatic checkpoint, or `0` if disabled
+	let autoCheckpointPageCount: Int
+
+	/// The key used to identify dispatch queues owned by the pool
+	let queueKey = DispatchSpecificKey<ObjectIdentifier>()
+
+	/// Creates a snapshot database pool for the database in a file.
+	///
+	/// The database is created if it doesn't exist and is placed in WAL mode.
+	///
+	/// - parameter url: The location of the SQLite database
+	/// - parameter maximumReaderCount: The number of reader connections in the pool
+	/// - parameter refreshPolicy: The policy controlling when the snapshot is advanced
+	/// - parameter label: The label used as a prefix for the labels of the pool's queues
+	/// - parameter qos: The quality of service class for the work performed by the pool
+	///
+	/// - throws: An error if the database could not be opened or placed in WAL mode
+	public init(url: URL, maximumReaderCount: Int = 4, refreshPolicy: RefreshPolicy = .afterCommit, label: String, qos: DispatchQoS = .default) throws {
+		precondition(maximumReaderCount > 0, "A database pool requires at least one reader")
+
+		let writer = try Database(url: url)
+		let journalMode: String = try writer.prepare(sql: "PRAGMA journal_mode = WAL;").front()
+		guard journalMode.lowercased() == "wal" else {
+			throw DatabaseError("Unable to place database \(url) in WAL mode")
+		}
+
+		self.writer = writer
+		self.writeQueue = DispatchQueue(label: "\(label).writer", qos: qos)
+		self.autoCheckpointPageCount = try writer.prepare(sql: "PRAGMA wal_autocheckpoint;").front()
+
+		self.anchor = Reader(database: try Database(readingFrom: url), queue: DispatchQueue(label: "\(label).anchor", qos: qos))
+
+		var readers = [Reader]()
+		for i in 0 ..< maximumReaderCount {
+			let database = try Database(readingFrom: url)
+			let queue = DispatchQueue(label: "\(label).reader.\(i)", qos: qos)
+			readers.append(Reader(database: database, queue: queue))
+		}
+
+		self.readers = readers
+		self.availableReaders = readers
+		self.readerSemaphore = DispatchSemaphore(value: maximumReaderCount)
+		self.generation = Generation(number: 0, snapshot: nil)
+		self.refreshPolicy = refreshPolicy
+
+		let identifier = ObjectIdentifier(self)
+		writeQueue.setSpecific(key: queueKey, value: identifier)
+		anchor.queue.setSpecific(key: queueKey, value: identifier)
+		for reader in readers {
+			reader.queue.setSpecific(key: queueKey, value: identifier)
+		}
+
+		anchor.queue.sync {
+			advanceGeneration()
+		}
+
+		// Installing a write-ahead log commit hook disables automatic checkpoints
+		writer.setWALCommitHook { [weak self] _, pageCount in
+			guard let self = self else {
+				return SQLITE_OK
+			}
+			self.transactionCommitted()
+			if self.autoCheckpointPageCount > 0 && pageCount >= self.autoCheckpointPageCount {
+				try? self.writer.walCheckpoint(type: .passive)
+			}
+			return SQLITE_OK
+		}
+
+		if case .interval(let interval) = refreshPolicy {
+			let timer = DispatchSource.makeTimerSource(queue: anchor.queue)
+			timer.schedule(deadline: .now() + interval, repeating: interval)
+			timer.setEventHandler { [weak self] in
+				guard let self = self else {
+					return
+				}
+				self.lock.lock()
+				let isStale = self.isStale
+				self.lock.unlock()
+				if isStale {
+					self.advanceGeneration()
+				}
+			}
+			timer.resume()
+			self.timer = timer
+		}
+
+		MemoryReleaseRegistry.shared.register(self)
+	}
+
+	deinit {
+		timer?.cancel()
+		writer.removeWALCommitHook()
+		if isAnchored {
+			try? anchor.database.endReadTransaction()
+		}
+	}
+
+	/// The number of reader connections in the pool
+	public var maximumReaderCount: Int {
+		return readers.count
+	}
+
+	/// The current generation number
+	///
+	/// The generation number is incremented each time the snapshot is advanced.
+	public var generationNumber: UInt64 {
+		lock.lock()
+		defer {
+			lock.unlock()
+		}
+		return generation.number
+	}
+
+	/// `true` if the current thread is executing a block on one of the pool's connections
+	var isExecutingOnPoolQueue: Bool {
+		return DispatchQueue.getSpecific(key: queueKey) == ObjectIdentifier(self)
+	}
+
+	/// Notes that a transaction was committed on the writer and schedules a refresh if required.
+	///
+	/// - note: Must be called on `writeQueue`
+	func transactionCommitted() {
+		lock.lock()
+		isStale = true
+		var scheduleRefresh = false
+		if case .afterCommit = refreshPolicy, !isRefreshScheduled {
+			isRefreshScheduled = true
+			scheduleRefresh = true
+		}
+		lock.unlock()
+
+		if scheduleRefresh {
+			anchor.queue.async {
+				self.advanceGeneration()
+			}
+		}
+	}
+
+	/// Restarts the anchor's read transaction and publishes a new generation for its snapshot.
+	///
+	/// - note: Must be called on `anchor.queue`
+	func advanceGeneration() {
+		lock.lock()
+		isStale = false
+		isRefreshScheduled = false
+		lock.unlock()
+
+		let database = anchor.database
+		if isAnchored {
+			try? database.endReadTransaction()
+			isAnchored = false
+		}
+
+		var snapshot: Snapshot? = nil
+		do {
+			try database.beginReadTransaction()
+			isAnchored = true
+			// A snapshot may only be recorded once the read transaction has started
+			_ = try database.prepare(sql: "PRAGMA schema_version;").front() as Int64
+			snapshot = try database.takeSnapshot()
+		}
+		catch let error {
+			// A snapshot is unavailable until a transaction has been committed to the write-ahead log
+			os_log("Unable to record database snapshot: %{public}@", type: .debug, String(describing: error))
+			if isAnchored {
+				try? database.endReadTransaction()
+				isAnchored = false
+			}
+		}
+
+		lock.lock()
+		generation = Generation(number: generation.number + 1, snapshot: snapshot)
+		lock.unlock()
+	}
+
+	/// Advances the pool's snapshot to the current state of the database.
+	///
+	/// Reads started after this method returns observe a new generation.
+	public func refreshSnapshot() {
+		precondition(!isExecutingOnPoolQueue, "Database pool operations may not be nested")
+		anchor.queue.sync {
+			advanceGeneration()
+		}
+	}
+
+	/// Removes and returns an available reader, waiting for one if necessary.
+	func checkoutReader() -> Reader {
+		precondition(!isExecutingOnPoolQueue, "Database pool operations may not be nested")
+		readerSemaphore.wait()
+		lock.lock()
+		let reader = availableReaders.removeLast()
+		lock.unlock()
+		return reader
+	}
+
+	/// Returns a reader previously obtained from `checkoutReader()` to the pool.
+	func checkinReader(_ reader: Reader) {
+		lock.lock()
+		availableReaders.append(reader)
+		lock.unlock()
+		readerSemaphore.signal()
+	}
+
+	/// Performs a synchronous read operation on one of the pool's reader connections.
+	///
+	/// `block` is executed within a read transaction on the current generation's snapshot.
+	///
+	/// - note: If all readers are in use this method blocks until one becomes available.
+	///
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	///
+	/// - throws: Any error thrown in `block` or an error if the read transaction could not be started
+	///
+	/// - returns: The value returned by `block`
+	public func read<T>(_ block: (_ database: Database) throws -> (T)) throws -> T {
+		let reader = checkoutReader()
+		defer {
+			checkinReader(reader)
+		}
+
+		return try reader.queue.sync {
+			let database = reader.database
+			try beginSnapshotReadTransaction(on: database)
+			defer {
+				try? database.endReadTransaction()
+			}
+			return try block(database)
+		}
+	}
+
+	/// Starts a read transaction on `database` using the current generation's snapshot.
+	///
+	/// A generation's snapshot is held by the anchor only until the next generation is published.  If the
+	/// generation is superseded before its snapshot is opened the snapshot may no longer be available, in
+	/// which case the read transaction is restarted on the current generation.
+	///
+	/// - note: Must be called on the queue of the reader owning `database`
+	///
+	/// - throws: An error if the read transaction could not be started or the snapshot could not be opened
+	func beginSnapshotReadTransaction(on database: Database) throws {
+		lock.lock()
+		var generation = self.generation
+		lock.unlock()
+
+		while true {
+			try database.beginReadTransaction()
+			guard let snapshot = generation.snapshot else {
+				return
+			}
+			do {
+				try database.openSnapshot(snapshot)
+				return
+			}
+			catch let error {
+				try? database.endReadTransaction()
+
+				// Wait for an advance in progress to publish its generation
+				anchor.queue.sync {}
+
+				lock.lock()
+				let current = self.generation
+				lock.unlock()
+
+				guard current !== generation else {
+					throw error
+				}
+				generation = current
+			}
+		}
+	}
+
+	/// Submits an asynchronous read operation to one of the pool's reader connections.
+	///
+	/// - parameter group: An optional `DispatchGroup` with which to associate `block`
+	/// - parameter qos: The quality of service for `block`
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	public func asyncRead(group: DispatchGroup? = nil, qos: DispatchQoS = .default, block: @escaping (_ database: Database) -> (Void)) {
+		DispatchQueue.global(qos: qos.qosClass).async(group: group) {
+			do {
+				try self.read(block)
+			}
+			catch let error as Error {
+				os_log("Error performing database read: %{public}@", type: .info, String(describing: error))
+			}
+			catch let error {
+				os_log("Error performing database read: %{public}@", type: .info, error.localizedDescription)
+			}
+		}
+	}
+
+	/// Performs a synchronous write operation on the pool's writer connection.
+	///
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	///
+	/// - throws: Any error thrown in `block`
+	///
+	/// - returns: The value returned by `block`
+	public func write<T>(_ block: (_ database: Database) throws -> (T)) rethrows -> T {
+		precondition(!isExecutingOnPoolQueue, "Database pool operations may not be nested")
+		return try writeQueue.sync {
+			return try block(self.writer)
+		}
+	}
+
+	/// Submits an asynchronous write operation to the pool's writer connection.
+	///
+	/// - parameter group: An optional `DispatchGroup` with which to associate `block`
+	/// - parameter qos: The quality of service for `block`
+	/// - parameter block: A closure performing the database operation
+	/// - parameter database: A `Database` used for database access within `block`
+	public func asyncWrite(group: DispatchGroup? = nil, qos: DispatchQoS = .default, block: @escaping (_ database: Database) -> (Void)) {
+		writeQueue.async(group: group, qos: qos) {
+			block(self.writer)
+		}
+	}
+
+	/// Performs a synchronous transaction on the pool's writer connection.
+	///
+	/// - parameter type: The type of transaction to perform
+	/// - parameter block: A closure performing the database operation
+	///
+	/// - throws: Any error thrown in `block` or an error if the transaction could not be started, rolled back, or committed
+	///
+	/// - note: If `block` throws an error the transaction will be rolled back and the error will be re-thrown
+	/// - note: If an error occurs committing the transaction a rollback will be attempted and the error will be re-thrown
+	public func writeTransaction(type: Database.TransactionType = .immediate, _ block: Database.TransactionBlock) throws {
+		try write { db in
+			try db.transaction(type: type, block)
+		}
+	}
+}
+
+extension SnapshotDatabasePool: MemoryReleasing {
+	func releaseMemory() {
+		writeQueue.async {
+			try? self.writer.releaseMemory()
+		}
+		anchor.queue.async {
+			try? self.anchor.database.releaseMemory()
+		}
+		for reader in readers {
+			reader.queue.async {
+				try? reader.database.releaseMemory()
+			}
+		}
+	}
+}
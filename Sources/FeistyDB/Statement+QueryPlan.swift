@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// The query plan chosen by SQLite for a statement, as reported by `EXPLAIN QUERY PLAN`.
+///
+/// ```swift
+/// let statement = try db.prepare(sql: "select * from orders where customer_id = ?;")
+/// let plan = try statement.explainQueryPlan()
+/// precondition(plan.fullScans.isEmpty, "Query plan regressed:\n\(plan)")
+/// ```
+///
+/// - seealso: [EXPLAIN QUERY PLAN](https://www.sqlite.org/eqp.html)
+public struct QueryPlan {
+	/// An element of a query plan.
+	public struct Node {
+		/// The node id, unique within the plan
+		public let id: Int
+		/// The id of the parent node, or `0` for a top-level node
+		public let parentID: Int
+		/// A description of the step, such as `SEARCH t1 USING INDEX t1_a (a=?)`
+		public let detail: String
+		/// The node's child steps
+		public internal(set) var children: [Node]
+		/// Runtime metrics for the step if it has executed and scan status is available
+		public internal(set) var scanStatus: Statement.ScanStatus?
+
+		/// `true` if the step visits every row of a table or index
+		public var isFullScan: Bool {
+			return detail.hasPrefix("SCAN ")
+		}
+	}
+
+	/// The top-level steps of the plan
+	public let nodes: [Node]
+
+	/// All steps of the plan in depth-first order
+	public var allNodes: [Node] {
+		var result = [Node]()
+		func visit(_ nodes: [Node]) {
+			for node in nodes {
+				result.append(node)
+				visit(node.children)
+			}
+		}
+		visit(nodes)
+		return result
+	}
+
+	/// The steps of the plan that visit every row of a table or index
+	public var fullScans: [Node] {
+		return allNodes.filter { $0.isFullScan }
+	}
+}
+
+extension QueryPlan: CustomStringConvertible {
+	/// The plan formatted as an indented tree, including any scan status metrics.
+	public var description: String {
+		var lines = [String]()
+		func visit(_ nodes: [Node], depth: Int) {
+			for node in nodes {
+				var line = String(repeating: "  ", count: depth) + node.detail
+				if let status = node.scanStatus, let rowsVisited = status.rowsVisited, let loopCount = status.loopCount {
+					line += " (loops=\(loopCount) rows=\(rowsVisited)"
+					if let estimatedRows = status.estimatedRows {
+						line += " est=\(estimatedRows)"
+					}
+					line += ")"
+				}
+				lines.append(line)
+				visit(node.children, depth: depth + 1)
+			}
+		}
+		visit(nodes, depth: 0)
+		return lines.joined(separator: "\n")
+	}
+}
+
+extension Statement {
+	/// Returns the query plan for the statement.
+	///
+	/// The plan is obtained by compiling the statement's SQL prefixed by `EXPLAIN QUERY PLAN`.  Bound parameters are
+	/// not carried over; because the plan may depend on parameter values, representative values may be supplied
+	/// in `parameterValues`.
+	///
+	/// When SQLite is compiled with `SQLITE_ENABLE_STMT_SCANSTATUS`, each step that has been executed includes the
+	/// metrics accumulated by `self` since the last call to `resetScanStatus()`.
+	///
+	/// - parameter parameterValues: Values bound to the SQL parameters while planning
+	///
+	/// - throws: An error if the plan could not be obtained
+	///
+	/// - returns: The statement's query plan
+	///
+	/// - seealso: [EXPLAIN QUERY PLAN](https://www.sqlite.org/eqp.html)
+	public func explainQueryPlan(parameterValues: [ParameterBindable?] = []) throws -> QueryPlan {
+		let explain = try Statement(database: database, sql: "EXPLAIN QUERY PLAN " + sql)
+		if !parameterValues.isEmpty {
+			try explain.bind(parameterValues: parameterValues)
+		}
+
+		var statusesBySelectID = [Int: ScanStatus]()
+		for status in scanStatus() {
+			statusesBySelectID[status.selectID] = status
+		}
+
+		// The result columns are `id`, `parent`, `notused`, and `detail`, with parents preceding their children
+		var childIDs = [Int: [Int]]()
+		var rootIDs = [Int]()
+		var nodesByID = [Int: QueryPlan.Node]()
+		try explain.results { row in
+			let id: Int = try row.value(at: 0)
+			let parentID: Int = try row.value(at: 1)
+			let detail: String = try row.value(at: 3)
+			nodesByID[id] = QueryPlan.Node(id: id, parentID: parentID, detail: detail, children: [], scanStatus: statusesBySelectID[id])
+			if nodesByID[parentID] != nil {
+				childIDs[parentID, default: []].append(id)
+			}
+			else {
+				rootIDs.append(id)
+			}
+		}
+
+		func makeNode(_ id: Int) -> QueryPlan.Node {
+			var node = nodesByID[id]!
+			node.children = childIDs[id, default: []].map(makeNode)
+			return node
+		}
+
+		return QueryPlan(nodes: rootIDs.map(makeNode))
+	}
+}
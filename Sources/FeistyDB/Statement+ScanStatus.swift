@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+extension Statement {
+	/// Runtime metrics for one element of a statement's query plan.
+	///
+	/// - seealso: [Prepared Statement Scan Status](https://www.sqlite.org/c3ref/stmt_scanstatus.html)
+	public struct ScanStatus {
+		/// The name of the table or index used, if any
+		public let name: String?
+		/// The `EXPLAIN QUERY PLAN` description of the element
+		public let explain: String?
+		/// The `EXPLAIN QUERY PLAN` node id of the element
+		public let selectID: Int
+		/// The number of times the loop was run, or `nil` if the element is not a loop
+		public let loopCount: Int64?
+		/// The number of rows visited by the loop across all runs, or `nil` if the element is not a loop
+		public let rowsVisited: Int64?
+		/// The query planner's estimate of the rows visited per run of the loop, or `nil` if the element is not a loop
+		public let estimatedRows: Double?
+	}
+
+	/// `true` if SQLite was compiled with `SQLITE_ENABLE_STMT_SCANSTATUS` so `scanStatus()` returns metrics
+	public static let scanStatusIsAvailable = sqlite3_compileoption_used("ENABLE_STMT_SCANSTATUS") != 0
+
+	/// Returns runtime metrics for each element of the statement's query plan.
+	///
+	/// Metrics accumulate across executions until `resetScanStatus()` is called.
+	///
+	/// - note: This requires SQLite compiled with `SQLITE_ENABLE_STMT_SCANSTATUS`; otherwise an empty array is returned.
+	///
+	/// - returns: The metrics for each loop, in the order reported by SQLite
+	///
+	/// - seealso: [Prepared Statement Scan Status](https://www.sqlite.org/c3ref/stmt_scanstatus.html)
+	public func scanStatus() -> [ScanStatus] {
+		func int64(_ idx: Int32, _ op: Int32) -> Int64? {
+			var value: Int64 = -1
+			guard feisty_db_sqlite3_stmt_scanstatus(stmt, idx, op, &value) == 0, value >= 0 else {
+				return nil
+			}
+			return value
+		}
+
+		func string(_ idx: Int32, _ op: Int32) -> String? {
+			var value: UnsafePointer<Int8>? = nil
+			guard feisty_db_sqlite3_stmt_scanstatus(stmt, idx, op, &value) == 0, let s = value else {
+				return nil
+			}
+			return String(cString: s)
+		}
+
+		var statuses = [ScanStatus]()
+		var idx: Int32 = 0
+		// An out of range index is indicated by a non-zero result
+		var selectID: Int32 = 0
+		while feisty_db_sqlite3_stmt_scanstatus(stmt, idx, SQLITE_SCANSTAT_SELECTID, &selectID) == 0 {
+			let loopCount = int64(idx, SQLITE_SCANSTAT_NLOOP)
+			var estimatedRows: Double = -1
+			let hasEstimate = feisty_db_sqlite3_stmt_scanstatus(stmt, idx, SQLITE_SCANSTAT_EST, &estimatedRows) == 0 && estimatedRows >= 0
+			statuses.append(ScanStatus(name: string(idx, SQLITE_SCANSTAT_NAME),
+									   explain: string(idx, SQLITE_SCANSTAT_EXPLAIN),
+									   selectID: Int(selectID),
+									   loopCount: loopCount,
+									   rowsVisited: loopCount != nil ? int64(idx, SQLITE_SCANSTAT_NVISIT) : nil,
+									   estimatedRows: loopCount != nil && hasEstimate ? estimatedRows : nil))
+			idx += 1
+		}
+		return statuses
+	}
+
+	/// Resets the metrics returned by `scanStatus()`.
+	///
+	/// - seealso: [Zero Scan-Status Counters](https://www.sqlite.org/c3ref/stmt_scanstatus_reset.html)
+	public func resetScanStatus() {
+		feisty_db_sqlite3_stmt_scanstatus_reset(stmt)
+	}
+}
@@ -62,25 +62,47 @@ public final class Statement {
 	/// The underlying `sqlite3_stmt *` object
 	let stmt: SQLitePreparedStatement
 
+	/// The key under which `stmt` is returned to the owning database's statement cache or `nil` if the statement isn't cached
+	let cacheKey: String?
+
 	/// Creates a compiled SQL statement.
 	///
 	/// - parameter database: The owning database
 	/// - parameter sql: The SQL statement to compile
+	/// - parameter prepareFlags: Flags passed to `sqlite3_prepare_v3()`
+	/// - parameter cacheKey: The key under which the statement should be returned to the statement cache or `nil`
 	///
 	/// - throws: An error if `sql` could not be compiled
-	init(database: Database, sql: String) throws {
+	init(database: Database, sql: String, prepareFlags: UInt32 = 0, cacheKey: String? = nil) throws {
 		self.database = database
+		self.cacheKey = cacheKey
 
 		var stmt: SQLitePreparedStatement? = nil
-		guard sqlite3_prepare_v2(database.db, sql, -1, &stmt, nil) == SQLITE_OK else {
+		guard sqlite3_prepare_v3(database.db, sql, -1, prepareFlags, &stmt, nil) == SQLITE_OK else {
 			throw SQLiteError("Error preparing SQL \"\(sql)\"", takingDescriptionFromDatabase: database.db)
 		}
 
 		self.stmt = stmt!
 	}
 
+	/// Creates a statement from a compiled SQL statement obtained from the statement cache.
+	///
+	/// - parameter database: The owning database
+	/// - parameter stmt: An `sqlite3_stmt *` object
+	/// - parameter cacheKey: The key under which the statement should be returned to the statement cache
+	init(database: Database, cachedStatement stmt: SQLitePreparedStatement, cacheKey: String) {
+		self.database = database
+		self.stmt = stmt
+		self.cacheKey = cacheKey
+	}
+
 	deinit {
-		sqlite3_finalize(stmt)
+		if let key = cacheKey, let cache = database.statementCache {
+			cache.insert(stmt, forKey: key)
+		}
+		else {
+			sqlite3_finalize(stmt)
+		}
 	}
 
 	/// `true` if this statement makes no direct changes to the database, `false` otherwise.
@@ -128,6 +150,12 @@ public final class Statement {
 		return map
 	}()
 
+	/// The column indexes of the coding keys of `Decodable` types decoded using `RowDecoder`
+	var decodingPlans = [ObjectIdentifier: CodingPlan]()
+
+	/// The parameter indexes of the coding keys of `Encodable` types bound using `ParameterEncoder`
+	var encodingPlans = [ObjectIdentifier: CodingPlan]()
+
 	/// Returns the name of the column at `index`.
 	///
 	/// - note: Column indexes are 0-based.  The leftmost column in a result row has index 0.
@@ -0,0 +1,283 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+/// A constraint on a virtual table column considered by the query planner.
+///
+/// - seealso: [The xBestIndex Method](https://www.sqlite.org/vtab.html#the_xbestindex_method)
+public struct VirtualTableConstraint {
+	/// Constraint operators.
+	///
+	/// - seealso: [Virtual Table Constraint Operator Codes](https://www.sqlite.org/c3ref/c_index_constraint_eq.html)
+	public enum Operator: Equatable {
+		/// `=`, which is also used for `IN` constraints
+		case equal
+		/// `>`
+		case greaterThan
+		/// `<=`
+		case lessThanOrEqual
+		/// `<`
+		case lessThan
+		/// `>=`
+		case greaterThanOrEqual
+		/// `MATCH`
+		case match
+		/// `LIKE`
+		case like
+		/// `GLOB`
+		case glob
+		/// `REGEXP`
+		case regexp
+		/// `!=` or `<>`
+		case notEqual
+		/// `IS NOT`
+		case isNot
+		/// `IS NOT NULL`
+		case isNotNull
+		/// `IS NULL`
+		case isNull
+		/// `IS`
+		case `is`
+		/// `LIMIT`, only reported by SQLite 3.38.0 and later
+		case limit
+		/// `OFFSET`, only reported by SQLite 3.38.0 and later
+		case offset
+		/// A function overloaded by `xFindFunction`
+		case function(UInt8)
+
+		/// Creates an operator from an SQLite constraint operator code
+		init(_ op: UInt8) {
+			switch Int32(op) {
+			case SQLITE_INDEX_CONSTRAINT_EQ:			self = .equal
+			case SQLITE_INDEX_CONSTRAINT_GT:			self = .greaterThan
+			case SQLITE_INDEX_CONSTRAINT_LE:			self = .lessThanOrEqual
+			case SQLITE_INDEX_CONSTRAINT_LT:			self = .lessThan
+			case SQLITE_INDEX_CONSTRAINT_GE:			self = .greaterThanOrEqual
+			case SQLITE_INDEX_CONSTRAINT_MATCH:			self = .match
+			case SQLITE_INDEX_CONSTRAINT_LIKE:			self = .like
+			case SQLITE_INDEX_CONSTRAINT_GLOB:			self = .glob
+			case SQLITE_INDEX_CONSTRAINT_REGEXP:		self = .regexp
+			case SQLITE_INDEX_CONSTRAINT_NE:			self = .notEqual
+			case SQLITE_INDEX_CONSTRAINT_ISNOT:			self = .isNot
+			case SQLITE_INDEX_CONSTRAINT_ISNOTNULL:		self = .isNotNull
+			case SQLITE_INDEX_CONSTRAINT_ISNULL:		self = .isNull
+			case SQLITE_INDEX_CONSTRAINT_IS:			self = .is
+			case SQLITE_INDEX_CONSTRAINT_LIMIT:			self = .limit
+			case SQLITE_INDEX_CONSTRAINT_OFFSET:		self = .offset
+			default:									self = .function(op)
+			}
+		}
+	}
+
+	/// The position of the constraint in `sqlite3_index_info.aConstraint`
+	public let index: Int
+	/// The constrained column, or `-1` for the rowid
+	public let column: Int32
+	/// The constraint operator
+	public let op: Operator
+	/// `true` if the constraint may be used in the query plan being evaluated
+	public let isUsable: Bool
+}
+
+/// An `ORDER BY` term considered by the query planner.
+public struct VirtualTableOrderBy {
+	/// The column, or `-1` for the rowid
+	public let column: Int32
+	/// `true` for descending order
+	public let isDescending: Bool
+}
+
+/// Typed access to virtual table query planning information.
+///
+/// These helpers are intended for use within `VirtualTableModule.bestIndex(_:)` and `BatchedVirtualTableModule.bestIndex(_:)`.
+/// The estimated cost and estimated rows are set directly using `estimatedCost` and `estimatedRows`.
+///
+/// ```swift
+/// func bestIndex(_ indexInfo: inout sqlite3_index_info) -> VirtualTableModuleBestIndexResult {
+///     var argumentIndex: Int32 = 1
+///     for constraint in indexInfo.constraints where constraint.isUsable && constraint.column == 0 && constraint.op == .equal {
+///         indexInfo.use(constraint, argumentIndex: argumentIndex, omit: true)
+///         argumentIndex += 1
+///         indexInfo.isUniqueScan = true
+///         indexInfo.estimatedCost = 1
+///         indexInfo.estimatedRows = 1
+///     }
+///     return .ok
+/// }
+/// ```
+///
+/// - important: Methods that pass the index information to SQLite, such as `collation(for:)` and `handleInList(_:allAtOnce:)`,
+/// must only be called on the `sqlite3_index_info` passed to `bestIndex(_:)` and never on a copy.
+///
+/// - seealso: [The xBestIndex Method](https://www.sqlite.org/vtab.html#the_xbestindex_method)
+extension sqlite3_index_info {
+	/// The constraints on the virtual table
+	public var constraints: [VirtualTableConstraint] {
+		let constraints = UnsafeBufferPointer(start: aConstraint, count: Int(nConstraint))
+		return constraints.enumerated().map { i, constraint in
+			return VirtualTableConstraint(index: i, column: constraint.iColumn, op: VirtualTableConstraint.Operator(constraint.op), isUsable: constraint.usable != 0)
+		}
+	}
+
+	/// The `ORDER BY` terms of the query
+	public var orderByTerms: [VirtualTableOrderBy] {
+		let orderBy = UnsafeBufferPointer(start: aOrderBy, count: Int(nOrderBy))
+		return orderBy.map { VirtualTableOrderBy(column: $0.iColumn, isDescending: $0.desc != 0) }
+	}
+
+	/// A mask of the columns used by the statement; bit 63 is set if any column beyond the 63rd is used
+	public var columnsUsed: UInt64 {
+		return colUsed
+	}
+
+	/// Passes the right-hand operand of `constraint` to `filter()`.
+	///
+	/// - requires: `argumentIndex` is 1-based and argument indexes are assigned contiguously
+	///
+	/// - parameter constraint: The constraint to use
+	/// - parameter argumentIndex: The 1-based position of the constraint's value in the arguments passed to `filter()`
+	/// - parameter omit: Whether SQLite may skip checking the constraint because the cursor guarantees it
+	public mutating func use(_ constraint: VirtualTableConstraint, argumentIndex: Int32, omit: Bool = false) {
+		precondition(constraint.index >= 0 && constraint.index < Int(nConstraint), "Constraint index out of bounds")
+		let usage = aConstraintUsage.unsafelyUnwrapped + constraint.index
+		usage.pointee.argvIndex = argumentIndex
+		usage.pointee.omit = omit ? 1 : 0
+	}
+
+	/// The index number passed to `filter()`
+	public var indexNumber: Int32 {
+		get {
+			return idxNum
+		}
+		set {
+			idxNum = newValue
+		}
+	}
+
+	/// Sets the index name passed to `filter()`.
+	///
+	/// - parameter name: The index name
+	public mutating func setIndexName(_ name: String?) {
+		if needToFreeIdxStr != 0 {
+			sqlite3_free(idxStr)
+		}
+		if let name = name {
+			idxStr = feisty_db_sqlite3_strdup(name)
+			needToFreeIdxStr = 1
+		}
+		else {
+			idxStr = nil
+			needToFreeIdxStr = 0
+		}
+	}
+
+	/// Whether the cursor will return rows in the order specified by `orderByTerms`
+	public var isOrderByConsumed: Bool {
+		get {
+			return orderByConsumed != 0
+		}
+		set {
+			orderByConsumed = newValue ? 1 : 0
+		}
+	}
+
+	/// Whether the query plan visits at most one row
+	public var isUniqueScan: Bool {
+		get {
+			return idxFlags & SQLITE_INDEX_SCAN_UNIQUE != 0
+		}
+		set {
+			if newValue {
+				idxFlags |= SQLITE_INDEX_SCAN_UNIQUE
+			}
+			else {
+				idxFlags &= ~SQLITE_INDEX_SCAN_UNIQUE
+			}
+		}
+	}
+
+	/// Returns the name of the collating sequence used to evaluate `constraint`.
+	///
+	/// - parameter constraint: The constraint of interest
+	///
+	/// - seealso: [Determine The Collation For a Virtual Table Constraint](https://www.sqlite.org/c3ref/vtab_collation.html)
+	public mutating func collation(for constraint: VirtualTableConstraint) -> String? {
+		return withUnsafeMutablePointer(to: &self) { indexInfo in
+			return sqlite3_vtab_collation(indexInfo, Int32(constraint.index)).map { String(cString: $0) }
+		}
+	}
+
+	/// Requests that the values of an `IN` operator constraint be passed to `filter()` all at once.
+	///
+	/// When the request is granted the argument for `constraint` is a list whose values are read using
+	/// `SQLArguments.valuesInList(at:)`.  Otherwise `filter()` is invoked once for each value.
+	///
+	/// - note: This requires SQLite 3.38.0 or later.  With earlier versions no `IN` constraints are detected
+	/// and this method always returns `false`.
+	///
+	/// - parameter constraint: A constraint using the `.equal` operator
+	/// - parameter allAtOnce: Whether the values should be passed to `filter()` all at once
+	///
+	/// - returns: `true` if `constraint` is an `IN` operator that may be processed all at once
+	///
+	/// - seealso: [Identify and handle IN constraints in xBestIndex](https://www.sqlite.org/c3ref/vtab_in.html)
+	@discardableResult public mutating func handleInList(_ constraint: VirtualTableConstraint, allAtOnce: Bool = true) -> Bool {
+		return withUnsafeMutablePointer(to: &self) { indexInfo in
+			return feisty_db_sqlite3_vtab_in(indexInfo, Int32(constraint.index), allAtOnce ? 1 : 0) != 0
+		}
+	}
+
+	/// Returns the right-hand operand of `constraint` if it is known during query planning.
+	///
+	/// This is useful for `.limit` and `.offset` constraints with constant values.
+	///
+	/// - note: This requires SQLite 3.38.0 or later. With earlier versions `nil` is always returned.
+	///
+	/// - parameter constraint: The constraint of interest
+	///
+	/// - returns: The right-hand operand of `constraint` or `nil` if it is not available
+	///
+	/// - seealso: [Constraint values in xBestIndex()](https://www.sqlite.org/c3ref/vtab_rhs_value.html)
+	public mutating func rightHandValue(for constraint: VirtualTableConstraint) -> DatabaseValue? {
+		return withUnsafeMutablePointer(to: &self) { indexInfo -> DatabaseValue? in
+			var value: SQLiteValue?
+			guard feisty_db_sqlite3_vtab_rhs_value(indexInfo, Int32(constraint.index), &value) == SQLITE_OK, let rhs = value else {
+				return nil
+			}
+			return DatabaseValue(rhs)
+		}
+	}
+}
+
+extension SQLArguments {
+	/// Returns the values of an `IN` operator list passed all at once.
+	///
+	/// - requires: The constraint for the argument at `index` was accepted by `sqlite3_index_info.handleInList(_:allAtOnce:)`
+	///
+	/// - parameter index: The index of the argument containing the list
+	///
+	/// - throws: An error if the argument is not an `IN` operator list
+	///
+	/// - returns: The values in the list
+	///
+	/// - seealso: [Find all elements on the right-hand side of an IN constraint](https://www.sqlite.org/c3ref/vtab_in_first.html)
+	public func valuesInList(at index: Int) throws -> [DatabaseValue] {
+		let list = value(at: index)
+		var values = [DatabaseValue]()
+		var value: SQLiteValue?
+		var rc = feisty_db_sqlite3_vtab_in_first(list, &value)
+		while rc == SQLITE_OK, let element = value {
+			values.append(DatabaseValue(element))
+			rc = feisty_db_sqlite3_vtab_in_next(list, &value)
+		}
+		guard rc == SQLITE_OK || rc == SQLITE_DONE else {
+			throw SQLiteError("Error reading IN operator list", code: rc)
+		}
+		return values
+	}
+}
@@ -0,0 +1,312 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import os.log
+import Foundation
+import CSQLite
+
+/// Performs write-ahead log checkpoints on a background connection.
+///
+/// A checkpoint scheduler observes commits on a writer connection using a write-ahead log commit hook.
+/// When the log grows beyond `Policy.passiveThreshold` frames a passive checkpoint is performed on the
+/// scheduler's own connection so the writer is not delayed.  When no transactions have been committed for
+/// `Policy.idleInterval` a more thorough checkpoint is performed so the log can be restarted or truncated.
+///
+/// ```swift
+/// let queue = try DatabaseQueue(url: url, configuration: .init(journalMode: .wal), label: "com.example.db")
+/// let scheduler = try WALCheckpointScheduler(url: url, label: "com.example.checkpoint")
+/// scheduler.attach(to: queue)
+/// ```
+///
+/// - note: Attaching a scheduler to a connection replaces its write-ahead log commit hook and disables
+/// automatic checkpoints on the connection.
+///
+/// - seealso: [Checkpoint Starvation](https://www.sqlite.org/wal.html#avoiding_excessively_large_wal_files)
+public final class WALCheckpointScheduler {
+	/// The conditions under which checkpoints are performed
+	public struct Policy {
+		/// The number of frames in the write-ahead log triggering a passive checkpoint
+		public var passiveThreshold: Int
+		/// The time in seconds without commits after which an idle checkpoint is performed
+		public var idleInterval: TimeInterval
+		/// The type of checkpoint performed after `idleInterval`
+		public var idleCheckpointType: Database.WALCheckpointType
+		/// The maximum time in milliseconds an idle checkpoint waits for readers and writers
+		public var busyTimeout: Int
+
+		/// Creates a checkpoint policy.
+		///
+		/// - parameter passiveThreshold: The number of frames in the write-ahead log triggering a passive checkpoint
+		/// - parameter idleInterval: The time in seconds without commits after which an idle checkpoint is performed
+		/// - parameter idleCheckpointType: The type of checkpoint performed after `idleInterval`
+		/// - parameter busyTimeout: The maximum time in milliseconds an idle checkpoint waits for readers and writers
+		public init(passiveThreshold: Int = 1000, idleInterval: TimeInterval = 1, idleCheckpointType: Database.WALCheckpointType = .truncate, busyTimeout: Int = 100) {
+			precondition(passiveThreshold > 0, "passiveThreshold must be positive")
+			self.passiveThreshold = passiveThreshold
+			self.idleInterval = idleInterval
+			self.idleCheckpointType = idleCheckpointType
+			self.busyTimeout = busyTimeout
+		}
+	}
+
+	/// The result of a checkpoint
+	public struct Checkpoint {
+		/// The type of checkpoint
+		public let type: Database.WALCheckpointType
+		/// The time in seconds taken by the checkpoint
+		public let duration: TimeInterval
+		/// The number of frames in the write-ahead log, or `nil` if the checkpoint failed
+		public let logFrameCount: Int?
+		/// The number of frames backfilled into the database, or `nil` if the checkpoint failed
+		public let checkpointedFrameCount: Int?
+	}
+
+	/// Cumulative checkpoint statistics
+	public struct Metrics {
+		/// The number of checkpoints performed
+		public internal(set) var checkpointCount = 0
+		/// The number of checkpoints that failed, typically because readers or writers were active
+		public internal(set) var failedCheckpointCount = 0
+		/// The total time in seconds spent performing checkpoints
+		public internal(set) var totalDuration: TimeInterval = 0
+		/// The total number of frames backfilled into the database
+		public internal(set) var checkpointedFrameCount = 0
+		/// The number of frames in the write-ahead log at the most recent commit
+		public internal(set) var logFrameCount = 0
+		/// The most recent checkpoint
+		public internal(set) var lastCheckpoint: Checkpoint?
+	}
+
+	/// The checkpoint policy
+	public let policy: Policy
+
+	/// The connection used to perform checkpoints
+	let database: Database
+	/// The dispatch queue used to serialize access to `database`
+	let queue: DispatchQueue
+
+	/// The lock protecting the mutable state
+	let lock = NSLock()
+	/// The metrics
+	var _metrics = Metrics()
+	/// The number of commits observed
+	var commitCount = 0
+	/// `true` if a passive checkpoint has been submitted to `queue`
+	var isPassiveCheckpointScheduled = false
+	/// `true` if an idle check has been submitted to `queue`
+	var isIdleCheckScheduled = false
+	/// `true` if the write-ahead log has frames that may not have been checkpointed
+	var hasUncheckpointedFrames = false
+	/// The number of frames in the current write-ahead log already counted in `_metrics.checkpointedFrameCount`
+	var countedFrameCount = 0
+
+	/// An optional closure called on the scheduler's queue after each checkpoint
+	public var checkpointHandler: ((_ checkpoint: Checkpoint) -> Void)? {
+		get {
+			lock.lock()
+			defer {
+				lock.unlock()
+			}
+			return _checkpointHandler
+		}
+		set {
+			lock.lock()
+			_checkpointHandler = newValue
+			lock.unlock()
+		}
+	}
+	var _checkpointHandler: ((_ checkpoint: Checkpoint) -> Void)?
+
+	/// Creates a checkpoint scheduler for the database in a file.
+	///
+	/// - requires: The database is in WAL mode
+	///
+	/// - parameter url: The location of the SQLite database
+	/// - parameter policy: The conditions under which checkpoints are performed
+	/// - parameter label: The label to attach to the scheduler's queue
+	/// - parameter qos: The quality of service class for checkpoints
+	///
+	/// - throws: An error if the database could not be opened
+	public init(url: URL, policy: Policy = Policy(), label: String, qos: DispatchQoS = .utility) throws {
+		self.database = try Database(url: url, create: false)
+		self.queue = DispatchQueue(label: label, qos: qos)
+		self.policy = policy
+		// The scheduler's connection must never perform checkpoints on commit
+		try database.setWALAutocheckpoint(pageCount: 0)
+		try database.setBusyTimeout(policy.busyTimeout)
+	}
+
+	/// Cumulative checkpoint statistics
+	public var metrics: Metrics {
+		lock.lock()
+		defer {
+			lock.unlock()
+		}
+		return _metrics
+	}
+
+	/// Installs a write-ahead log commit hook on `database` to schedule checkpoints.
+	///
+	/// - important: Must be called on the queue serializing access to `database`
+	///
+	/// - parameter database: A writer connection to the scheduler's database
+	public func attach(to database: Database) {
+		database.setWALCommitHook { [weak self] _, pageCount in
+			self?.transactionCommitted(logFrameCount: pageCount)
+			return SQLITE_OK
+		}
+	}
+
+	/// Installs a write-ahead log commit hook on the connection managed by `databaseQueue`.
+	///
+	/// - parameter databaseQueue: A database queue for the scheduler's database
+	public func attach(to databaseQueue: DatabaseQueue) {
+		databaseQueue.sync { database in
+			attach(to: database)
+		}
+	}
+
+	/// Installs a write-ahead log commit hook on the writer connection of `databasePool`.
+	///
+	/// - parameter databasePool: A database pool for the scheduler's database
+	public func attach(to databasePool: DatabasePool) {
+		databasePool.write { database in
+			attach(to: database)
+		}
+	}
+
+	/// Records a commit and schedules checkpoints as required.
+	///
+	/// - parameter logFrameCount: The number of frames in the write-ahead log
+	func transactionCommitted(logFrameCount: Int) {
+		lock.lock()
+		commitCount += 1
+		hasUncheckpointedFrames = true
+		// A shorter log indicates the write-ahead log was restarted from the beginning
+		if logFrameCount < _metrics.logFrameCount {
+			countedFrameCount = 0
+		}
+		_metrics.logFrameCount = logFrameCount
+
+		let schedulePassiveCheckpoint = logFrameCount >= policy.passiveThreshold && !isPassiveCheckpointScheduled
+		if schedulePassiveCheckpoint {
+			isPassiveCheckpointScheduled = true
+		}
+		let scheduleIdleCheck = !isIdleCheckScheduled
+		if scheduleIdleCheck {
+			isIdleCheckScheduled = true
+		}
+		let observedCommitCount = commitCount
+		lock.unlock()
+
+		if schedulePassiveCheckpoint {
+			queue.async {
+				self.lock.lock()
+				self.isPassiveCheckpointScheduled = false
+				self.lock.unlock()
+				self.performCheckpoint(type: .passive)
+			}
+		}
+		if scheduleIdleCheck {
+			scheduleIdleCheckpoint(after: observedCommitCount)
+		}
+	}
+
+	/// Performs an idle checkpoint if no commits occur within `policy.idleInterval`.
+	///
+	/// - parameter observedCommitCount: The commit count when the check was scheduled
+	func scheduleIdleCheckpoint(after observedCommitCount: Int) {
+		queue.asyncAfter(deadline: .now() + policy.idleInterval) { [weak self] in
+			guard let self = self else {
+				return
+			}
+
+			self.lock.lock()
+			let commitCount = self.commitCount
+			let isIdle = commitCount == observedCommitCount
+			if isIdle {
+				self.isIdleCheckScheduled = false
+			}
+			let hasUncheckpointedFrames = self.hasUncheckpointedFrames
+			self.lock.unlock()
+
+			guard isIdle else {
+				self.scheduleIdleCheckpoint(after: commitCount)
+				return
+			}
+			if hasUncheckpointedFrames {
+				self.performCheckpoint(type: self.policy.idleCheckpointType)
+			}
+		}
+	}
+
+	/// Performs a checkpoint on the scheduler's queue.
+	///
+	/// - parameter type: The type of checkpoint to perform
+	/// - parameter completion: A closure called with the result of the checkpoint
+	public func checkpoint(type: Database.WALCheckpointType = .passive, completion: ((_ checkpoint: Checkpoint) -> Void)? = nil) {
+		queue.async {
+			let checkpoint = self.performCheckpoint(type: type)
+			completion?(checkpoint)
+		}
+	}
+
+	/// Performs a checkpoint and updates the metrics.
+	///
+	/// - note: Must be called on `queue`
+	///
+	/// - parameter type: The type of checkpoint to perform
+	@discardableResult func performCheckpoint(type: Database.WALCheckpointType) -> Checkpoint {
+		lock.lock()
+		let commitCount = self.commitCount
+		lock.unlock()
+
+		let start = DispatchTime.now().uptimeNanoseconds
+		var result: (logFrameCount: Int, checkpointedFrameCount: Int)? = nil
+		do {
+			result = try database.walCheckpoint(type: type)
+		}
+		catch let error {
+			os_log("Error performing WAL checkpoint: %{public}@", type: .info, String(describing: error))
+		}
+		let duration = Double(DispatchTime.now().uptimeNanoseconds - start) / Double(NSEC_PER_SEC)
+
+		let checkpoint = Checkpoint(type: type, duration: duration, logFrameCount: result?.logFrameCount, checkpointedFrameCount: result?.checkpointedFrameCount)
+
+		lock.lock()
+		_metrics.checkpointCount += 1
+		_metrics.totalDuration += duration
+		_metrics.lastCheckpoint = checkpoint
+		if let result = result {
+			// The checkpointed frame count is cumulative for the current write-ahead log
+			if result.logFrameCount == 0 {
+				// The log was truncated or is empty, so the frames backfilled are those committed but not yet counted
+				_metrics.checkpointedFrameCount += max(_metrics.logFrameCount - countedFrameCount, 0)
+				countedFrameCount = 0
+				_metrics.logFrameCount = 0
+			}
+			else {
+				if result.checkpointedFrameCount < countedFrameCount {
+					countedFrameCount = 0
+				}
+				_metrics.checkpointedFrameCount += result.checkpointedFrameCount - countedFrameCount
+				countedFrameCount = result.checkpointedFrameCount
+			}
+			// Frames committed during the checkpoint may remain
+			if commitCount == self.commitCount && result.checkpointedFrameCount == result.logFrameCount {
+				hasUncheckpointedFrames = false
+			}
+		}
+		else {
+			_metrics.failedCheckpointCount += 1
+		}
+		let handler = _checkpointHandler
+		lock.unlock()
+
+		handler?(checkpoint)
+		return checkpoint
+	}
+}
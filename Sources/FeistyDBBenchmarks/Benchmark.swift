@@ -0,0 +1,199 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+import CMallocCounter
+
+/// One side of a paired benchmark
+struct Run {
+	/// An optional closure executed before each iteration and excluded from the measurement
+	let reset: (() throws -> Void)?
+	/// The measured closure
+	let body: () throws -> Void
+
+	init(reset: (() throws -> Void)? = nil, _ body: @escaping () throws -> Void) {
+		self.reset = reset
+		self.body = body
+	}
+}
+
+/// A workload prepared for a specific dataset size
+struct PreparedWorkload {
+	/// The number of operations performed by one iteration
+	let operations: Int
+	/// The number of rows produced or consumed by one iteration
+	let rows: Int
+	/// `true` if allocations can be attributed to the measured run
+	let countsAllocations: Bool
+	/// The FeistyDB implementation
+	let feistyDB: Run
+	/// The equivalent implementation using the SQLite C API
+	let sqlite: Run
+
+	init(operations: Int, rows: Int? = nil, countsAllocations: Bool = true, feistyDB: Run, sqlite: Run) {
+		self.operations = operations
+		self.rows = rows ?? operations
+		self.countsAllocations = countsAllocations
+		self.feistyDB = feistyDB
+		self.sqlite = sqlite
+	}
+}
+
+/// A named benchmark workload
+struct Workload {
+	/// The name of the workload
+	let name: String
+	/// A closure creating the workload for a dataset size
+	let prepare: (_ datasetSize: Int) throws -> PreparedWorkload
+}
+
+/// A benchmark measurement
+struct Measurement: Encodable {
+	/// The name of the workload
+	let workload: String
+	/// `feistydb` or `sqlite3`
+	let implementation: String
+	/// The number of rows in the dataset
+	let datasetSize: Int
+	/// The number of operations per iteration
+	let operations: Int
+	/// The number of measured iterations
+	let iterations: Int
+	/// The fastest iteration, in nanoseconds per operation
+	let nanosecondsPerOperation: Double
+	/// The median iteration, in nanoseconds per operation
+	let medianNanosecondsPerOperation: Double
+	/// The number of rows processed per second by the fastest iteration
+	let rowsPerSecond: Double
+	/// The number of SQLite allocator calls per operation, or `nil` if not measured
+	let sqliteAllocationsPerOperation: Double?
+	/// The number of process heap allocations per operation, or `nil` if not measured
+	let heapAllocationsPerOperation: Double?
+}
+
+/// Counts process heap allocations, including allocations made by Swift, Foundation and SQLite
+enum HeapAllocationCounter {
+	/// `true` if the counter is installed
+	static var isInstalled = false
+
+	/// The number of heap allocations since the counter was installed
+	static var count: UInt64 {
+		return feisty_db_malloc_counter_count()
+	}
+
+	/// Installs the counter.
+	static func install() {
+		isInstalled = feisty_db_malloc_counter_install() != 0
+	}
+}
+
+/// Counts calls to the SQLite allocator
+enum AllocationCounter {
+	/// The allocator in use before the counter was installed
+	static var underlying = sqlite3_mem_methods()
+	/// The number of calls to `xMalloc` and `xRealloc`
+	static var count = 0
+	/// `true` if the counter is installed
+	static var isInstalled = false
+
+	/// Installs the counter.
+	///
+	/// - important: Must be called before SQLite is initialized
+	static func install() {
+		guard feisty_db_sqlite3_config_getmalloc(&underlying) == SQLITE_OK else {
+			return
+		}
+		var methods = underlying
+		methods.xMalloc = { size in
+			AllocationCounter.count += 1
+			return AllocationCounter.underlying.xMalloc!(size)
+		}
+		methods.xRealloc = { pointer, size in
+			AllocationCounter.count += 1
+			return AllocationCounter.underlying.xRealloc!(pointer, size)
+		}
+		isInstalled = feisty_db_sqlite3_config_malloc(&methods) == SQLITE_OK
+	}
+}
+
+/// Executes workloads and reports measurements
+struct Benchmark {
+	/// The dataset sizes
+	let datasetSizes: [Int]
+	/// The number of measured iterations for each run
+	let iterations: Int
+	/// The workloads to execute
+	let workloads: [Workload]
+
+	/// Executes all workloads for all dataset sizes.
+	///
+	/// - parameter report: A closure receiving each measurement
+	func run(_ report: (Measurement) -> Void) throws {
+		for workload in workloads {
+			for size in datasetSizes {
+				let prepared = try workload.prepare(size)
+				report(try measure(workload.name, "feistydb", size, prepared, prepared.feistyDB))
+				report(try measure(workload.name, "sqlite3", size, prepared, prepared.sqlite))
+			}
+		}
+	}
+
+	/// Measures one side of a prepared workload.
+	func measure(_ name: String, _ implementation: String, _ size: Int, _ prepared: PreparedWorkload, _ run: Run) throws -> Measurement {
+		// Warm up caches and compiled statements
+		try run.reset?()
+		try run.body()
+
+		var durations = [UInt64]()
+		durations.reserveCapacity(iterations)
+		var allocations = 0
+		var heapAllocations: UInt64 = 0
+		for _ in 0 ..< iterations {
+			try run.reset?()
+			let allocationsBefore = AllocationCounter.count
+			let heapAllocationsBefore = HeapAllocationCounter.count
+			let start = DispatchTime.now().uptimeNanoseconds
+			try run.body()
+			durations.append(DispatchTime.now().uptimeNanoseconds - start)
+			heapAllocations += HeapAllocationCounter.count - heapAllocationsBefore
+			allocations += AllocationCounter.count - allocationsBefore
+		}
+		durations.sort()
+
+		let operations = Double(max(prepared.operations, 1))
+		let fastest = Double(durations.first!)
+		let median = Double(durations[durations.count / 2])
+		let countsAllocations = prepared.countsAllocations && AllocationCounter.isInstalled
+		let countsHeapAllocations = prepared.countsAllocations && HeapAllocationCounter.isInstalled
+		let totalOperations = operations * Double(iterations)
+
+		return Measurement(workload: name,
+						   implementation: implementation,
+						   datasetSize: size,
+						   operations: prepared.operations,
+						   iterations: iterations,
+						   nanosecondsPerOperation: fastest / operations,
+						   medianNanosecondsPerOperation: median / operations,
+						   rowsPerSecond: Double(prepared.rows) / (fastest / Double(NSEC_PER_SEC)),
+						   sqliteAllocationsPerOperation: countsAllocations ? Double(allocations) / totalOperations : nil,
+						   heapAllocationsPerOperation: countsHeapAllocations ? Double(heapAllocations) / totalOperations : nil)
+	}
+}
+
+/// A deterministic pseudo-random number generator so runs are comparable
+struct LinearCongruentialGenerator: RandomNumberGenerator {
+	var state: UInt64
+
+	init(seed: UInt64 = 0x5DEECE66D) {
+		self.state = seed
+	}
+
+	mutating func next() -> UInt64 {
+		state = state &* 6364136223846793005 &+ 1442695040888963407
+		return state
+	}
+}
@@ -0,0 +1,593 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+import FeistyDB
+
+/// Accumulates results so the optimizer can't discard the measured work
+var sink: Int64 = 0
+
+/// An error in the raw SQLite implementation of a workload
+struct BenchmarkError: Swift.Error, CustomStringConvertible {
+	let description: String
+}
+
+/// A connection using the SQLite C API directly
+final class RawConnection {
+	let db: OpaquePointer
+
+	init(path: String = ":memory:", flags: Int32 = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) throws {
+		var db: OpaquePointer?
+		guard sqlite3_open_v2(path, &db, flags, nil) == SQLITE_OK, let connection = db else {
+			sqlite3_close(db)
+			throw BenchmarkError(description: "Error opening \(path)")
+		}
+		self.db = connection
+	}
+
+	deinit {
+		sqlite3_close(db)
+	}
+
+	func execute(_ sql: String) throws {
+		guard sqlite3_exec(db, sql, nil, nil, nil) == SQLITE_OK else {
+			throw BenchmarkError(description: String(cString: sqlite3_errmsg(db)))
+		}
+	}
+
+	func prepare(_ sql: String) throws -> RawStatement {
+		var stmt: OpaquePointer?
+		guard sqlite3_prepare_v3(db, sql, -1, UInt32(SQLITE_PREPARE_PERSISTENT), &stmt, nil) == SQLITE_OK, let statement = stmt else {
+			throw BenchmarkError(description: String(cString: sqlite3_errmsg(db)))
+		}
+		return RawStatement(statement)
+	}
+}
+
+/// A statement using the SQLite C API directly
+final class RawStatement {
+	let stmt: OpaquePointer
+
+	init(_ stmt: OpaquePointer) {
+		self.stmt = stmt
+	}
+
+	deinit {
+		sqlite3_finalize(stmt)
+	}
+
+	func step() throws -> Bool {
+		switch sqlite3_step(stmt) {
+		case SQLITE_ROW:
+			return true
+		case SQLITE_DONE:
+			return false
+		default:
+			throw BenchmarkError(description: String(cString: sqlite3_errmsg(sqlite3_db_handle(stmt))))
+		}
+	}
+}
+
+/// Returns the SQL creating and populating table `t` with `count` rows
+func populateSQL(_ count: Int) -> String {
+	return """
+	create table t(id integer primary key, a integer, b text);
+	insert into t select value, value * 2, printf('row %d', value) from generate_series(1, \(count));
+	"""
+}
+
+/// The number of columns in the wide-row table
+let wideColumnCount = 16
+
+/// Returns the SQL creating and populating table `w` with `count` rows of `wideColumnCount` columns
+func populateWideSQL(_ count: Int) -> String {
+	let columns = (0 ..< wideColumnCount).map { "c\($0)" }.joined(separator: ", ")
+	let values = (0 ..< wideColumnCount).map { i -> String in
+		switch i % 3 {
+		case 0:		return "value + \(i)"
+		case 1:		return "value * 1.5 + \(i)"
+		default:	return "printf('text %d %d', value, \(i))"
+		}
+	}.joined(separator: ", ")
+	return """
+	create table w(\(columns));
+	insert into w select \(values) from generate_series(1, \(count));
+	"""
+}
+
+/// Words used to generate full-text documents
+let vocabulary = ["alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india", "juliet", "kilo", "lima", "mike", "november", "oscar", "papa", "quebec", "romeo", "sierra", "tango", "uniform", "victor", "whiskey", "xray", "yankee", "zulu", "amber", "basalt", "cobalt", "dune", "ember", "fjord"]
+
+/// Returns `count` generated documents of twelve words each
+func documents(_ count: Int) -> [String] {
+	var generator = LinearCongruentialGenerator()
+	return (0 ..< count).map { _ in
+		(0 ..< 12).map { _ in vocabulary.randomElement(using: &generator)! }.joined(separator: " ")
+	}
+}
+
+/// Returns `count` random row identifiers in `1 ... upperBound`
+func randomIDs(_ count: Int, upTo upperBound: Int) -> [Int64] {
+	var generator = LinearCongruentialGenerator()
+	return (0 ..< count).map { _ in Int64.random(in: 1 ... Int64(upperBound), using: &generator) }
+}
+
+/// An eponymous virtual table producing the integers `1 ... rowCount`
+final class NumbersModule: EponymousVirtualTableModule {
+	/// The number of rows produced
+	static var rowCount: Int64 = 0
+
+	final class Cursor: VirtualTableCursor {
+		var _rowid: Int64 = 1
+
+		func column(_ index: Int32) -> DatabaseValue {
+			return .integer(_rowid)
+		}
+
+		func next() {
+			_rowid += 1
+		}
+
+		func rowid() -> Int64 {
+			return _rowid
+		}
+
+		func filter(_ arguments: [DatabaseValue], indexNumber: Int32, indexName: String?) {
+			_rowid = 1
+		}
+
+		var eof: Bool {
+			return _rowid > NumbersModule.rowCount
+		}
+	}
+
+	required init(database: Database, arguments: [String]) {
+	}
+
+	var declaration: String {
+		return "CREATE TABLE x(value)"
+	}
+
+	var options: Database.VirtualTableModuleOptions {
+		return [.innocuous]
+	}
+
+	func bestIndex(_ indexInfo: inout sqlite3_index_info) -> VirtualTableModuleBestIndexResult {
+		return .ok
+	}
+
+	func openCursor() -> VirtualTableCursor {
+		return Cursor()
+	}
+}
+
+/// All workloads
+let allWorkloads: [Workload] = [
+	Workload(name: "point-lookup") { size in
+		let ids = randomIDs(10_000, upTo: size)
+
+		let db = try Database()
+		try db.execute(sql: populateSQL(size))
+		let statement = try db.prepare(sql: "select a from t where id = ?;")
+
+		let raw = try RawConnection()
+		try raw.execute(populateSQL(size))
+		let rawStatement = try raw.prepare("select a from t where id = ?;")
+
+		return PreparedWorkload(operations: ids.count, feistyDB: Run {
+			for id in ids {
+				try statement.bind(value: id, toParameter: 1)
+				if let row = try statement.nextRow() {
+					let a: Int64 = try row.value(at: 0)
+					sink &+= a
+				}
+				try statement.reset()
+			}
+		}, sqlite: Run {
+			let stmt = rawStatement.stmt
+			for id in ids {
+				sqlite3_bind_int64(stmt, 1, id)
+				if try rawStatement.step() {
+					sink &+= sqlite3_column_int64(stmt, 0)
+				}
+				sqlite3_reset(stmt)
+			}
+		})
+	},
+
+	Workload(name: "range-scan") { size in
+		let db = try Database()
+		try db.execute(sql: populateSQL(size))
+		let statement = try db.prepare(sql: "select a, b from t where id between ? and ?;")
+		try statement.bind(parameterValues: [1, size])
+
+		let raw = try RawConnection()
+		try raw.execute(populateSQL(size))
+		let rawStatement = try raw.prepare("select a, b from t where id between ? and ?;")
+		sqlite3_bind_int64(rawStatement.stmt, 1, 1)
+		sqlite3_bind_int64(rawStatement.stmt, 2, Int64(size))
+
+		return PreparedWorkload(operations: size, feistyDB: Run {
+			try statement.results { row in
+				let a: Int64 = try row.value(at: 0)
+				let b: String = try row.value(at: 1)
+				sink &+= a &+ Int64(b.utf8.count)
+			}
+			try statement.reset()
+		}, sqlite: Run {
+			let stmt = rawStatement.stmt
+			while try rawStatement.step() {
+				let a = sqlite3_column_int64(stmt, 0)
+				let b = String(cString: sqlite3_column_text(stmt, 1)!)
+				sink &+= a &+ Int64(b.utf8.count)
+			}
+			sqlite3_reset(stmt)
+		})
+	},
+
+	Workload(name: "wide-row-decode") { size in
+		let db = try Database()
+		try db.execute(sql: populateWideSQL(size))
+		let statement = try db.prepare(sql: "select * from w;")
+
+		let raw = try RawConnection()
+		try raw.execute(populateWideSQL(size))
+		let rawStatement = try raw.prepare("select * from w;")
+
+		return PreparedWorkload(operations: size, feistyDB: Run {
+			try statement.results { row in
+				for i in 0 ..< wideColumnCount {
+					switch i % 3 {
+					case 0:
+						let value: Int64 = try row.value(at: i)
+						sink &+= value
+					case 1:
+						let value: Double = try row.value(at: i)
+						sink &+= Int64(value)
+					default:
+						let value: String = try row.value(at: i)
+						sink &+= Int64(value.utf8.count)
+					}
+				}
+			}
+			try statement.reset()
+		}, sqlite: Run {
+			let stmt = rawStatement.stmt
+			while try rawStatement.step() {
+				for i in 0 ..< Int32(wideColumnCount) {
+					switch i % 3 {
+					case 0:
+						sink &+= sqlite3_column_int64(stmt, i)
+					case 1:
+						sink &+= Int64(sqlite3_column_double(stmt, i))
+					default:
+						let value = String(cString: sqlite3_column_text(stmt, i)!)
+						sink &+= Int64(value.utf8.count)
+					}
+				}
+			}
+			sqlite3_reset(stmt)
+		})
+	},
+
+	Workload(name: "blob-read") { size in
+		let count = min(size, 10_000)
+		let sql = "create table blobs(id integer primary key, data blob); insert into blobs select value, randomblob(4096) from generate_series(1, \(count));"
+
+		let db = try Database()
+		try db.execute(sql: sql)
+		let statement = try db.prepare(sql: "select data from blobs;")
+
+		let raw = try RawConnection()
+		try raw.execute(sql)
+		let rawStatement = try raw.prepare("select data from blobs;")
+
+		return PreparedWorkload(operations: count, feistyDB: Run {
+			try statement.results { row in
+				let data: Data = try row.value(at: 0)
+				sink &+= Int64(data.count)
+			}
+			try statement.reset()
+		}, sqlite: Run {
+			let stmt = rawStatement.stmt
+			while try rawStatement.step() {
+				let data = Data(bytes: sqlite3_column_blob(stmt, 0)!, count: Int(sqlite3_column_bytes(stmt, 0)))
+				sink &+= Int64(data.count)
+			}
+			sqlite3_reset(stmt)
+		})
+	},
+
+	Workload(name: "bulk-insert") { size in
+		let schema = "drop table if exists b; create table b(a, b, c);"
+
+		let db = try Database()
+		try db.execute(sql: schema)
+
+		let raw = try RawConnection()
+		try raw.execute(schema)
+
+		return PreparedWorkload(operations: size, feistyDB: Run(reset: {
+			try db.execute(sql: schema)
+		}) {
+			let statement = try db.prepare(sql: "insert into b(a, b, c) values (?, ?, ?);")
+			try db.transaction { db in
+				for i in 0 ..< size {
+					try statement.bind(value: i, toParameter: 1)
+					try statement.bind(value: Double(i) * 0.5, toParameter: 2)
+					try statement.bind(value: "value", toParameter: 3)
+					try statement.execute()
+					try statement.reset()
+				}
+				return .commit
+			}
+		}, sqlite: Run(reset: {
+			try raw.execute(schema)
+		}) {
+			let statement = try raw.prepare("insert into b(a, b, c) values (?, ?, ?);")
+			let stmt = statement.stmt
+			try raw.execute("begin;")
+			for i in 0 ..< size {
+				sqlite3_bind_int64(stmt, 1, Int64(i))
+				sqlite3_bind_double(stmt, 2, Double(i) * 0.5)
+				sqlite3_bind_text(stmt, 3, "value", -1, unsafeBitCast(-1, to: sqlite3_destructor_type.self))
+				_ = try statement.step()
+				sqlite3_reset(stmt)
+			}
+			try raw.execute("commit;")
+		})
+	},
+
+	Workload(name: "carray-in-list") { size in
+		var generator = LinearCongruentialGenerator()
+		let lists = (0 ..< 1_000).map { _ in
+			(0 ..< 100).map { _ in Int64.random(in: 1 ... Int64(size), using: &generator) }
+		}
+		let sql = "select count(*) from t where id in carray(?);"
+
+		let db = try Database()
+		try db.execute(sql: populateSQL(size))
+		let statement = try db.prepare(sql: sql)
+
+		let raw = try RawConnection()
+		try raw.execute(populateSQL(size))
+		let rawStatement = try raw.prepare(sql)
+
+		return PreparedWorkload(operations: lists.count, rows: lists.count * 100, feistyDB: Run {
+			for list in lists {
+				try statement.bind(array: list, toParameter: 1)
+				let count: Int64 = try statement.front()
+				sink &+= count
+				try statement.reset()
+			}
+		}, sqlite: Run {
+			let stmt = rawStatement.stmt
+			for list in lists {
+				list.withUnsafeBufferPointer { buffer in
+					_ = sqlite3_carray_bind(stmt, 1, UnsafeMutableRawPointer(mutating: buffer.baseAddress), Int32(buffer.count), CARRAY_INT64, unsafeBitCast(-1, to: sqlite3_destructor_type.self))
+				}
+				if try rawStatement.step() {
+					sink &+= sqlite3_column_int64(stmt, 0)
+				}
+				sqlite3_reset(stmt)
+			}
+		})
+	},
+
+	Workload(name: "custom-function") { size in
+		let sql = "select sum(twice(a)) from t;"
+
+		let db = try Database()
+		try db.execute(sql: populateSQL(size))
+		try db.addFunction("twice") { (a: Int64) -> Int64 in
+			return a &* 2
+		}
+		let statement = try db.prepare(sql: sql)
+
+		let raw = try RawConnection()
+		try raw.execute(populateSQL(size))
+		guard sqlite3_create_function_v2(raw.db, "twice", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nil, { sqlite_context, argc, argv in
+			sqlite3_result_int64(sqlite_context, sqlite3_value_int64(argv.unsafelyUnwrapped[0]) &* 2)
+		}, nil, nil, nil) == SQLITE_OK else {
+			throw BenchmarkError(description: "Error creating function")
+		}
+		let rawStatement = try raw.prepare(sql)
+
+		return PreparedWorkload(operations: size, feistyDB: Run {
+			let sum: Int64 = try statement.front()
+			sink &+= sum
+			try statement.reset()
+		}, sqlite: Run {
+			if try rawStatement.step() {
+				sink &+= sqlite3_column_int64(rawStatement.stmt, 0)
+			}
+			sqlite3_reset(rawStatement.stmt)
+		})
+	},
+
+	// The FeistyDB side uses a virtual table implemented in Swift and the SQLite side the series extension written in C
+	Workload(name: "virtual-table-scan") { size in
+		let db = try Database()
+		try db.addModule("numbers", type: NumbersModule.self)
+		let statement = try db.prepare(sql: "select sum(value) from numbers;")
+
+		let raw = try RawConnection()
+		let rawStatement = try raw.prepare("select sum(value) from generate_series(1, \(size));")
+
+		return PreparedWorkload(operations: size, feistyDB: Run(reset: {
+			NumbersModule.rowCount = Int64(size)
+		}) {
+			let sum: Int64 = try statement.front()
+			sink &+= sum
+			try statement.reset()
+		}, sqlite: Run {
+			if try rawStatement.step() {
+				sink &+= sqlite3_column_int64(rawStatement.stmt, 0)
+			}
+			sqlite3_reset(rawStatement.stmt)
+		})
+	},
+
+	Workload(name: "fts5-index") { size in
+		let docs = documents(size)
+		let schema = "drop table if exists docs; create virtual table docs using fts5(body);"
+
+		let db = try Database()
+		let raw = try RawConnection()
+
+		return PreparedWorkload(operations: size, feistyDB: Run(reset: {
+			try db.execute(sql: schema)
+		}) {
+			let statement = try db.prepare(sql: "insert into docs(body) values (?);")
+			try db.transaction { db in
+				for doc in docs {
+					try statement.bind(value: doc, toParameter: 1)
+					try statement.execute()
+					try statement.reset()
+				}
+				return .commit
+			}
+		}, sqlite: Run(reset: {
+			try raw.execute(schema)
+		}) {
+			let statement = try raw.prepare("insert into docs(body) values (?);")
+			let stmt = statement.stmt
+			try raw.execute("begin;")
+			for doc in docs {
+				sqlite3_bind_text(stmt, 1, doc, -1, unsafeBitCast(-1, to: sqlite3_destructor_type.self))
+				_ = try statement.step()
+				sqlite3_reset(stmt)
+			}
+			try raw.execute("commit;")
+		})
+	},
+
+	Workload(name: "fts5-query") { size in
+		let docs = documents(size)
+		var generator = LinearCongruentialGenerator(seed: 42)
+		let queries = (0 ..< 100).map { _ in "\(vocabulary.randomElement(using: &generator)!) \(vocabulary.randomElement(using: &generator)!)" }
+		let sql = "select count(*) from docs where docs match ?;"
+
+		let db = try Database()
+		try db.execute(sql: "create virtual table docs using fts5(body);")
+		try db.transaction { db in
+			for doc in docs {
+				try db.execute(sql: "insert into docs(body) values (?);", parameterValues: [doc])
+			}
+			return .commit
+		}
+		let statement = try db.prepare(sql: sql)
+
+		let raw = try RawConnection()
+		try raw.execute("create virtual table docs using fts5(body);")
+		let insert = try raw.prepare("insert into docs(body) values (?);")
+		try raw.execute("begin;")
+		for doc in docs {
+			sqlite3_bind_text(insert.stmt, 1, doc, -1, unsafeBitCast(-1, to: sqlite3_destructor_type.self))
+			_ = try insert.step()
+			sqlite3_reset(insert.stmt)
+		}
+		try raw.execute("commit;")
+		let rawStatement = try raw.prepare(sql)
+
+		return PreparedWorkload(operations: queries.count, feistyDB: Run {
+			for query in queries {
+				try statement.bind(value: query, toParameter: 1)
+				let count: Int64 = try statement.front()
+				sink &+= count
+				try statement.reset()
+			}
+		}, sqlite: Run {
+			let stmt = rawStatement.stmt
+			for query in queries {
+				sqlite3_bind_text(stmt, 1, query, -1, unsafeBitCast(-1, to: sqlite3_destructor_type.self))
+				if try rawStatement.step() {
+					sink &+= sqlite3_column_int64(stmt, 0)
+				}
+				sqlite3_reset(stmt)
+			}
+		})
+	},
+
+	// Four readers perform point lookups while one writer commits single-row transactions
+	Workload(name: "concurrent-readers-writer") { size in
+		let readerCount = 4
+		let lookupsPerReader = 10_000
+		let writeCount = 100
+		let ids = randomIDs(lookupsPerReader, upTo: size)
+
+		let directory = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString, isDirectory: true)
+		try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+		let feistyURL = directory.appendingPathComponent("feistydb.sqlite")
+		let rawURL = directory.appendingPathComponent("sqlite3.sqlite")
+
+		let pool = try DatabasePool(url: feistyURL, maximumReaderCount: readerCount, label: "benchmark.pool")
+		try pool.write { db in
+			try db.execute(sql: populateSQL(size))
+		}
+
+		let rawWriter = try RawConnection(path: rawURL.path)
+		try rawWriter.execute("PRAGMA journal_mode = WAL;")
+		try rawWriter.execute(populateSQL(size))
+		let rawInsert = try rawWriter.prepare("insert into t(a, b) values (?, 'new');")
+		let rawReaders = try (0 ..< readerCount).map { _ -> (RawConnection, RawStatement) in
+			let connection = try RawConnection(path: rawURL.path, flags: SQLITE_OPEN_READONLY)
+			return (connection, try connection.prepare("select a from t where id = ?;"))
+		}
+
+		return PreparedWorkload(operations: readerCount * lookupsPerReader + writeCount, countsAllocations: false, feistyDB: Run {
+			DispatchQueue.concurrentPerform(iterations: readerCount + 1) { i in
+				if i == readerCount {
+					for j in 0 ..< writeCount {
+						try! pool.write { db in
+							try db.execute(sql: "insert into t(a, b) values (?, 'new');", parameterValues: [j])
+						}
+					}
+				}
+				else {
+					try! pool.read { db in
+						let statement = try db.prepare(sql: "select a from t where id = ?;")
+						for id in ids {
+							try statement.bind(value: id, toParameter: 1)
+							if let row = try statement.nextRow() {
+								let a: Int64 = try row.value(at: 0)
+								if a == -1 {
+									sink &+= a
+								}
+							}
+							try statement.reset()
+						}
+					}
+				}
+			}
+		}, sqlite: Run {
+			DispatchQueue.concurrentPerform(iterations: readerCount + 1) { i in
+				if i == readerCount {
+					let stmt = rawInsert.stmt
+					for j in 0 ..< writeCount {
+						sqlite3_bind_int64(stmt, 1, Int64(j))
+						_ = try! rawInsert.step()
+						sqlite3_reset(stmt)
+					}
+				}
+				else {
+					let (connection, statement) = rawReaders[i]
+					let stmt = statement.stmt
+					try! connection.execute("begin;")
+					for id in ids {
+						sqlite3_bind_int64(stmt, 1, id)
+						if try! statement.step(), sqlite3_column_int64(stmt, 0) == -1 {
+							sink &+= 1
+						}
+						sqlite3_reset(stmt)
+					}
+					try! connection.execute("rollback;")
+				}
+			}
+		})
+	},
+]
@@ -0,0 +1,90 @@
+//
+// Copyright (c) 2020 Feisty Dog, LLC
+//
+// See https://github.com/feistydog/FeistyDB/blob/master/LICENSE.txt for license information
+//
+
+import Foundation
+import CSQLite
+
+// Paired FeistyDB and SQLite C API benchmarks.
+//
+// Each workload is executed using FeistyDB and using the SQLite C API directly, producing the same
+// Swift values, so the difference between the two measurements is the overhead of the wrapper.
+//
+// Usage: feisty-db-benchmarks [--sizes 1000,100000] [--iterations 5] [--filter name] [--format json|text]
+//
+// JSON output consists of one object per line containing `workload`, `implementation`, `datasetSize`,
+// `nanosecondsPerOperation`, `medianNanosecondsPerOperation`, `rowsPerSecond`, `sqliteAllocationsPerOperation`
+// and `heapAllocationsPerOperation`.
+//
+// `sqliteAllocationsPerOperation` counts calls to the SQLite allocator.  `heapAllocationsPerOperation` counts every
+// process heap allocation, including those made by Swift, Foundation and SQLite, whether or not the memory is freed
+// before the iteration completes.
+
+var datasetSizes = [1_000, 100_000]
+var iterations = 5
+var filter: String? = nil
+var format = "json"
+
+var arguments = CommandLine.arguments.dropFirst()
+while let argument = arguments.popFirst() {
+	switch argument {
+	case "--sizes":
+		datasetSizes = arguments.popFirst()?.split(separator: ",").compactMap({ Int($0) }) ?? datasetSizes
+	case "--iterations":
+		iterations = arguments.popFirst().flatMap({ Int($0) }) ?? iterations
+	case "--filter":
+		filter = arguments.popFirst()
+	case "--format":
+		format = arguments.popFirst() ?? format
+	default:
+		FileHandle.standardError.write("Usage: \(CommandLine.arguments[0]) [--sizes 1000,100000] [--iterations 5] [--filter name] [--format json|text]\n".data(using: .utf8)!)
+		exit(1)
+	}
+}
+
+guard !datasetSizes.isEmpty, datasetSizes.allSatisfy({ $0 > 0 }), iterations > 0 else {
+	FileHandle.standardError.write("Dataset sizes and iterations must be positive\n".data(using: .utf8)!)
+	exit(1)
+}
+
+// The allocator may only be replaced before SQLite is initialized
+AllocationCounter.install()
+HeapAllocationCounter.install()
+
+let workloads = allWorkloads.filter { workload in
+	filter.map { workload.name.contains($0) } ?? true
+}
+
+let encoder = JSONEncoder()
+if #available(macOS 10.13, *) {
+	encoder.outputFormatting = .sortedKeys
+}
+
+if format == "text" {
+	print("workload".padding(toLength: 28, withPad: " ", startingAt: 0), "impl".padding(toLength: 10, withPad: " ", startingAt: 0), "size".padding(toLength: 10, withPad: " ", startingAt: 0), "ns/op".padding(toLength: 12, withPad: " ", startingAt: 0), "rows/s".padding(toLength: 14, withPad: " ", startingAt: 0), "allocs/op".padding(toLength: 12, withPad: " ", startingAt: 0), "heap allocs/op")
+}
+
+do {
+	try Benchmark(datasetSizes: datasetSizes, iterations: iterations, workloads: workloads).run { measurement in
+		if format == "text" {
+			print(measurement.workload.padding(toLength: 28, withPad: " ", startingAt: 0),
+				  measurement.implementation.padding(toLength: 10, withPad: " ", startingAt: 0),
+				  String(measurement.datasetSize).padding(toLength: 10, withPad: " ", startingAt: 0),
+				  String(format: "%.1f", measurement.nanosecondsPerOperation).padding(toLength: 12, withPad: " ", startingAt: 0),
+				  String(format: "%.0f", measurement.rowsPerSecond).padding(toLength: 14, withPad: " ", startingAt: 0),
+				  (measurement.sqliteAllocationsPerOperation.map { String(format: "%.2f", $0) } ?? "-").padding(toLength: 12, withPad: " ", startingAt: 0),
+				  measurement.heapAllocationsPerOperation.map { String(format: "%.2f", $0) } ?? "-")
+		}
+		else {
+			print(String(data: try! encoder.encode(measurement), encoding: .utf8)!)
+		}
+	}
+}
+catch let error {
+	FileHandle.standardError.write("Benchmark failed: \(error)\n".data(using: .utf8)!)
+	exit(1)
+}
+
+withExtendedLifetime(sink) {}
@@ -138,6 +138,31 @@ class FeistyDBPerformanceTests: XCTestCase {
 		}
 	}
 
+	func testFeistyDBBulkInsertPerformance() {
+		self.measureMetrics(XCTestCase.defaultPerformanceMetrics, automaticallyStartMeasuring: false) {
+			let db = try! Database()
+
+			try! db.execute(sql: "create table t1(a, b);")
+
+			let inserter = try! db.bulkInserter(table: "t1", columns: ["a", "b"])
+
+			startMeasuring()
+
+			let rowCount = 50_000
+			for i in 0..<rowCount {
+				try! inserter.insert([.integer(Int64(i*2)), .integer(Int64(i*2+1))])
+			}
+			try! inserter.finish()
+
+			stopMeasuring()
+
+			let s = try! db.prepare(sql: "select count(*) from t1;")
+			let count: Int = try! s.front()
+
+			XCTAssertEqual(count, rowCount)
+		}
+	}
+
 	func testFeistyDBSelectPerformance() {
 		self.measureMetrics(XCTestCase.defaultPerformanceMetrics, automaticallyStartMeasuring: false) {
 			let db = try! Database()
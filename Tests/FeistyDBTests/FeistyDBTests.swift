@@ -921,6 +921,1507 @@ class FeistyDBTests: XCTestCase {
 	func testDatabaseQueue() {
 	}
 
+	func testDatabasePool() {
+		let pool = try! DatabasePool(url: temporaryFileURL(), maximumReaderCount: 3, label: "pool")
+
+		try! pool.writeTransaction { db in
+			try db.execute(sql: "create table t1(a);")
+			for i in 0 ..< 100 {
+				try db.execute(sql: "insert into t1(a) values (?);", parameterValues: [i])
+			}
+			return .commit
+		}
+
+		let counts = UnsafeMutableBufferPointer<Int>.allocate(capacity: 10)
+		defer {
+			counts.deallocate()
+		}
+
+		DispatchQueue.concurrentPerform(iterations: counts.count) { i in
+			counts[i] = try! pool.read { db in
+				try db.prepare(sql: "select count(*) from t1;").front()
+			}
+		}
+
+		XCTAssertEqual(Array(counts), Array(repeating: 100, count: counts.count))
+
+		let isReadOnly = try! pool.read { db in
+			db.isReadOnly
+		}
+		XCTAssertTrue(isReadOnly)
+	}
+
+	func testStatementCache() {
+		let db = try! Database()
+		XCTAssertNil(db.statementCacheStatistics)
+
+		db.statementCacheCapacity = 2
+
+		try! db.execute(sql: "create table t1(a);")
+		for i in 0 ..< 10 {
+			try! db.execute(sql: "insert into t1(a) values (?);", parameterValues: [i])
+		}
+
+		var statistics = db.statementCacheStatistics!
+		XCTAssertEqual(statistics.misses, 2)
+		XCTAssertEqual(statistics.hits, 9)
+		XCTAssertEqual(statistics.count, 2)
+		XCTAssertEqual(statistics.evictions, 0)
+
+		var count = 0
+		try! db.results(sql: "select count(*) from t1;") { row in
+			count = try row.value(at: 0)
+		}
+		XCTAssertEqual(count, 10)
+
+		statistics = db.statementCacheStatistics!
+		XCTAssertEqual(statistics.count, 2)
+		XCTAssertEqual(statistics.evictions, 1)
+
+		db.statementCacheCapacity = 0
+		XCTAssertNil(db.statementCacheStatistics)
+	}
+
+	func testBorrowedColumnAccess() {
+		let db = try! Database()
+
+		try! db.execute(sql: "create table t1(a, b, c, d);")
+		try! db.execute(sql: "insert into t1(a, b, c, d) values (?, ?, ?, ?);", parameterValues: [42, 2.5, "feisty", Data([1, 2, 3])])
+		try! db.execute(sql: "insert into t1(a, b, c, d) values (NULL, NULL, NULL, NULL);")
+
+		let statement = try! db.prepare(sql: "select a, b, c, d from t1;")
+
+		var row = try! statement.nextRow()!
+		XCTAssertEqual(try! row.int64(at: 0), 42)
+		XCTAssertEqual(try! row.double(at: 1), 2.5)
+		XCTAssertEqual(try! row.withUnsafeText(at: 2) { String(decoding: $0, as: UTF8.self) }, "feisty")
+		XCTAssertEqual(try! row.withUnsafeBLOB(at: 3) { Array($0) }, [1, 2, 3])
+		XCTAssertFalse(try! row.isNull(at: 2))
+		XCTAssertThrowsError(try row.int64(at: 4))
+
+		row = try! statement.nextRow()!
+		XCTAssertTrue(try! row.isNull(at: 0))
+		XCTAssertEqual(try! row.withUnsafeText(at: 2) { $0.count }, 0)
+		XCTAssertEqual(try! row.withUnsafeBLOB(at: 3) { $0.count }, 0)
+	}
+
+	func testColumnarBatches() {
+		let db = try! Database()
+
+		try! db.execute(sql: "create table t1(a, b, c);")
+		for i in 0 ..< 10 {
+			try! db.execute(sql: "insert into t1(a, b, c) values (?, ?, ?);", parameterValues: [i, i % 2 == 0 ? Double(i) / 2 : nil, "row \(i)"])
+		}
+
+		let statement = try! db.prepare(sql: "select a, b, c from t1 order by a;")
+
+		var batchSizes = [Int]()
+		var ids = [Int64]()
+		var halves = [Double?]()
+		var names = [String]()
+		try! statement.batches(schema: [.init(.int64, nullable: false), .init(.double), .init(.text, nullable: false)], chunkSize: 4) { batch in
+			batchSizes.append(batch.count)
+			ids.append(contentsOf: batch.columns[0].int64Values)
+			for i in 0 ..< batch.count {
+				halves.append(batch.columns[1].isValid(at: i) ? batch.columns[1].doubleValues[i] : nil)
+				names.append(batch.columns[2].string(at: i)!)
+			}
+		}
+
+		XCTAssertEqual(batchSizes, [4, 4, 2])
+		XCTAssertEqual(ids, Array(0 ..< 10))
+		XCTAssertEqual(halves, [0, nil, 1, nil, 2, nil, 3, nil, 4, nil])
+		XCTAssertEqual(names.last, "row 9")
+
+		try! statement.reset()
+		XCTAssertThrowsError(try statement.batches(schema: [.init(.int64), .init(.double, nullable: false)]) { _ in })
+	}
+
+	func testBulkInserter() {
+		let db = try! Database()
+
+		try! db.execute(sql: "create table t1(a, b, c);")
+
+		let inserter = try! BulkInserter(database: db, table: "t1", columns: ["a", "b", "c"], maximumRowsPerStatement: 7, commitRowInterval: 20, commitTimeInterval: nil)
+		XCTAssertEqual(inserter.rowsPerStatement, 7)
+
+		for i in 0 ..< 50 {
+			try! inserter.insert([.integer(Int64(i)), .text("row \(i)"), i % 2 == 0 ? .null : .float(Double(i))])
+		}
+		XCTAssertFalse(db.isInAutocommitMode)
+
+		let statistics = try! inserter.finish()
+		XCTAssertEqual(statistics.rowCount, 50)
+		XCTAssertEqual(statistics.commitCount, 3)
+		XCTAssertTrue(db.isInAutocommitMode)
+
+		let count: Int = try! db.prepare(sql: "select count(*) from t1 where c is null;").front()
+		XCTAssertEqual(count, 25)
+		let last: String = try! db.prepare(sql: "select b from t1 order by a desc limit 1;").front()
+		XCTAssertEqual(last, "row 49")
+
+		XCTAssertThrowsError(try inserter.insert([.integer(1)]))
+	}
+
+	func testBulkInserterCommitTimeInterval() {
+		let url = temporaryFileURL()
+		let db = try! Database(url: url)
+		let reader = try! Database(url: url)
+
+		try! db.execute(sql: "create table t1(a);")
+
+		let inserter = try! db.bulkInserter(table: "t1", columns: ["a"], commitRowInterval: nil, commitTimeInterval: 0.05)
+		XCTAssertGreaterThan(inserter.rowsPerStatement, 5)
+
+		for i in 0 ..< 4 {
+			try! inserter.insert([.integer(Int64(i))])
+		}
+		Thread.sleep(forTimeInterval: 0.1)
+		try! inserter.insert([.integer(4)])
+
+		// The time limit was reached with only a partial statement buffered
+		XCTAssertTrue(db.isInAutocommitMode)
+		XCTAssertEqual(inserter.statistics.commitCount, 1)
+		XCTAssertEqual(try! reader.prepare(sql: "select count(*) from t1;").front(), 5)
+
+		try! inserter.insert([.integer(5)])
+		XCTAssertEqual(try! reader.prepare(sql: "select count(*) from t1;").front(), 5)
+
+		let statistics = try! inserter.finish()
+		XCTAssertEqual(statistics.rowCount, 6)
+		XCTAssertEqual(statistics.commitCount, 2)
+		XCTAssertEqual(try! reader.prepare(sql: "select count(*) from t1;").front(), 6)
+	}
+
+	#if compiler(>=5.6) && canImport(_Concurrency)
+
+	@available(macOS 10.15, iOS 13.0, watchOS 6.0, tvOS 13.0, *)
+	func testDatabaseQueueConcurrency() async throws {
+		let dbQueue = try DatabaseQueue(label: "dbQueue")
+
+		try await dbQueue.write { db in
+			try db.execute(sql: "create table t1(a);")
+			for i in 0 ..< 1000 {
+				try db.execute(sql: "insert into t1(a) values (?);", parameterValues: [i])
+			}
+		}
+
+		let count: Int = try await dbQueue.read { db in
+			try db.prepare(sql: "select count(*) from t1;").front()
+		}
+		XCTAssertEqual(count, 1000)
+
+		var sum = 0
+		for try await value in dbQueue.rows(sql: "select a from t1 where a >= ?;", parameterValues: [500], chunkSize: 64, { row -> Int in try row.value(at: 0) }) {
+			sum += value
+		}
+		XCTAssertEqual(sum, (500 ..< 1000).reduce(0, +))
+
+		do {
+			try await dbQueue.write { db in
+				try db.execute(sql: "insert into t1(a) values (-1);")
+				throw DatabaseError("Abort")
+			}
+			XCTFail("Expected an error")
+		}
+		catch {
+		}
+
+		let minimum: Int = try await dbQueue.read { db in
+			try db.prepare(sql: "select min(a) from t1;").front()
+		}
+		XCTAssertEqual(minimum, 0)
+	}
+
+	@available(macOS 10.15, iOS 13.0, watchOS 6.0, tvOS 13.0, *)
+	func testDatabaseQueueCancellation() async throws {
+		let dbQueue = try DatabaseQueue(label: "dbQueue")
+
+		let sql = "with recursive c(x) as (select 1 union all select x + 1 from c) select x from c;"
+
+		let read = Task {
+			try await dbQueue.read { db in
+				try db.prepare(sql: sql).results { _ in }
+			}
+		}
+		try await Task.sleep(nanoseconds: 50_000_000)
+		read.cancel()
+		do {
+			try await read.value
+			XCTFail("Expected an error")
+		}
+		catch let error as QueryBudgetExceededError {
+			XCTAssertEqual(error.reason, .cancelled)
+		}
+
+		let rows = Task { () -> Int in
+			var count = 0
+			// Rows are rarely produced so cancellation occurs while a chunk is being stepped
+			for try await _ in dbQueue.rows(sql: "with recursive c(x) as (select 1 union all select x + 1 from c) select x from c where x % 1000000000 = 0;", { row -> Int in try row.value(at: 0) }) {
+				count += 1
+			}
+			return count
+		}
+		try await Task.sleep(nanoseconds: 50_000_000)
+		rows.cancel()
+		do {
+			_ = try await rows.value
+			XCTFail("Expected an error")
+		}
+		catch let error as QueryBudgetExceededError {
+			XCTAssertEqual(error.reason, .cancelled)
+		}
+
+		let one: Int = try await dbQueue.read { db in
+			try db.prepare(sql: "select 1;").front()
+		}
+		XCTAssertEqual(one, 1)
+
+		// Cancellations arriving as single-row chunks complete must not interrupt later operations
+		for _ in 0 ..< 20 {
+			let stream = Task { () -> Int in
+				var count = 0
+				for try await _ in dbQueue.rows(sql: "with recursive c(x) as (select 1 union all select x + 1 from c) select x from c;", chunkSize: 1, { row -> Int in try row.value(at: 0) }) {
+					count += 1
+				}
+				return count
+			}
+			await Task.yield()
+			stream.cancel()
+			_ = try? await stream.value
+
+			let value: Int = try await dbQueue.read { db in
+				try db.prepare(sql: "select 2;").front()
+			}
+			XCTAssertEqual(value, 2)
+		}
+	}
+
+	#endif
+
+	func testQueryObserver() {
+		final class Recorder: QueryObserver {
+			var events = [QueryEvent]()
+			func queryDidComplete(_ event: QueryEvent) {
+				events.append(event)
+			}
+		}
+
+		let db = try! Database()
+		try! db.execute(sql: "create table t1(a);")
+		for i in 0 ..< 10 {
+			try! db.execute(sql: "insert into t1(a) values (?);", parameterValues: [i])
+		}
+
+		let recorder = Recorder()
+		db.setQueryObserver(recorder, countingRows: true)
+
+		try! db.results(sql: "select a from t1 where a > 4;") { _ in }
+
+		XCTAssertEqual(recorder.events.count, 1)
+		XCTAssertEqual(recorder.events.first?.sql, "select a from t1 where a > 4;")
+		XCTAssertEqual(recorder.events.first?.rowCount, 5)
+		XCTAssertEqual(recorder.events.first?.fullscanSteps, 9)
+
+		// The observer reports per-execution counts without resetting the statement's counters
+		recorder.events.removeAll()
+		db.setQueryObserver(recorder)
+		let statement = try! db.prepare(sql: "select a from t1;")
+		try! statement.results { _ in }
+		try! statement.reset()
+		try! statement.results { _ in }
+		XCTAssertEqual(recorder.events.map { $0.fullscanSteps }, [9, 9])
+		XCTAssertEqual(recorder.events.map { $0.rowCount }, [nil, nil])
+		XCTAssertEqual(statement.count(of: .fullscanStep), 18)
+
+		let statistics = QueryStatistics()
+		db.setQueryObserver(statistics)
+
+		try! db.results(sql: "select a from t1 where a > 4;") { _ in }
+		try! db.results(sql: "select a   from t1 where a > 7; -- comment") { _ in }
+
+		let summary = statistics.summary(for: "select a from t1 where a > 1;")
+		XCTAssertEqual(summary?.count, 2)
+		XCTAssertEqual(summary?.sql, "select a from t1 where a > ?;")
+
+		db.removeQueryObserver()
+		try! db.results(sql: "select a from t1;") { _ in }
+		XCTAssertEqual(statistics.summaries().count, 1)
+
+		XCTAssertEqual(QueryStatistics.normalize("SELECT * FROM \"t 1\" WHERE b = 'it''s' AND c = x'00ff' AND d = ?2 AND e = 1.5e-3"), "SELECT * FROM \"t 1\" WHERE b = ? AND c = ? AND d = ?2 AND e = ?")
+	}
+
+	func testMemoryGovernance() {
+		let previousLimit = SQLite.softHeapLimit
+		defer {
+			SQLite.softHeapLimit = previousLimit
+		}
+
+		SQLite.softHeapLimit = 8 * 1024 * 1024
+		XCTAssertEqual(SQLite.softHeapLimit, 8 * 1024 * 1024)
+
+		let (current, highwater) = try! SQLite.status(ofParameter: .memoryUsed)
+		XCTAssertGreaterThanOrEqual(current, 0)
+		XCTAssertGreaterThanOrEqual(highwater, current)
+
+		let dbQueue = try! DatabaseQueue(label: "dbQueue")
+		try! dbQueue.sync { db in
+			try db.execute(sql: "create table t1(a);")
+			try db.releaseMemory()
+		}
+
+		SQLite.releaseMemoryFromAllDatabases()
+		dbQueue.sync { _ in }
+	}
+
+	func testConfiguration() {
+		let url = temporaryFileURL()
+		defer {
+			try? FileManager.default.removeItem(at: url)
+		}
+
+		let configuration = Database.Configuration(lookaside: .init(slotSize: 256, slotCount: 64), cacheSize: -1024, mmapSize: 1024 * 1024, pageSize: 8192, journalMode: .wal)
+		let db = try! Database(url: url, configuration: configuration)
+
+		let pageSize: Int = try! db.prepare(sql: "PRAGMA page_size;").front()
+		XCTAssertEqual(pageSize, 8192)
+		let journalMode: String = try! db.prepare(sql: "PRAGMA journal_mode;").front()
+		XCTAssertEqual(journalMode, "wal")
+		let cacheSize: Int = try! db.prepare(sql: "PRAGMA cache_size;").front()
+		XCTAssertEqual(cacheSize, -1024)
+
+		try! db.execute(sql: "create table t1(a);")
+		XCTAssertNoThrow(try db.status(ofParameter: .lookasideHit))
+
+		XCTAssertThrowsError(try Database(configuration: Database.Configuration(journalMode: .wal)))
+	}
+
+	func testImmutableDatabase() {
+		let url = temporaryFileURL().appendingPathComponent("reference data?#.sqlite")
+		try! FileManager.default.createDirectory(at: url.deletingLastPathComponent(), withIntermediateDirectories: true)
+		defer {
+			try? FileManager.default.removeItem(at: url.deletingLastPathComponent())
+		}
+
+		do {
+			let db = try! Database(url: url)
+			try! db.execute(sql: "create table t1(a);")
+			try! db.execute(sql: "insert into t1(a) values (1), (2), (3);")
+		}
+
+		let readers = (0 ..< 3).map { try! DatabaseReadQueue(immutableURL: url, label: "reader.\($0)") }
+		for reader in readers {
+			let sum: Int = try! reader.sync { db in
+				XCTAssertTrue(db.isReadOnly)
+				return try db.prepare(sql: "select sum(a) from t1;").front()
+			}
+			XCTAssertEqual(sum, 6)
+		}
+
+		let db = try! Database(immutableReadingFrom: url)
+		let mmapSize: Int64 = try! db.prepare(sql: "PRAGMA mmap_size;").front()
+		XCTAssertGreaterThan(mmapSize, 0)
+		XCTAssertThrowsError(try db.execute(sql: "insert into t1(a) values (4);"))
+	}
+
+	func testBackupAndSerialization() {
+		let db = try! Database()
+		try! db.execute(sql: "create table t1(a);")
+		for i in 0 ..< 1000 {
+			try! db.execute(sql: "insert into t1(a) values (?);", parameterValues: [i])
+		}
+
+		let destination = try! Database()
+		var progressCount = 0
+		try! db.backup(to: destination, options: Database.BackupOptions(pagesPerStep: 2)) { _, _ in
+			progressCount += 1
+		}
+		XCTAssertGreaterThan(progressCount, 1)
+		var count: Int = try! destination.prepare(sql: "select count(*) from t1;").front()
+		XCTAssertEqual(count, 1000)
+
+		let data = try! db.serialize()
+		XCTAssertFalse(data.isEmpty)
+
+		let copy = try! Database()
+		try! copy.deserialize(data)
+		count = try! copy.prepare(sql: "select count(*) from t1;").front()
+		XCTAssertEqual(count, 1000)
+		try! copy.execute(sql: "insert into t1(a) values (1000);")
+
+		let size = try! copy.withUnsafeSerialization { $0.count }
+		XCTAssertGreaterThanOrEqual(size, data.count)
+
+		let readOnly = try! Database()
+		try! readOnly.deserialize(data, readOnly: true)
+		XCTAssertThrowsError(try readOnly.execute(sql: "insert into t1(a) values (1000);"))
+	}
+
+	func testBatchedVirtualTable() {
+		final class TimeSeriesModule: BatchedVirtualTableModule {
+			final class Cursor: BatchedVirtualTableCursor {
+				var value: Int64 = 0
+				var limit: Int64 = 0
+
+				func filter(_ arguments: SQLArguments, indexNumber: Int32, indexName: String?) {
+					value = 0
+					limit = 10_000
+				}
+
+				func fill(_ batch: ColumnarBatch, rowids: inout [Int64]) {
+					while !batch.isFull && value < limit {
+						value += 1
+						batch.columns[0].append(value)
+						batch.columns[1].append(Double(value) / 2)
+						if value % 10 == 0 {
+							batch.columns[2].appendNull()
+						}
+						else {
+							batch.columns[2].append("v\(value)")
+						}
+					}
+				}
+			}
+
+			required init(database: Database, arguments: [String], create: Bool) {
+			}
+
+			var declaration: String {
+				return "CREATE TABLE x(ts, value, label)"
+			}
+
+			var schema: [ColumnarBatch.Field] {
+				return [.init(.int64, nullable: false), .init(.double, nullable: false), .init(.text)]
+			}
+
+			var batchSize: Int {
+				return 256
+			}
+
+			func bestIndex(_ indexInfo: inout sqlite3_index_info) -> VirtualTableModuleBestIndexResult {
+				return .ok
+			}
+
+			func openCursor() -> BatchedVirtualTableCursor {
+				return Cursor()
+			}
+		}
+
+		let db = try! Database()
+		try! db.addModule("time_series", type: TimeSeriesModule.self, eponymous: true)
+
+		let count: Int = try! db.prepare(sql: "select count(*) from time_series;").front()
+		XCTAssertEqual(count, 10_000)
+		let sum: Double = try! db.prepare(sql: "select sum(value) from time_series;").front()
+		XCTAssertEqual(sum, 25_002_500)
+		let nullCount: Int = try! db.prepare(sql: "select count(*) from time_series where label is null;").front()
+		XCTAssertEqual(nullCount, 1_000)
+		let label: String = try! db.prepare(sql: "select label from time_series where rowid = 257;").front()
+		XCTAssertEqual(label, "v257")
+	}
+
+	func testWritableVirtualTable() {
+		final class Store {
+			var rows = [Int64: String]()
+			var pending = [Int64: String?]()
+			var commitCount = 0
+		}
+
+		final class KeyValueModule: WritableVirtualTableModule {
+			final class Cursor: VirtualTableCursor {
+				let rows: [(Int64, String)]
+				var index = 0
+
+				init(rows: [(Int64, String)]) {
+					self.rows = rows
+				}
+
+				func column(_ index: Int32) -> DatabaseValue {
+					return .text(rows[self.index].1)
+				}
+
+				func next() {
+					index += 1
+				}
+
+				func rowid() -> Int64 {
+					return rows[index].0
+				}
+
+				func filter(_ arguments: [DatabaseValue], indexNumber: Int32, indexName: String?) {
+					index = 0
+				}
+
+				var eof: Bool {
+					return index >= rows.count
+				}
+			}
+
+			static let store = Store()
+
+			required init(database: Database, arguments: [String], create: Bool) {
+			}
+
+			var declaration: String {
+				return "CREATE TABLE x(value TEXT)"
+			}
+
+			func bestIndex(_ indexInfo: inout sqlite3_index_info) -> VirtualTableModuleBestIndexResult {
+				return .ok
+			}
+
+			func openCursor() -> VirtualTableCursor {
+				return Cursor(rows: KeyValueModule.store.rows.sorted { $0.key < $1.key })
+			}
+
+			func insert(rowid: Int64?, values: SQLArguments) throws -> Int64 {
+				let rowid = rowid ?? (KeyValueModule.store.rows.keys.max() ?? 0) + 1
+				KeyValueModule.store.pending[rowid] = values.string(at: 0) ?? ""
+				return rowid
+			}
+
+			func update(rowid: Int64, newRowid: Int64, values: SQLArguments) {
+				KeyValueModule.store.pending[newRowid] = values.string(at: 0) ?? ""
+			}
+
+			func delete(rowid: Int64) {
+				KeyValueModule.store.pending[rowid] = .some(nil)
+			}
+
+			func commit() {
+				let store = KeyValueModule.store
+				for (rowid, value) in store.pending {
+					store.rows[rowid] = value
+				}
+				store.pending.removeAll()
+				store.commitCount += 1
+			}
+
+			func rollback() {
+				KeyValueModule.store.pending.removeAll()
+			}
+		}
+
+		let db = try! Database()
+		try! db.addModule("kv", type: KeyValueModule.self)
+		try! db.execute(sql: "create virtual table temp.t1 using kv;")
+
+		try! db.execute(sql: "insert into t1(value) values ('a');")
+		try! db.execute(sql: "insert into t1(rowid, value) values (10, 'b');")
+		XCTAssertEqual(KeyValueModule.store.rows, [1: "a", 10: "b"])
+
+		try! db.execute(sql: "begin;")
+		try! db.execute(sql: "update t1 set value = 'c' where rowid = 1;")
+		try! db.execute(sql: "delete from t1 where rowid = 10;")
+		try! db.execute(sql: "rollback;")
+		XCTAssertEqual(KeyValueModule.store.rows, [1: "a", 10: "b"])
+
+		try! db.execute(sql: "update t1 set value = 'c' where rowid = 1;")
+		try! db.execute(sql: "delete from t1 where rowid = 10;")
+		XCTAssertEqual(KeyValueModule.store.rows, [1: "c"])
+		XCTAssertEqual(KeyValueModule.store.commitCount, 4)
+	}
+
+	func testVirtualTableIndexInfo() {
+		final class RangeModule: BatchedVirtualTableModule {
+			final class Cursor: BatchedVirtualTableCursor {
+				var value: Int64 = 0
+				var limit: Int64 = 0
+
+				func filter(_ arguments: SQLArguments, indexNumber: Int32, indexName: String?) {
+					value = 0
+					limit = 1_000
+					var argument = 0
+					if indexNumber & 1 != 0 {
+						value = arguments.int64(at: argument) - 1
+						argument += 1
+					}
+					if indexNumber & 2 != 0 {
+						limit = min(limit, arguments.int64(at: argument) - 1)
+					}
+					RangeModule.indexName = indexName
+				}
+
+				func fill(_ batch: ColumnarBatch, rowids: inout [Int64]) {
+					while !batch.isFull && value < limit {
+						value += 1
+						batch.columns[0].append(value)
+						rowids.append(value)
+					}
+				}
+			}
+
+			static var indexName: String?
+
+			required init(database: Database, arguments: [String], create: Bool) {
+			}
+
+			var declaration: String {
+				return "CREATE TABLE x(value)"
+			}
+
+			var schema: [ColumnarBatch.Field] {
+				return [.init(.int64, nullable: false)]
+			}
+
+			func bestIndex(_ indexInfo: inout sqlite3_index_info) -> VirtualTableModuleBestIndexResult {
+				let constraints = indexInfo.constraints.filter { $0.isUsable && $0.column == 0 }
+				var argumentIndex: Int32 = 1
+				var indexNumber: Int32 = 0
+				if let lower = constraints.first(where: { $0.op == .greaterThanOrEqual }) {
+					indexInfo.use(lower, argumentIndex: argumentIndex, omit: true)
+					argumentIndex += 1
+					indexNumber |= 1
+				}
+				if let upper = constraints.first(where: { $0.op == .lessThan }) {
+					indexInfo.use(upper, argumentIndex: argumentIndex, omit: true)
+					argumentIndex += 1
+					indexNumber |= 2
+				}
+				indexInfo.indexNumber = indexNumber
+				indexInfo.setIndexName(indexNumber != 0 ? "range" : nil)
+				if let orderBy = indexInfo.orderByTerms.first, indexInfo.orderByTerms.count == 1, orderBy.column == 0, !orderBy.isDescending {
+					indexInfo.isOrderByConsumed = true
+				}
+				indexInfo.estimatedCost = indexNumber == 0 ? 1_000 : 10
+				indexInfo.estimatedRows = indexNumber == 0 ? 1_000 : 10
+				return .ok
+			}
+
+			func openCursor() -> BatchedVirtualTableCursor {
+				return Cursor()
+			}
+		}
+
+		let db = try! Database()
+		try! db.addModule("integers", type: RangeModule.self, eponymous: true)
+
+		let count: Int = try! db.prepare(sql: "select count(*) from integers where value >= 10 and value < 20;").front()
+		XCTAssertEqual(count, 10)
+		XCTAssertEqual(RangeModule.indexName, "range")
+
+		let values: [Int] = try! db.prepare(sql: "select value from integers where value >= 995 order by value;").column(0)
+		XCTAssertEqual(values, [995, 996, 997, 998, 999, 1000])
+
+		let total: Int = try! db.prepare(sql: "select count(*) from integers;").front()
+		XCTAssertEqual(total, 1_000)
+		XCTAssertNil(RangeModule.indexName)
+	}
+
+	func testTypedFunctions() {
+		let db = try! Database()
+
+		try! db.addFunction("hypot3") { (x: Double, y: Double, z: Double) -> Double in
+			return (x * x + y * y + z * z).squareRoot()
+		}
+		try! db.addFunction("byte_count") { (bytes: UnsafeRawBufferPointer) -> Int in
+			return bytes.count
+		}
+		try! db.addFunction("maybe_upper") { (s: String?) -> String? in
+			return s?.uppercased()
+		}
+		try! db.addFunction("empty_blob") { (i: Int) -> Data in
+			return Data(count: i)
+		}
+
+		final class Parser {
+			static var parseCount = 0
+		}
+
+		try! db.addFunction("prefix_match", arity: 2) { context, arguments -> Bool in
+			let prefix = context.cachedValue(forArgument: 0) { () -> String in
+				Parser.parseCount += 1
+				return arguments.string(at: 0) ?? ""
+			}
+			return arguments.string(at: 1)?.hasPrefix(prefix) ?? false
+		}
+
+		var d: Double = try! db.prepare(sql: "select hypot3(2, 3, 6);").front()
+		XCTAssertEqual(d, 7)
+		var i: Int = try! db.prepare(sql: "select byte_count(x'00010203');").front()
+		XCTAssertEqual(i, 4)
+		let s: String = try! db.prepare(sql: "select maybe_upper('feisty');").front()
+		XCTAssertEqual(s, "FEISTY")
+		let v: DatabaseValue = try! db.prepare(sql: "select maybe_upper(NULL);").front()
+		XCTAssertEqual(v, .null)
+		XCTAssertThrowsError(try db.prepare(sql: "select hypot3(1, NULL, 2);").front() as Double)
+		let type: String = try! db.prepare(sql: "select typeof(empty_blob(0));").front()
+		XCTAssertEqual(type, "blob")
+		i = try! db.prepare(sql: "select length(empty_blob(3));").front()
+		XCTAssertEqual(i, 3)
+
+		try! db.execute(sql: "create table t1(a);")
+		for word in ["dog", "doge", "cat", "dogma"] {
+			try! db.execute(sql: "insert into t1(a) values (?);", parameterValues: [word])
+		}
+		i = try! db.prepare(sql: "select count(*) from t1 where prefix_match('dog', a);").front()
+		XCTAssertEqual(i, 3)
+		XCTAssertEqual(Parser.parseCount, 1)
+
+		final class Sum: SQLArgumentsAggregateWindowFunction {
+			var sum: Double = 0
+
+			func step(_ arguments: SQLArguments) {
+				sum += arguments.double(at: 0)
+			}
+
+			func inverse(_ arguments: SQLArguments) {
+				sum -= arguments.double(at: 0)
+			}
+
+			func value() -> Double {
+				return sum
+			}
+
+			func final() -> Double {
+				defer {
+					sum = 0
+				}
+				return sum
+			}
+		}
+
+		try! db.addAggregateFunction("typed_sum", arity: 1, Sum())
+		try! db.execute(sql: "create table t2(x);")
+		try! db.execute(sql: "insert into t2(x) values (1.5), (2.5), (3);")
+		d = try! db.prepare(sql: "select typed_sum(x) from t2;").front()
+		XCTAssertEqual(d, 7)
+
+		try! db.addAggregateWindowFunction("typed_window_sum", arity: 1, Sum())
+		let sums: [Double] = try! db.prepare(sql: "select typed_window_sum(x) over (order by rowid rows between 1 preceding and current row) from t2;").column(0)
+		XCTAssertEqual(sums, [1.5, 4, 5.5])
+	}
+
+	func testUTF8Tokenizer() {
+		/// A tokenizer splitting text on spaces and adding "hound" as a synonym for "dog"
+		final class SpaceTokenizer: FTS5UTF8Tokenizer {
+			required init(arguments: [String]) {
+			}
+
+			func tokenize(_ text: UnsafeRawBufferPointer, reason: Database.FTS5TokenizationReason, tokens: FTS5TokenSink) throws {
+				var start = 0
+				for i in 0 ... text.count where i == text.count || text[i] == 0x20 {
+					if i > start {
+						let range = start ..< i
+						try tokens.emit(range)
+						if reason == .document && text[range].elementsEqual("dog".utf8) {
+							try tokens.emit("hound", sourceRange: range, colocated: true)
+						}
+					}
+					start = i + 1
+				}
+			}
+		}
+
+		let db = try! Database()
+
+		try! db.addTokenizer("space", type: SpaceTokenizer.self)
+
+		try! db.execute(sql: "create virtual table t1 USING fts5(a, tokenize = 'space');")
+
+		for text in ["quick brown", "fox", "the lazy dog", "", "hot dog stand", "🦊 🐶"] {
+			try! db.prepare(sql: "insert into t1(a) values (?);").bind(parameterValues: [text]).execute()
+		}
+
+		var count: Int = try! db.prepare(sql: "select count(*) from t1 where t1 match 'dog';").front()
+		XCTAssertEqual(count, 2)
+		count = try! db.prepare(sql: "select count(*) from t1 where t1 match 'hound';").front()
+		XCTAssertEqual(count, 2)
+		count = try! db.prepare(sql: "select count(*) from t1 where t1 match '\"lazy hound\"';").front()
+		XCTAssertEqual(count, 1)
+		count = try! db.prepare(sql: "select count(*) from t1 where t1 match '🐶';").front()
+		XCTAssertEqual(count, 1)
+	}
+
+	func testFTS5AuxiliaryFunction() {
+		let db = try! Database()
+
+		try! db.execute(sql: "create virtual table t1 USING fts5(title, body);")
+		try! db.execute(sql: "insert into t1(title, body) values ('fox', 'the quick brown fox');")
+		try! db.execute(sql: "insert into t1(title, body) values ('dog', 'the lazy dog sleeps near the fox');")
+		try! db.execute(sql: "insert into t1(title, body) values ('fox fox', 'fox');")
+		try! db.execute(sql: "insert into t1(title, body) values ('cat', 'nothing to see');")
+
+		// Weight title matches more heavily than body matches and penalize long rows
+		try! db.addAuxiliaryFunction("weighted_rank") { fts, arguments -> Double in
+			let weights = (0 ..< fts.columnCount).map { $0 < arguments.count ? arguments.double(at: $0) : 1 }
+			var score: Double = 0
+			for instance in try fts.instances() {
+				score += weights[instance.column]
+			}
+			return -score / Double(try fts.columnSize() + 1)
+		}
+
+		try! db.addAuxiliaryFunction("phrase_rows") { fts, arguments -> Int in
+			return try fts.cachedValue { () -> Int in
+				var count = 0
+				try fts.queryPhrase(0) { _ in
+					count += 1
+					return true
+				}
+				return count
+			}
+		}
+
+		try! db.addAuxiliaryFunction("first_title_token") { fts, arguments -> String? in
+			return try fts.withUnsafeColumnText(0) { text in
+				var first: String?
+				try fts.tokenize(text) { token, range in
+					first = String(decoding: token, as: UTF8.self)
+					return false
+				}
+				return first
+			}
+		}
+
+		let titles: [String] = try! db.prepare(sql: "select title from t1 where t1 match 'fox' order by weighted_rank(t1, 10.0, 1.0);").column(0)
+		XCTAssertEqual(titles, ["fox fox", "fox", "dog"])
+
+		try! db.execute(sql: "insert into t1(t1, rank) values ('rank', 'weighted_rank(10.0, 1.0)');")
+		let rowid: Int64 = try! db.prepare(sql: "select rowid from t1 where t1 match 'fox' order by rank limit 1;").front()
+		XCTAssertEqual(rowid, 3)
+
+		let counts: [Int] = try! db.prepare(sql: "select phrase_rows(t1) from t1 where t1 match 'the';").column(0)
+		XCTAssertEqual(counts, [2, 2])
+
+		let tokens: [String] = try! db.prepare(sql: "select first_title_token(t1) from t1 where t1 match 'fox' order by rowid;").column(0)
+		XCTAssertEqual(tokens, ["fox", "dog", "fox"])
+	}
+
+	func testStreamingBLOB() {
+		let db = try! Database()
+		try! db.execute(sql: "create table t1(b blob);")
+
+		let bytes = (0 ..< 100_000).map { UInt8(truncatingIfNeeded: $0) }
+		let url = temporaryFileURL()
+		try! Data(bytes).write(to: url)
+		defer {
+			try? FileManager.default.removeItem(at: url)
+		}
+
+		let rowid = try! db.insertBLOB(contentsOf: url, table: "t1", column: "b", chunkSize: 4096)
+		let length: Int = try! db.prepare(sql: "select length(b) from t1 where rowid = ?;").bind(parameterValues: [rowid]).front()
+		XCTAssertEqual(length, bytes.count)
+
+		do {
+			let blob = try! db.openBLOB(table: "t1", column: "b", row: rowid, readOnly: true)
+			var result = Data()
+			var maxChunk = 0
+			try! blob.readChunks(chunkSize: 4096) { chunk, offset in
+				XCTAssertEqual(offset, result.count)
+				maxChunk = max(maxChunk, chunk.count)
+				result.append(contentsOf: chunk)
+			}
+			XCTAssertEqual(maxChunk, 4096)
+			XCTAssertEqual(result, Data(bytes))
+
+			let output = OutputStream(toMemory: ())
+			output.open()
+			try! blob.write(to: output, chunkSize: 1000)
+			output.close()
+			XCTAssertEqual(output.property(forKey: .dataWrittenToMemoryStreamKey) as? Data, Data(bytes))
+		}
+
+		let small = InputStream(data: Data([1, 2, 3]))
+		small.open()
+		let rowid2 = try! db.insertBLOB(from: small, length: 3, table: "t1", column: "b")
+		small.close()
+
+		var lengths = [Int64: Int]()
+		try! db.forEachBLOB(inRows: [rowid, rowid2], table: "t1", column: "b") { row, blob in
+			lengths[row] = blob.length
+		}
+		XCTAssertEqual(lengths, [rowid: bytes.count, rowid2: 3])
+
+		let tooShort = InputStream(data: Data([1, 2]))
+		tooShort.open()
+		XCTAssertThrowsError(try db.insertBLOB(from: tooShort, length: 3, table: "t1", column: "b"))
+		let count: Int = try! db.prepare(sql: "select count(*) from t1;").front()
+		XCTAssertEqual(count, 2)
+	}
+
+	func testTupleArrays() {
+		let db = try! Database()
+		try! db.addTupleArrayModule()
+
+		try! db.execute(sql: "create table t1(a, b, c);")
+		for i in 0 ..< 100 {
+			try! db.execute(sql: "insert into t1(a, b, c) values (?, ?, ?);", parameterValues: [i, "\(i % 10)", Data([UInt8(i)])])
+		}
+
+		let keys = ColumnarBatch(fields: [.init(.int64, nullable: false), .init(.text, nullable: false)], capacity: 3)
+		for (a, b) in [(Int64(3), "3"), (Int64(4), "5"), (Int64(42), "2")] {
+			keys.columns[0].append(a)
+			keys.columns[1].append(b)
+		}
+
+		var statement = try! db.prepare(sql: "select a from t1 where (a, b) in (select c0, c1 from tuples(?1)) order by a;")
+		try! statement.bind(tuples: keys, toParameter: 1)
+		var results: [Int] = try! statement.column(0)
+		XCTAssertEqual(results, [3, 42])
+
+		statement = try! db.prepare(sql: "select a from t1 where c in (select c0 from tuples(?1)) order by a;")
+		try! statement.bind(blobs: [Data([7]), Data([99]), Data([200])], toParameter: 1)
+		results = try! statement.column(0)
+		XCTAssertEqual(results, [7, 99])
+
+		let ids: ContiguousArray<Int64> = [5, 6, 500]
+		statement = try! db.prepare(sql: "select a from t1 where a in carray(?1) order by a;")
+		results = try! statement.withCArray(ids, boundToParameter: 1) {
+			try statement.column(0)
+		}
+		XCTAssertEqual(results, [5, 6])
+
+		for (strategy, isTemporaryTable) in [(KeySet.Strategy.tableValuedFunction, false), (.temporaryTable, true)] {
+			let count: Int = try! db.withKeySet(keys, strategy: strategy) { keySet in
+				XCTAssertEqual(keySet.isTemporaryTable, isTemporaryTable)
+				let statement = try db.prepare(sql: "select count(*) from t1 where (a, b) in (\(keySet.subquery));")
+				try keySet.bind(to: statement)
+				return try statement.firstRow()!.value(at: 0)
+			}
+			XCTAssertEqual(count, 2)
+		}
+	}
+
+	func testRowDecoderAndParameterEncoder() {
+		struct Tag: Codable, Equatable {
+			let name: String
+		}
+
+		struct Item: Codable, Equatable {
+			let id: Int64
+			let name: String
+			let score: Double?
+			let flag: Bool
+			let payload: Data
+			let tag: Tag
+		}
+
+		let db = try! Database()
+		try! db.execute(sql: "create table items(id integer primary key, name text, score real, flag integer, payload blob, tag blob);")
+
+		let items = [
+			Item(id: 1, name: "one", score: 1.5, flag: true, payload: Data([1, 2]), tag: Tag(name: "a")),
+			Item(id: 2, name: "two", score: nil, flag: false, payload: Data([3]), tag: Tag(name: "b")),
+		]
+
+		let insert = try! db.prepare(sql: "insert into items(id, name, score, flag, payload, tag) values (:id, :name, :score, :flag, :payload, :tag);")
+		let encoder = ParameterEncoder()
+		for item in items {
+			try! encoder.encode(item, to: insert)
+			try! insert.execute()
+			try! insert.reset()
+		}
+
+		let select = try! db.prepare(sql: "select tag, payload, flag, score, name, id from items order by id;")
+		let decoded: [Item] = try! select.decode()
+		XCTAssertEqual(decoded, items)
+
+		let ids = try! db.prepare(sql: "select id from items order by id;").decode(Int64.self)
+		XCTAssertEqual(ids, [1, 2])
+
+		struct Missing: Decodable {
+			let nonexistent: Int
+		}
+		try! select.reset()
+		XCTAssertThrowsError(try select.decode(Missing.self))
+	}
+
+	func testShardedDatabase() {
+		let urls = [temporaryFileURL(), temporaryFileURL(), temporaryFileURL()]
+		defer {
+			for url in urls {
+				try? FileManager.default.removeItem(at: url)
+			}
+		}
+
+		let writers: [Database] = urls.enumerated().map { i, url in
+			let db = try! Database(url: url, configuration: Database.Configuration(journalMode: .wal))
+			try! db.execute(sql: "create table sales(day, region, total);")
+			for day in 0 ..< 100 {
+				try! db.execute(sql: "insert into sales values (?, ?, ?);", parameterValues: [day * 3 + i, day % 2 == 0 ? "east" : "west", 1])
+			}
+			return db
+		}
+
+		let shards = try! ShardedDatabase(urls: urls, label: "shards")
+		XCTAssertEqual(shards.shardCount, 3)
+
+		let counts: [Int64] = try! shards.read { _, db in
+			return try db.prepare(sql: "select count(*) from sales;").front()
+		}
+		XCTAssertEqual(counts, [100, 100, 100])
+
+		var days = [Int64]()
+		try! shards.merge(sql: "select day from sales order by day;", orderBy: [.init(column: 0)], batchSize: 7) { row in
+			if case .integer(let day) = row[0] {
+				days.append(day)
+			}
+		}
+		XCTAssertEqual(days, (0 ..< 300).map { Int64($0) })
+
+		days.removeAll()
+		try! shards.merge(sql: "select day from sales order by day desc;", orderBy: [.init(column: 0, descending: true)]) { row in
+			if case .integer(let day) = row[0] {
+				days.append(day)
+			}
+		}
+		XCTAssertEqual(days, (0 ..< 300).reversed().map { Int64($0) })
+
+		try! shards.pinSnapshots()
+		try! writers[0].execute(sql: "insert into sales values (1000, 'north', 5);")
+		// A checkpoint followed by a write would restart the WAL if the pinned state were not held open
+		try! writers[0].walCheckpoint(type: .passive)
+		try! writers[0].execute(sql: "insert into sales values (1001, 'north', 5);")
+
+		var groups = [(String, Int64, Int64)]()
+		try! shards.aggregate(sql: "select region, count(*), max(day) from sales group by region order by region;", groupColumnCount: 1, aggregates: [.count, .max]) { row in
+			if case .text(let region) = row[0], case .integer(let count) = row[1], case .integer(let day) = row[2] {
+				groups.append((region, count, day))
+			}
+		}
+		XCTAssertEqual(groups.map { $0.0 }, ["east", "west"])
+		XCTAssertEqual(groups.map { $0.1 }, [150, 150])
+		XCTAssertEqual(groups.map { $0.2 }, [296, 299])
+
+		shards.unpinSnapshots()
+		let total: [Int64] = try! shards.read { _, db in
+			return try db.prepare(sql: "select count(*) from sales where region = 'north';").front()
+		}
+		XCTAssertEqual(total, [2, 0, 0])
+	}
+
+	func testSnapshotDatabasePool() {
+		let url = temporaryFileURL()
+		defer {
+			try? FileManager.default.removeItem(at: url)
+		}
+
+		let pool = try! SnapshotDatabasePool(url: url, maximumReaderCount: 2, refreshPolicy: .manual, label: "snapshot-pool")
+		try! pool.write { db in
+			try db.execute(sql: "create table t1(a);")
+			try db.execute(sql: "insert into t1 default values;")
+		}
+		pool.refreshSnapshot()
+		let generation = pool.generationNumber
+
+		var count: Int = try! pool.read { db in
+			try db.prepare(sql: "select count(*) from t1;").front()
+		}
+		XCTAssertEqual(count, 1)
+
+		try! pool.write { db in
+			try db.execute(sql: "insert into t1 default values;")
+		}
+
+		// Reads in the same generation observe the same snapshot
+		count = try! pool.read { db in
+			try db.prepare(sql: "select count(*) from t1;").front()
+		}
+		XCTAssertEqual(count, 1)
+		XCTAssertEqual(pool.generationNumber, generation)
+
+		pool.refreshSnapshot()
+		XCTAssertEqual(pool.generationNumber, generation + 1)
+		count = try! pool.read { db in
+			try db.prepare(sql: "select count(*) from t1;").front()
+		}
+		XCTAssertEqual(count, 2)
+
+		let committing = try! SnapshotDatabasePool(url: url, refreshPolicy: .afterCommit, label: "committing-pool")
+		let before = committing.generationNumber
+		try! committing.write { db in
+			try db.execute(sql: "insert into t1 default values;")
+		}
+		// Wait for the refresh scheduled by the commit
+		committing.anchor.queue.sync {
+		}
+		XCTAssertGreaterThan(committing.generationNumber, before)
+		count = try! committing.read { db in
+			try db.prepare(sql: "select count(*) from t1;").front()
+		}
+		XCTAssertEqual(count, 3)
+	}
+
+	func testWALCheckpointScheduler() {
+		let url = temporaryFileURL()
+		defer {
+			try? FileManager.default.removeItem(at: url)
+		}
+
+		let dbQueue = try! DatabaseQueue(url: url, configuration: Database.Configuration(journalMode: .wal, journalSizeLimit: 0), label: "writer")
+		let scheduler = try! WALCheckpointScheduler(url: url, policy: .init(passiveThreshold: 10, idleInterval: 60), label: "checkpoint")
+		scheduler.attach(to: dbQueue)
+
+		try! dbQueue.sync { db in
+			try db.execute(sql: "create table t1(a);")
+			for i in 0 ..< 50 {
+				try db.execute(sql: "insert into t1(a) values (?);", parameterValues: [i])
+			}
+		}
+
+		let semaphore = DispatchSemaphore(value: 0)
+		var result: WALCheckpointScheduler.Checkpoint? = nil
+		scheduler.checkpoint(type: .truncate) { checkpoint in
+			result = checkpoint
+			semaphore.signal()
+		}
+		semaphore.wait()
+
+		XCTAssertEqual(result?.logFrameCount, 0)
+		let metrics = scheduler.metrics
+		XCTAssertGreaterThan(metrics.checkpointCount, 1)
+		XCTAssertGreaterThan(metrics.checkpointedFrameCount, 0)
+		XCTAssertEqual(metrics.failedCheckpointCount, 0)
+		XCTAssertGreaterThanOrEqual(metrics.logFrameCount, 10)
+
+		// Repeated checkpoints of the same log count each backfilled frame once
+		let checkpointedFrameCount = metrics.checkpointedFrameCount
+		try! dbQueue.sync { db in
+			try db.transaction { db in
+				for i in 50 ..< 53 {
+					try db.execute(sql: "insert into t1(a) values (?);", parameterValues: [i])
+				}
+				return .commit
+			}
+		}
+		var checkpoints = [WALCheckpointScheduler.Checkpoint]()
+		for _ in 0 ..< 2 {
+			scheduler.checkpoint(type: .passive) { checkpoint in
+				checkpoints.append(checkpoint)
+				semaphore.signal()
+			}
+			semaphore.wait()
+		}
+		XCTAssertGreaterThan(checkpoints[0].checkpointedFrameCount ?? 0, 0)
+		XCTAssertEqual(checkpoints[0].checkpointedFrameCount, checkpoints[1].checkpointedFrameCount)
+		XCTAssertEqual(scheduler.metrics.checkpointedFrameCount, checkpointedFrameCount + checkpoints[0].checkpointedFrameCount!)
+
+		// Truncating a fully backfilled log doesn't count any frames
+		scheduler.checkpoint(type: .truncate) { _ in
+			semaphore.signal()
+		}
+		semaphore.wait()
+		XCTAssertEqual(scheduler.metrics.checkpointedFrameCount, checkpointedFrameCount + checkpoints[0].checkpointedFrameCount!)
+
+		let count: Int = try! dbQueue.sync { db in
+			try db.prepare(sql: "select count(*) from t1;").front()
+		}
+		XCTAssertEqual(count, 53)
+	}
+
+	func testGroupCommitQueue() {
+		let dbQueue = try! DatabaseQueue(label: "dbQueue")
+		try! dbQueue.sync { db in
+			try db.execute(sql: "create table t1(a unique);")
+		}
+
+		let writer = GroupCommitQueue(databaseQueue: dbQueue, maximumBatchSize: 16, maximumDelay: 0.01)
+		let lock = NSLock()
+		var successCount = 0
+		var failureCount = 0
+		for i in 0 ..< 100 {
+			writer.submit({ db in
+				// Violates the unique constraint
+				try db.execute(sql: "insert into t1(a) values (?);", parameterValues: [i == 50 ? 49 : i])
+				return i == 60 ? .rollback : .release
+			}, completion: { result in
+				lock.lock()
+				if case .success = result {
+					successCount += 1
+				}
+				else {
+					failureCount += 1
+				}
+				lock.unlock()
+			})
+		}
+		writer.flush()
+
+		XCTAssertEqual(successCount, 99)
+		XCTAssertEqual(failureCount, 1)
+
+		let count: Int = try! dbQueue.sync { db in
+			XCTAssertTrue(db.isInAutocommitMode)
+			return try db.prepare(sql: "select count(*) from t1;").front()
+		}
+		XCTAssertEqual(count, 98)
+	}
+
+	func testQueryBudget() {
+		let db = try! Database()
+		let sql = "with recursive c(x) as (select 1 union all select x + 1 from c) select count(*) from c;"
+
+		XCTAssertThrowsError(try db.withBudget(.init(instructionLimit: 100_000)) { db in
+			try db.execute(sql: sql)
+		}) { error in
+			XCTAssertEqual((error as? QueryBudgetExceededError)?.reason, .instructionLimit)
+		}
+
+		XCTAssertThrowsError(try db.withBudget(.init(timeLimit: 0.05)) { db in
+			try db.execute(sql: sql)
+		}) { error in
+			XCTAssertEqual((error as? QueryBudgetExceededError)?.reason, .timeLimit)
+		}
+
+		let token = QueryCancellationToken()
+		DispatchQueue.global().asyncAfter(deadline: .now() + 0.05) {
+			token.cancel()
+		}
+		XCTAssertThrowsError(try db.withBudget(.init(cancellationToken: token)) { db in
+			try db.execute(sql: sql)
+		}) { error in
+			XCTAssertEqual((error as? QueryBudgetExceededError)?.reason, .cancelled)
+		}
+
+		// Operations within the budget and other operations on the connection are unaffected
+		let count: Int = try! db.withBudget(.init(instructionLimit: 1_000_000)) { db in
+			try db.prepare(sql: "with recursive c(x) as (select 1 union all select x + 1 from c where x < 10) select count(*) from c;").front()
+		}
+		XCTAssertEqual(count, 10)
+		XCTAssertNil(db.progressHandler)
+	}
+
+	func testParameterBinder() {
+		let db = try! Database()
+
+		try! db.execute(sql: "create table t1(a, b, c);")
+
+		let statement = try! db.prepare(sql: "insert into t1(a, b, c) values (:a, :b, :c);")
+		let binder = try! statement.binder(names: [":c", ":a", ":b"])
+		XCTAssertEqual(binder.indexes, [3, 1, 2])
+		XCTAssertThrowsError(try statement.binder(names: [":d"]))
+
+		for i in 0 ..< 10 {
+			try! binder.bind(Data([UInt8(i)]), i, i % 2 == 0 ? "even" : nil)
+			try! statement.execute()
+			try! statement.reset()
+		}
+
+		let text = String(repeating: "feisty", count: 100)
+		try! binder.withBorrowedText(text, at: 2) {
+			try binder.bind(nil as Data?, at: 0)
+			try binder.bind(10, at: 1)
+			try statement.execute()
+		}
+		try! statement.reset()
+
+		try! statement.withBorrowedBLOB(Data(), toParameter: 3) {
+			try statement.execute()
+		}
+
+		XCTAssertEqual(try! db.prepare(sql: "select count(*) from t1 where b = 'even';").front(), 5)
+		XCTAssertEqual(try! db.prepare(sql: "select b from t1 where a = 10;").front(), text)
+		XCTAssertEqual(try! db.prepare(sql: "select length(c) from t1 where a = 10 and b is null;").front(), 0)
+		XCTAssertEqual(try! db.prepare(sql: "select c from t1 where a = 3;").front(), Data([3]))
+
+		let positional = try! db.prepare(sql: "select ?1 + ?2;").binder()
+		try! positional.bind(2, 3)
+		XCTAssertEqual(try! positional.statement.front(), 5)
+	}
+
+	func testOptimizeAndScanStatus() {
+		let db = try! Database()
+
+		try! db.execute(sql: "create table t1(a, b);")
+		try! db.execute(sql: "create index t1_a on t1(a);")
+		for i in 0 ..< 100 {
+			try! db.execute(sql: "insert into t1(a, b) values (?, ?);", parameterValues: [i, i % 10])
+		}
+
+		XCTAssertEqual(try! db.setAnalysisLimit(100), 100)
+		XCTAssertNoThrow(try db.optimize(analysisLimit: 200, mask: 0x10002))
+		XCTAssertEqual(try! db.prepare(sql: "PRAGMA analysis_limit;").front(), 100)
+		XCTAssertNoThrow(try db.optimize())
+		XCTAssertEqual(try! db.prepare(sql: "PRAGMA analysis_limit;").front(), 100)
+
+		let statement = try! db.prepare(sql: "select count(*) from t1 where b = 3;")
+		XCTAssertEqual(try! statement.front(), 10)
+		let status = statement.scanStatus()
+		if Statement.scanStatusIsAvailable {
+			XCTAssertEqual(status.first?.name, "t1")
+			XCTAssertEqual(status.first?.loopCount, 1)
+			XCTAssertEqual(status.first?.rowsVisited, 100)
+		}
+		else {
+			XCTAssertTrue(status.isEmpty)
+		}
+		statement.resetScanStatus()
+	}
+
+	func testExplainQueryPlan() {
+		let db = try! Database()
+
+		try! db.execute(sql: "create table t1(a, b);")
+		try! db.execute(sql: "create index t1_a on t1(a);")
+		try! db.execute(sql: "create table t2(c);")
+		for i in 0 ..< 50 {
+			try! db.execute(sql: "insert into t1(a, b) values (?, ?);", parameterValues: [i, i])
+			try! db.execute(sql: "insert into t2(c) values (?);", parameterValues: [i % 5])
+		}
+
+		let search = try! db.prepare(sql: "select b from t1 where a = ?;")
+		let searchPlan = try! search.explainQueryPlan(parameterValues: [3])
+		XCTAssertEqual(searchPlan.nodes.count, 1)
+		XCTAssertTrue(searchPlan.nodes[0].detail.hasPrefix("SEARCH"))
+		XCTAssertTrue(searchPlan.nodes[0].detail.contains("t1_a"))
+		XCTAssertTrue(searchPlan.fullScans.isEmpty)
+
+		let statement = try! db.prepare(sql: "select count(*) from t1 where b in (select c from t2);")
+		XCTAssertEqual(try! statement.front(), 5)
+		let plan = try! statement.explainQueryPlan()
+		XCTAssertEqual(plan.fullScans.count, 2)
+		let subquery = plan.allNodes.first { $0.detail.contains("SUBQUERY") }
+		XCTAssertNotNil(subquery)
+		XCTAssertTrue(subquery?.children.allSatisfy { $0.parentID == subquery?.id } ?? false)
+		XCTAssertEqual(subquery?.children.first?.detail.contains("t2"), true)
+		XCTAssertTrue(subquery?.children.first?.isFullScan ?? false)
+		XCTAssertTrue(plan.description.contains("\n  "))
+
+		if Statement.scanStatusIsAvailable {
+			let scan = plan.fullScans.first { $0.detail.contains("t2") }
+			XCTAssertEqual(scan?.scanStatus?.rowsVisited, 50)
+		}
+		else {
+			XCTAssertTrue(plan.allNodes.allSatisfy { $0.scanStatus == nil })
+		}
+	}
+
+	func testWALCommitHookOnNewConnection() {
+		let url = temporaryFileURL()
+		defer {
+			try? FileManager.default.removeItem(at: url)
+		}
+
+		// A new connection has SQLite's automatic checkpoint installed as its write-ahead log hook
+		let db = try! Database(url: url, configuration: Database.Configuration(journalMode: .wal))
+		var pageCounts = [Int]()
+		db.setWALCommitHook { _, pageCount in
+			pageCounts.append(pageCount)
+			return SQLITE_OK
+		}
+		try! db.execute(sql: "create table t1(a);")
+		XCTAssertEqual(pageCounts.count, 1)
+		db.setWALCommitHook { _, _ in SQLITE_OK }
+		db.removeWALCommitHook()
+
+		// The pool installs its hook on a new writer connection
+		var pool: SnapshotDatabasePool? = try! SnapshotDatabasePool(url: url, maximumReaderCount: 1, refreshPolicy: .afterCommit, label: "snapshot-pool")
+		try! pool!.write { db in
+			try db.execute(sql: "insert into t1 default values;")
+		}
+		pool = nil
+		pool = try! SnapshotDatabasePool(url: url, maximumReaderCount: 1, label: "snapshot-pool")
+		let count: Int = try! pool!.read { db in
+			try db.prepare(sql: "select count(*) from t1;").front()
+		}
+		XCTAssertEqual(count, 1)
+	}
+
+	func testCodableNestedValues() {
+		struct Location: Codable, Equatable {
+			let x: Int
+			let y: Int
+		}
+
+		struct Event: Codable, Equatable {
+			let id: Int64
+			let location: Location
+			let tags: [String]
+			let note: String?
+		}
+
+		let db = try! Database()
+		try! db.execute(sql: "create table events(id integer primary key, location blob, tags blob, note text);")
+
+		let events = [Event(id: 1, location: Location(x: 3, y: 4), tags: ["a", "b"], note: nil), Event(id: 2, location: Location(x: -1, y: 0), tags: [], note: "n")]
+		let insert = try! db.prepare(sql: "insert into events(id, location, tags, note) values (:id, :location, :tags, :note);")
+		for event in events {
+			try! insert.bind(encoding: event)
+			try! insert.execute()
+			try! insert.reset()
+		}
+
+		// Nested values are stored as JSON
+		let tag: String = try! db.prepare(sql: "select json_extract(tags, '$[1]') from events where id = 1;").front()
+		XCTAssertEqual(tag, "b")
+
+		let decoded: [Event] = try! db.prepare(sql: "select id, location, tags, note from events order by id;").decode()
+		XCTAssertEqual(decoded, events)
+
+		struct Nested: Codable {
+			let x: Int
+
+			enum CodingKeys: String, CodingKey {
+				case location
+			}
+
+			enum LocationKeys: String, CodingKey {
+				case x
+			}
+
+			init(x: Int) {
+				self.x = x
+			}
+
+			init(from decoder: Decoder) throws {
+				let container = try decoder.container(keyedBy: CodingKeys.self)
+				let location = try container.nestedContainer(keyedBy: LocationKeys.self, forKey: .location)
+				x = try location.decode(Int.self, forKey: .x)
+			}
+
+			func encode(to encoder: Encoder) throws {
+				var container = encoder.container(keyedBy: CodingKeys.self)
+				var location = container.nestedContainer(keyedBy: LocationKeys.self, forKey: .location)
+				try location.encode(x, forKey: .x)
+			}
+		}
+
+		// Nested containers are unsupported in both directions
+		let nested = try! db.prepare(sql: "select :location;")
+		XCTAssertThrowsError(try nested.bind(encoding: Nested(x: 1)))
+		XCTAssertThrowsError(try db.prepare(sql: "select location from events;").decode() as [Nested])
+	}
+
+	func testSnapshotDatabasePoolSupersededGeneration() {
+		let url = temporaryFileURL()
+		defer {
+			try? FileManager.default.removeItem(at: url)
+		}
+
+		let pool = try! SnapshotDatabasePool(url: url, maximumReaderCount: 1, refreshPolicy: .manual, label: "superseded-pool")
+		try! pool.write { db in
+			try db.execute(sql: "create table t1(a);")
+			try db.execute(sql: "insert into t1 default values;")
+		}
+		pool.refreshSnapshot()
+
+		// Release the current generation's snapshot as an advance does, then reset the write-ahead log to invalidate it
+		pool.anchor.queue.sync {
+			try! pool.anchor.database.endReadTransaction()
+			pool.isAnchored = false
+		}
+		try! pool.write { db in
+			try db.walCheckpoint(type: .truncate)
+			try db.execute(sql: "insert into t1 default values;")
+		}
+
+		// Without a new generation the snapshot can't be opened
+		XCTAssertThrowsError(try pool.read { _ in })
+
+		// A read racing an advance is retried on the new generation
+		let generation = pool.generationNumber
+		pool.anchor.queue.async {
+			Thread.sleep(forTimeInterval: 0.1)
+			pool.advanceGeneration()
+		}
+		let count: Int = try! pool.read { db in
+			try db.prepare(sql: "select count(*) from t1;").front()
+		}
+		XCTAssertEqual(count, 2)
+		XCTAssertEqual(pool.generationNumber, generation + 1)
+	}
+
 	#if SQLITE_ENABLE_PREUPDATE_HOOK
 
 	func testPreUpdateHook() {
@@ -1038,6 +2539,98 @@ class FeistyDBTests: XCTestCase {
 		XCTAssert(count == 0)
 	}
 
+	func testStreamingChangeset() {
+		let db1 = try! Database()
+		let db2 = try! Database()
+
+		let sql = "CREATE TABLE birds(id integer primary key, kind);"
+
+		try! db1.execute(sql: sql)
+		try! db2.execute(sql: sql)
+
+		let session = try! Session(database: db1, schema: "main")
+		try! session.attach("birds")
+
+		for kind in ["robin", "cardinal", "finch", "sparrow", "utahraptor"] {
+			try! db1.execute(sql: "insert into birds(kind) values (?);", parameterValues: [kind])
+		}
+
+		var chunks = [Data]()
+		try! session.changeset(streamingTo: { chunk in
+			chunks.append(Data(chunk))
+		})
+		let data = chunks.reduce(Data(), +)
+		XCTAssertEqual(data, try! session.changeset().data)
+
+		var offset = 0
+		try! db2.apply(streamingFrom: { buffer in
+			let count = min(buffer.count, data.count - offset, 7)
+			data.copyBytes(to: buffer.bindMemory(to: UInt8.self), from: offset ..< offset + count)
+			offset += count
+			return count
+		}) { conflict in
+			.abort
+		}
+
+		let birds: [String] = try! db2.prepare(sql: "select kind from birds order by id;").column(0)
+		XCTAssertEqual(birds, ["robin", "cardinal", "finch", "sparrow", "utahraptor"])
+	}
+
+	func testChangesetReplicator() {
+		let leader = try! Database()
+		let follower = try! Database()
+
+		let sql = "CREATE TABLE birds(id integer primary key, kind);"
+
+		try! leader.execute(sql: sql)
+		try! follower.execute(sql: sql)
+
+		#if canImport(Compression)
+		let compression = ChangesetReplicator.Compression.zlib
+		#else
+		let compression = ChangesetReplicator.Compression.none
+		#endif
+
+		let replicator = try! ChangesetReplicator(compression: compression, chunkSize: 64)
+
+		for batch in 0 ..< 3 {
+			let session = try! Session(database: leader, schema: "main")
+			try! session.attachAll()
+			for i in 0 ..< 100 {
+				try! leader.execute(sql: "insert into birds(kind) values (?);", parameterValues: ["bird \(batch)-\(i)"])
+			}
+			try! leader.execute(sql: "delete from birds where id % 10 = 0;")
+			try! replicator.add(session)
+		}
+		XCTAssertEqual(replicator.pendingChangesetCount, 3)
+
+		let batch = try! replicator.flush()
+		XCTAssertEqual(replicator.pendingChangesetCount, 0)
+
+		try! ChangesetReplicator.apply(batch, compression: compression, to: follower) { conflict in
+			.abort
+		}
+
+		let leaderCount: Int = try! leader.prepare(sql: "select count(*) from birds;").front()
+		let followerCount: Int = try! follower.prepare(sql: "select count(*) from birds;").front()
+		XCTAssertEqual(leaderCount, 270)
+		XCTAssertEqual(followerCount, leaderCount)
+
+		// A truncated batch applied to an empty follower has no conflicts, so only truncation causes an error
+		for length in [batch.count / 2, batch.count - 1] {
+			let fresh = try! Database()
+			try! fresh.execute(sql: sql)
+			var conflictCount = 0
+			XCTAssertThrowsError(try ChangesetReplicator.apply(batch.prefix(length), compression: compression, to: fresh) { conflict in
+				conflictCount += 1
+				return .abort
+			})
+			XCTAssertEqual(conflictCount, 0)
+			let count: Int = try! fresh.prepare(sql: "select count(*) from birds;").front()
+			XCTAssertEqual(count, 0)
+		}
+	}
+
 	#endif
 
 }